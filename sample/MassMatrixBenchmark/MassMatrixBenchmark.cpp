@@ -0,0 +1,115 @@
+/**
+   This program compares the composite-rigid-body algorithm of calcMassMatrix with the
+   unit vector method on the sample humanoid models. The model files can also be given
+   as the command line arguments.
+*/
+
+#include <cnoid/MassMatrix>
+#include <cnoid/BodyLoader>
+#include <cnoid/Link>
+#include <cnoid/ExecutablePath>
+#include <cnoid/MathUtil>
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <cstdio>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+const int NumPostures = 100;
+const int NumRepetitions = 100;
+
+template<class Function>
+double measure(Function func)
+{
+    auto start = std::chrono::steady_clock::now();
+    for(int i=0; i < NumRepetitions; ++i){
+        func();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::micro>(elapsed).count() / NumRepetitions;
+}
+
+void runBenchmark(Body* body)
+{
+    const int nj = body->numJoints();
+    std::mt19937 engine(0);
+    std::uniform_real_distribution<double> ratio(0.0, 1.0);
+
+    Vector3 g(0.0, 0.0, 9.8);
+    MatrixXd M1, M2, LTDL;
+    VectorXd b1, b2, x1, x2;
+    vector<int> parents;
+    getMassMatrixParentIndices(body, parents);
+
+    double timeUnitVector = 0.0;
+    double timeCRBA = 0.0;
+    double timeLDLT = 0.0;
+    double timeLTDL = 0.0;
+    double maxMatrixError = 0.0;
+    double maxSolutionError = 0.0;
+
+    for(int i=0; i < NumPostures; ++i){
+        Link* rootLink = body->rootLink();
+        rootLink->p() = Vector3::Random();
+        rootLink->R() = AngleAxis(ratio(engine) * 2.0 * PI, Vector3::Random().normalized()).toRotationMatrix();
+        for(int j=0; j < nj; ++j){
+            Link* joint = body->joint(j);
+            double lower = std::max(joint->q_lower(), -PI);
+            double upper = std::min(joint->q_upper(), PI);
+            joint->q() = lower + (upper - lower) * ratio(engine);
+        }
+        body->calcForwardKinematics();
+
+        timeUnitVector += measure([&](){ calcMassMatrixWithUnitVectorMethod(body, g, M1, b1); });
+        timeCRBA += measure([&](){ calcMassMatrix(body, g, M2, b2); });
+        maxMatrixError = std::max(maxMatrixError, (M1 - M2).cwiseAbs().maxCoeff());
+
+        VectorXd tau = VectorXd::Random(M1.rows());
+        timeLDLT += measure([&](){ x1 = M1.ldlt().solve(tau); });
+        timeLTDL += measure([&](){
+            LTDL = M2;
+            factorizeMassMatrixLTDL(LTDL, parents);
+            x2 = tau;
+            solveMassMatrixLTDL(LTDL, parents, x2);
+        });
+        maxSolutionError = std::max(maxSolutionError, (x1 - x2).cwiseAbs().maxCoeff());
+    }
+
+    printf("%s (%d DOF)\n", body->modelName().c_str(), (int)M1.rows());
+    printf("  unit vector method: %8.2f us\n", timeUnitVector / NumPostures);
+    printf("  CRBA              : %8.2f us (max error %g)\n", timeCRBA / NumPostures, maxMatrixError);
+    printf("  dense LDLT solve  : %8.2f us\n", timeLDLT / NumPostures);
+    printf("  sparse LTDL solve : %8.2f us (max error %g)\n", timeLTDL / NumPostures, maxSolutionError);
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    vector<string> files;
+    for(int i=1; i < argc; ++i){
+        files.push_back(argv[i]);
+    }
+    if(files.empty()){
+        const string modelDir = shareDir() + "/model/";
+        files.push_back(modelDir + "SR1/SR1.body");
+        files.push_back(modelDir + "GR001/GR001.body");
+        files.push_back(modelDir + "RIC30/RIC30.body");
+    }
+
+    BodyLoader loader;
+    for(auto& file : files){
+        BodyPtr body = loader.load(file);
+        if(!body){
+            cerr << "\"" << file << "\" cannot be loaded." << endl;
+            continue;
+        }
+        runBenchmark(body);
+    }
+
+    return 0;
+}
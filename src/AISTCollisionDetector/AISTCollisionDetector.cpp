@@ -4,16 +4,28 @@
 #include <cnoid/SceneDrawables>
 #include <cnoid/MeshExtractor>
 #include <cnoid/ThreadPool>
+#include <cnoid/CollisionBroadphase>
+#include <cnoid/UTF8>
+#include <cnoid/stdx/filesystem>
+#include <fmt/format.h>
 #include <algorithm>
-#include <random>
+#include <atomic>
+#include <chrono>
 #include <set>
+#include <unordered_map>
+#include <mutex>
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
 
 using namespace std;
 using namespace cnoid;
+namespace filesystem = cnoid::stdx::filesystem;
 
 namespace {
 
-const bool ENABLE_SHUFFLE = false;
+// The target number of chunks per thread in the parallel detection
+const int NumChunksPerThread = 4;
 
 typedef CollisionDetector::GeometryHandle GeometryHandle;
 
@@ -41,10 +53,156 @@ public:
     bool isStatic;
     stdx::optional<Isometry3> localPosition;
     ColdetModelExPtr sibling;
+    // Bounding box of the vertices in the local coordinate
+    BoundingBox localBoundingBox;
+    // Bounding box including the siblings in the world coordinate
+    BoundingBox worldBoundingBox;
+    // Index in the models array, which is also the object id of the broadphase
+    int index;
+    // The current position and its revision, which is incremented when the position is changed
+    Isometry3 position;
+    unsigned int positionRevision;
     
-    ColdetModelEx() : groupId(0), isEnabled(true), isStatic(false) { }
+    ColdetModelEx() : groupId(0), isEnabled(true), isStatic(false), index(-1) {
+        position.setIdentity();
+        positionRevision = 0;
+    }
+
+    // The built model is shared with the original model
+    ColdetModelEx(const ColdetModel& org, const BoundingBox& bbox)
+        : ColdetModel(org), groupId(0), isEnabled(true), isStatic(false), localBoundingBox(bbox), index(-1) {
+        position.setIdentity();
+        positionRevision = 0;
+    }
+
+    void updatePosition(const Isometry3& T){
+        if(T.matrix() != position.matrix()){
+            setPosition(T);
+            position = T;
+            ++positionRevision;
+        }
+    }
 };
 
+/**
+   The built models are shared by the models with the same vertices, triangles and primitive.
+   The vertices are stored after the transform of the shape is applied, so the scale
+   is also included in the key. The cache is disabled by default. When it is enabled, the
+   entries are kept until clear() is called so that the models are reused in the next simulation.
+   The initial state can be given by the environment variables CNOID_ENABLE_AIST_MODEL_CACHE
+   and CNOID_AIST_MODEL_CACHE_DIR. Specifying the directory also enables the cache.
+*/
+class ModelCache
+{
+public:
+    struct Entry {
+        ColdetModelPtr model;
+        BoundingBox bbox;
+    };
+    
+    std::mutex mutex;
+    std::atomic<bool> isEnabled;
+    string directory;
+    unordered_map<uint64_t, vector<Entry>> hashToEntries;
+
+    ModelCache() : isEnabled(false) {
+        char* CNOID_AIST_MODEL_CACHE_DIR = getenv("CNOID_AIST_MODEL_CACHE_DIR");
+        if(CNOID_AIST_MODEL_CACHE_DIR && CNOID_AIST_MODEL_CACHE_DIR[0] != '\0'){
+            directory = CNOID_AIST_MODEL_CACHE_DIR;
+            stdx::error_code ec;
+            filesystem::create_directories(filesystem::path(fromUTF8(directory)), ec);
+            isEnabled = true;
+        }
+        char* CNOID_ENABLE_AIST_MODEL_CACHE = getenv("CNOID_ENABLE_AIST_MODEL_CACHE");
+        if(CNOID_ENABLE_AIST_MODEL_CACHE){
+            isEnabled = (strcmp(CNOID_ENABLE_AIST_MODEL_CACHE, "0") != 0);
+        }
+    }
+
+    int numModels(){
+        std::lock_guard<std::mutex> lock(mutex);
+        int n = 0;
+        for(auto& kv : hashToEntries){
+            n += kv.second.size();
+        }
+        return n;
+    }
+
+    // The primitive information is shared with the built model
+    static bool hasSamePrimitive(ColdetModel* model1, ColdetModel* model2){
+        if(model1->getPrimitiveType() != model2->getPrimitiveType()){
+            return false;
+        }
+        float value1, value2;
+        for(int i=0; model1->getPrimitiveParam(i, value1); ++i){
+            if(!model2->getPrimitiveParam(i, value2) || value1 != value2){
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool find(ColdetModel* model, uint64_t hash, Entry& out_entry){
+        std::lock_guard<std::mutex> lock(mutex);
+        auto p = hashToEntries.find(hash);
+        if(p != hashToEntries.end()){
+            for(auto& entry : p->second){
+                if(entry.model->hasSameMesh(*model) && hasSamePrimitive(entry.model, model)){
+                    out_entry = entry;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void add(ColdetModel* model, uint64_t hash, const BoundingBox& bbox){
+        std::lock_guard<std::mutex> lock(mutex);
+        hashToEntries[hash].push_back(Entry{ new ColdetModel(*model), bbox });
+    }
+
+    string getFilename(uint64_t hash){
+        std::lock_guard<std::mutex> lock(mutex);
+        if(directory.empty()){
+            return string();
+        }
+        return (filesystem::path(fromUTF8(directory)) / fmt::format("{:016x}.coldet", hash)).string();
+    }
+
+    ColdetModelExPtr load(ColdetModelEx* model, const string& filename){
+        ifstream ifs(filename, ios::in | ios::binary);
+        if(!ifs){
+            return nullptr;
+        }
+        ColdetModelExPtr loaded = new ColdetModelEx;
+        if(!loaded->readBuiltModel(ifs) || !loaded->hasSameMesh(*model)){
+            return nullptr;
+        }
+        loaded->localBoundingBox = model->localBoundingBox;
+        return loaded;
+    }
+
+    void save(ColdetModel* model, const string& filename){
+        // The file is renamed after it is completely written so that other processes
+        // reading the same directory never see a partially written file
+        string tmpFilename = filename + fmt::format(".{}.tmp", reinterpret_cast<uintptr_t>(model));
+        bool saved = false;
+        {
+            ofstream ofs(tmpFilename, ios::out | ios::binary | ios::trunc);
+            saved = ofs && model->writeBuiltModel(ofs);
+        }
+        stdx::error_code ec;
+        if(saved){
+            filesystem::rename(filesystem::path(tmpFilename), filesystem::path(filename), ec);
+        }
+        if(!saved || ec){
+            filesystem::remove(filesystem::path(tmpFilename), ec);
+        }
+    }
+};
+
+ModelCache modelCache;
+
 class ColdetModelPairEx;
 typedef ref_ptr<ColdetModelPairEx> ColdetModelPairExPtr;
 
@@ -60,17 +218,28 @@ GeometryHandle getHandle(ColdetModelEx* model)
 
 class ColdetModelPairEx : public ColdetModelPair
 {
-    ColdetModelPairEx(){ }
+    ColdetModelPairEx() : cost(0.0) {
+        initializeCache();
+    }
     
 public:
     ColdetModelPairEx(ColdetModelEx* model1, ColdetModelEx* model2)
         : ColdetModelPair(model1, model2)
     {
+        initializeCache();
+
+        // A sphere and a non-primitive mesh are detected with the triangles
+        setSphereMeshColliderEnabled(false);
+
+        // The initial cost is estimated from the mesh sizes until the actual time is measured
+        cost = 1.0e-9 * (model1->getNumTriangles() + model2->getNumTriangles());
+        
         ColdetModelPairEx* last = this;
         for(auto sibling1 = model1->sibling; sibling1; sibling1 = sibling1->sibling){
             for(auto sibling2 = model2->sibling; sibling2; sibling2 = sibling2->sibling){
                 last->sibling = new ColdetModelPairEx;
                 last->sibling->set(sibling1, sibling2);
+                last->sibling->setSphereMeshColliderEnabled(false);
                 last = last->sibling->sibling;
             }
         }
@@ -81,6 +250,80 @@ public:
     }
 
     ColdetModelPairExPtr sibling;
+
+    // The detection time in seconds measured in the last parallel detection
+    double cost;
+
+    // The collisions are kept as the result of the detection at these positions
+    bool hasCache;
+    unsigned int cachedPositionRevisions[2];
+    Isometry3 cachedRelativePosition;
+    Isometry3 cachedPosition0;
+
+    // The axis that separated the bounding boxes in the last detection or -1
+    int separatingAxis;
+
+    void initializeCache(){
+        hasCache = false;
+        separatingAxis = -1;
+    }
+};
+
+
+/**
+   The bounding boxes in the local coordinates are tested as oriented boxes in the coordinate of box 0.
+   The axes 0-2 are the box 0 axes, 3-5 are the box 1 axes and 6-14 are their cross products.
+*/
+class OrientedBoxSeparationTest
+{
+    Vector3 h0;
+    Vector3 h1;
+    Vector3 t;
+    Matrix3 R;
+    Matrix3 Q;
+
+public:
+    OrientedBoxSeparationTest(const BoundingBox& bbox0, const BoundingBox& bbox1, const Isometry3& T01)
+    {
+        h0 = bbox0.size() / 2.0;
+        h1 = bbox1.size() / 2.0;
+        R = T01.linear();
+        t = T01 * bbox1.center() - bbox0.center();
+        // The small value avoids the degeneracy of the parallel edges
+        Q = (R.cwiseAbs().array() + 1.0e-9).matrix();
+    }
+
+    bool isSeparatedBy(int axis) const
+    {
+        if(axis < 3){
+            return fabs(t[axis]) > h0[axis] + h1.dot(Q.row(axis));
+        } else if(axis < 6){
+            const int j = axis - 3;
+            return fabs(t.dot(R.col(j))) > h0.dot(Q.col(j)) + h1[j];
+        }
+        const int i = (axis - 6) / 3;
+        const int j = (axis - 6) % 3;
+        const Vector3 a = Vector3::Unit(i).cross(R.col(j));
+        if(a.squaredNorm() < 1.0e-12){
+            return false;
+        }
+        const double r0 = (h0.array() * a.array().abs()).sum();
+        const double r1 = (h1.array() * (R.transpose() * a).array().abs()).sum();
+        return fabs(t.dot(a)) > r0 + r1;
+    }
+
+    int findSeparatingAxis(int hint) const
+    {
+        if(hint >= 0 && isSeparatedBy(hint)){
+            return hint;
+        }
+        for(int axis=0; axis < 15; ++axis){
+            if(axis != hint && isSeparatedBy(axis)){
+                return axis;
+            }
+        }
+        return -1;
+    }
 };
 
 
@@ -129,23 +372,44 @@ class AISTCollisionDetector::Impl
 public:
     vector<ColdetModelExPtr> models;
     vector<ColdetModelPairExPtr> modelPairs;
+    // Pairs to be checked in the narrow-phase detection
+    vector<ColdetModelPairEx*> activeModelPairs;
     int maxNumThreads;
     set<IdPair<GeometryHandle>> ignoredPairs;
     set<IdPair<int>> ignoredGroupPairs;
     MeshExtractor* meshExtractor;
     bool isReady;
     bool isDynamicGeometryPairChangeEnabled;
+    bool isBroadphaseEnabled;
+    bool isPrimitiveNarrowphaseEnabled;
     CollisionPair collisionPair;
+
+    // The primitive of the geometry being added, which is used when the geometry consists of a single primitive mesh
+    int numExtractedMeshes;
+    ColdetModel::PrimitiveType primitiveType;
+    vector<float> primitiveParams;
+    Isometry3 primitivePosition;
+
+    CollisionBroadphase broadphase;
+    // The value is null if the pair is disabled by the group or ignored pair setting
+    unordered_map<IdPair<int>, ColdetModelPairExPtr> broadphasePairMap;
         
     Impl();
     Impl(const AISTCollisionDetector::Impl& org);
     ~Impl();
     void initialize();
     stdx::optional<GeometryHandle> addGeometry(SgNode* geometry);
+    ColdetModelExPtr getCachedModel(ColdetModelExPtr model);
     void addMesh(ColdetModelEx* model);
+    void extractPrimitive(SgMesh* mesh);
+    void setPrimitive(ColdetModel* model);
     void makeReady();
+    void expandWorldBoundingBox(ColdetModelEx* model, const Isometry3& T, BoundingBox& io_bbox);
+    void updateBroadphaseObject(ColdetModelEx* model, const BoundingBox& bbox);
+    void updateActiveModelPairs();
     bool checkIfGroupPairEnabled(int groupId1, int groupId2);
     bool checkIfModelPairEnabled(ColdetModelPairEx* modelPair);
+    bool checkIfModelPairEnabled(ColdetModelEx* model0, ColdetModelEx* model1);
     void detectCollisions(GeometryHandle geometry, const std::function<void(const CollisionPair&)>& callback);
     void detectCollisions(const std::function<void(const CollisionPair&)>& callback);
     void detectCollisionsInParallel(const std::function<void(const CollisionPair&)>& callback);
@@ -153,13 +417,36 @@ public:
     // for multithread version
     int numThreads;
     unique_ptr<ThreadPool> threadPool;
-    vector<int> shuffledPairIndices;
-    vector<vector<CollisionPair>> collisionPairArrays;
-    mt19937 randomEngine;
     
-    void extractCollisionsOfAssignedPairs(
-        int pairIndexBegin, int pairIndexEnd, vector<CollisionPair>& collisionPairs);    
-    void dispatchCollisionsInCollisionPairArrays(std::function<void(const CollisionPair&)> callback);    
+    // The pair index range [begin, end) processed as a unit of the work
+    struct Chunk {
+        int begin;
+        int end;
+    };
+    vector<Chunk> chunks;
+
+    /*
+      Each thread first takes the chunks of its own queue and then steals the remaining
+      chunks from the queues of the other threads. A chunk is taken by incrementing the
+      atomic index so that every chunk is processed exactly once.
+    */
+    struct ChunkQueue {
+        std::atomic<int> next;
+        int end;
+    };
+    unique_ptr<ChunkQueue[]> chunkQueues;
+
+    // The collisions of each active pair, which are dispatched in the pair order
+    vector<CollisionPair> pairCollisions;
+    
+    void partitionActivePairsIntoChunks();
+    void processChunks(int queueIndex);
+    void detectPairCollisions(ColdetModelPairEx* modelPair, CollisionPair& collisionPair);
+
+    bool isContactCacheEnabled;
+    double translationTolerance;
+    double rotationTolerance;
+    const std::vector<collision_data>& detectModelPairCollisions(ColdetModelPairEx* modelPair);
 };
 
 }
@@ -174,6 +461,11 @@ AISTCollisionDetector::AISTCollisionDetector()
 AISTCollisionDetector::Impl::Impl()
 {
     isDynamicGeometryPairChangeEnabled = false;
+    isBroadphaseEnabled = true;
+    isPrimitiveNarrowphaseEnabled = true;
+    isContactCacheEnabled = true;
+    translationTolerance = 0.0;
+    rotationTolerance = 0.0;
     maxNumThreads = 0;
 
     initialize();
@@ -189,6 +481,11 @@ AISTCollisionDetector::AISTCollisionDetector(const AISTCollisionDetector& org)
 AISTCollisionDetector::Impl::Impl(const AISTCollisionDetector::Impl& org)
 {
     isDynamicGeometryPairChangeEnabled = org.isDynamicGeometryPairChangeEnabled;
+    isBroadphaseEnabled = org.isBroadphaseEnabled;
+    isPrimitiveNarrowphaseEnabled = org.isPrimitiveNarrowphaseEnabled;
+    isContactCacheEnabled = org.isContactCacheEnabled;
+    translationTolerance = org.translationTolerance;
+    rotationTolerance = org.rotationTolerance;
     maxNumThreads = org.maxNumThreads;
 
     initialize();
@@ -200,11 +497,6 @@ void AISTCollisionDetector::Impl::initialize()
     isReady = false;
     numThreads = 0;
     meshExtractor = new MeshExtractor;
-
-    if(ENABLE_SHUFFLE){
-        random_device seed;
-        randomEngine.seed(seed());
-    }
 }    
 
 
@@ -238,11 +530,60 @@ void AISTCollisionDetector::setNumThreads(int n)
     impl->maxNumThreads = n;
 }
 
+
+void AISTCollisionDetector::setModelCacheEnabled(bool on)
+{
+    modelCache.isEnabled = on;
+    if(!on){
+        clearModelCache();
+    }
+}
+
+
+bool AISTCollisionDetector::isModelCacheEnabled()
+{
+    return modelCache.isEnabled;
+}
+
+
+void AISTCollisionDetector::setModelCacheDirectory(const std::string& directory)
+{
+    if(!directory.empty()){
+        stdx::error_code ec;
+        filesystem::create_directories(filesystem::path(fromUTF8(directory)), ec);
+    }
+    std::lock_guard<std::mutex> lock(modelCache.mutex);
+    modelCache.directory = directory;
+}
+
+
+std::string AISTCollisionDetector::modelCacheDirectory()
+{
+    std::lock_guard<std::mutex> lock(modelCache.mutex);
+    return modelCache.directory;
+}
+
+
+void AISTCollisionDetector::clearModelCache()
+{
+    std::lock_guard<std::mutex> lock(modelCache.mutex);
+    modelCache.hashToEntries.clear();
+}
+
+
+int AISTCollisionDetector::numCachedModels()
+{
+    return modelCache.numModels();
+}
+
         
 void AISTCollisionDetector::clearGeometries()
 {
     impl->models.clear();
     impl->modelPairs.clear();
+    impl->activeModelPairs.clear();
+    impl->broadphase.clear();
+    impl->broadphasePairMap.clear();
     impl->ignoredPairs.clear();
     impl->ignoredGroupPairs.clear();
     impl->isReady = false;
@@ -265,10 +606,28 @@ stdx::optional<GeometryHandle> AISTCollisionDetector::Impl::addGeometry(SgNode*
 {
     if(geometry){
         ColdetModelExPtr model = new ColdetModelEx;
+        numExtractedMeshes = 0;
+        primitiveType = ColdetModel::SP_MESH;
         if(meshExtractor->extract(geometry, [&]() { addMesh(model); })){
+            bool isPrimitive = (primitiveType != ColdetModel::SP_MESH && isPrimitiveNarrowphaseEnabled);
+            if(isPrimitive){
+                // The triangles are kept for the pairs with the other meshes
+                setPrimitive(model);
+            }
+            if(modelCache.isEnabled){
+                model = getCachedModel(model);
+            } else {
+                model->build();
+            }
             model->setName(geometry->name());
-            model->build();
+            if(isPrimitive){
+                // The primitive position is not shared with the cached model
+                Matrix3 R = primitivePosition.linear().transpose(); // row-major
+                model->setPrimitivePosition(R.data(), primitivePosition.translation().data());
+            }
             if(model->isValid()){
+                // The initial position is the identity
+                model->worldBoundingBox = model->localBoundingBox;
                 models.push_back(model);
                 isReady = false;
                 return getHandle(model);
@@ -279,10 +638,47 @@ stdx::optional<GeometryHandle> AISTCollisionDetector::Impl::addGeometry(SgNode*
 }
 
 
+ColdetModelExPtr AISTCollisionDetector::Impl::getCachedModel(ColdetModelExPtr model)
+{
+    const uint64_t hash = model->computeMeshHash();
+    ModelCache::Entry entry;
+    if(modelCache.find(model, hash, entry)){
+        return new ColdetModelEx(*entry.model, entry.bbox);
+    }
+    string filename = modelCache.getFilename(hash);
+    ColdetModelExPtr loaded;
+    if(!filename.empty()){
+        loaded = modelCache.load(model, filename);
+    }
+    if(loaded){
+        // The primitive information is not stored in the file
+        if(model->getPrimitiveType() != ColdetModel::SP_MESH){
+            setPrimitive(loaded);
+        }
+        model = loaded;
+    } else {
+        model->build();
+        if(model->isValid() && !filename.empty()){
+            modelCache.save(model, filename);
+        }
+    }
+    if(model->isValid()){
+        modelCache.add(model, hash, model->localBoundingBox);
+    }
+    return model;
+}
+
+
 void AISTCollisionDetector::Impl::addMesh(ColdetModelEx* model)
 {
     SgMesh* mesh = meshExtractor->currentMesh();
     const Affine3& T = meshExtractor->currentTransform();
+
+    if(++numExtractedMeshes == 1){
+        extractPrimitive(mesh);
+    } else {
+        primitiveType = ColdetModel::SP_MESH;
+    }
     
     const int vertexIndexTop = model->getNumVertices();
     
@@ -291,6 +687,7 @@ void AISTCollisionDetector::Impl::addMesh(ColdetModelEx* model)
     for(int i=0; i < numVertices; ++i){
         const Vector3 v = T * vertices[i].cast<Affine3::Scalar>();
         model->addVertex(v.x(), v.y(), v.z());
+        model->localBoundingBox.expandBy(v);
     }
 
     const int numTriangles = mesh->numTriangles();
@@ -304,6 +701,54 @@ void AISTCollisionDetector::Impl::addMesh(ColdetModelEx* model)
 }
 
 
+void AISTCollisionDetector::Impl::setPrimitive(ColdetModel* model)
+{
+    model->setPrimitiveType(primitiveType);
+    model->setNumPrimitiveParams(primitiveParams.size());
+    for(size_t i=0; i < primitiveParams.size(); ++i){
+        model->setPrimitiveParam(i, primitiveParams[i]);
+    }
+}
+
+
+void AISTCollisionDetector::Impl::extractPrimitive(SgMesh* mesh)
+{
+    const int type = mesh->primitiveType();
+    if(type != SgMesh::BoxType && type != SgMesh::SphereType && type != SgMesh::CapsuleType){
+        return;
+    }
+    Vector3 scale(1.0, 1.0, 1.0);
+    primitivePosition = meshExtractor->currentTransformWithoutScaling();
+    if(meshExtractor->isCurrentScaled()){
+        Affine3 S = primitivePosition.inverse() * meshExtractor->currentTransform();
+        if(!S.linear().isDiagonal()){
+            return;
+        }
+        scale = S.linear().diagonal();
+        if(type != SgMesh::BoxType){
+            // The spheres of the sphere and the capsule must be uniformly scaled
+            if(scale.x() != scale.y() || scale.x() != scale.z()){
+                return;
+            }
+        }
+        primitivePosition.translation() += primitivePosition.linear() * S.translation();
+    }
+    
+    if(type == SgMesh::BoxType){
+        const Vector3& size = mesh->primitive<SgMesh::Box>().size;
+        primitiveType = ColdetModel::SP_BOX;
+        primitiveParams = { (float)(size.x() * scale.x()), (float)(size.y() * scale.y()), (float)(size.z() * scale.z()) };
+    } else if(type == SgMesh::SphereType){
+        primitiveType = ColdetModel::SP_SPHERE;
+        primitiveParams = { (float)(mesh->primitive<SgMesh::Sphere>().radius * scale.x()) };
+    } else {
+        const auto& capsule = mesh->primitive<SgMesh::Capsule>();
+        primitiveType = ColdetModel::SP_CAPSULE;
+        primitiveParams = { (float)(capsule.radius * scale.x()), (float)(capsule.height * scale.x()) };
+    }
+}
+
+
 void AISTCollisionDetector::setCustomObject(GeometryHandle geometry, Referenced* object)
 {
     getColdetModel(geometry)->object = object;
@@ -372,6 +817,53 @@ bool AISTCollisionDetector::isDynamicGeometryPairChangeEnabled() const
 }
 
 
+bool AISTCollisionDetector::setBroadphaseEnabled(bool on)
+{
+    if(on != impl->isBroadphaseEnabled){
+        impl->isBroadphaseEnabled = on;
+        impl->isReady = false;
+    }
+    return true;
+}
+
+
+void AISTCollisionDetector::setPrimitiveNarrowphaseEnabled(bool on)
+{
+    impl->isPrimitiveNarrowphaseEnabled = on;
+}
+
+
+bool AISTCollisionDetector::isPrimitiveNarrowphaseEnabled() const
+{
+    return impl->isPrimitiveNarrowphaseEnabled;
+}
+
+
+void AISTCollisionDetector::setContactCacheEnabled(bool on)
+{
+    impl->isContactCacheEnabled = on;
+}
+
+
+bool AISTCollisionDetector::isContactCacheEnabled() const
+{
+    return impl->isContactCacheEnabled;
+}
+
+
+void AISTCollisionDetector::setContactCacheTolerance(double translation, double rotation)
+{
+    impl->translationTolerance = translation;
+    impl->rotationTolerance = rotation;
+}
+
+
+bool AISTCollisionDetector::isBroadphaseEnabled() const
+{
+    return impl->isBroadphaseEnabled;
+}
+
+
 bool AISTCollisionDetector::makeReady()
 {
     impl->makeReady();
@@ -382,50 +874,87 @@ bool AISTCollisionDetector::makeReady()
 void AISTCollisionDetector::Impl::makeReady()
 {
     modelPairs.clear();
+    activeModelPairs.clear();
+    broadphase.clear();
+    broadphasePairMap.clear();
+    
     const int n = models.size();
     for(int i=0; i < n; ++i){
-        ColdetModelEx* model0 = models[i];
-        for(int j = i + 1; j < n; ++j){
-            ColdetModelEx* model1 = models[j];
-            if(!model0->isStatic || !model1->isStatic){
-                bool doRegisterPair = isDynamicGeometryPairChangeEnabled;
-                if(!doRegisterPair){
-                    if(checkIfGroupPairEnabled(model0->groupId, model1->groupId)){
-                        IdPair<GeometryHandle> handlePair(getHandle(model0), getHandle(model1));
-                        if(ignoredPairs.find(handlePair) == ignoredPairs.end()){
-                            doRegisterPair = true;
-                        }
+        ColdetModelEx* model = models[i];
+        model->index = i;
+        if(isBroadphaseEnabled){
+            broadphase.addObject(model->isStatic);
+            broadphase.updateObject(i, model->worldBoundingBox);
+        }
+    }
+
+    // The pairs are created on demand in updateActiveModelPairs if the broadphase is enabled
+    if(!isBroadphaseEnabled){
+        for(int i=0; i < n; ++i){
+            ColdetModelEx* model0 = models[i];
+            for(int j = i + 1; j < n; ++j){
+                ColdetModelEx* model1 = models[j];
+                if(!model0->isStatic || !model1->isStatic){
+                    if(isDynamicGeometryPairChangeEnabled || checkIfModelPairEnabled(model0, model1)){
+                        modelPairs.push_back(new ColdetModelPairEx(model0, model1));
                     }
                 }
-                if(doRegisterPair){
-                    modelPairs.push_back(new ColdetModelPairEx(model0, model1));
-                }
             }
         }
+        for(auto& modelPair : modelPairs){
+            activeModelPairs.push_back(modelPair);
+        }
     }
 
-    const int numPairs = modelPairs.size();
-
     if(maxNumThreads <= 0){
         numThreads = 0;
         threadPool.reset();
-        collisionPairArrays.clear();
+        chunkQueues.reset();
     } else {
-        numThreads = (maxNumThreads > numPairs) ? numPairs : maxNumThreads;
-        threadPool.reset(new ThreadPool(numThreads));
-        if(ENABLE_SHUFFLE){
-            shuffledPairIndices.resize(modelPairs.size());
-            for(size_t i=0; i < shuffledPairIndices.size(); ++i){
-                shuffledPairIndices[i] = i;
-            }
+        if(isBroadphaseEnabled){
+            numThreads = maxNumThreads;
+        } else {
+            const int numPairs = modelPairs.size();
+            numThreads = (maxNumThreads > numPairs) ? numPairs : maxNumThreads;
+        }
+        /*
+          The calling thread also processes the chunks, so the pool only has to provide
+          the remaining threads.
+        */
+        if(numThreads > 1){
+            threadPool.reset(new ThreadPool(numThreads - 1));
+        } else {
+            threadPool.reset();
         }
-        collisionPairArrays.resize(numThreads);
+        chunkQueues.reset(new ChunkQueue[numThreads]);
     }
 
     isReady = true;
 }
 
 
+void AISTCollisionDetector::Impl::updateActiveModelPairs()
+{
+    if(isBroadphaseEnabled){
+        activeModelPairs.clear();
+        for(auto& idPair : broadphase.findOverlappingPairs()){
+            auto inserted = broadphasePairMap.emplace(idPair, nullptr);
+            auto& modelPair = inserted.first->second;
+            if(inserted.second){
+                ColdetModelEx* model0 = models[idPair[0]];
+                ColdetModelEx* model1 = models[idPair[1]];
+                if(isDynamicGeometryPairChangeEnabled || checkIfModelPairEnabled(model0, model1)){
+                    modelPair = new ColdetModelPairEx(model0, model1);
+                }
+            }
+            if(modelPair){
+                activeModelPairs.push_back(modelPair);
+            }
+        }
+    }
+}
+
+
 bool AISTCollisionDetector::Impl::checkIfGroupPairEnabled(int groupId1, int groupId2)
 {
     return (ignoredGroupPairs.find(IdPair<>(groupId1, groupId2)) == ignoredGroupPairs.end());
@@ -437,8 +966,12 @@ bool AISTCollisionDetector::Impl::checkIfGroupPairEnabled(int groupId1, int grou
 */
 bool AISTCollisionDetector::Impl::checkIfModelPairEnabled(ColdetModelPairEx* modelPair)
 {
-    auto model0 = modelPair->model(0);
-    auto model1 = modelPair->model(1);
+    return checkIfModelPairEnabled(modelPair->model(0), modelPair->model(1));
+}
+
+
+bool AISTCollisionDetector::Impl::checkIfModelPairEnabled(ColdetModelEx* model0, ColdetModelEx* model1)
+{
     if(checkIfGroupPairEnabled(model0->groupId, model1->groupId)){
         IdPair<GeometryHandle> handlePair(getHandle(model0), getHandle(model1));
         if(ignoredPairs.find(handlePair) == ignoredPairs.end()){
@@ -452,15 +985,21 @@ bool AISTCollisionDetector::Impl::checkIfModelPairEnabled(ColdetModelPairEx* mod
 void AISTCollisionDetector::updatePosition(GeometryHandle geometry, const Isometry3& position)
 {
     auto model = getColdetModel(geometry);
+    auto head = model;
+    BoundingBox bbox;
     do {
         if(model->localPosition){
             Isometry3 T = position * (*model->localPosition);
-            model->setPosition(T);
+            model->updatePosition(T);
+            impl->expandWorldBoundingBox(model, T, bbox);
         } else {
-            model->setPosition(position);
+            model->updatePosition(position);
+            impl->expandWorldBoundingBox(model, position, bbox);
         }
         model = model->sibling;
     } while(model);
+
+    impl->updateBroadphaseObject(head, bbox);
 }
 
 
@@ -468,17 +1007,45 @@ void AISTCollisionDetector::updatePositions
 (std::function<void(Referenced* object, Isometry3*& out_Position)> positionQuery)
 {
     for(ColdetModelEx* model : impl->models){ // Do not use auto&
+        auto head = model;
+        BoundingBox bbox;
         do {
             Isometry3* T;
             positionQuery(model->object, T);
             if(model->localPosition){
                 Isometry3 T2 = (*T) * (*model->localPosition);
-                model->setPosition(T2);
+                model->updatePosition(T2);
+                impl->expandWorldBoundingBox(model, T2, bbox);
             } else {
-                model->setPosition(*T);
+                model->updatePosition(*T);
+                impl->expandWorldBoundingBox(model, *T, bbox);
             }
             model = model->sibling; // Elements in models are overridden here if auto& is used
         } while(model);
+
+        impl->updateBroadphaseObject(head, bbox);
+    }
+}
+
+
+void AISTCollisionDetector::Impl::expandWorldBoundingBox
+(ColdetModelEx* model, const Isometry3& T, BoundingBox& io_bbox)
+{
+    if(isBroadphaseEnabled){
+        BoundingBox bbox = model->localBoundingBox;
+        bbox.transform(Affine3(T.matrix()));
+        io_bbox.expandBy(bbox);
+    }
+}
+
+
+void AISTCollisionDetector::Impl::updateBroadphaseObject(ColdetModelEx* model, const BoundingBox& bbox)
+{
+    if(isBroadphaseEnabled){
+        model->worldBoundingBox = bbox;
+        if(isReady){
+            broadphase.updateObject(model->index, bbox);
+        }
     }
 }
 
@@ -488,6 +1055,7 @@ void AISTCollisionDetector::detectCollisions(GeometryHandle geometry, std::funct
     if(!impl->isReady){
         impl->makeReady();
     }
+    impl->updateActiveModelPairs();
     impl->detectCollisions(geometry, callback);
 }
 
@@ -497,7 +1065,7 @@ void AISTCollisionDetector::Impl::detectCollisions
 {
     auto& collisions = collisionPair.collisions();
     
-    for(ColdetModelPairEx* modelPair : modelPairs){ // Do not use auto&
+    for(ColdetModelPairEx* modelPair : activeModelPairs){ // Do not use auto&
         collisions.clear();
         do {
             auto model0 = modelPair->model(0);
@@ -505,7 +1073,7 @@ void AISTCollisionDetector::Impl::detectCollisions
             if(getHandle(modelPair->model(0)) == geometry || getHandle(modelPair->model(1)) == geometry){
                 if(model0->isEnabled && model1->isEnabled){
                     if(!isDynamicGeometryPairChangeEnabled || checkIfModelPairEnabled(modelPair)){
-                        if(!modelPair->detectCollisions().empty()){
+                        if(!detectModelPairCollisions(modelPair).empty()){
                             copyCollisionPairCollisions(modelPair, collisionPair);
                         }
                     }
@@ -526,6 +1094,7 @@ void AISTCollisionDetector::detectCollisions(std::function<void(const CollisionP
     if(!impl->isReady){
         impl->makeReady();
     }
+    impl->updateActiveModelPairs();
     if(impl->numThreads > 0){
         impl->detectCollisionsInParallel(callback);
     } else {
@@ -534,20 +1103,16 @@ void AISTCollisionDetector::detectCollisions(std::function<void(const CollisionP
 } 
 
 
-/**
-   \todo Remeber which geometry positions are updated after the last collision detection
-   and do the actual collision detection only for the updated geometry pairs.
-*/
 void AISTCollisionDetector::Impl::detectCollisions(const std::function<void(const CollisionPair&)>& callback)
 {
     auto& collisions = collisionPair.collisions();
     
-    for(ColdetModelPairEx* modelPair : modelPairs){ // Do not use auto&
+    for(ColdetModelPairEx* modelPair : activeModelPairs){ // Do not use auto&
         collisions.clear();
         do {
             if(modelPair->model(0)->isEnabled && modelPair->model(1)->isEnabled){
                 if(!isDynamicGeometryPairChangeEnabled || checkIfModelPairEnabled(modelPair)){
-                    if(!modelPair->detectCollisions().empty()){
+                    if(!detectModelPairCollisions(modelPair).empty()){
                         copyCollisionPairCollisions(modelPair, collisionPair);
                     }
                 }
@@ -564,13 +1129,62 @@ void AISTCollisionDetector::Impl::detectCollisions(const std::function<void(cons
 
 void AISTCollisionDetector::Impl::detectCollisionsInParallel(const std::function<void(const CollisionPair&)>& callback)
 {
-    if(ENABLE_SHUFFLE){
-        std::shuffle(shuffledPairIndices.begin(), shuffledPairIndices.end(), randomEngine);
+    const int numPairs = activeModelPairs.size();
+    if(static_cast<int>(pairCollisions.size()) < numPairs){
+        pairCollisions.resize(numPairs);
+    }
+    
+    partitionActivePairsIntoChunks();
+
+    for(int i=1; i < numThreads; ++i){
+        threadPool->start([this, i](){ processChunks(i); });
+    }
+    processChunks(0);
+
+    if(threadPool){
+        threadPool->wait();
+    }
+
+    for(int i=0; i < numPairs; ++i){
+        auto& collisionPair = pairCollisions[i];
+        if(!collisionPair.empty()){
+            callback(collisionPair);
+        }
+    }
+}
+
+
+/**
+   The active pairs are divided into the chunks of almost the same cost by using the detection
+   time of each pair in the last step, and the chunks are initially distributed to the threads
+   so that each thread has the same amount of the work. The remaining imbalance is resolved by
+   the work stealing in processChunks.
+*/
+void AISTCollisionDetector::Impl::partitionActivePairsIntoChunks()
+{
+    const int numPairs = activeModelPairs.size();
+    
+    double totalCost = 0.0;
+    for(auto& modelPair : activeModelPairs){
+        totalCost += modelPair->cost;
+    }
+    const double chunkCost = totalCost / (numThreads * NumChunksPerThread);
+
+    chunks.clear();
+    int begin = 0;
+    double cost = 0.0;
+    for(int i=0; i < numPairs; ++i){
+        cost += activeModelPairs[i]->cost;
+        if(cost >= chunkCost || i == numPairs - 1){
+            chunks.push_back({ begin, i + 1 });
+            begin = i + 1;
+            cost = 0.0;
+        }
     }
 
-    const int numPairs = modelPairs.size();
-    const int minSize = numPairs / numThreads;
-    int remainder = numPairs % numThreads;
+    const int numChunks = chunks.size();
+    const int minSize = numChunks / numThreads;
+    int remainder = numChunks % numThreads;
     int index = 0;
     for(int i=0; i < numThreads; ++i){
         int size = minSize;
@@ -578,61 +1192,108 @@ void AISTCollisionDetector::Impl::detectCollisionsInParallel(const std::function
             ++size;
             --remainder;
         }
-        if(size == 0){
-            break;
-        }
-        threadPool->start([this, i, index, size](){
-                extractCollisionsOfAssignedPairs(index, index + size, collisionPairArrays[i]); });
+        auto& queue = chunkQueues[i];
+        queue.next.store(index, std::memory_order_relaxed);
+        queue.end = index + size;
         index += size;
     }
-    threadPool->waitLoop();
-    //threadPool->wait();
+}
+
 
-    dispatchCollisionsInCollisionPairArrays(callback);
+void AISTCollisionDetector::Impl::processChunks(int queueIndex)
+{
+    for(int i=0; i < numThreads; ++i){
+        auto& queue = chunkQueues[(queueIndex + i) % numThreads];
+        while(true){
+            int chunkIndex = queue.next.fetch_add(1, std::memory_order_relaxed);
+            if(chunkIndex >= queue.end){
+                break;
+            }
+            auto& chunk = chunks[chunkIndex];
+            for(int j = chunk.begin; j < chunk.end; ++j){
+                auto modelPair = activeModelPairs[j];
+                auto& collisionPair = pairCollisions[j];
+                collisionPair.clearCollisions();
+                auto t0 = std::chrono::steady_clock::now();
+                detectPairCollisions(modelPair, collisionPair);
+                auto t1 = std::chrono::steady_clock::now();
+                modelPair->cost = std::chrono::duration<double>(t1 - t0).count();
+            }
+        }
+    }
 }
 
 
-void AISTCollisionDetector::Impl::extractCollisionsOfAssignedPairs
-(int pairIndexBegin, int pairIndexEnd, vector<CollisionPair>& collisionPairs)
+void AISTCollisionDetector::Impl::detectPairCollisions(ColdetModelPairEx* modelPair, CollisionPair& collisionPair)
 {
-    collisionPairs.clear();
+    do {
+        if(modelPair->model(0)->isEnabled && modelPair->model(1)->isEnabled){
+            if(!isDynamicGeometryPairChangeEnabled || checkIfModelPairEnabled(modelPair)){
+                if(!detectModelPairCollisions(modelPair).empty()){
+                    copyCollisionPairCollisions(modelPair, collisionPair, true);
+                }
+            }
+        }
+        modelPair = modelPair->sibling;
+    } while(modelPair);
+}
 
-    for(int i=pairIndexBegin; i < pairIndexEnd; ++i){
-        ColdetModelPairEx* modelPair;
-        if(ENABLE_SHUFFLE){
-            modelPair = modelPairs[shuffledPairIndices[i]];
-        } else {
-            modelPair = modelPairs[i];
+
+/**
+   The collisions of the last detection are reused if the positions of the pair have not been
+   updated since then or the relative position has not changed beyond the tolerance. Otherwise
+   the bounding boxes are tested with the separating axis of the last detection first, so that
+   OPCODE is not called for the pairs which remain separated.
+*/
+const std::vector<collision_data>& AISTCollisionDetector::Impl::detectModelPairCollisions(ColdetModelPairEx* modelPair)
+{
+    auto model0 = modelPair->model(0);
+    auto model1 = modelPair->model(1);
+
+    if(isContactCacheEnabled && modelPair->hasCache){
+        if(model0->positionRevision == modelPair->cachedPositionRevisions[0] &&
+           model1->positionRevision == modelPair->cachedPositionRevisions[1]){
+            return modelPair->collisions();
         }
+    }
 
-        collisionPairs.push_back(CollisionPair());
-        CollisionPair& collisionPair = collisionPairs.back();
-        do {
-            if(modelPair->model(0)->isEnabled && modelPair->model(1)->isEnabled){
-                if(!isDynamicGeometryPairChangeEnabled || checkIfModelPairEnabled(modelPair)){
-                    if(!modelPair->detectCollisions().empty()){
-                        copyCollisionPairCollisions(modelPair, collisionPair, true);
+    const Isometry3 T01 = model0->position.inverse(Eigen::Isometry) * model1->position;
+
+    if(isContactCacheEnabled && modelPair->hasCache && (translationTolerance > 0.0 || rotationTolerance > 0.0)){
+        const Isometry3& T0 = modelPair->cachedRelativePosition;
+        if((T01.translation() - T0.translation()).norm() <= translationTolerance){
+            const AngleAxis aa(T0.linear().transpose() * T01.linear());
+            if(fabs(aa.angle()) <= rotationTolerance){
+                // The contacts move with model 0
+                const Isometry3 D = model0->position * modelPair->cachedPosition0.inverse(Eigen::Isometry);
+                for(auto& cd : modelPair->collisions()){
+                    for(int i=0; i < cd.num_of_i_points; ++i){
+                        cd.i_points[i] = D * cd.i_points[i];
                     }
+                    cd.n_vector = D.linear() * cd.n_vector;
                 }
+                modelPair->cachedPosition0 = model0->position;
+                modelPair->cachedPositionRevisions[0] = model0->positionRevision;
+                modelPair->cachedPositionRevisions[1] = model1->positionRevision;
+                return modelPair->collisions();
             }
-            modelPair = modelPair->sibling;
-        } while(modelPair);
-
-        if(collisionPair.empty()){
-            collisionPairs.pop_back();
         }
     }
-}
 
-void AISTCollisionDetector::Impl::dispatchCollisionsInCollisionPairArrays
-(std::function<void(const CollisionPair&)> callback)
-{
-    for(int i=0; i < numThreads; ++i){
-        const vector<CollisionPair>& collisionPairs = collisionPairArrays[i];
-        for(size_t j=0; j < collisionPairs.size(); ++j){
-            callback(collisionPairs[j]);
-        }
+    modelPair->hasCache = isContactCacheEnabled;
+    modelPair->cachedPositionRevisions[0] = model0->positionRevision;
+    modelPair->cachedPositionRevisions[1] = model1->positionRevision;
+    modelPair->cachedRelativePosition = T01;
+    modelPair->cachedPosition0 = model0->position;
+
+    OrientedBoxSeparationTest test(model0->localBoundingBox, model1->localBoundingBox, T01);
+    modelPair->separatingAxis = test.findSeparatingAxis(modelPair->separatingAxis);
+    if(modelPair->separatingAxis >= 0){
+        modelPair->clearCollisions();
+        return modelPair->collisions();
     }
+    
+    return modelPair->detectCollisions();
 }
 
 
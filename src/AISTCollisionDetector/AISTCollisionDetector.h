@@ -25,6 +25,8 @@ public:
     virtual void ignoreGeometryPair(GeometryHandle geometry1, GeometryHandle geometry2, bool ignore = true) override;
     virtual void setDynamicGeometryPairChangeEnabled(bool on) override;
     virtual bool isDynamicGeometryPairChangeEnabled() const override;
+    virtual bool setBroadphaseEnabled(bool on) override;
+    virtual bool isBroadphaseEnabled() const override;
     virtual bool makeReady() override;
     virtual void updatePosition(GeometryHandle geometry, const Isometry3& position) override;
     virtual void updatePositions(std::function<void(Referenced* object, Isometry3*& out_Position)> positionQuery) override;
@@ -38,6 +40,49 @@ public:
     // experimental
     void setNumThreads(int n);
 
+    /**
+       A geometry consisting of a single box, sphere or capsule mesh is detected with the
+       closed-form functions when the other geometry of the pair is also such a primitive.
+       This is enabled by default.
+    */
+    void setPrimitiveNarrowphaseEnabled(bool on);
+    bool isPrimitiveNarrowphaseEnabled() const;
+
+    /**
+       The collisions of a geometry pair are reused when the positions of the pair have not
+       been updated since the last detection. This is enabled by default.
+    */
+    void setContactCacheEnabled(bool on);
+    bool isContactCacheEnabled() const;
+
+    /**
+       The collisions are also reused while the relative position of the pair does not change
+       beyond the tolerances from the position where the collisions were actually detected.
+       The tolerances are zero by default.
+       @param translation Tolerance of the relative translation [m]
+       @param rotation Tolerance of the relative rotation angle [rad]
+    */
+    void setContactCacheTolerance(double translation, double rotation);
+
+    /**
+       The built models of the geometries with the same mesh are shared by all the detectors.
+       The cache is disabled by default. The cached models are kept until clearModelCache()
+       is called or the cache is disabled. The initial state can also be given by the
+       environment variables CNOID_ENABLE_AIST_MODEL_CACHE and CNOID_AIST_MODEL_CACHE_DIR.
+    */
+    static void setModelCacheEnabled(bool on);
+    static bool isModelCacheEnabled();
+
+    /**
+       The built models are also stored in the directory and loaded from it if the directory
+       is specified. An empty string disables the storage.
+    */
+    static void setModelCacheDirectory(const std::string& directory);
+    static std::string modelCacheDirectory();
+
+    static void clearModelCache();
+    static int numCachedModels();
+
 private:
     class Impl;
     Impl* impl;
@@ -7,6 +7,7 @@
 #include "Opcode/Opcode.h"
 #include <map>
 #include <iostream>
+#include <cstring>
 
 using namespace std;
 using namespace cnoid;
@@ -42,6 +43,38 @@ struct trianglePair {
 };
 
 typedef std::map< Edge, trianglePair > EdgeToTriangleMap;
+
+const uint32_t builtModelMagic = 0x4d43434e; // "NCCM"
+const uint32_t builtModelFormatVersion = 1;
+
+inline uint64_t addToFnvHash(uint64_t hash, const void* data, size_t size)
+{
+    auto bytes = static_cast<const unsigned char*>(data);
+    for(size_t i=0; i < size; ++i){
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+template<class T>
+void writeArray(std::ostream& os, const std::vector<T>& elements)
+{
+    if(!elements.empty()){
+        os.write(reinterpret_cast<const char*>(&elements[0]), elements.size() * sizeof(T));
+    }
+}
+
+template<class T>
+bool readArray(std::istream& is, std::vector<T>& elements, uint32_t size)
+{
+    elements.resize(size);
+    if(size > 0){
+        is.read(reinterpret_cast<char*>(&elements[0]), size * sizeof(T));
+    }
+    return static_cast<bool>(is);
+}
+
 }
 
 
@@ -199,6 +232,62 @@ void ColdetModel::build()
 }
 
 
+uint64_t ColdetModel::computeMeshHash() const
+{
+    const auto& vertices = internalModel->vertices;
+    const auto& triangles = internalModel->triangles;
+    uint32_t sizes[] = { static_cast<uint32_t>(vertices.size()), static_cast<uint32_t>(triangles.size()) };
+    uint64_t hash = addToFnvHash(14695981039346656037ull, sizes, sizeof(sizes));
+    if(!vertices.empty()){
+        hash = addToFnvHash(hash, &vertices[0], vertices.size() * sizeof(vertices[0]));
+    }
+    if(!triangles.empty()){
+        hash = addToFnvHash(hash, &triangles[0], triangles.size() * sizeof(triangles[0]));
+    }
+    return hash;
+}
+
+
+bool ColdetModel::hasSameMesh(const ColdetModel& model) const
+{
+    const auto& vertices1 = internalModel->vertices;
+    const auto& vertices2 = model.internalModel->vertices;
+    const auto& triangles1 = internalModel->triangles;
+    const auto& triangles2 = model.internalModel->triangles;
+    if(internalModel == model.internalModel){
+        return true;
+    }
+    if(vertices1.size() != vertices2.size() || triangles1.size() != triangles2.size()){
+        return false;
+    }
+    if(!vertices1.empty() &&
+       memcmp(&vertices1[0], &vertices2[0], vertices1.size() * sizeof(vertices1[0])) != 0){
+        return false;
+    }
+    if(!triangles1.empty() &&
+       memcmp(&triangles1[0], &triangles2[0], triangles1.size() * sizeof(triangles1[0])) != 0){
+        return false;
+    }
+    return true;
+}
+
+
+bool ColdetModel::writeBuiltModel(std::ostream& os) const
+{
+    if(!isValid_){
+        return false;
+    }
+    return internalModel->write(os);
+}
+
+
+bool ColdetModel::readBuiltModel(std::istream& is)
+{
+    isValid_ = internalModel->read(is);
+    return isValid_;
+}
+
+
 int ColdetModel::numofBBtoDepth(int minNumofBB)
 {
     for(int i=0; i < getAABBTreeDepth(); ++i){
@@ -262,9 +351,7 @@ bool ColdetModelInternalModel::build()
 
         Opcode::OPCODECREATE OPCC;
 
-        iMesh.SetPointers(&triangles[0], &vertices[0]);
-        iMesh.SetNbTriangles(triangles.size());
-        iMesh.SetNbVertices(vertices.size());
+        setMeshInterface();
         
         OPCC.mIMesh = &iMesh;
         
@@ -273,12 +360,7 @@ bool ColdetModelInternalModel::build()
         OPCC.mKeepOriginal = false;
         
         model.Build(OPCC);
-        if(model.GetTree()){
-            AABBTreeMaxDepth = computeDepth(((Opcode::AABBCollisionTree*)model.GetTree())->GetNodes(), 0, -1) + 1;
-            for(int i=0; i<AABBTreeMaxDepth; i++)
-                for(int j=0; j<i; j++)
-                    numBBMap.at(i) += numLeafMap.at(j);
-        }
+        updateTreeDepthInfo();
         result = true;
     }
 
@@ -286,6 +368,98 @@ bool ColdetModelInternalModel::build()
 }
 
 
+void ColdetModelInternalModel::setMeshInterface()
+{
+    iMesh.SetPointers(&triangles[0], &vertices[0]);
+    iMesh.SetNbTriangles(triangles.size());
+    iMesh.SetNbVertices(vertices.size());
+}
+
+
+void ColdetModelInternalModel::updateTreeDepthInfo()
+{
+    AABBTreeMaxDepth = 0;
+    numBBMap.clear();
+    numLeafMap.clear();
+    if(model.GetTree()){
+        AABBTreeMaxDepth = computeDepth(((Opcode::AABBCollisionTree*)model.GetTree())->GetNodes(), 0, -1) + 1;
+        for(int i=0; i<AABBTreeMaxDepth; i++)
+            for(int j=0; j<i; j++)
+                numBBMap.at(i) += numLeafMap.at(j);
+    }
+}
+
+
+bool ColdetModelInternalModel::write(std::ostream& os) const
+{
+    auto tree = dynamic_cast<const Opcode::AABBCollisionTree*>(model.GetTree());
+    if(!tree || triangles.empty() || neighbors.size() != triangles.size()){
+        return false;
+    }
+    std::vector<Opcode::AABBCollisionNodeData> nodes(tree->GetNbNodes());
+    tree->ExportNodes(&nodes[0]);
+
+    uint32_t header[] = {
+        builtModelMagic,
+        builtModelFormatVersion,
+        static_cast<uint32_t>(sizeof(Opcode::AABBCollisionNodeData)),
+        static_cast<uint32_t>(vertices.size()),
+        static_cast<uint32_t>(triangles.size()),
+        static_cast<uint32_t>(nodes.size())
+    };
+    os.write(reinterpret_cast<const char*>(header), sizeof(header));
+    writeArray(os, vertices);
+    writeArray(os, triangles);
+    writeArray(os, neighbors);
+    writeArray(os, nodes);
+
+    return static_cast<bool>(os);
+}
+
+
+bool ColdetModelInternalModel::read(std::istream& is)
+{
+    uint32_t header[6];
+    is.read(reinterpret_cast<char*>(header), sizeof(header));
+    if(!is ||
+       header[0] != builtModelMagic ||
+       header[1] != builtModelFormatVersion ||
+       header[2] != sizeof(Opcode::AABBCollisionNodeData) ||
+       header[4] == 0){
+        return false;
+    }
+    std::vector<Opcode::AABBCollisionNodeData> nodes;
+    if(!readArray(is, vertices, header[3]) ||
+       !readArray(is, triangles, header[4]) ||
+       !readArray(is, neighbors, header[4]) ||
+       !readArray(is, nodes, header[5])){
+        return false;
+    }
+    for(auto& triangle : triangles){
+        for(int i=0; i < 3; ++i){
+            if(triangle.mVRef[i] >= vertices.size()){
+                return false;
+            }
+        }
+    }
+    const int numTriangles = triangles.size();
+    for(auto& neighbor : neighbors){
+        for(int i=0; i < 3; ++i){
+            if(neighbor[i] >= numTriangles){
+                return false;
+            }
+        }
+    }
+    setMeshInterface();
+    if(!model.Restore(&iMesh, &nodes[0], nodes.size())){
+        return false;
+    }
+    updateTreeDepthInfo();
+
+    return true;
+}
+
+
 void ColdetModel::setPosition(const Isometry3& T)
 {
     transform->Set((float)T(0,0), (float)T(1,0), (float)T(2,0), 0.0f,
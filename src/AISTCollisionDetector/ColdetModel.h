@@ -9,6 +9,8 @@
 #include <cnoid/EigenTypes>
 #include <string>
 #include <vector>
+#include <iosfwd>
+#include <cstdint>
 #include "exportdecl.h"
 
 namespace IceMaths {
@@ -22,7 +24,13 @@ class ColdetModelInternalModel;
 class CNOID_EXPORT ColdetModel : public Referenced
 {
 public:
-    enum PrimitiveType { SP_MESH, SP_BOX, SP_CYLINDER, SP_CONE, SP_SPHERE, SP_PLANE };
+    /**
+       The parameters of the primitives are (x size, y size, z size) for SP_BOX,
+       (radius) for SP_SPHERE and (radius, height) for SP_CYLINDER and SP_CAPSULE.
+       The axis of a cylinder or a capsule is the y-axis, and the height of a capsule
+       is the distance between the centers of its hemispheres.
+    */
+    enum PrimitiveType { SP_MESH, SP_BOX, SP_CYLINDER, SP_CONE, SP_SPHERE, SP_PLANE, SP_CAPSULE };
 
     /**
      * @brief constructor
@@ -129,6 +137,33 @@ public:
      */
     bool isValid() const { return isValid_; }
 
+    /**
+     * @brief compute the hash value of the vertices and the triangles
+     *
+     * Models with the same mesh have the same hash value, so the value can be used
+     * as the key to share the built model. Use hasSameMesh() to confirm the match.
+     */
+    uint64_t computeMeshHash() const;
+
+    /**
+     * @brief check if the vertices and the triangles are the same as those of another model
+     */
+    bool hasSameMesh(const ColdetModel& model) const;
+
+    /**
+     * @brief write the mesh and the bounding box tree built by build()
+     * @return true if the model is valid and written successfully
+     *
+     * The data is written in the native byte order of the machine.
+     */
+    bool writeBuiltModel(std::ostream& os) const;
+
+    /**
+     * @brief read the data written by writeBuiltModel() instead of calling build()
+     * @return true if the model is restored successfully
+     */
+    bool readBuiltModel(std::istream& is);
+
 #ifdef CNOID_BACKWARD_COMPATIBILITY
     /**
      * @brief set position and orientation of this model
@@ -8,6 +8,8 @@
 #include "ColdetModel.h"
 #include "Opcode/Opcode.h"
 #include <vector>
+#include <atomic>
+#include <iosfwd>
 
 namespace cnoid {
 
@@ -46,6 +48,8 @@ public:
     ColdetModelInternalModel();
 
     bool build();
+    bool write(std::ostream& os) const;
+    bool read(std::istream& is);
 
     // need two instances ?
     Opcode::Model model;
@@ -71,12 +75,14 @@ public:
     };
 
 private:
-    int refCounter;
+    std::atomic<int> refCounter;
     int AABBTreeMaxDepth;
     std::vector<int> numBBMap;
     std::vector<int> numLeafMap;
 
     void extractNeghiborTriangles();
+    void setMeshInterface();
+    void updateTreeDepthInfo();
     int computeDepth(const Opcode::AABBCollisionNode* node, int currentDepth, int max );
 
     friend class ColdetModel;
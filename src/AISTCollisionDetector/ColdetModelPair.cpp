@@ -8,6 +8,8 @@
 #include "StdCollisionPairInserter.h"
 #include "Opcode/Opcode.h"
 #include "SSVTreeCollider.h"
+#include "PrimitiveCollisions.h"
+#include <algorithm>
 #include <iostream>
 
 using namespace std;
@@ -31,12 +33,26 @@ struct figStruct {
     float area;
     float cx, cy;
 };
+
+bool isClosedFormPrimitive(int type)
+{
+    return (type == ColdetModel::SP_BOX || type == ColdetModel::SP_SPHERE || type == ColdetModel::SP_CAPSULE);
+}
+
+float getPrimitiveParam(ColdetModel* model, int index)
+{
+    float value = 0.0f;
+    model->getPrimitiveParam(index, value);
+    return value;
+}
+
 }
 
 
 ColdetModelPair::ColdetModelPair()
 {
     collisionPairInserter = new Opcode::StdCollisionPairInserter;
+    isSphereMeshColliderEnabled = true;
 }
 
 
@@ -45,6 +61,7 @@ ColdetModelPair::ColdetModelPair(ColdetModel* model0, ColdetModel* model1, doubl
     collisionPairInserter = new Opcode::StdCollisionPairInserter;
     set(model0, model1);
     tolerance_ = tolerance;
+    isSphereMeshColliderEnabled = true;
 }
 
 
@@ -53,6 +70,7 @@ ColdetModelPair::ColdetModelPair(const ColdetModelPair& org)
     collisionPairInserter = new Opcode::StdCollisionPairInserter;
     set(org.models[0], org.models[1]);
     tolerance_ = org.tolerance_;
+    isSphereMeshColliderEnabled = org.isSphereMeshColliderEnabled;
 }
 
 
@@ -93,8 +111,10 @@ std::vector<collision_data>& ColdetModelPair::detectCollisionsSub(bool detectAll
     else if (pt0 == ColdetModel::SP_SPHERE && pt1 == ColdetModel::SP_SPHERE) {
         detected = detectSphereSphereCollisions(detectAllContacts);
     }
-	
-    else if (pt0 == ColdetModel::SP_SPHERE || pt1 == ColdetModel::SP_SPHERE) {
+    else if (isClosedFormPrimitive(pt0) && isClosedFormPrimitive(pt1)) {
+        detected = detectPrimitivePrimitiveCollisions(detectAllContacts);
+    }
+    else if (isSphereMeshColliderEnabled && (pt0 == ColdetModel::SP_SPHERE || pt1 == ColdetModel::SP_SPHERE)) {
         detected = detectSphereMeshCollisions(detectAllContacts);
     }
     else {
@@ -262,6 +282,104 @@ bool ColdetModelPair::detectSphereSphereCollisions(bool detectAllContacts) {
     return result;
 }
 
+bool ColdetModelPair::detectPrimitivePrimitiveCollisions(bool detectAllContacts)
+{
+    struct Primitive {
+        int type;
+        Isometry3 T;
+        Vector3 halfSize;
+        double radius;
+        double halfHeight;
+    } primitives[2];
+
+    for(int i=0; i < 2; ++i){
+        ColdetModel* model = models[i];
+        Primitive& primitive = primitives[i];
+        primitive.type = model->getPrimitiveType();
+        IceMaths::Matrix4x4 M = (*(model->pTransform)) * (*(model->transform));
+        for(int j=0; j < 3; ++j){
+            for(int k=0; k < 3; ++k){
+                primitive.T.linear()(j, k) = M[k][j];
+            }
+            primitive.T.translation()[j] = M[3][j];
+        }
+        if(primitive.type == ColdetModel::SP_BOX){
+            for(int j=0; j < 3; ++j){
+                primitive.halfSize[j] = getPrimitiveParam(model, j) / 2.0;
+            }
+        } else {
+            primitive.radius = getPrimitiveParam(model, 0);
+            primitive.halfHeight = getPrimitiveParam(model, 1) / 2.0;
+        }
+    }
+
+    // The primitive types are ordered as sphere, capsule and box to reduce the combinations
+    auto order = [](int type){
+        return (type == ColdetModel::SP_SPHERE) ? 0 : ((type == ColdetModel::SP_CAPSULE) ? 1 : 2); };
+    bool reversed = order(primitives[0].type) > order(primitives[1].type);
+    const Primitive& a = primitives[reversed ? 1 : 0];
+    const Primitive& b = primitives[reversed ? 0 : 1];
+    const Vector3 pa = a.T.translation();
+    const Vector3 pb = b.T.translation();
+
+    using namespace primitive_collisions;
+    std::vector<Contact> contacts;
+    
+    if(a.type == ColdetModel::SP_SPHERE){
+        if(b.type == ColdetModel::SP_SPHERE){
+            collideSphereSphere(pa, a.radius, pb, b.radius, contacts);
+        } else if(b.type == ColdetModel::SP_CAPSULE){
+            // The normal is from the capsule to the sphere
+            collideCapsuleSphere(b.T, b.radius, b.halfHeight, pa, a.radius, contacts);
+            reversed = !reversed;
+        } else {
+            collideSphereBox(pa, a.radius, b.T, b.halfSize, contacts);
+        }
+    } else if(a.type == ColdetModel::SP_CAPSULE){
+        if(b.type == ColdetModel::SP_CAPSULE){
+            collideCapsuleCapsule(a.T, a.radius, a.halfHeight, b.T, b.radius, b.halfHeight, contacts);
+        } else {
+            collideCapsuleBox(a.T, a.radius, a.halfHeight, b.T, b.halfSize, contacts);
+        }
+    } else {
+        collideBoxBox(a.T, a.halfSize, b.T, b.halfSize, contacts);
+    }
+
+    if(contacts.empty()){
+        return false;
+    }
+    if(!detectAllContacts && contacts.size() > 1){
+        // Only the deepest contact is kept
+        auto deepest = std::max_element(
+            contacts.begin(), contacts.end(),
+            [](const Contact& c1, const Contact& c2){ return c1.depth < c2.depth; });
+        if(deepest != contacts.begin()){
+            contacts.front() = *deepest;
+        }
+        contacts.resize(1);
+    }
+
+    std::vector<collision_data>& cdata = collisionPairInserter->collisions();
+    cdata.clear();
+    for(auto& contact : contacts){
+        collision_data col;
+        col.id1 = 0;
+        col.id2 = 0;
+        col.depth = contact.depth;
+        col.num_of_i_points = 1;
+        col.i_point_new[0] = 1;
+        col.i_point_new[1] = 0;
+        col.i_point_new[2] = 0;
+        col.i_point_new[3] = 0;
+        col.n_vector = reversed ? Vector3(-contact.normal) : contact.normal;
+        col.i_points[0] = contact.point;
+        col.c_type = 1;
+        cdata.push_back(col);
+    }
+
+    return true;
+}
+
 bool ColdetModelPair::detectSphereMeshCollisions(bool detectAllContacts) {
 	
     bool result = false;
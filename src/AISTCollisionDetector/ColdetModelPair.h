@@ -60,6 +60,13 @@ public:
 
     void setCollisionPairInserter(Opcode::CollisionPairInserter *inserter); 
 
+    /**
+       If this is false, a sphere and a mesh are detected with the triangles of the sphere
+       instead of the sphere collider. The pairs of boxes, spheres and capsules are always
+       detected with the closed-form functions.
+    */
+    void setSphereMeshColliderEnabled(bool on) { isSphereMeshColliderEnabled = on; }
+
     int calculateCentroidIntersection(float &cx, float &cy, float &A, float radius, std::vector<float> vx, std::vector<float> vy);
 		
     int makeCCW(std::vector<float> &vx, std::vector<float> &vy);
@@ -82,9 +89,11 @@ private:
     bool detectSphereMeshCollisions(bool detectAllContacts);
     bool detectPlaneCylinderCollisions(bool detectAllContacts);
     bool detectPlaneMeshCollisions(bool detectAllContacts);
+    bool detectPrimitivePrimitiveCollisions(bool detectAllContacts);
 
     ColdetModelPtr models[2];
     double tolerance_;
+    bool isSphereMeshColliderEnabled;
     Opcode::CollisionPairInserter* collisionPairInserter;
     int boxTestsCount;
     int triTestsCount;
@@ -213,6 +213,30 @@ bool Model::Build(const OPCODECREATE& create)
 }
 #pragma clang diagnostic pop
 
+#if 1 // Added by AIST
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ *	Restores a collision model with the AABB collision tree exported from a built model.
+ *	\param		imesh		[in] mesh interface
+ *	\param		nodes		[in] nodes exported by AABBCollisionTree::ExportNodes
+ *	\param		nb_nodes	[in] number of nodes
+ *	\return		true if success
+ */
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool Model::Restore(const MeshInterface* imesh, const AABBCollisionNodeData* nodes, udword nb_nodes)
+{
+	if(!imesh || !imesh->IsValid())	return false;
+	if(nb_nodes!=imesh->GetNbTriangles()*2-1)	return false;
+
+	Release();
+	SetMeshInterface(imesh);
+
+	if(!CreateTree(false, false))	return false;
+
+	return static_cast<AABBCollisionTree*>(mTree)->ImportNodes(nodes, nb_nodes, imesh->GetNbTriangles());
+}
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /**
  *	Gets the number of bytes used by the tree.
@@ -36,6 +36,19 @@
 		///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 		override(BaseModel)	bool				Build(const OPCODECREATE& create);
 
+#if 1 // Added by AIST
+		///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+		/**
+		 *	Restores a collision model with the AABB collision tree exported from a built model.
+		 *	\param		imesh		[in] mesh interface
+		 *	\param		nodes		[in] nodes exported by AABBCollisionTree::ExportNodes
+		 *	\param		nb_nodes	[in] number of nodes
+		 *	\return		true if success
+		 */
+		///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+							bool				Restore(const MeshInterface* imesh, const AABBCollisionNodeData* nodes, udword nb_nodes);
+#endif
+
 #ifdef __MESHMERIZER_H__
 		///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 		/**
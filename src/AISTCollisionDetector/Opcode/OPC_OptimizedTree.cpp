@@ -308,6 +308,77 @@ bool AABBCollisionTree::Walk(GenericWalkingCallback callback, void* user_data) c
 	return true;
 }
 
+#if 1 // Added by AIST
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ *	Exports the nodes with the node indices instead of the pointers so that the tree can be stored.
+ *	\param		data	[out] array of GetNbNodes() elements
+ */
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void AABBCollisionTree::ExportNodes(AABBCollisionNodeData* data) const
+{
+	for(udword i=0;i<mNbNodes;i++)
+	{
+		const AABBCollisionNode& node = mNodes[i];
+		AABBCollisionNodeData& d = data[i];
+		for(udword j=0;j<3;j++)
+		{
+			d.mCenter[j] = node.mAABB.mCenter[j];
+			d.mExtents[j] = node.mAABB.mExtents[j];
+		}
+		if(node.IsLeaf())	d.mData = udword(node.mData);
+		else				d.mData = udword(node.GetPos() - mNodes)<<1;
+		d.mParent = udword(node.mB - mNodes);
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ *	Imports the nodes exported by ExportNodes.
+ *	\param		data		[in] exported nodes
+ *	\param		nb_nodes	[in] number of nodes
+ *	\param		nb_prims	[in] number of primitives referred by the leaves
+ *	\return		true if success
+ */
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool AABBCollisionTree::ImportNodes(const AABBCollisionNodeData* data, udword nb_nodes, udword nb_prims)
+{
+	if(!nb_nodes)	return false;
+
+	// Check the indices before they are converted to the pointers
+	for(udword i=0;i<nb_nodes;i++)
+	{
+		if(data[i].mParent>=nb_nodes)	return false;
+		if(data[i].mData&1)
+		{
+			if((data[i].mData>>1)>=nb_prims)	return false;
+		}
+		else if((data[i].mData>>1)+1>=nb_nodes)	return false;
+	}
+
+	if(mNbNodes!=nb_nodes)
+	{
+		mNbNodes = nb_nodes;
+		DELETEARRAY(mNodes);
+		mNodes = new AABBCollisionNode[mNbNodes];
+		CHECKALLOC(mNodes);
+	}
+
+	for(udword i=0;i<mNbNodes;i++)
+	{
+		const AABBCollisionNodeData& d = data[i];
+		AABBCollisionNode& node = mNodes[i];
+		node.mAABB.mCenter.Set(d.mCenter[0], d.mCenter[1], d.mCenter[2]);
+		node.mAABB.mExtents.Set(d.mExtents[0], d.mExtents[1], d.mExtents[2]);
+		node.mAABB.CreateSSV();
+		if(d.mData&1)	node.mData = d.mData;
+		else			node.mData = (EXWORD)&mNodes[d.mData>>1];
+		node.mB = &mNodes[d.mParent];
+	}
+	return true;
+}
+#endif
+
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /**
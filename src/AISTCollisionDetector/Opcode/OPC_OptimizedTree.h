@@ -185,9 +185,27 @@
 						udword				mNbNodes;
 	};
 
+#if 1 // Added by AIST
+	//! Node of AABBCollisionTree with the node indices instead of the pointers
+	struct AABBCollisionNodeData
+	{
+		float		mCenter[3];
+		float		mExtents[3];
+		udword		mData;		//!< (primitive index << 1) | 1 for a leaf, positive child index << 1 otherwise
+		udword		mParent;	//!< Index of the parent node. The parent of the root is itself.
+	};
+#endif
+
 	class OPCODE_API AABBCollisionTree : public AABBOptimizedTree
 	{
 		IMPLEMENT_COLLISION_TREE(AABBCollisionTree, AABBCollisionNode)
+#if 1 // Added by AIST
+		public:
+		/* Exports the nodes to the array of GetNbNodes() elements */
+									void			ExportNodes(AABBCollisionNodeData* data) const;
+		/* Imports the nodes exported by ExportNodes */
+									bool			ImportNodes(const AABBCollisionNodeData* data, udword nb_nodes, udword nb_prims);
+#endif
 	};
 
 	class OPCODE_API AABBNoLeafTree : public AABBOptimizedTree
@@ -0,0 +1,464 @@
+#include "PrimitiveCollisions.h"
+#include <limits>
+#include <cmath>
+
+using namespace std;
+using namespace cnoid;
+using namespace cnoid::primitive_collisions;
+
+namespace {
+
+// An edge axis is chosen only when it is clearly better than the face axes
+// because the face contacts give more stable contact sets
+const double EdgeAxisPreference = 1.05;
+
+const int MaxNumBoxContacts = 4;
+
+inline double clamp(double x, double lower, double upper)
+{
+    return (x < lower) ? lower : ((x > upper) ? upper : x);
+}
+
+
+Vector3 closestPointOnSegment(const Vector3& p, const Vector3& a, const Vector3& b)
+{
+    const Vector3 ab = b - a;
+    const double l2 = ab.squaredNorm();
+    if(l2 < 1.0e-18){
+        return a;
+    }
+    return a + clamp((p - a).dot(ab) / l2, 0.0, 1.0) * ab;
+}
+
+
+void findClosestPointsBetweenSegments
+(const Vector3& p1, const Vector3& q1, const Vector3& p2, const Vector3& q2,
+ Vector3& out_c1, Vector3& out_c2)
+{
+    const double eps = 1.0e-18;
+    const Vector3 d1 = q1 - p1;
+    const Vector3 d2 = q2 - p2;
+    const Vector3 r = p1 - p2;
+    const double a = d1.squaredNorm();
+    const double e = d2.squaredNorm();
+    const double f = d2.dot(r);
+    double s, t;
+
+    if(a <= eps && e <= eps){
+        s = t = 0.0;
+    } else if(a <= eps){
+        s = 0.0;
+        t = clamp(f / e, 0.0, 1.0);
+    } else {
+        const double c = d1.dot(r);
+        if(e <= eps){
+            t = 0.0;
+            s = clamp(-c / a, 0.0, 1.0);
+        } else {
+            const double b = d1.dot(d2);
+            const double denom = a * e - b * b;
+            s = (denom > eps) ? clamp((b * f - c * e) / denom, 0.0, 1.0) : 0.0;
+            t = (b * s + f) / e;
+            if(t < 0.0){
+                t = 0.0;
+                s = clamp(-c / a, 0.0, 1.0);
+            } else if(t > 1.0){
+                t = 1.0;
+                s = clamp((b - c) / a, 0.0, 1.0);
+            }
+        }
+    }
+    out_c1 = p1 + s * d1;
+    out_c2 = p2 + t * d2;
+}
+
+
+//! The value is negative inside the box
+double signedDistanceToBox(const Vector3& p, const Vector3& halfSize)
+{
+    const Vector3 q = p.cwiseAbs() - halfSize;
+    return q.cwiseMax(0.0).norm() + std::min(q.maxCoeff(), 0.0);
+}
+
+
+void clipPolygon(vector<Vector3>& polygon, const Vector3& normal, double offset, vector<Vector3>& buf)
+{
+    // Keep the part satisfying normal.dot(x) <= offset
+    buf.clear();
+    const int n = polygon.size();
+    for(int i=0; i < n; ++i){
+        const Vector3& a = polygon[i];
+        const Vector3& b = polygon[(i + 1) % n];
+        const double da = normal.dot(a) - offset;
+        const double db = normal.dot(b) - offset;
+        if(da <= 0.0){
+            buf.push_back(a);
+        }
+        if((da < 0.0 && db > 0.0) || (da > 0.0 && db < 0.0)){
+            buf.push_back(a + (da / (da - db)) * (b - a));
+        }
+    }
+    polygon.swap(buf);
+}
+
+
+void reduceContacts(vector<Contact>& contacts, size_t begin, int maxNumContacts)
+{
+    const int n = contacts.size() - begin;
+    if(n <= maxNumContacts){
+        return;
+    }
+    // Keep the deepest one and the ones spread most widely
+    vector<Contact> selected;
+    vector<bool> isSelected(n, false);
+    int deepest = 0;
+    for(int i=1; i < n; ++i){
+        if(contacts[begin + i].depth > contacts[begin + deepest].depth){
+            deepest = i;
+        }
+    }
+    selected.push_back(contacts[begin + deepest]);
+    isSelected[deepest] = true;
+    while(static_cast<int>(selected.size()) < maxNumContacts){
+        int farthest = -1;
+        double maxDistance = -1.0;
+        for(int i=0; i < n; ++i){
+            if(!isSelected[i]){
+                double minDistance = numeric_limits<double>::max();
+                for(auto& c : selected){
+                    minDistance = std::min(minDistance, (c.point - contacts[begin + i].point).squaredNorm());
+                }
+                if(minDistance > maxDistance){
+                    maxDistance = minDistance;
+                    farthest = i;
+                }
+            }
+        }
+        selected.push_back(contacts[begin + farthest]);
+        isSelected[farthest] = true;
+    }
+    contacts.resize(begin);
+    contacts.insert(contacts.end(), selected.begin(), selected.end());
+}
+
+}
+
+
+bool primitive_collisions::collideSphereSphere
+(const Vector3& center1, double radius1, const Vector3& center2, double radius2, vector<Contact>& out_contacts)
+{
+    const Vector3 d = center2 - center1;
+    const double distance = d.norm();
+    const double depth = radius1 + radius2 - distance;
+    if(depth < 0.0){
+        return false;
+    }
+    Contact contact;
+    contact.normal = (distance > 1.0e-9) ? Vector3(d / distance) : Vector3::UnitZ();
+    contact.depth = depth;
+    contact.point = center1 + (radius1 - depth / 2.0) * contact.normal;
+    out_contacts.push_back(contact);
+    return true;
+}
+
+
+bool primitive_collisions::collideSphereBox
+(const Vector3& center, double radius, const Isometry3& T, const Vector3& halfSize, vector<Contact>& out_contacts)
+{
+    const Matrix3 R = T.linear();
+    const Vector3 c = R.transpose() * (center - T.translation());
+    const Vector3 q = c.cwiseMax(-halfSize).cwiseMin(halfSize);
+    const Vector3 diff = c - q;
+    const double d2 = diff.squaredNorm();
+    if(d2 > radius * radius){
+        return false;
+    }
+
+    // The normal in the box coordinate points from the box to the sphere
+    Vector3 n;
+    Vector3 surfacePoint;
+    double depth;
+    if(d2 > 1.0e-18){
+        const double d = sqrt(d2);
+        n = diff / d;
+        depth = radius - d;
+        surfacePoint = q;
+    } else {
+        // The center is inside the box
+        int axis;
+        (halfSize - c.cwiseAbs()).minCoeff(&axis);
+        const double sign = (c[axis] >= 0.0) ? 1.0 : -1.0;
+        n = Vector3::Zero();
+        n[axis] = sign;
+        depth = radius + halfSize[axis] - fabs(c[axis]);
+        surfacePoint = c;
+        surfacePoint[axis] = sign * halfSize[axis];
+    }
+    Contact contact;
+    contact.point = T * Vector3((surfacePoint + c - radius * n) / 2.0);
+    contact.normal = -(R * n);
+    contact.depth = depth;
+    out_contacts.push_back(contact);
+    return true;
+}
+
+
+bool primitive_collisions::collideCapsuleSphere
+(const Isometry3& T, double radius1, double halfHeight, const Vector3& center, double radius2,
+ vector<Contact>& out_contacts)
+{
+    const Vector3 a = T * Vector3(0.0, -halfHeight, 0.0);
+    const Vector3 b = T * Vector3(0.0, halfHeight, 0.0);
+    return collideSphereSphere(closestPointOnSegment(center, a, b), radius1, center, radius2, out_contacts);
+}
+
+
+bool primitive_collisions::collideCapsuleCapsule
+(const Isometry3& T1, double radius1, double halfHeight1,
+ const Isometry3& T2, double radius2, double halfHeight2,
+ vector<Contact>& out_contacts)
+{
+    const Vector3 a1 = T1 * Vector3(0.0, -halfHeight1, 0.0);
+    const Vector3 b1 = T1 * Vector3(0.0, halfHeight1, 0.0);
+    const Vector3 a2 = T2 * Vector3(0.0, -halfHeight2, 0.0);
+    const Vector3 b2 = T2 * Vector3(0.0, halfHeight2, 0.0);
+    const Vector3 u1 = T1.linear().col(1);
+    const Vector3 u2 = T2.linear().col(1);
+
+    // Parallel capsules touch along a line, which is represented by the contacts at both ends
+    if(halfHeight1 > 0.0 && halfHeight2 > 0.0 && fabs(u1.dot(u2)) > 1.0 - 1.0e-6){
+        const Vector3& p1 = T1.translation();
+        const double ta = u1.dot(a2 - p1);
+        const double tb = u1.dot(b2 - p1);
+        const double lower = std::max(-halfHeight1, std::min(ta, tb));
+        const double upper = std::min(halfHeight1, std::max(ta, tb));
+        if(upper - lower > 1.0e-6){
+            bool detected = false;
+            for(double t : { lower, upper }){
+                const Vector3 p = p1 + t * u1;
+                detected |= collideSphereSphere(
+                    p, radius1, closestPointOnSegment(p, a2, b2), radius2, out_contacts);
+            }
+            return detected;
+        }
+    }
+
+    Vector3 c1, c2;
+    findClosestPointsBetweenSegments(a1, b1, a2, b2, c1, c2);
+    return collideSphereSphere(c1, radius1, c2, radius2, out_contacts);
+}
+
+
+bool primitive_collisions::collideCapsuleBox
+(const Isometry3& T1, double radius, double halfHeight, const Isometry3& T2, const Vector3& halfSize,
+ vector<Contact>& out_contacts)
+{
+    const Vector3 a = T1 * Vector3(0.0, -halfHeight, 0.0);
+    const Vector3 b = T1 * Vector3(0.0, halfHeight, 0.0);
+
+    bool detected = collideSphereBox(a, radius, T2, halfSize, out_contacts);
+    if(halfHeight <= 0.0){
+        return detected;
+    }
+    detected |= collideSphereBox(b, radius, T2, halfSize, out_contacts);
+
+    /*
+      The signed distance from the box is convex along the segment, so the deepest point
+      is found by the golden section search. It is added when it is not at an end.
+    */
+    const Isometry3 T2inv = T2.inverse();
+    const Vector3 al = T2inv * a;
+    const Vector3 bl = T2inv * b;
+    const double r = (sqrt(5.0) - 1.0) / 2.0;
+    double lower = 0.0;
+    double upper = 1.0;
+    double t1 = upper - r * (upper - lower);
+    double t2 = lower + r * (upper - lower);
+    double f1 = signedDistanceToBox(al + t1 * (bl - al), halfSize);
+    double f2 = signedDistanceToBox(al + t2 * (bl - al), halfSize);
+    for(int i=0; i < 40; ++i){
+        if(f1 < f2){
+            upper = t2;
+            t2 = t1;
+            f2 = f1;
+            t1 = upper - r * (upper - lower);
+            f1 = signedDistanceToBox(al + t1 * (bl - al), halfSize);
+        } else {
+            lower = t1;
+            t1 = t2;
+            f1 = f2;
+            t2 = lower + r * (upper - lower);
+            f2 = signedDistanceToBox(al + t2 * (bl - al), halfSize);
+        }
+    }
+    const double t = (lower + upper) / 2.0;
+    if(t > 0.01 && t < 0.99){
+        detected |= collideSphereBox(a + t * (b - a), radius, T2, halfSize, out_contacts);
+    }
+
+    return detected;
+}
+
+
+bool primitive_collisions::collideBoxBox
+(const Isometry3& T1, const Vector3& h1, const Isometry3& T2, const Vector3& h2, vector<Contact>& out_contacts)
+{
+    const Matrix3 R1 = T1.linear();
+    const Matrix3 R2 = T2.linear();
+    const Vector3 p = T2.translation() - T1.translation();
+    const Matrix3 R = R1.transpose() * R2;
+    // The small value avoids the degeneracy of the parallel edges
+    const Matrix3 Q = (R.cwiseAbs().array() + 1.0e-9).matrix();
+    const Vector3 p1 = R1.transpose() * p;
+    const Vector3 p2 = R2.transpose() * p;
+
+    // Separating axis test. The axis with the least penetration is selected.
+    double maxSeparation = -numeric_limits<double>::max();
+    int axisCode = -1;
+    Vector3 normal; // from box 1 to box 2
+
+    for(int i=0; i < 3; ++i){
+        const double s = fabs(p1[i]) - (h1[i] + h2.dot(Q.row(i)));
+        if(s > 0.0){
+            return false;
+        }
+        if(s > maxSeparation){
+            maxSeparation = s;
+            axisCode = i;
+            normal = (p1[i] >= 0.0) ? R1.col(i) : Vector3(-R1.col(i));
+        }
+    }
+    for(int i=0; i < 3; ++i){
+        const double s = fabs(p2[i]) - (h1.dot(Q.col(i)) + h2[i]);
+        if(s > 0.0){
+            return false;
+        }
+        if(s > maxSeparation){
+            maxSeparation = s;
+            axisCode = 3 + i;
+            normal = (p2[i] >= 0.0) ? R2.col(i) : Vector3(-R2.col(i));
+        }
+    }
+    for(int i=0; i < 3; ++i){
+        for(int j=0; j < 3; ++j){
+            Vector3 axis = R1.col(i).cross(R2.col(j));
+            const double l = axis.norm();
+            if(l < 1.0e-6){
+                continue;
+            }
+            axis /= l;
+            const double r1 = (h1.array() * (R1.transpose() * axis).array().abs()).sum();
+            const double r2 = (h2.array() * (R2.transpose() * axis).array().abs()).sum();
+            const double d = p.dot(axis);
+            const double s = fabs(d) - (r1 + r2);
+            if(s > 0.0){
+                return false;
+            }
+            if(s * EdgeAxisPreference > maxSeparation){
+                maxSeparation = s;
+                axisCode = 6 + 3 * i + j;
+                normal = (d >= 0.0) ? axis : Vector3(-axis);
+            }
+        }
+    }
+
+    const double depth = -maxSeparation;
+
+    if(axisCode >= 6){
+        // Edge-edge contact
+        const int i = (axisCode - 6) / 3;
+        const int j = (axisCode - 6) % 3;
+        Vector3 pa = T1.translation();
+        Vector3 pb = T2.translation();
+        for(int k=0; k < 3; ++k){
+            if(k != i){
+                pa += ((R1.col(k).dot(normal) > 0.0) ? h1[k] : -h1[k]) * R1.col(k);
+            }
+            if(k != j){
+                pb += ((R2.col(k).dot(normal) > 0.0) ? -h2[k] : h2[k]) * R2.col(k);
+            }
+        }
+        const Vector3 ua = R1.col(i);
+        const Vector3 ub = R2.col(j);
+        const Vector3 w = pb - pa;
+        const double uaub = ua.dot(ub);
+        const double q1 = ua.dot(w);
+        const double q2 = -ub.dot(w);
+        const double dd = 1.0 - uaub * uaub;
+        double alpha = 0.0;
+        double beta = 0.0;
+        if(dd > 1.0e-12){
+            alpha = clamp((q1 + uaub * q2) / dd, -h1[i], h1[i]);
+            beta = clamp((uaub * q1 + q2) / dd, -h2[j], h2[j]);
+        }
+        Contact contact;
+        contact.point = ((pa + alpha * ua) + (pb + beta * ub)) / 2.0;
+        contact.normal = normal;
+        contact.depth = depth;
+        out_contacts.push_back(contact);
+        return true;
+    }
+
+    // Face contact. The incident face is clipped by the side planes of the reference face.
+    const bool isReferenceBox1 = (axisCode < 3);
+    const int refAxis = axisCode % 3;
+    const Isometry3& Tr = isReferenceBox1 ? T1 : T2;
+    const Vector3& hr = isReferenceBox1 ? h1 : h2;
+    const Isometry3& Ti = isReferenceBox1 ? T2 : T1;
+    const Vector3& hi = isReferenceBox1 ? h2 : h1;
+    const Vector3 nr = isReferenceBox1 ? normal : Vector3(-normal); // toward the incident box
+
+    int incAxis = 0;
+    double maxProjection = -1.0;
+    for(int k=0; k < 3; ++k){
+        const double projection = fabs(Ti.linear().col(k).dot(nr));
+        if(projection > maxProjection){
+            maxProjection = projection;
+            incAxis = k;
+        }
+    }
+    const Vector3 incNormal =
+        (Ti.linear().col(incAxis).dot(nr) > 0.0) ? Vector3(-Ti.linear().col(incAxis)) : Vector3(Ti.linear().col(incAxis));
+    const Vector3 incCenter = Ti.translation() + hi[incAxis] * incNormal;
+    const int u = (incAxis + 1) % 3;
+    const int v = (incAxis + 2) % 3;
+    const Vector3 eu = hi[u] * Ti.linear().col(u);
+    const Vector3 ev = hi[v] * Ti.linear().col(v);
+
+    vector<Vector3> polygon = {
+        incCenter + eu + ev, incCenter - eu + ev, incCenter - eu - ev, incCenter + eu - ev };
+    vector<Vector3> buf;
+    buf.reserve(8);
+
+    for(int k=1; k < 3; ++k){
+        const int axis = (refAxis + k) % 3;
+        const Vector3 n = Tr.linear().col(axis);
+        const double c = n.dot(Tr.translation());
+        clipPolygon(polygon, n, c + hr[axis], buf);
+        clipPolygon(polygon, -n, -c + hr[axis], buf);
+    }
+
+    const double refOffset = nr.dot(Tr.translation()) + hr[refAxis];
+    const size_t begin = out_contacts.size();
+    for(auto& point : polygon){
+        const double pointDepth = refOffset - nr.dot(point);
+        if(pointDepth >= 0.0){
+            Contact contact;
+            contact.point = point + (pointDepth / 2.0) * nr;
+            contact.normal = normal;
+            contact.depth = pointDepth;
+            out_contacts.push_back(contact);
+        }
+    }
+    if(out_contacts.size() == begin){
+        // This may happen due to the numerical error when the boxes are just touching
+        Contact contact;
+        contact.point = (Tr.translation() + hr[refAxis] * nr + incCenter) / 2.0;
+        contact.normal = normal;
+        contact.depth = depth;
+        out_contacts.push_back(contact);
+    }
+    reduceContacts(out_contacts, begin, MaxNumBoxContacts);
+
+    return true;
+}
@@ -0,0 +1,58 @@
+#ifndef CNOID_AIST_COLLISION_DETECTOR_PRIMITIVE_COLLISIONS_H_INCLUDED
+#define CNOID_AIST_COLLISION_DETECTOR_PRIMITIVE_COLLISIONS_H_INCLUDED
+
+#include <cnoid/EigenTypes>
+#include <vector>
+
+namespace cnoid {
+
+/**
+   Closed-form contact generation for the pairs of boxes, spheres and capsules.
+   Each function returns false if the primitives do not collide. The normal of a contact
+   points from the first primitive to the second one and the depth is positive.
+*/
+namespace primitive_collisions {
+
+struct Contact
+{
+    Vector3 point;
+    Vector3 normal;
+    double depth;
+};
+
+/**
+   @param halfSize1, halfSize2 half lengths of the box edges
+*/
+bool collideBoxBox(
+    const Isometry3& T1, const Vector3& halfSize1, const Isometry3& T2, const Vector3& halfSize2,
+    std::vector<Contact>& out_contacts);
+
+bool collideSphereBox(
+    const Vector3& center, double radius, const Isometry3& T, const Vector3& halfSize,
+    std::vector<Contact>& out_contacts);
+
+bool collideSphereSphere(
+    const Vector3& center1, double radius1, const Vector3& center2, double radius2,
+    std::vector<Contact>& out_contacts);
+
+/**
+   @param halfHeight half the distance between the centers of the hemispheres on the y-axis
+*/
+bool collideCapsuleSphere(
+    const Isometry3& T, double radius1, double halfHeight, const Vector3& center, double radius2,
+    std::vector<Contact>& out_contacts);
+
+bool collideCapsuleCapsule(
+    const Isometry3& T1, double radius1, double halfHeight1,
+    const Isometry3& T2, double radius2, double halfHeight2,
+    std::vector<Contact>& out_contacts);
+
+bool collideCapsuleBox(
+    const Isometry3& T1, double radius, double halfHeight, const Isometry3& T2, const Vector3& halfSize,
+    std::vector<Contact>& out_contacts);
+
+}
+
+}
+
+#endif
@@ -1014,9 +1014,13 @@ void SceneWidget::Impl::doFpsTest(int iteration)
 
     update();
 
-    QMessageBox::information(
-        this, _("FPS Test Result"),
-        QString(_("FPS: %1 frames / %2 [s] = %3")).arg(numFrames).arg(time).arg(fps));
+    QString result = QString(_("FPS: %1 frames / %2 [s] = %3")).arg(numFrames).arg(time).arg(fps);
+    if(glslRenderer){
+        result += QString(_("\nVertex buffer memory: %1 [MB] (%2)"))
+            .arg(glslRenderer->vertexBufferMemorySize() / (1024.0 * 1024.0), 0, 'f', 2)
+            .arg(glslRenderer->isIndexedVertexBufferEnabled() ? _("indexed") : _("non-indexed"));
+    }
+    QMessageBox::information(this, _("FPS Test Result"), result);
 
     builtinCameraTransform->setTransform(C);
     update();
@@ -4,24 +4,182 @@
 using namespace std;
 using namespace cnoid;
 
+namespace cnoid {
 
-BodyPositionSeqFrame::BodyPositionSeqFrame()
+class BodyPositionSeqArena
 {
+public:
+    const int frameSize;
+    const int numFramesPerChunk;
+    vector<unique_ptr<double[]>> chunks;
+    vector<double*> freeFrames;
+
+    BodyPositionSeqArena(int frameSize, int numFramesPerChunk)
+        : frameSize(frameSize),
+          numFramesPerChunk(numFramesPerChunk)
+    { }
+
+    double* allocate(){
+        if(freeFrames.empty()){
+            double* chunk = new double[frameSize * numFramesPerChunk];
+            chunks.emplace_back(chunk);
+            // The capacity for all the frames is reserved so that release() does not allocate the memory
+            freeFrames.reserve(chunks.size() * numFramesPerChunk);
+            for(int i = numFramesPerChunk - 1; i >= 0; --i){
+                freeFrames.push_back(chunk + i * frameSize);
+            }
+        }
+        double* frame = freeFrames.back();
+        freeFrames.pop_back();
+        return frame;
+    }
+
+    void release(double* frame){
+        freeFrames.push_back(frame);
+    }
+};
 
 }
 
 
+BodyPositionSeqFrame::BodyPositionSeqFrame()
+{
+    arenaFrameSize = 0;
+}
+
+
 BodyPositionSeqFrame::BodyPositionSeqFrame(const BodyPositionSeqFrame& org)
-    : data(org.data)
+    : data(org.pdata, org.pdata + org.dataSize())
 {
     pdata = data.data();
+    arenaFrameSize = 0;
 }
 
 
 BodyPositionSeqFrame::BodyPositionSeqFrame(BodyPositionSeqFrame&& org)
-    : data(std::move(org.data))
+    : data(std::move(org.data)),
+      arena(std::move(org.arena))
+{
+    if(arena){
+        pdata = org.pdata;
+        arenaFrameSize = org.arenaFrameSize;
+    } else {
+        pdata = data.data();
+        arenaFrameSize = 0;
+    }
+    org.pdata = nullptr;
+    org.arenaFrameSize = 0;
+}
+
+
+BodyPositionSeqFrame::~BodyPositionSeqFrame()
+{
+    releaseArenaFrame();
+}
+
+
+BodyPositionSeqFrame& BodyPositionSeqFrame::operator=(const BodyPositionSeqFrame& rhs)
+{
+    if(this != &rhs){
+        const int size = rhs.dataSize();
+        if(arena && size == arenaFrameSize){
+            std::copy(rhs.pdata, rhs.pdata + size, pdata);
+        } else {
+            releaseArenaFrame();
+            data.assign(rhs.pdata, rhs.pdata + size);
+            pdata = data.data();
+        }
+    }
+    return *this;
+}
+
+
+BodyPositionSeqFrame& BodyPositionSeqFrame::operator=(BodyPositionSeqFrame&& rhs)
+{
+    if(this != &rhs){
+        if(rhs.arena){
+            releaseArenaFrame();
+            data.clear();
+            arena = std::move(rhs.arena);
+            arenaFrameSize = rhs.arenaFrameSize;
+            pdata = rhs.pdata;
+            rhs.arenaFrameSize = 0;
+        } else if(arena && static_cast<int>(rhs.data.size()) == arenaFrameSize){
+            std::copy(rhs.data.begin(), rhs.data.end(), pdata);
+        } else {
+            releaseArenaFrame();
+            data = std::move(rhs.data);
+            pdata = data.data();
+        }
+        rhs.pdata = nullptr;
+    }
+    return *this;
+}
+
+
+void BodyPositionSeqFrame::releaseArenaFrame()
+{
+    if(arena){
+        arena->release(pdata);
+        arena.reset();
+        arenaFrameSize = 0;
+        pdata = data.data();
+    }
+}
+
+
+void BodyPositionSeqFrame::clear()
 {
+    releaseArenaFrame();
+    data.clear();
+    pdata = nullptr;
+}
+
+
+BodyPositionSeqFrame& BodyPositionSeqFrame::allocate(int numLinks, int numJoints)
+{
+    const int size = numLinks * LinkPositionSize + numJoints + 2;
+    if(!arena || size != arenaFrameSize){
+        releaseArenaFrame();
+        data.resize(size);
+        pdata = data.data();
+    }
+    pdata[0] = numLinks;
+    pdata[numLinks * LinkPositionSize + 1] = numJoints;
+    return *this;
+}
+
+
+void BodyPositionSeqFrame::allocateInArena
+(const std::shared_ptr<BodyPositionSeqArena>& arena_, int numLinks, int numJoints)
+{
+    if(arena != arena_){
+        releaseArenaFrame();
+        vector<double>().swap(data);
+        pdata = arena_->allocate();
+        arena = arena_;
+        arenaFrameSize = arena_->frameSize;
+    }
+    pdata[0] = numLinks;
+    pdata[numLinks * LinkPositionSize + 1] = numJoints;
+}
+
+
+BodyPositionSeqFrameBlock BodyPositionSeqFrame::extend(int numLinks, int numJoints)
+{
+    if(arena){
+        // The extended frame does not fit in the fixed stride of the arena
+        vector<double> ownData(pdata, pdata + arenaFrameSize);
+        releaseArenaFrame();
+        data.swap(ownData);
+    }
+    int prevSize = data.size();
+    data.resize(prevSize + numLinks * LinkPositionSize + numJoints + 2);
     pdata = data.data();
+    double* block = pdata + prevSize;
+    block[0] = numLinks;
+    block[numLinks * LinkPositionSize + 1] = numJoints;
+    return BodyPositionSeqFrameBlock(block);
 }
 
 
@@ -30,6 +188,8 @@ BodyPositionSeq::BodyPositionSeq(int numFrames)
 {
     numLinkPositionsHint_ = 0;
     numJointDisplacementsHint_ = 0;
+    isArenaStorageEnabled_ = false;
+    numFramesPerArenaChunk = 1024;
 }
 
 
@@ -38,6 +198,43 @@ BodyPositionSeq::BodyPositionSeq(const BodyPositionSeq& org)
 {
     numLinkPositionsHint_ = org.numLinkPositionsHint_;
     numJointDisplacementsHint_ = org.numJointDisplacementsHint_;
+    isArenaStorageEnabled_ = org.isArenaStorageEnabled_;
+    numFramesPerArenaChunk = org.numFramesPerArenaChunk;
+}
+
+
+//! The arena is not shared with the source sequence.
+BodyPositionSeq& BodyPositionSeq::operator=(const BodyPositionSeq& rhs)
+{
+    if(this != &rhs){
+        Seq<BodyPositionSeqFrame>::operator=(rhs);
+        numLinkPositionsHint_ = rhs.numLinkPositionsHint_;
+        numJointDisplacementsHint_ = rhs.numJointDisplacementsHint_;
+    }
+    return *this;
+}
+
+
+void BodyPositionSeq::setArenaStorageEnabled(bool on, int numFramesPerChunk)
+{
+    isArenaStorageEnabled_ = on;
+    if(numFramesPerChunk != numFramesPerArenaChunk || !on){
+        // The frames in the current arena keep it until they are released
+        arena.reset();
+    }
+    numFramesPerArenaChunk = std::max(numFramesPerChunk, 1);
+}
+
+
+BodyPositionSeqFrame& BodyPositionSeq::allocateArenaFrame(BodyPositionSeqFrame& frame)
+{
+    const int frameSize =
+        numLinkPositionsHint_ * BodyPositionSeqFrame::LinkPositionSize + numJointDisplacementsHint_ + 2;
+    if(!arena || arena->frameSize != frameSize){
+        arena = make_shared<BodyPositionSeqArena>(frameSize, numFramesPerArenaChunk);
+    }
+    frame.allocateInArena(arena, numLinkPositionsHint_, numJointDisplacementsHint_);
+    return frame;
 }
 
 
@@ -4,6 +4,7 @@
 #include <cnoid/Seq>
 #include <cnoid/EigenTypes>
 #include <vector>
+#include <memory>
 #include <algorithm>
 #include "exportdecl.h"
 
@@ -109,50 +110,36 @@ protected:
 };
 
 
+class BodyPositionSeqArena;
+
 class CNOID_EXPORT BodyPositionSeqFrame : public BodyPositionSeqFrameBlock
 {
 public:
     BodyPositionSeqFrame();
     BodyPositionSeqFrame(const BodyPositionSeqFrame& org);
     BodyPositionSeqFrame(BodyPositionSeqFrame&& org);
+    ~BodyPositionSeqFrame();
     
-    BodyPositionSeqFrame& operator=(const BodyPositionSeqFrame& rhs){
-        data = rhs.data;
-        pdata = data.data();
-        return *this;
-    }
-
-    BodyPositionSeqFrame& operator=(BodyPositionSeqFrame&& rhs){
-        data = std::move(rhs.data);
-        pdata = data.data();
-        return *this;
-    }
+    BodyPositionSeqFrame& operator=(const BodyPositionSeqFrame& rhs);
+    BodyPositionSeqFrame& operator=(BodyPositionSeqFrame&& rhs);
 
-    void clear(){
-        data.clear();
-        pdata = nullptr;
-    }
+    void clear();
     
-    BodyPositionSeqFrame& allocate(int numLinks, int numJoints){
-        data.resize(numLinks * LinkPositionSize + numJoints + 2);
-        data[0] = numLinks;
-        data[numLinks * LinkPositionSize + 1] = numJoints;
-        pdata = data.data();
-        return *this;
-    }
+    BodyPositionSeqFrame& allocate(int numLinks, int numJoints);
+    BodyPositionSeqFrameBlock extend(int numLinks, int numJoints);
+
+    /**
+       True if the frame data is stored in the arena of the BodyPositionSeq.
+       A copy of the frame has its own data.
+    */
+    bool isArenaFrame() const { return arena != nullptr; }
 
-    BodyPositionSeqFrameBlock extend(int numLinks, int numJoints){
-        int prevSize = data.size();
-        data.resize(prevSize + numLinks * LinkPositionSize + numJoints + 2);
-        pdata = data.data();
-        double* block = pdata + prevSize;
-        block[0] = numLinks;
-        block[numLinks * LinkPositionSize + 1] = numJoints;
-        return BodyPositionSeqFrameBlock(block);
+    int dataSize() const {
+        return arena ? arenaFrameSize : data.size();
     }
 
     BodyPositionSeqFrameBlock firstBlock(){
-        return BodyPositionSeqFrameBlock(data.empty() ? nullptr : data.data());
+        return BodyPositionSeqFrameBlock(dataSize() == 0 ? nullptr : pdata);
     }
 
     const BodyPositionSeqFrameBlock firstBlock() const {
@@ -161,7 +148,7 @@ public:
     
     BodyPositionSeqFrameBlock nextBlockOf(const BodyPositionSeqFrameBlock& block){
         double* nextData = block.pdata + block.numLinkPositions() * LinkPositionSize + block.numJointDisplacements() + 2;
-        if(nextData >= data.data() + data.size()){
+        if(nextData >= pdata + dataSize()){
             nextData = nullptr;
         }
         return BodyPositionSeqFrameBlock(nextData);
@@ -173,6 +160,13 @@ public:
     
 private:
     std::vector<double> data;
+    std::shared_ptr<BodyPositionSeqArena> arena;
+    int arenaFrameSize;
+
+    void allocateInArena(const std::shared_ptr<BodyPositionSeqArena>& arena, int numLinks, int numJoints);
+    void releaseArenaFrame();
+
+    friend class BodyPositionSeq;
 };
 
 
@@ -188,21 +182,32 @@ public:
     BodyPositionSeq(int numFrames = 0);
     BodyPositionSeq(const BodyPositionSeq& org);
 
+    BodyPositionSeq& operator=(const BodyPositionSeq& rhs);
+
     int numLinkPositionsHint() const { return numLinkPositionsHint_; }
     void setNumLinkPositionsHint(int n) { numLinkPositionsHint_ = n; }
     
     int numJointDisplacementsHint() const { return numJointDisplacementsHint_; }
     void setNumJointDisplacementsHint(int n) { numJointDisplacementsHint_ = n; }
 
+    /**
+       In the arena storage mode, the data of the frames allocated with the hinted numbers of link
+       positions and joint displacements is stored in large fixed-stride chunks shared by the frames.
+       The frames removed from the sequence return their areas to the arena, so appending frames
+       does not allocate the memory for each frame.
+    */
+    void setArenaStorageEnabled(bool on, int numFramesPerChunk = 1024);
+    bool isArenaStorageEnabled() const { return isArenaStorageEnabled_; }
+
     BodyPositionSeqFrame& appendAllocatedFrame(){
-        return append().allocate(numLinkPositionsHint_, numJointDisplacementsHint_);
+        return allocateFrameData(append(), numLinkPositionsHint_, numJointDisplacementsHint_);
     }
 
     BodyPositionSeqFrame& allocateFrame(int index, int numLinks, int numJoints){
         if(index >= numFrames()){
             setNumFrames(index + 1);
         }
-        return frame(index).allocate(numLinks, numJoints);
+        return allocateFrameData(frame(index), numLinks, numJoints);
     }
 
     BodyPositionSeqFrame& allocateFrame(int index){
@@ -216,6 +221,19 @@ public:
 private:
     int numLinkPositionsHint_;
     int numJointDisplacementsHint_;
+    bool isArenaStorageEnabled_;
+    int numFramesPerArenaChunk;
+    std::shared_ptr<BodyPositionSeqArena> arena;
+
+    BodyPositionSeqFrame& allocateFrameData(BodyPositionSeqFrame& frame, int numLinks, int numJoints){
+        if(isArenaStorageEnabled_ &&
+           numLinks == numLinkPositionsHint_ && numJoints == numJointDisplacementsHint_){
+            return allocateArenaFrame(frame);
+        }
+        return frame.allocate(numLinks, numJoints);
+    }
+
+    BodyPositionSeqFrame& allocateArenaFrame(BodyPositionSeqFrame& frame);
 };
 
 class Body;
@@ -13,10 +13,12 @@
 #include <cnoid/EigenUtil>
 #include <cnoid/CloneMap>
 #include <cnoid/TimeMeasure>
+#include <cnoid/ThreadPool>
 #include <cnoid/stdx/clamp>
 #include <fmt/format.h>
 #include <random>
 #include <unordered_map>
+#include <atomic>
 #include <limits>
 #include <fstream>
 #include <iomanip>
@@ -114,6 +116,115 @@ enum CollisionDetectionModeBit {
     SelfCollision = 2
 };
 
+typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> DenseMatrix;
+
+/**
+   The matrix of the MCP stored in the block-sparse form.
+   The rows are grouped into the blocks of the constraints between the same pair of sub-bodies,
+   and the rows of a block only have the columns of the blocks sharing a non-static sub-body with it.
+   The other elements are always zero because the test forces of the constraints do not accelerate
+   the sub-bodies of the constraints.
+*/
+class BlockSparseMatrix
+{
+public:
+    // The sorted column indices of the non-zero elements of each block
+    vector<vector<int>> blockColumns;
+    vector<int> rowToBlock;
+    vector<int> rowValueOffsets;
+    vector<int> diagonalPositions;
+    vector<double> values;
+
+    class SubMatrix
+    {
+    public:
+        SubMatrix(BlockSparseMatrix& M, int rowOffset, int colOffset)
+            : M(M), rowOffset(rowOffset), colOffset(colOffset) { }
+        double& operator()(int i, int j) { return M.values[M.position(i + rowOffset, j + colOffset)]; }
+    private:
+        BlockSparseMatrix& M;
+        int rowOffset;
+        int colOffset;
+    };
+
+    BlockSparseMatrix(){
+        cachedBlock = -1;
+    }
+
+    int rows() const { return rowToBlock.size(); }
+
+    void setStructure(){
+        const int n = rowToBlock.size();
+        rowValueOffsets.resize(n);
+        diagonalPositions.resize(n);
+        int offset = 0;
+        for(int i=0; i < n; ++i){
+            auto& columns = blockColumns[rowToBlock[i]];
+            rowValueOffsets[i] = offset;
+            diagonalPositions[i] = offset + (std::lower_bound(columns.begin(), columns.end(), i) - columns.begin());
+            offset += columns.size();
+        }
+        values.resize(offset);
+        cachedBlock = -1;
+    }
+
+    double diagonal(int i) const { return values[diagonalPositions[i]]; }
+    double& diagonal(int i) { return values[diagonalPositions[i]]; }
+    
+    double operator()(int i, int j) const {
+        return (i == j) ? values[diagonalPositions[i]] : values[position(i, j)];
+    }
+
+    /**
+       The position of a column in a block is cached because the elements of a test force are
+       written to the consecutive rows of the same block.
+    */
+    int position(int i, int j) const {
+        const int block = rowToBlock[i];
+        if(block != cachedBlock || j != cachedColumn){
+            auto& columns = blockColumns[block];
+            cachedBlock = block;
+            cachedColumn = j;
+            cachedColumnPosition = std::lower_bound(columns.begin(), columns.end(), j) - columns.begin();
+        }
+        return rowValueOffsets[i] + cachedColumnPosition;
+    }
+
+    template<class TVector>
+    double sumOfOffDiagonalProducts(const TVector& x, int i) const {
+        auto& columns = blockColumns[rowToBlock[i]];
+        const double* row = &values[rowValueOffsets[i]];
+        double sum = -diagonal(i) * x(i);
+        const int n = columns.size();
+        for(int k=0; k < n; ++k){
+            sum += row[k] * x(columns[k]);
+        }
+        return sum;
+    }
+
+private:
+    mutable int cachedBlock;
+    mutable int cachedColumn;
+    mutable int cachedColumnPosition;
+};
+
+template<class TVector>
+inline double sumOfOffDiagonalProducts(const DenseMatrix& M, const TVector& x, int i)
+{
+    double sum = -M(i, i) * x(i);
+    const int size = M.cols();
+    for(int k=0; k < size; ++k){
+        sum += M(i, k) * x(k);
+    }
+    return sum;
+}
+
+template<class TVector>
+inline double sumOfOffDiagonalProducts(const BlockSparseMatrix& M, const TVector& x, int i)
+{
+    return M.sumOfOffDiagonalProducts(x, i);
+}
+
 }
 
 namespace cnoid
@@ -145,7 +256,8 @@ public:
 
     struct ConstraintPoint
     {
-        int globalIndex;
+        // Indices in the island that the constraint belongs to
+        int index;
         Vector3 point;
         Vector3 normalTowardInside[2];
         Vector3 defaultAccel[2];
@@ -153,7 +265,7 @@ public:
         double normalProjectionOfRelVelocityOn0;
         double depth; // position error in the case of a connection point
         double mu;
-        int globalFrictionIndex;
+        int frictionIndex;
         int numFrictionVectors;
         Vector3 frictionVector[4][2];
     };
@@ -188,6 +300,7 @@ public:
         vector<ConstraintPoint> constraintPoints;
         ContactMaterialExPtr contactMaterial;
         bool isNonContactConstraint;
+        int islandIndex;
     };
 
     unordered_map<IdPair<GeometryHandle>, LinkPair> geometryPairToLinkPairMap;
@@ -221,41 +334,127 @@ public:
     std::vector<LinkPair*> constrainedLinkPairs;
 
     int globalNumConstraintVectors;
-
     int globalNumContactNormalVectors;
-    int globalNumFrictionVectors;
-
-    int prevGlobalNumConstraintVectors;
-    int prevGlobalNumFrictionVectors;
 
     bool areThereImpacts;
     int numUnconverged;
 
-    typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> MatrixX;
+    typedef DenseMatrix MatrixX;
     typedef VectorXd VectorX;
-        
-    // Mlcp * solution + b   _|_  solution
-    MatrixX Mlcp;
 
-    // constant acceleration term when no external force is applied
-    VectorX an0;
-    VectorX at0;
+    /**
+       A set of the constraints whose sub-bodies are connected with each other by the constraints.
+       Static sub-bodies do not connect the constraints because their accelerations are not affected
+       by the constraint forces, so the MCP of each island can be solved independently.
+    */
+    class Island
+    {
+    public:
+        Impl* impl;
+        std::vector<LinkPair*> constrainedLinkPairs;
+        std::vector<DySubBody*> subBodies;
+
+        int numConstraintVectors;
+        int numContactNormalVectors;
+        int numFrictionVectors;
+
+        int prevNumConstraintVectors;
+        int prevNumFrictionVectors;
+
+        bool isConverged;
+
+        // The result of the last Gauss-Seidel iteration used for the debug output
+        int numGaussSeidelLoops;
+        bool isGaussSeidelIterationStopped;
+        double gaussSeidelError;
+
+        // Mlcp * solution + b   _|_  solution
+        MatrixX Mlcp;
+
+        // Mlcp in the block-sparse matrix mode
+        bool isBlockSparseMatrixMode;
+        BlockSparseMatrix sparseMlcp;
+        vector<int> linkPairToBlock;
+        vector<vector<LinkPair*>> blockAdjacentLinkPairs;
+        unordered_map<IdPair<DySubBody*>, int> subBodyPairToBlockMap;
+        vector<IdPair<DySubBody*>> blockSubBodyPairs;
+        vector<vector<LinkPair*>> blockLinkPairs;
+        vector<vector<int>> blockRows;
+        vector<vector<int>> subBodyToBlocks;
+        vector<int> blockMarks;
+        vector<char> singularColumnFlags;
+
+        // constant acceleration term when no external force is applied
+        VectorX an0;
+        VectorX at0;
+
+        // constant vector of LCP
+        VectorX b;
+
+        // contact force solution: normal forces at contact points
+        VectorX solution;
+
+        // for special version of gauss sidel iterative solver
+        std::vector<int> frictionIndexToContactIndex;
+        VectorX contactIndexToMu;
+        VectorX mcpHi;
+
+        Island(Impl* impl);
+        void clear();
+        void setConstraintIndices();
+        void solve();
+        void initMatrices();
+        void setBlockSparseMatrixStructure();
+        void setAccelCalcSkipInformation();
+        void setDefaultAccelerationVector();
+        void setAccelerationMatrix();
+        template<class TBlock>
+        void setAccelerationMatrix(TBlock& Knn, TBlock& Ktn, TBlock& Knt, TBlock& Ktt);
+        template<class TBlock>
+        void extractRelAccelsOfConstraintPoints(
+            TBlock& Kxn, TBlock& Kxt, const vector<LinkPair*>& linkPairs, int testForceIndex, int constraintIndex);
+        template<class TBlock>
+        void extractRelAccelsFromLinkPairCase1(
+            TBlock& Kxn, TBlock& Kxt, LinkPair& linkPair, int testForceIndex, int constraintIndex);
+        template<class TBlock>
+        void extractRelAccelsFromLinkPairCase2(
+            TBlock& Kxn, TBlock& Kxt,
+            LinkPair& linkPair, int iTestForce, int iDefault, int testForceIndex, int constraintIndex);
+        template<class TBlock>
+        void extractRelAccelsFromLinkPairCase3(
+            TBlock& Kxn, TBlock& Kxt, LinkPair& linkPair, int testForceIndex, int constraintIndex);
+        template<class TBlock>
+        void copySymmetricElementsOfAccelerationMatrix(TBlock& Knn, TBlock& Ktn, TBlock& Knt, TBlock& Ktt);
+        void clearSingularPointConstraintsOfClosedLoopConnections();
+        void setConstantVectorAndMuBlock();
+        template<class TMatrix>
+        void solveMCPByProjectedGaussSeidel(const TMatrix& M, const VectorX& b, VectorX& x);
+        template<class TMatrix>
+        void solveMCPByProjectedGaussSeidelMainStep(const TMatrix& M, const VectorX& b, VectorX& x);
+        template<class TMatrix>
+        void solveMCPByProjectedGaussSeidelInitial(
+            const TMatrix& M, const VectorX& b, VectorX& x, const int numIteration);
+        void checkLCPResult(MatrixX& M, VectorX& b, VectorX& x);
+        void checkMCPResult(MatrixX& M, VectorX& b, VectorX& x);
+#ifdef USE_PIVOTING_LCP
+        bool callPathLCPSolver(MatrixX& Mlcp, VectorX& b, VectorX& solution);
+#endif
+    };
 
-    // constant vector of LCP
-    VectorX b;
+    // Island instances are reused between the steps to keep the matrices and the previous solutions
+    vector<unique_ptr<Island>> islands;
+    int numIslands;
+    vector<int> islandSolvingOrder;
+    bool isBlockSparseMatrixMode;
 
-    // contact force solution: normal forces at contact points
-    VectorX solution;
+    int numThreads;
+    unique_ptr<ThreadPool> threadPool;
+    std::atomic<int> nextIslandOrderIndex;
 
     // random number generator
     std::uniform_real_distribution<double> randomAngle;
     std::mt19937 randomEngine;
     
-    // for special version of gauss sidel iterative solver
-    std::vector<int> frictionIndexToContactIndex;
-    VectorX contactIndexToMu;
-    VectorX mcpHi;
-
     int  maxNumGaussSeidelIteration;
     int  numGaussSeidelInitialIteration;
     double gaussSeidelErrorCriterion;
@@ -286,42 +485,20 @@ public:
     void set2dConstraintPoints(const Constrain2dLinkPairPtr& linkPair);
     void putContactPoints();
     void solveImpactConstraints();
-    void initMatrices();
-    void setAccelCalcSkipInformation();
-    void setDefaultAccelerationVector();
-    void setAccelerationMatrix();
+    DySubBody* findIslandRoot(DySubBody* subBody);
+    void extractIslands();
+    void solveIslands();
+    void solveIslandsInQueue();
+    void putGaussSeidelIterationStatistics();
     void initABMForceElementsWithNoExtForce(DySubBody* subBody);
     void calcABMForceElementsWithTestForce(
         DySubBody* subBody, DyLink* linkToApplyForce, const Vector3& f, const Vector3& tau);
     void calcAccelsABM(DySubBody* subBody, int constraintIndex);
     void calcAccelsMM(DySubBody* bodyData, int constraintIndex);
-    void extractRelAccelsOfConstraintPoints(
-        Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt, int testForceIndex, int constraintIndex);
-    void extractRelAccelsFromLinkPairCase1(
-        Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt,
-        LinkPair& linkPair, int testForceIndex, int constraintIndex);
-    void extractRelAccelsFromLinkPairCase2(
-        Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt,
-        LinkPair& linkPair, int iTestForce, int iDefault, int testForceIndex, int constraintIndex);
-    void extractRelAccelsFromLinkPairCase3(
-        Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt,
-        LinkPair& linkPair, int testForceIndex, int constraintIndex);
-    void copySymmetricElementsOfAccelerationMatrix(
-        Eigen::Block<MatrixX>& Knn, Eigen::Block<MatrixX>& Ktn, Eigen::Block<MatrixX>& Knt, Eigen::Block<MatrixX>& Ktt);
-    void clearSingularPointConstraintsOfClosedLoopConnections();
-    void setConstantVectorAndMuBlock();
     void addConstraintForceToLinks();
     void addConstraintForceToLink(LinkPair* linkPair, int ipair);
-    void solveMCPByProjectedGaussSeidel(const MatrixX& M, const VectorX& b, VectorX& x);
-    void solveMCPByProjectedGaussSeidelMainStep(const MatrixX& M, const VectorX& b, VectorX& x);
-    void solveMCPByProjectedGaussSeidelInitial(
-        const MatrixX& M, const VectorX& b, VectorX& x, const int numIteration);
-    void checkLCPResult(MatrixX& M, VectorX& b, VectorX& x);
-    void checkMCPResult(MatrixX& M, VectorX& b, VectorX& x);
 
 #ifdef USE_PIVOTING_LCP
-    bool callPathLCPSolver(MatrixX& Mlcp, VectorX& b, VectorX& solution);
-
     // for PATH solver
     std::vector<double> lb;
     std::vector<double> ub;
@@ -386,6 +563,10 @@ ConstraintForceSolver::Impl::Impl(DyWorldBase& world)
 
     bodyIndexToCollisionDetectionModeMap.clear();
     is2Dmode = false;
+
+    numIslands = 0;
+    numThreads = 0;
+    isBlockSparseMatrixMode = false;
 }
 
 
@@ -433,6 +614,8 @@ void ConstraintForceSolver::Impl::initSubBody(DySubBody* subBody)
     subBody->hasConstrainedLinks = false;
     subBody->isTestForceBeingApplied = false;
     subBody->hasConstrainedLinks = false;
+    subBody->islandParent = subBody;
+    subBody->islandIndex = -1;
     
     for(auto& link : subBody->links()){
         link->cfs.dw.setZero();
@@ -470,7 +653,7 @@ void ConstraintForceSolver::Impl::init2Dconstraint(DySubBody* subBody)
     for(int i=0; i < 3; ++i){
         ConstraintPoint& constraint = linkPair->constraintPoints[i];
         constraint.numFrictionVectors = 0;
-        constraint.globalFrictionIndex = numeric_limits<int>::max();
+        constraint.frictionIndex = numeric_limits<int>::max();
         linkPair->globalYpositions[i] = (rootLink->R() * local2dConstraintPoints[i] + rootLink->p()).y();
     }
         
@@ -519,7 +702,7 @@ void ConstraintForceSolver::Impl::initExtraJoint(ExtraJoint& extraJoint)
     for(int i=0; i < numConstraints; ++i){
         ConstraintPoint& constraint = linkPair->constraintPoints[i];
         constraint.numFrictionVectors = 0;
-        constraint.globalFrictionIndex = numeric_limits<int>::max();
+        constraint.frictionIndex = numeric_limits<int>::max();
     }
 
     for(int i=0; i < 2; ++i){
@@ -586,8 +769,8 @@ void ConstraintForceSolver::Impl::initialize(void)
 
     bodyCollisionDetector.makeReady();
 
-    prevGlobalNumConstraintVectors = 0;
-    prevGlobalNumFrictionVectors = 0;
+    islands.clear();
+    numIslands = 0;
     numUnconverged = 0;
 
     if(ENABLE_RANDOM_STATIC_FRICTION_BASE){
@@ -669,7 +852,6 @@ void ConstraintForceSolver::Impl::solve()
     bodyCollisionDetector.updatePositions();
 
     globalNumConstraintVectors = 0;
-    globalNumFrictionVectors = 0;
     areThereImpacts = false;
 
     constrainedLinkPairs.clear();
@@ -680,72 +862,48 @@ void ConstraintForceSolver::Impl::solve()
         cout << globalNumContactNormalVectors;
     }
 
+    int prevNumIslands = numIslands;
+    numIslands = 0;
+
     if(globalNumConstraintVectors > 0){
 
         if(CFS_DEBUG){
             os << "Num Collisions: " << globalNumContactNormalVectors << std::endl;
         }
-        if(CFS_DEBUG_VERBOSE) putContactPoints();
 
-        const bool constraintsSizeChanged = ((globalNumFrictionVectors   != prevGlobalNumFrictionVectors) ||
-                                             (globalNumConstraintVectors != prevGlobalNumConstraintVectors));
+        extractIslands();
 
-        if(constraintsSizeChanged){
-            initMatrices();
-        }
+        if(CFS_DEBUG_VERBOSE) putContactPoints();
 
         if(areThereImpacts){
             solveImpactConstraints();
         }
 
-        if(SKIP_REDUNDANT_ACCEL_CALC){
-            setAccelCalcSkipInformation();
-        }
-
-        setDefaultAccelerationVector();
-        setAccelerationMatrix();
+        solveIslands();
 
-        clearSingularPointConstraintsOfClosedLoopConnections();
-		
-        setConstantVectorAndMuBlock();
-
-        if(CFS_DEBUG_VERBOSE){
-            debugPutVector(an0, "an0");
-            debugPutVector(at0, "at0");
-            debugPutMatrix(Mlcp, "Mlcp");
-            debugPutVector(b.head(globalNumConstraintVectors), "b1");
-            debugPutVector(b.segment(globalNumConstraintVectors, globalNumFrictionVectors), "b2");
-        }
-
-        bool isConverged;
-#ifdef USE_PIVOTING_LCP
-        isConverged = callPathLCPSolver(Mlcp, b, solution);
-#else
-        if(!USE_PREVIOUS_LCP_SOLUTION || constraintsSizeChanged){
-            solution.setZero();
+        if(CFS_MCP_DEBUG){
+            putGaussSeidelIterationStatistics();
         }
-        solveMCPByProjectedGaussSeidel(Mlcp, b, solution);
-        isConverged = true;
-#endif
 
-        if(!isConverged){
-            ++numUnconverged;
-            if(CFS_DEBUG)
-                os << "LCP didn't converge" << numUnconverged << std::endl;
-        } else {
-            if(CFS_DEBUG)
-                os << "LCP converged" << std::endl;
-            if(CFS_DEBUG_LCPCHECK){
-                // checkLCPResult(Mlcp, b, solution);
-                checkMCPResult(Mlcp, b, solution);
+        for(int i=0; i < numIslands; ++i){
+            if(!islands[i]->isConverged){
+                ++numUnconverged;
+                if(CFS_DEBUG)
+                    os << "LCP didn't converge" << numUnconverged << std::endl;
+            } else {
+                if(CFS_DEBUG)
+                    os << "LCP converged" << std::endl;
             }
-
-            addConstraintForceToLinks();
         }
+
+        addConstraintForceToLinks();
     }
 
-    prevGlobalNumConstraintVectors = globalNumConstraintVectors;
-    prevGlobalNumFrictionVectors = globalNumFrictionVectors;
+    // The islands which are not used in this step have no constraints
+    for(int i = numIslands; i < prevNumIslands; ++i){
+        islands[i]->prevNumConstraintVectors = 0;
+        islands[i]->prevNumFrictionVectors = 0;
+    }
 }
 
 
@@ -852,7 +1010,7 @@ bool ConstraintForceSolver::Impl::setContactConstraintPoint(LinkPair& linkPair,
     contact.normalTowardInside[1] = collision.normal;
     contact.normalTowardInside[0] = -contact.normalTowardInside[1];
     contact.depth = collision.depth;
-    contact.globalIndex = globalNumConstraintVectors++;
+    ++globalNumConstraintVectors;
 
     // check velocities
     Vector3 v[2];
@@ -894,8 +1052,6 @@ bool ConstraintForceSolver::Impl::setContactConstraintPoint(LinkPair& linkPair,
     Vector3 v_tangent =
         contact.relVelocityOn0 - contact.normalProjectionOfRelVelocityOn0 * contact.normalTowardInside[1];
     
-    contact.globalFrictionIndex = globalNumFrictionVectors;
-    
     double vt_square = v_tangent.squaredNorm();
     static const double vsqrthresh = VEL_THRESH_OF_DYNAMIC_FRICTION * VEL_THRESH_OF_DYNAMIC_FRICTION;
     bool isSlipping = (vt_square > vsqrthresh);
@@ -925,7 +1081,6 @@ bool ConstraintForceSolver::Impl::setContactConstraintPoint(LinkPair& linkPair,
             contact.numFrictionVectors = 0;
         }
     }
-    globalNumFrictionVectors += contact.numFrictionVectors;
 
     return true;
 }
@@ -1011,7 +1166,7 @@ void ConstraintForceSolver::Impl::setExtraJointConstraintPoints(const ExtraJoint
         constraint.normalTowardInside[0] =  axis;
         constraint.normalTowardInside[1] = -axis;
         constraint.depth = axis.dot(error);
-        constraint.globalIndex = globalNumConstraintVectors++;
+        ++globalNumConstraintVectors;
         constraint.normalProjectionOfRelVelocityOn0 = constraint.normalTowardInside[1].dot(relVelocityOn0);
     }
     linkPair->link[0]->subBody()->hasConstrainedLinks = true;
@@ -1036,7 +1191,7 @@ void ConstraintForceSolver::Impl::set2dConstraintPoints(const Constrain2dLinkPai
         constraint.normalTowardInside[0] =  yAxis;
         constraint.normalTowardInside[1] = -yAxis;
         constraint.depth = point1.y() - linkPair->globalYpositions[i];
-        constraint.globalIndex = globalNumConstraintVectors++;
+        ++globalNumConstraintVectors;
         constraint.normalProjectionOfRelVelocityOn0 = -(link1->vo() + link1->w().cross(point1)).y();
     }
     linkPair->link[0]->subBody()->hasConstrainedLinks = true;
@@ -1065,7 +1220,7 @@ void ConstraintForceSolver::Impl::putContactPoints()
             auto& constraintPoints = linkPair->constraintPoints;
             for(size_t j=0; j < constraintPoints.size(); ++j){
                 ConstraintPoint& contact = constraintPoints[j];
-                os << " index " << contact.globalIndex;
+                os << " index " << contact.index;
                 os << " point: " << contact.point;
                 os << " normal: " << contact.normalTowardInside[1];
                 os << " defaultAccel[0]: " << contact.defaultAccel[0];
@@ -1094,14 +1249,389 @@ void ConstraintForceSolver::Impl::solveImpactConstraints()
 }
 
 
-void ConstraintForceSolver::Impl::initMatrices()
+/**
+   The sub-bodies connected by the constraints are merged with the union-find algorithm.
+*/
+DySubBody* ConstraintForceSolver::Impl::findIslandRoot(DySubBody* subBody)
+{
+    auto root = subBody;
+    while(root->islandParent != root){
+        root = root->islandParent;
+    }
+    // path compression
+    while(subBody != root){
+        auto parent = subBody->islandParent;
+        subBody->islandParent = root;
+        subBody = parent;
+    }
+    return root;
+}
+
+
+/**
+   The islands are numbered in the order of the first appearance of their link pairs
+   in constrainedLinkPairs so that the decomposition is deterministic.
+*/
+void ConstraintForceSolver::Impl::extractIslands()
+{
+    for(auto& linkPair : constrainedLinkPairs){
+        for(int i=0; i < 2; ++i){
+            auto subBody = linkPair->link[i]->subBody();
+            subBody->islandParent = subBody;
+            subBody->islandIndex = -1;
+        }
+    }
+
+    for(auto& linkPair : constrainedLinkPairs){
+        auto subBody0 = linkPair->link[0]->subBody();
+        auto subBody1 = linkPair->link[1]->subBody();
+        if(!subBody0->isStatic() && !subBody1->isStatic()){
+            auto root0 = findIslandRoot(subBody0);
+            auto root1 = findIslandRoot(subBody1);
+            if(root0 != root1){
+                root1->islandParent = root0;
+            }
+        }
+    }
+
+    for(auto& linkPair : constrainedLinkPairs){
+        auto subBody = linkPair->link[0]->subBody();
+        if(subBody->isStatic()){
+            subBody = linkPair->link[1]->subBody();
+        }
+        auto root = findIslandRoot(subBody);
+        if(root->islandIndex < 0){
+            root->islandIndex = numIslands++;
+            if(numIslands > static_cast<int>(islands.size())){
+                islands.emplace_back(new Island(this));
+            }
+            auto& island = *islands[root->islandIndex];
+            island.clear();
+            if(!root->isStatic()){
+                root->islandSubBodyIndex = island.subBodies.size();
+                island.subBodies.push_back(root);
+            }
+        }
+        auto& island = *islands[root->islandIndex];
+        island.constrainedLinkPairs.push_back(linkPair);
+        linkPair->islandIndex = root->islandIndex;
+
+        for(int i=0; i < 2; ++i){
+            auto subBody = linkPair->link[i]->subBody();
+            if(!subBody->isStatic() && subBody->islandIndex < 0){
+                subBody->islandIndex = root->islandIndex;
+                subBody->islandSubBodyIndex = island.subBodies.size();
+                island.subBodies.push_back(subBody);
+            }
+        }
+    }
+
+    for(int i=0; i < numIslands; ++i){
+        islands[i]->setConstraintIndices();
+    }
+}
+
+
+/**
+   Each island only accesses the links of its own non-static sub-bodies while it is solved,
+   so the islands can be solved in any order and in parallel without changing the results.
+*/
+void ConstraintForceSolver::Impl::solveIslands()
+{
+    int numThreadsToUse = std::min(numThreads, numIslands);
+
+    // The islands are solved serially when they write the debug output to the shared stream
+    if(CFS_DEBUG_VERBOSE || CFS_DEBUG_VERBOSE_2 || CFS_DEBUG_LCPCHECK){
+        numThreadsToUse = 1;
+    }
+
+    if(numThreadsToUse <= 1){
+        for(int i=0; i < numIslands; ++i){
+            islands[i]->solve();
+        }
+        return;
+    }
+
+    // Larger islands are solved first to balance the loads of the threads
+    islandSolvingOrder.resize(numIslands);
+    for(int i=0; i < numIslands; ++i){
+        islandSolvingOrder[i] = i;
+    }
+    std::stable_sort(
+        islandSolvingOrder.begin(), islandSolvingOrder.end(),
+        [&](int i1, int i2){
+            return islands[i1]->numConstraintVectors > islands[i2]->numConstraintVectors; });
+
+    if(!threadPool || threadPool->size() != numThreads - 1){
+        threadPool.reset(new ThreadPool(numThreads - 1));
+    }
+    nextIslandOrderIndex = 0;
+    for(int i=1; i < numThreadsToUse; ++i){
+        threadPool->start([this](){ solveIslandsInQueue(); });
+    }
+    solveIslandsInQueue();
+    threadPool->wait();
+}
+
+
+void ConstraintForceSolver::Impl::solveIslandsInQueue()
+{
+    while(true){
+        int orderIndex = nextIslandOrderIndex.fetch_add(1);
+        if(orderIndex >= numIslands){
+            break;
+        }
+        islands[islandSolvingOrder[orderIndex]]->solve();
+    }
+}
+
+
+/**
+   The iteration results are recorded by each island and gathered here after all the islands
+   are solved so that the worker threads do not update the shared counters and stream.
+*/
+void ConstraintForceSolver::Impl::putGaussSeidelIterationStatistics()
+{
+    for(int i=0; i < numIslands; ++i){
+        auto& island = islands[i];
+        const int n = island->numGaussSeidelLoops;
+        os << "Iteration ";
+        if(!island->isGaussSeidelIterationStopped){
+            os << "not stopped" << ", error = " << island->gaussSeidelError << endl;
+        } else if(CFS_MCP_DEBUG_SHOW_ITERATION_STOP){
+            os << "stopped at " << n << ", error = " << island->gaussSeidelError << endl;
+        }
+        numGaussSeidelTotalLoops += n;
+        numGaussSeidelTotalCalls++;
+        numGaussSeidelTotalLoopsMax = std::max(numGaussSeidelTotalLoopsMax, n);
+        os << ", avarage = " << (numGaussSeidelTotalLoops / numGaussSeidelTotalCalls);
+        os << ", max = " << numGaussSeidelTotalLoopsMax;
+        os << endl;
+    }
+}
+
+
+ConstraintForceSolver::Impl::Island::Island(Impl* impl)
+    : impl(impl)
+{
+    numConstraintVectors = 0;
+    numContactNormalVectors = 0;
+    numFrictionVectors = 0;
+    prevNumConstraintVectors = 0;
+    prevNumFrictionVectors = 0;
+    isConverged = false;
+    numGaussSeidelLoops = 0;
+    isGaussSeidelIterationStopped = false;
+    gaussSeidelError = 0.0;
+    isBlockSparseMatrixMode = false;
+}
+
+
+void ConstraintForceSolver::Impl::Island::clear()
+{
+    constrainedLinkPairs.clear();
+    subBodies.clear();
+}
+
+
+/**
+   The contact constraints precede the non-contact constraints in constrainedLinkPairs,
+   so the normal vectors of the contacts are placed at the head of the island indices.
+*/
+void ConstraintForceSolver::Impl::Island::setConstraintIndices()
+{
+    numConstraintVectors = 0;
+    numContactNormalVectors = 0;
+    numFrictionVectors = 0;
+
+    for(auto& linkPair : constrainedLinkPairs){
+        for(auto& constraint : linkPair->constraintPoints){
+            constraint.index = numConstraintVectors++;
+            if(!linkPair->isNonContactConstraint){
+                constraint.frictionIndex = numFrictionVectors;
+                numFrictionVectors += constraint.numFrictionVectors;
+            }
+        }
+        if(!linkPair->isNonContactConstraint){
+            numContactNormalVectors = numConstraintVectors;
+        }
+    }
+}
+
+
+void ConstraintForceSolver::Impl::Island::solve()
+{
+    const bool constraintsSizeChanged = ((numFrictionVectors   != prevNumFrictionVectors) ||
+                                         (numConstraintVectors != prevNumConstraintVectors));
+
+    // The mode is updated at every solve so that the islands follow the mode changed in the simulation.
+    // The block-sparse matrix is not supported by the pivoting solver and the symmetric matrix assumption.
+    const bool blockSparseMode = impl->isBlockSparseMatrixMode && !usePivotingLCP && !ASSUME_SYMMETRIC_MATRIX;
+    const bool modeChanged = (blockSparseMode != isBlockSparseMatrixMode);
+    isBlockSparseMatrixMode = blockSparseMode;
+
+    if(constraintsSizeChanged || modeChanged){
+        initMatrices();
+    }
+
+    if(isBlockSparseMatrixMode){
+        setBlockSparseMatrixStructure();
+    }
+
+    if(SKIP_REDUNDANT_ACCEL_CALC){
+        setAccelCalcSkipInformation();
+    }
+
+    setDefaultAccelerationVector();
+    setAccelerationMatrix();
+
+    clearSingularPointConstraintsOfClosedLoopConnections();
+
+    setConstantVectorAndMuBlock();
+
+    if(CFS_DEBUG_VERBOSE){
+        impl->debugPutVector(an0, "an0");
+        impl->debugPutVector(at0, "at0");
+        if(!isBlockSparseMatrixMode){
+            impl->debugPutMatrix(Mlcp, "Mlcp");
+        }
+        impl->debugPutVector(b.head(numConstraintVectors), "b1");
+        impl->debugPutVector(b.segment(numConstraintVectors, numFrictionVectors), "b2");
+    }
+
+#ifdef USE_PIVOTING_LCP
+    isConverged = callPathLCPSolver(Mlcp, b, solution);
+#else
+    if(!USE_PREVIOUS_LCP_SOLUTION || constraintsSizeChanged){
+        solution.setZero();
+    }
+    if(isBlockSparseMatrixMode){
+        solveMCPByProjectedGaussSeidel(sparseMlcp, b, solution);
+    } else {
+        solveMCPByProjectedGaussSeidel(Mlcp, b, solution);
+    }
+    isConverged = true;
+#endif
+
+    if(isConverged && CFS_DEBUG_LCPCHECK && !isBlockSparseMatrixMode){
+        // checkLCPResult(Mlcp, b, solution);
+        checkMCPResult(Mlcp, b, solution);
+    }
+
+    prevNumConstraintVectors = numConstraintVectors;
+    prevNumFrictionVectors = numFrictionVectors;
+}
+
+
+/**
+   The structure is updated every step because the contacts in the island change in every step.
+*/
+void ConstraintForceSolver::Impl::Island::setBlockSparseMatrixStructure()
+{
+    const int n = numConstraintVectors;
+    const int numLinkPairs = constrainedLinkPairs.size();
+    auto& M = sparseMlcp;
+
+    // Each block consists of the link pairs whose sub-bodies are the same
+    subBodyPairToBlockMap.clear();
+    blockSubBodyPairs.clear();
+    linkPairToBlock.resize(numLinkPairs);
+    for(int i=0; i < numLinkPairs; ++i){
+        auto linkPair = constrainedLinkPairs[i];
+        IdPair<DySubBody*> subBodyPair(linkPair->link[0]->subBody(), linkPair->link[1]->subBody());
+        auto inserted = subBodyPairToBlockMap.insert(make_pair(subBodyPair, blockSubBodyPairs.size()));
+        if(inserted.second){
+            blockSubBodyPairs.push_back(subBodyPair);
+        }
+        linkPairToBlock[i] = inserted.first->second;
+    }
+    const int numBlocks = blockSubBodyPairs.size();
+
+    blockLinkPairs.resize(numBlocks);
+    blockRows.resize(numBlocks);
+    for(int i=0; i < numBlocks; ++i){
+        blockLinkPairs[i].clear();
+        blockRows[i].clear();
+    }
+    for(int i=0; i < numLinkPairs; ++i){
+        const int block = linkPairToBlock[i];
+        auto linkPair = constrainedLinkPairs[i];
+        blockLinkPairs[block].push_back(linkPair);
+        auto& rows = blockRows[block];
+        for(auto& constraint : linkPair->constraintPoints){
+            rows.push_back(constraint.index);
+            for(int j=0; j < constraint.numFrictionVectors; ++j){
+                rows.push_back(n + constraint.frictionIndex + j);
+            }
+        }
+    }
+
+    subBodyToBlocks.resize(subBodies.size());
+    for(auto& blocks : subBodyToBlocks){
+        blocks.clear();
+    }
+    for(int i=0; i < numBlocks; ++i){
+        auto& subBodyPair = blockSubBodyPairs[i];
+        for(int j=0; j < 2; ++j){
+            auto subBody = subBodyPair[j];
+            if(!subBody->isStatic() && (j == 0 || subBody != subBodyPair[0])){
+                subBodyToBlocks[subBody->islandSubBodyIndex].push_back(i);
+            }
+        }
+    }
+
+    /*
+      The blocks sharing a non-static sub-body are adjacent. A block is always adjacent to itself
+      so that the diagonal elements are stored even if both the sub-bodies are static.
+    */
+    M.blockColumns.resize(numBlocks);
+    blockAdjacentLinkPairs.resize(numBlocks);
+    blockMarks.assign(numBlocks, -1);
+    for(int i=0; i < numBlocks; ++i){
+        auto& columns = M.blockColumns[i];
+        auto& adjacentLinkPairs = blockAdjacentLinkPairs[i];
+        columns.clear();
+        adjacentLinkPairs.clear();
+        auto addAdjacentBlock = [&](int block){
+            if(blockMarks[block] != i){
+                blockMarks[block] = i;
+                columns.insert(columns.end(), blockRows[block].begin(), blockRows[block].end());
+                adjacentLinkPairs.insert(
+                    adjacentLinkPairs.end(), blockLinkPairs[block].begin(), blockLinkPairs[block].end());
+            }
+        };
+        addAdjacentBlock(i);
+        for(int j=0; j < 2; ++j){
+            auto subBody = blockSubBodyPairs[i][j];
+            if(!subBody->isStatic()){
+                for(auto& block : subBodyToBlocks[subBody->islandSubBodyIndex]){
+                    addAdjacentBlock(block);
+                }
+            }
+        }
+        std::sort(columns.begin(), columns.end());
+    }
+
+    M.rowToBlock.resize(n + numFrictionVectors);
+    for(int i=0; i < numBlocks; ++i){
+        for(auto& row : blockRows[i]){
+            M.rowToBlock[row] = i;
+        }
+    }
+    M.setStructure();
+}
+
+
+void ConstraintForceSolver::Impl::Island::initMatrices()
 {
-    const int n = globalNumConstraintVectors;
-    const int m = globalNumFrictionVectors;
+    const int n = numConstraintVectors;
+    const int m = numFrictionVectors;
 
     const int dimLCP = usePivotingLCP ? (n + m + m) : (n + m);
 
-    Mlcp.resize(dimLCP, dimLCP);
+    if(!isBlockSparseMatrixMode){
+        Mlcp.resize(dimLCP, dimLCP);
+    }
     b.resize(dimLCP);
     solution.resize(dimLCP);
 
@@ -1115,8 +1645,8 @@ void ConstraintForceSolver::Impl::initMatrices()
 
     } else {
         frictionIndexToContactIndex.resize(m);
-        contactIndexToMu.resize(globalNumContactNormalVectors);
-        mcpHi.resize(globalNumContactNormalVectors);
+        contactIndexToMu.resize(numContactNormalVectors);
+        mcpHi.resize(numContactNormalVectors);
     }
 
     an0.resize(n);
@@ -1124,14 +1654,12 @@ void ConstraintForceSolver::Impl::initMatrices()
 }
 
 
-void ConstraintForceSolver::Impl::setAccelCalcSkipInformation()
+void ConstraintForceSolver::Impl::Island::setAccelCalcSkipInformation()
 {
     // clear skip check numbers
-    for(auto& subBody : world.subBodies()){
-        if(subBody->hasConstrainedLinks){
-            for(auto& link : subBody->links()){
-                link->cfs.numberToCheckAccelCalcSkip = numeric_limits<int>::max();
-            }
+    for(auto& subBody : subBodies){
+        for(auto& link : subBody->links()){
+            link->cfs.numberToCheckAccelCalcSkip = numeric_limits<int>::max();
         }
     }
 
@@ -1139,9 +1667,13 @@ void ConstraintForceSolver::Impl::setAccelCalcSkipInformation()
     int numLinkPairs = constrainedLinkPairs.size();
     for(int i=0; i < numLinkPairs; ++i){
         LinkPair* linkPair = constrainedLinkPairs[i];
-        int constraintIndex = linkPair->constraintPoints.front().globalIndex;
+        int constraintIndex = linkPair->constraintPoints.front().index;
         for(int j=0; j < 2; ++j){
             auto link = linkPair->link[j];
+            if(link->subBody()->isStatic()){
+                // The links of static sub-bodies may be shared with other islands
+                continue;
+            }
             while(link){
                 if(link->cfs.numberToCheckAccelCalcSkip < constraintIndex){
                     break;
@@ -1157,19 +1689,17 @@ void ConstraintForceSolver::Impl::setAccelCalcSkipInformation()
 }
 
 
-void ConstraintForceSolver::Impl::setDefaultAccelerationVector()
+void ConstraintForceSolver::Impl::Island::setDefaultAccelerationVector()
 {
     // calculate accelerations with no constraint force
-    for(auto& subBody : world.subBodies()){
-        if(subBody->hasConstrainedLinks && !subBody->isStatic()){
-            if(auto cbm = subBody->forwardDynamicsCBM()){
-                cbm->sumExternalForces();
-                cbm->solveUnknownAccels();
-                calcAccelsMM(subBody, numeric_limits<int>::max());
-            } else {
-                initABMForceElementsWithNoExtForce(subBody);
-                calcAccelsABM(subBody, numeric_limits<int>::max());
-            }
+    for(auto& subBody : subBodies){
+        if(auto cbm = subBody->forwardDynamicsCBM()){
+            cbm->sumExternalForces();
+            cbm->solveUnknownAccels();
+            impl->calcAccelsMM(subBody, numeric_limits<int>::max());
+        } else {
+            impl->initABMForceElementsWithNoExtForce(subBody);
+            impl->calcAccelsABM(subBody, numeric_limits<int>::max());
         }
     }
 
@@ -1194,35 +1724,61 @@ void ConstraintForceSolver::Impl::setDefaultAccelerationVector()
             }
 
             Vector3 relDefaultAccel(constraint.defaultAccel[1] - constraint.defaultAccel[0]);
-            an0[constraint.globalIndex] = constraint.normalTowardInside[1].dot(relDefaultAccel);
+            an0[constraint.index] = constraint.normalTowardInside[1].dot(relDefaultAccel);
 
             for(int k=0; k < constraint.numFrictionVectors; ++k){
-                at0[constraint.globalFrictionIndex + k] = constraint.frictionVector[k][1].dot(relDefaultAccel);
+                at0[constraint.frictionIndex + k] = constraint.frictionVector[k][1].dot(relDefaultAccel);
             }
         }
     }
 }
 
 
-void ConstraintForceSolver::Impl::setAccelerationMatrix()
+void ConstraintForceSolver::Impl::Island::setAccelerationMatrix()
 {
-    const int n = globalNumConstraintVectors;
-    const int m = globalNumFrictionVectors;
+    const int n = numConstraintVectors;
+    const int m = numFrictionVectors;
+
+    if(isBlockSparseMatrixMode){
+        BlockSparseMatrix::SubMatrix Knn(sparseMlcp, 0, 0);
+        BlockSparseMatrix::SubMatrix Ktn(sparseMlcp, 0, n);
+        BlockSparseMatrix::SubMatrix Knt(sparseMlcp, n, 0);
+        BlockSparseMatrix::SubMatrix Ktt(sparseMlcp, n, n);
+        setAccelerationMatrix(Knn, Ktn, Knt, Ktt);
+
+    } else {
+        Eigen::Block<MatrixX> Knn = Mlcp.block(0, 0, n, n);
+        Eigen::Block<MatrixX> Ktn = Mlcp.block(0, n, n, m);
+        Eigen::Block<MatrixX> Knt = Mlcp.block(n, 0, m, n);
+        Eigen::Block<MatrixX> Ktt = Mlcp.block(n, n, m, m);
+        setAccelerationMatrix(Knn, Ktn, Knt, Ktt);
 
-    Eigen::Block<MatrixX> Knn = Mlcp.block(0, 0, n, n);
-    Eigen::Block<MatrixX> Ktn = Mlcp.block(0, n, n, m);
-    Eigen::Block<MatrixX> Knt = Mlcp.block(n, 0, m, n);
-    Eigen::Block<MatrixX> Ktt = Mlcp.block(n, n, m, m);
+        if(ASSUME_SYMMETRIC_MATRIX){
+            copySymmetricElementsOfAccelerationMatrix(Knn, Ktn, Knt, Ktt);
+        }
+    }
+}
 
+
+/**
+   In the block-sparse matrix mode, the accelerations caused by a test force are only extracted
+   from the link pairs of the blocks adjacent to the block of the test force.
+*/
+template<class TBlock>
+void ConstraintForceSolver::Impl::Island::setAccelerationMatrix(TBlock& Knn, TBlock& Ktn, TBlock& Knt, TBlock& Ktt)
+{
     for(size_t i=0; i < constrainedLinkPairs.size(); ++i){
 
         LinkPair& linkPair = *constrainedLinkPairs[i];
         int numConstraintsInPair = linkPair.constraintPoints.size();
 
+        auto& linkPairsToExtract =
+            isBlockSparseMatrixMode ? blockAdjacentLinkPairs[linkPairToBlock[i]] : constrainedLinkPairs;
+
         for(int j=0; j < numConstraintsInPair; ++j){
 
             ConstraintPoint& constraint = linkPair.constraintPoints[j];
-            int constraintIndex = constraint.globalIndex;
+            int constraintIndex = constraint.index;
 
             // apply test normal force
             for(int k=0; k < 2; ++k){
@@ -1239,18 +1795,18 @@ void ConstraintForceSolver::Impl::setAccelerationMatrix()
                         Vector3 tau = arm.cross(f);
                         Vector3 tauext = constraint.point.cross(f);
                         if(cbm->solveUnknownAccels(link, f, tauext, f, tau)){
-                            calcAccelsMM(subBody, constraintIndex);
+                            impl->calcAccelsMM(subBody, constraintIndex);
                         }
                     } else {
                         Vector3 tau = constraint.point.cross(f);
-                        calcABMForceElementsWithTestForce(subBody, link, f, tau);
+                        impl->calcABMForceElementsWithTestForce(subBody, link, f, tau);
                         if(!linkPair.isBelongingToSameSubBody || (k > 0)){
-                            calcAccelsABM(subBody, constraintIndex);
+                            impl->calcAccelsABM(subBody, constraintIndex);
                         }
                     }
                 }
             }
-            extractRelAccelsOfConstraintPoints(Knn, Knt, constraintIndex, constraintIndex);
+            extractRelAccelsOfConstraintPoints(Knn, Knt, linkPairsToExtract, constraintIndex, constraintIndex);
 
             // apply test friction force
             for(int l=0; l < constraint.numFrictionVectors; ++l){
@@ -1266,28 +1822,29 @@ void ConstraintForceSolver::Impl::setAccelerationMatrix()
                             Vector3 tau = arm.cross(f);
                             Vector3 tauext = constraint.point.cross(f);
                             if(cbm->solveUnknownAccels(link, f, tauext, f, tau)){
-                                calcAccelsMM(subBody, constraintIndex);
+                                impl->calcAccelsMM(subBody, constraintIndex);
                             }
                         } else {
                             Vector3 tau = constraint.point.cross(f);
-                            calcABMForceElementsWithTestForce(subBody, link, f, tau);
+                            impl->calcABMForceElementsWithTestForce(subBody, link, f, tau);
                             if(!linkPair.isBelongingToSameSubBody || (k > 0)){
-                                calcAccelsABM(subBody, constraintIndex);
+                                impl->calcAccelsABM(subBody, constraintIndex);
                             }
                         }
                     }
                 }
-                extractRelAccelsOfConstraintPoints(Ktn, Ktt, constraint.globalFrictionIndex + l, constraintIndex);
+                extractRelAccelsOfConstraintPoints(
+                    Ktn, Ktt, linkPairsToExtract, constraint.frictionIndex + l, constraintIndex);
             }
 
-            linkPair.link[0]->subBody()->isTestForceBeingApplied = false;
-            linkPair.link[1]->subBody()->isTestForceBeingApplied = false;
+            for(int k=0; k < 2; ++k){
+                auto subBody = linkPair.link[k]->subBody();
+                if(!subBody->isStatic()){
+                    subBody->isTestForceBeingApplied = false;
+                }
+            }
         }
     }
-
-    if(ASSUME_SYMMETRIC_MATRIX){
-        copySymmetricElementsOfAccelerationMatrix(Knn, Ktn, Knt, Ktt);
-    }
 }
 
 
@@ -1428,13 +1985,14 @@ void ConstraintForceSolver::Impl::calcAccelsMM(DySubBody* subBody, int constrain
 }
 
 
-void ConstraintForceSolver::Impl::extractRelAccelsOfConstraintPoints
-(Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt, int testForceIndex, int constraintIndex)
+template<class TBlock>
+void ConstraintForceSolver::Impl::Island::extractRelAccelsOfConstraintPoints
+(TBlock& Kxn, TBlock& Kxt, const vector<LinkPair*>& linkPairs, int testForceIndex, int constraintIndex)
 {
-    int maxConstraintIndexToExtract = ASSUME_SYMMETRIC_MATRIX ? constraintIndex : globalNumConstraintVectors;
+    int maxConstraintIndexToExtract = ASSUME_SYMMETRIC_MATRIX ? constraintIndex : numConstraintVectors;
 
-    for(size_t i=0; i < constrainedLinkPairs.size(); ++i){
-        LinkPair& linkPair = *constrainedLinkPairs[i];
+    for(size_t i=0; i < linkPairs.size(); ++i){
+        LinkPair& linkPair = *linkPairs[i];
         auto subBody0 = linkPair.link[0]->subBody();
         auto subBody1 = linkPair.link[1]->subBody();
         if(subBody0->isTestForceBeingApplied){
@@ -1454,16 +2012,16 @@ void ConstraintForceSolver::Impl::extractRelAccelsOfConstraintPoints
 }
 
 
-void ConstraintForceSolver::Impl::extractRelAccelsFromLinkPairCase1
-(Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt,
- LinkPair& linkPair, int testForceIndex, int maxConstraintIndexToExtract)
+template<class TBlock>
+void ConstraintForceSolver::Impl::Island::extractRelAccelsFromLinkPairCase1
+(TBlock& Kxn, TBlock& Kxt, LinkPair& linkPair, int testForceIndex, int maxConstraintIndexToExtract)
 {
     auto& constraintPoints = linkPair.constraintPoints;
 
     for(size_t i=0; i < constraintPoints.size(); ++i){
 
         ConstraintPoint& constraint = constraintPoints[i];
-        int constraintIndex = constraint.globalIndex;
+        int constraintIndex = constraint.index;
 
         if(ASSUME_SYMMETRIC_MATRIX && constraintIndex > maxConstraintIndexToExtract){
             break;
@@ -1486,23 +2044,23 @@ void ConstraintForceSolver::Impl::extractRelAccelsFromLinkPairCase1
         Kxn(constraintIndex, testForceIndex) = constraint.normalTowardInside[1].dot(relAccel) - an0(constraintIndex);
 
         for(int j=0; j < constraint.numFrictionVectors; ++j){
-            const int index = constraint.globalFrictionIndex + j;
+            const int index = constraint.frictionIndex + j;
             Kxt(index, testForceIndex) = constraint.frictionVector[j][1].dot(relAccel) - at0(index);
         }
     }
 }
 
 
-void ConstraintForceSolver::Impl::extractRelAccelsFromLinkPairCase2
-(Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt,
- LinkPair& linkPair, int iTestForce, int iDefault, int testForceIndex, int maxConstraintIndexToExtract)
+template<class TBlock>
+void ConstraintForceSolver::Impl::Island::extractRelAccelsFromLinkPairCase2
+(TBlock& Kxn, TBlock& Kxt, LinkPair& linkPair, int iTestForce, int iDefault, int testForceIndex, int maxConstraintIndexToExtract)
 {
     auto& constraintPoints = linkPair.constraintPoints;
 
     for(size_t i=0; i < constraintPoints.size(); ++i){
 
         ConstraintPoint& constraint = constraintPoints[i];
-        int constraintIndex = constraint.globalIndex;
+        int constraintIndex = constraint.index;
 
         if(ASSUME_SYMMETRIC_MATRIX && constraintIndex > maxConstraintIndexToExtract){
             break;
@@ -1513,7 +2071,7 @@ void ConstraintForceSolver::Impl::extractRelAccelsFromLinkPairCase2
         Vector3 dv(link->cfs.dvo - constraint.point.cross(link->cfs.dw) + link->w().cross(link->vo() + link->w().cross(constraint.point)));
 
         if(CFS_DEBUG_VERBOSE_2){
-            os << "dv " << constraintIndex << " = " << dv << "\n";
+            impl->os << "dv " << constraintIndex << " = " << dv << "\n";
         }
 
         Vector3 relAccel = constraint.defaultAccel[iDefault] - dv;
@@ -1521,7 +2079,7 @@ void ConstraintForceSolver::Impl::extractRelAccelsFromLinkPairCase2
         Kxn(constraintIndex, testForceIndex) = constraint.normalTowardInside[iDefault].dot(relAccel) - an0(constraintIndex);
 
         for(int j=0; j < constraint.numFrictionVectors; ++j){
-            const int index = constraint.globalFrictionIndex + j;
+            const int index = constraint.frictionIndex + j;
             Kxt(index, testForceIndex) = constraint.frictionVector[j][iDefault].dot(relAccel) - at0(index);
         }
 
@@ -1529,15 +2087,16 @@ void ConstraintForceSolver::Impl::extractRelAccelsFromLinkPairCase2
 }
 
 
-void ConstraintForceSolver::Impl::extractRelAccelsFromLinkPairCase3
-(Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt, LinkPair& linkPair, int testForceIndex, int maxConstraintIndexToExtract)
+template<class TBlock>
+void ConstraintForceSolver::Impl::Island::extractRelAccelsFromLinkPairCase3
+(TBlock& Kxn, TBlock& Kxt, LinkPair& linkPair, int testForceIndex, int maxConstraintIndexToExtract)
 {
     auto& constraintPoints = linkPair.constraintPoints;
 
     for(size_t i=0; i < constraintPoints.size(); ++i){
 
         ConstraintPoint& constraint = constraintPoints[i];
-        int constraintIndex = constraint.globalIndex;
+        int constraintIndex = constraint.index;
 
         if(ASSUME_SYMMETRIC_MATRIX && constraintIndex > maxConstraintIndexToExtract){
             break;
@@ -1546,14 +2105,15 @@ void ConstraintForceSolver::Impl::extractRelAccelsFromLinkPairCase3
         Kxn(constraintIndex, testForceIndex) = 0.0;
 
         for(int j=0; j < constraint.numFrictionVectors; ++j){
-            Kxt(constraint.globalFrictionIndex + j, testForceIndex) = 0.0;
+            Kxt(constraint.frictionIndex + j, testForceIndex) = 0.0;
         }
     }
 }
 
 
-void ConstraintForceSolver::Impl::copySymmetricElementsOfAccelerationMatrix
-(Eigen::Block<MatrixX>& Knn, Eigen::Block<MatrixX>& Ktn, Eigen::Block<MatrixX>& Knt, Eigen::Block<MatrixX>& Ktt)
+template<class TBlock>
+void ConstraintForceSolver::Impl::Island::copySymmetricElementsOfAccelerationMatrix
+(TBlock& Knn, TBlock& Ktn, TBlock& Knt, TBlock& Ktt)
 {
     for(size_t linkPairIndex=0; linkPairIndex < constrainedLinkPairs.size(); ++linkPairIndex){
 
@@ -1563,24 +2123,24 @@ void ConstraintForceSolver::Impl::copySymmetricElementsOfAccelerationMatrix
 
             ConstraintPoint& constraint = constraintPoints[localConstraintIndex];
 
-            int constraintIndex = constraint.globalIndex;
+            int constraintIndex = constraint.index;
             int nextConstraintIndex = constraintIndex + 1;
-            for(int i = nextConstraintIndex; i < globalNumConstraintVectors; ++i){
+            for(int i = nextConstraintIndex; i < numConstraintVectors; ++i){
                 Knn(i, constraintIndex) = Knn(constraintIndex, i);
             }
-            int frictionTopOfNextConstraint = constraint.globalFrictionIndex + constraint.numFrictionVectors;
-            for(int i = frictionTopOfNextConstraint; i < globalNumFrictionVectors; ++i){
+            int frictionTopOfNextConstraint = constraint.frictionIndex + constraint.numFrictionVectors;
+            for(int i = frictionTopOfNextConstraint; i < numFrictionVectors; ++i){
                 Knt(i, constraintIndex) = Ktn(constraintIndex, i);
             }
 
             for(int localFrictionIndex=0; localFrictionIndex < constraint.numFrictionVectors; ++localFrictionIndex){
 
-                int frictionIndex = constraint.globalFrictionIndex + localFrictionIndex;
+                int frictionIndex = constraint.frictionIndex + localFrictionIndex;
 
-                for(int i = nextConstraintIndex; i < globalNumConstraintVectors; ++i){
+                for(int i = nextConstraintIndex; i < numConstraintVectors; ++i){
                     Ktn(i, frictionIndex) = Knt(frictionIndex, i);
                 }
-                for(int i = frictionTopOfNextConstraint; i < globalNumFrictionVectors; ++i){
+                for(int i = frictionTopOfNextConstraint; i < numFrictionVectors; ++i){
                     Ktt(i, frictionIndex) = Ktt(frictionIndex, i);
                 }
             }
@@ -1589,8 +2149,38 @@ void ConstraintForceSolver::Impl::copySymmetricElementsOfAccelerationMatrix
 }
 
 
-void ConstraintForceSolver::Impl::clearSingularPointConstraintsOfClosedLoopConnections()
+void ConstraintForceSolver::Impl::Island::clearSingularPointConstraintsOfClosedLoopConnections()
 {
+    if(isBlockSparseMatrixMode){
+        auto& M = sparseMlcp;
+        const int n = M.rows();
+        bool hasSingularPoints = false;
+        singularColumnFlags.assign(n, 0);
+        for(int i=0; i < n; ++i){
+            if(M.diagonal(i) < 1.0e-4){
+                singularColumnFlags[i] = 1;
+                hasSingularPoints = true;
+            }
+        }
+        if(hasSingularPoints){
+            for(int i=0; i < n; ++i){
+                auto& columns = M.blockColumns[M.rowToBlock[i]];
+                double* row = &M.values[M.rowValueOffsets[i]];
+                for(size_t k=0; k < columns.size(); ++k){
+                    if(singularColumnFlags[columns[k]]){
+                        row[k] = 0.0;
+                    }
+                }
+            }
+            for(int i=0; i < n; ++i){
+                if(singularColumnFlags[i]){
+                    M.diagonal(i) = numeric_limits<double>::max();
+                }
+            }
+        }
+        return;
+    }
+    
     for(int i = 0; i < Mlcp.rows(); ++i){
         if(Mlcp(i, i) < 1.0e-4){
             for(int j=0; j < Mlcp.rows(); ++j){
@@ -1602,11 +2192,11 @@ void ConstraintForceSolver::Impl::clearSingularPointConstraintsOfClosedLoopConne
 }
 
 
-void ConstraintForceSolver::Impl::setConstantVectorAndMuBlock()
+void ConstraintForceSolver::Impl::Island::setConstantVectorAndMuBlock()
 {
-    double dtinv = 1.0 / world.timeStep();
-    const int block2 = globalNumConstraintVectors;
-    const int block3 = globalNumConstraintVectors + globalNumFrictionVectors;
+    double dtinv = 1.0 / impl->world.timeStep();
+    const int block2 = numConstraintVectors;
+    const int block3 = numConstraintVectors + numFrictionVectors;
 
     for(size_t i=0; i < constrainedLinkPairs.size(); ++i){
 
@@ -1615,7 +2205,7 @@ void ConstraintForceSolver::Impl::setConstantVectorAndMuBlock()
 
         for(int j=0; j < numConstraintsInPair; ++j){
             ConstraintPoint& constraint = linkPair.constraintPoints[j];
-            int globalIndex = constraint.globalIndex;
+            int index = constraint.index;
 
             // set constant vector of LCP
 
@@ -1632,45 +2222,45 @@ void ConstraintForceSolver::Impl::setConstantVectorAndMuBlock()
                     v = 0.1 * ( 1.0 - exp( error * 20.0));
                 }
 					
-                b(globalIndex) = an0(globalIndex) + (constraint.normalProjectionOfRelVelocityOn0 + v) * dtinv;
+                b(index) = an0(index) + (constraint.normalProjectionOfRelVelocityOn0 + v) * dtinv;
 
             } else {
                 // contact constraint
                 if(ENABLE_CONTACT_DEPTH_CORRECTION){
                     double velOffset;
-                    const double depth = constraint.depth - contactCorrectionDepth;
+                    const double depth = constraint.depth - impl->contactCorrectionDepth;
                     if(depth <= 0.0){
-                        velOffset = contactCorrectionVelocityRatio * depth;
+                        velOffset = impl->contactCorrectionVelocityRatio * depth;
                     } else {
-                        velOffset = contactCorrectionVelocityRatio * (-1.0 / (depth + 1.0) + 1.0);
+                        velOffset = impl->contactCorrectionVelocityRatio * (-1.0 / (depth + 1.0) + 1.0);
                     }
-                    b(globalIndex) = an0(globalIndex) + (constraint.normalProjectionOfRelVelocityOn0 - velOffset) * dtinv;
+                    b(index) = an0(index) + (constraint.normalProjectionOfRelVelocityOn0 - velOffset) * dtinv;
                 } else {
-                    b(globalIndex) = an0(globalIndex) + constraint.normalProjectionOfRelVelocityOn0 * dtinv;
+                    b(index) = an0(index) + constraint.normalProjectionOfRelVelocityOn0 * dtinv;
                 }
 
-                contactIndexToMu[globalIndex] = constraint.mu;
+                contactIndexToMu[index] = constraint.mu;
 
-                int globalFrictionIndex = constraint.globalFrictionIndex;
+                int frictionIndex = constraint.frictionIndex;
                 for(int k=0; k < constraint.numFrictionVectors; ++k){
 
                     // constraints for tangent acceleration
                     double tangentProjectionOfRelVelocity = constraint.frictionVector[k][1].dot(constraint.relVelocityOn0);
 
-                    b(block2 + globalFrictionIndex) = at0(globalFrictionIndex);
+                    b(block2 + frictionIndex) = at0(frictionIndex);
                     if( !IGNORE_CURRENT_VELOCITY_IN_STATIC_FRICTION || constraint.numFrictionVectors == 1){
-                        b(block2 + globalFrictionIndex) += tangentProjectionOfRelVelocity * dtinv;
+                        b(block2 + frictionIndex) += tangentProjectionOfRelVelocity * dtinv;
                     }
 
                     if(usePivotingLCP){
                         // set mu (coefficients of friction)
-                        Mlcp(block3 + globalFrictionIndex, globalIndex) = constraint.mu;
+                        Mlcp(block3 + frictionIndex, index) = constraint.mu;
                     } else {
                         // for iterative solver
-                        frictionIndexToContactIndex[globalFrictionIndex] = globalIndex;
+                        frictionIndexToContactIndex[frictionIndex] = index;
                     }
 
-                    ++globalFrictionIndex;
+                    ++frictionIndex;
                 }
             }
         }
@@ -1678,11 +2268,18 @@ void ConstraintForceSolver::Impl::setConstantVectorAndMuBlock()
 }
 
 
+/**
+   The forces are added in the order of constrainedLinkPairs regardless of the islands
+   so that the forces accumulated on the links shared by the islands are deterministic.
+*/
 void ConstraintForceSolver::Impl::addConstraintForceToLinks()
 {
     int n = constrainedLinkPairs.size();
     for(int i=0; i < n; ++i){
         LinkPair* linkPair = constrainedLinkPairs[i];
+        if(!islands[linkPair->islandIndex]->isConverged){
+            continue;
+        }
         for(int j=0; j < 2; ++j){
             // if(!linkPair->link[j]->isRoot() || linkPair->link[j]->jointType != Link::FIXED_JOINT){
             addConstraintForceToLink(linkPair, j);
@@ -1698,6 +2295,8 @@ void ConstraintForceSolver::Impl::addConstraintForceToLink(LinkPair* linkPair, i
     int numConstraintPoints = constraintPoints.size();
 
     if(numConstraintPoints > 0){
+        auto& island = *islands[linkPair->islandIndex];
+        auto& solution = island.solution;
         auto link = linkPair->link[ipair];
         Vector3 f_total   = Vector3::Zero();
         Vector3 tau_total = Vector3::Zero();
@@ -1706,11 +2305,11 @@ void ConstraintForceSolver::Impl::addConstraintForceToLink(LinkPair* linkPair, i
         for(int i=0; i < numConstraintPoints; ++i){
 
             ConstraintPoint& constraint = constraintPoints[i];
-            int globalIndex = constraint.globalIndex;
+            int index = constraint.index;
 
-            Vector3 f = solution(globalIndex) * constraint.normalTowardInside[ipair];
+            Vector3 f = solution(index) * constraint.normalTowardInside[ipair];
             for(int j=0; j < constraint.numFrictionVectors; ++j){
-                f += solution(globalNumConstraintVectors + constraint.globalFrictionIndex + j) * constraint.frictionVector[j][ipair];
+                f += solution(island.numConstraintVectors + constraint.frictionIndex + j) * constraint.frictionVector[j][ipair];
             }
             f_total   += f;
             tau_total += constraint.point.cross(f);
@@ -1734,23 +2333,21 @@ void ConstraintForceSolver::Impl::addConstraintForceToLink(LinkPair* linkPair, i
 }
 
 
-void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidel(const MatrixX& M, const VectorX& b, VectorX& x)
+template<class TMatrix>
+void ConstraintForceSolver::Impl::Island::solveMCPByProjectedGaussSeidel(const TMatrix& M, const VectorX& b, VectorX& x)
 {
     static const int loopBlockSize = DEFAULT_NUM_GAUSS_SEIDEL_ITERATION_BLOCK;
 
-    if(numGaussSeidelInitialIteration > 0){
-        solveMCPByProjectedGaussSeidelInitial(M, b, x, numGaussSeidelInitialIteration);
+    if(impl->numGaussSeidelInitialIteration > 0){
+        solveMCPByProjectedGaussSeidelInitial(M, b, x, impl->numGaussSeidelInitialIteration);
     }
 
-    int numBlockLoops = maxNumGaussSeidelIteration / loopBlockSize;
+    int numBlockLoops = impl->maxNumGaussSeidelIteration / loopBlockSize;
     if(numBlockLoops==0){
         numBlockLoops = 1;
     }
 
-    if(CFS_MCP_DEBUG){
-        os << "Iteration ";
-    }
-
+    bool isStopped = false;
     double error = 0.0;
     VectorXd x0;
     int i = 0;
@@ -1784,45 +2381,32 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidel(const MatrixX&
             }
         }
 
-        if(error < gaussSeidelErrorCriterion){
-            if(CFS_MCP_DEBUG_SHOW_ITERATION_STOP){
-                os << "stopped at " << (i * loopBlockSize) << ", error = " << error << endl;
-            }
+        if(error < impl->gaussSeidelErrorCriterion){
+            isStopped = true;
             break;
         }
     }
 
     if(CFS_MCP_DEBUG){
-
-        if(i == numBlockLoops){
-            os << "not stopped" << ", error = " << error << endl;
-        }
-        
-        int n = loopBlockSize * i;
-        numGaussSeidelTotalLoops += n;
-        numGaussSeidelTotalCalls++;
-        numGaussSeidelTotalLoopsMax = std::max(numGaussSeidelTotalLoopsMax, n);
-        os << ", avarage = " << (numGaussSeidelTotalLoops / numGaussSeidelTotalCalls);
-        os << ", max = " << numGaussSeidelTotalLoopsMax;
-        os << endl;
+        numGaussSeidelLoops = loopBlockSize * i;
+        isGaussSeidelIterationStopped = isStopped;
+        gaussSeidelError = error;
     }
 }
 
 
-void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelMainStep(const MatrixX& M, const VectorX& b, VectorX& x)
+template<class TMatrix>
+void ConstraintForceSolver::Impl::Island::solveMCPByProjectedGaussSeidelMainStep(const TMatrix& M, const VectorX& b, VectorX& x)
 {
-    const int size = globalNumConstraintVectors + globalNumFrictionVectors;
+    const int size = numConstraintVectors + numFrictionVectors;
 
-    for(int j=0; j < globalNumContactNormalVectors; ++j){
+    for(int j=0; j < numContactNormalVectors; ++j){
 
         double xx;
         if(M(j,j) == numeric_limits<double>::max()){
             xx=0.0;
         } else {
-            double sum = -M(j, j) * x(j);
-            for(int k=0; k < size; ++k){
-                sum += M(j, k) * x(k);
-            }
+            double sum = sumOfOffDiagonalProducts(M, x, j);
             xx = (-b(j) - sum) / M(j, j);
         }
         if(xx < 0.0){
@@ -1833,15 +2417,12 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelMainStep(const M
         mcpHi[j] = contactIndexToMu[j] * x(j);
     }
     
-    for(int j=globalNumContactNormalVectors; j < globalNumConstraintVectors; ++j){
+    for(int j=numContactNormalVectors; j < numConstraintVectors; ++j){
         
         if(M(j,j) == numeric_limits<double>::max()){
             x(j)=0.0;
         } else {
-            double sum = -M(j, j) * x(j);
-            for(int k=0; k < size; ++k){
-                sum += M(j, k) * x(k);
-            }
+            double sum = sumOfOffDiagonalProducts(M, x, j);
             x(j) = (-b(j) - sum) / M(j, j);
         }
     }
@@ -1850,16 +2431,13 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelMainStep(const M
     if(ENABLE_TRUE_FRICTION_CONE){
 
         int contactIndex = 0;
-        for(int j=globalNumConstraintVectors; j < size; ++j, ++contactIndex){
+        for(int j=numConstraintVectors; j < size; ++j, ++contactIndex){
             
             double fx0;
             if(M(j,j) == numeric_limits<double>::max()) {
                 fx0 = 0.0;
             } else {
-                double sum = -M(j, j) * x(j);
-                for(int k=0; k < size; ++k){
-                    sum += M(j, k) * x(k);
-                }
+                double sum = sumOfOffDiagonalProducts(M, x, j);
                 fx0 = (-b(j) - sum) / M(j, j);
             }
             double& fx = x(j);
@@ -1870,10 +2448,7 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelMainStep(const M
             if(M(j,j) == numeric_limits<double>::max()) {
                 fy0=0.0;
             } else {
-                double sum = -M(j, j) * x(j);
-                for(int k=0; k < size; ++k){
-                    sum += M(j, k) * x(k);
-                }
+                double sum = sumOfOffDiagonalProducts(M, x, j);
                 fy0 = (-b(j) - sum) / M(j, j);
             }
             double& fy = x(j);
@@ -1895,16 +2470,13 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelMainStep(const M
     } else {
 
         int frictionIndex = 0;
-        for(int j=globalNumConstraintVectors; j < size; ++j, ++frictionIndex){
+        for(int j=numConstraintVectors; j < size; ++j, ++frictionIndex){
 
             double xx;
             if(M(j,j) == numeric_limits<double>::max()) {
                 xx=0.0;
             } else {
-                double sum = -M(j, j) * x(j);
-                for(int k=0; k < size; ++k){
-                    sum += M(j, k) * x(k);
-                }
+                double sum = sumOfOffDiagonalProducts(M, x, j);
                 xx = (-b(j) - sum) / M(j, j);
             }
             
@@ -1924,26 +2496,24 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelMainStep(const M
 }
 
 
-void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelInitial
-(const MatrixX& M, const VectorX& b, VectorX& x, const int numIteration)
+template<class TMatrix>
+void ConstraintForceSolver::Impl::Island::solveMCPByProjectedGaussSeidelInitial
+(const TMatrix& M, const VectorX& b, VectorX& x, const int numIteration)
 {
-    const int size = globalNumConstraintVectors + globalNumFrictionVectors;
+    const int size = numConstraintVectors + numFrictionVectors;
 
     const double rstep = 1.0 / (numIteration * size);
     double r = 0.0;
 
     for(int i=0; i < numIteration; ++i){
 
-        for(int j=0; j < globalNumContactNormalVectors; ++j){
+        for(int j=0; j < numContactNormalVectors; ++j){
 
             double xx;
             if(M(j,j)==numeric_limits<double>::max()){
                 xx=0.0;
             } else {
-                double sum = -M(j, j) * x(j);
-                for(int k=0; k < size; ++k){
-                    sum += M(j, k) * x(k);
-                }
+                double sum = sumOfOffDiagonalProducts(M, x, j);
                 xx = (-b(j) - sum) / M(j, j);
             }
             if(xx < 0.0){
@@ -1955,15 +2525,12 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelInitial
             mcpHi[j] = contactIndexToMu[j] * x(j);
         }
 
-        for(int j=globalNumContactNormalVectors; j < globalNumConstraintVectors; ++j){
+        for(int j=numContactNormalVectors; j < numConstraintVectors; ++j){
 
             if(M(j,j)==numeric_limits<double>::max()){
                 x(j) = 0.0;
             } else {
-                double sum = -M(j, j) * x(j);
-                for(int k=0; k < size; ++k){
-                    sum += M(j, k) * x(k);
-                }
+                double sum = sumOfOffDiagonalProducts(M, x, j);
                 x(j) = r * (-b(j) - sum) / M(j, j);
             }
             r += rstep;
@@ -1972,16 +2539,13 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelInitial
         if(ENABLE_TRUE_FRICTION_CONE){
 
             int contactIndex = 0;
-            for(int j=globalNumConstraintVectors; j < size; ++j, ++contactIndex){
+            for(int j=numConstraintVectors; j < size; ++j, ++contactIndex){
 
                 double fx0;
                 if(M(j,j)==numeric_limits<double>::max())
                     fx0 = 0.0;
                 else{
-                    double sum = -M(j, j) * x(j);
-                    for(int k=0; k < size; ++k){
-                        sum += M(j, k) * x(k);
-                    }
+                    double sum = sumOfOffDiagonalProducts(M, x, j);
                     fx0 = (-b(j) - sum) / M(j, j);
                 }
                 double& fx = x(j);
@@ -1992,10 +2556,7 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelInitial
                 if(M(j,j)==numeric_limits<double>::max())
                     fy0 = 0.0;
                 else{
-                    double sum = -M(j, j) * x(j);
-                    for(int k=0; k < size; ++k){
-                        sum += M(j, k) * x(k);
-                    }
+                    double sum = sumOfOffDiagonalProducts(M, x, j);
                     fy0 = (-b(j) - sum) / M(j, j);
                 }
                 double& fy = x(j);
@@ -2018,16 +2579,13 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelInitial
         } else {
 
             int frictionIndex = 0;
-            for(int j=globalNumConstraintVectors; j < size; ++j, ++frictionIndex){
+            for(int j=numConstraintVectors; j < size; ++j, ++frictionIndex){
 
                 double xx;
                 if(M(j,j)==numeric_limits<double>::max())
                     xx = 0.0;
                 else{
-                    double sum = -M(j, j) * x(j);
-                    for(int k=0; k < size; ++k){
-                        sum += M(j, k) * x(k);
-                    }
+                    double sum = sumOfOffDiagonalProducts(M, x, j);
                     xx = (-b(j) - sum) / M(j, j);
                 }
 
@@ -2050,87 +2608,87 @@ void ConstraintForceSolver::Impl::solveMCPByProjectedGaussSeidelInitial
 }
 
 
-void ConstraintForceSolver::Impl::checkLCPResult(MatrixX& M, VectorX& b, VectorX& x)
+void ConstraintForceSolver::Impl::Island::checkLCPResult(MatrixX& M, VectorX& b, VectorX& x)
 {
-    os << "check LCP result\n";
-    os << "-------------------------------\n";
+    impl->os << "check LCP result\n";
+    impl->os << "-------------------------------\n";
 
     VectorX z = M * x + b;
 
     int n = x.size();
     for(int i=0; i < n; ++i){
-        os << "(" << x(i) << ", " << z(i) << ")";
+        impl->os << "(" << x(i) << ", " << z(i) << ")";
 
         if(x(i) < 0.0 || z(i) < 0.0 || x(i) * z(i) != 0.0){
-            os << " - X";
+            impl->os << " - X";
         }
-        os << "\n";
+        impl->os << "\n";
 
-        if(i == globalNumConstraintVectors){
-            os << "-------------------------------\n";
-        } else if(i == globalNumConstraintVectors + globalNumFrictionVectors){
-            os << "-------------------------------\n";
+        if(i == numConstraintVectors){
+            impl->os << "-------------------------------\n";
+        } else if(i == numConstraintVectors + numFrictionVectors){
+            impl->os << "-------------------------------\n";
         }
     }
 
-    os << "-------------------------------\n";
+    impl->os << "-------------------------------\n";
 
 
-    os << std::endl;
+    impl->os << std::endl;
 }
 
 
-void ConstraintForceSolver::Impl::checkMCPResult(MatrixX& M, VectorX& b, VectorX& x)
+void ConstraintForceSolver::Impl::Island::checkMCPResult(MatrixX& M, VectorX& b, VectorX& x)
 {
-    os << "check MCP result\n";
-    os << "-------------------------------\n";
+    impl->os << "check MCP result\n";
+    impl->os << "-------------------------------\n";
 
     VectorX z = M * x + b;
 
-    for(int i=0; i < globalNumConstraintVectors; ++i){
-        os << "(" << x(i) << ", " << z(i) << ")";
+    for(int i=0; i < numConstraintVectors; ++i){
+        impl->os << "(" << x(i) << ", " << z(i) << ")";
 
         if(x(i) < 0.0 || z(i) < -1.0e-6){
-            os << " - X";
+            impl->os << " - X";
         } else if(x(i) > 0.0 && fabs(z(i)) > 1.0e-6){
-            os << " - X";
+            impl->os << " - X";
         } else if(z(i) > 1.0e-6 && fabs(x(i)) > 1.0e-6){
-            os << " - X";
+            impl->os << " - X";
         }
 
 
-        os << "\n";
+        impl->os << "\n";
     }
 
-    os << "-------------------------------\n";
+    impl->os << "-------------------------------\n";
 
     int j = 0;
-    for(int i=globalNumConstraintVectors; i < globalNumConstraintVectors + globalNumFrictionVectors; ++i, ++j){
-        os << "(" << x(i) << ", " << z(i) << ")";
+    for(int i=numConstraintVectors; i < numConstraintVectors + numFrictionVectors; ++i, ++j){
+        impl->os << "(" << x(i) << ", " << z(i) << ")";
 
         int contactIndex = frictionIndexToContactIndex[j];
         double hi = contactIndexToMu[contactIndex] * x(contactIndex);
 
-        os << " hi = " << hi;
+        impl->os << " hi = " << hi;
 
         if(x(i) < 0.0 || x(i) > hi){
-            os << " - X";
+            impl->os << " - X";
         } else if(x(i) == hi && z(i) > -1.0e-6){
-            os << " - X";
+            impl->os << " - X";
         } else if(x(i) < hi && x(i) > 0.0 && fabs(z(i)) > 1.0e-6){
-            os << " - X";
+            impl->os << " - X";
         }
-        os << "\n";
+        impl->os << "\n";
     }
 
-    os << "-------------------------------\n";
+    impl->os << "-------------------------------\n";
 
-    os << std::endl;
+    impl->os << std::endl;
 }
 
 
 #ifdef USE_PIVOTING_LCP
-bool ConstraintForceSolver::Impl::callPathLCPSolver(MatrixX& Mlcp, VectorX& b, VectorX& solution)
+bool ConstraintForceSolver::Impl::Island::callPathLCPSolver(MatrixX& Mlcp, VectorX& b, VectorX& solution)
 {
     int size = solution.size();
     int square = size * size;
@@ -2332,6 +2890,33 @@ void ConstraintForceSolver::enableConstraintForceOutput(bool /* on */)
 }
 
 
+void ConstraintForceSolver::setNumThreads(int n)
+{
+    impl->numThreads = std::max(n, 0);
+    if(impl->numThreads <= 1){
+        impl->threadPool.reset();
+    }
+}
+
+
+int ConstraintForceSolver::numThreads() const
+{
+    return impl->numThreads;
+}
+
+
+void ConstraintForceSolver::setBlockSparseMatrixMode(bool on)
+{
+    impl->isBlockSparseMatrixMode = on;
+}
+
+
+bool ConstraintForceSolver::isBlockSparseMatrixMode() const
+{
+    return impl->isBlockSparseMatrixMode;
+}
+
+
 void ConstraintForceSolver::set2Dmode(bool on)
 {
     impl->is2Dmode = on;
@@ -51,6 +51,24 @@ public:
 
     void set2Dmode(bool on);
 
+    /**
+       The constraints are decomposed into the islands which do not interact with each other,
+       and the islands are solved in parallel when the number of threads is more than one.
+       The results do not depend on the number of threads. The default value is zero,
+       which means that the islands are solved in the calling thread.
+    */
+    void setNumThreads(int n);
+    int numThreads() const;
+
+    /**
+       In the block-sparse matrix mode, the matrix of each island only stores the elements between
+       the constraints sharing a non-static sub-body, and the Gauss-Seidel iteration only visits them.
+       This mode is efficient when an island has many constraints on different sub-bodies.
+       The mode is applied when the solver is initialized.
+    */
+    void setBlockSparseMatrixMode(bool on);
+    bool isBlockSparseMatrixMode() const;
+
     [[deprecated("This function does nothing. Set Link::LinkContactState to Link::sensingMode from a controller.")]]
     void enableConstraintForceOutput(bool on);
 
@@ -57,6 +57,9 @@ private:
     bool isTestForceBeingApplied;
     Vector3 dpf;
     Vector3 dptau;
+    DySubBody* islandParent;
+    int islandIndex;
+    int islandSubBodyIndex;
 
     void initialize(DyLink* rootLink, std::multimap<Link*, ForceSensor*>& forceSensorMap);
     void extractLinksInSubBody(
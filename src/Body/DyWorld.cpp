@@ -3,6 +3,8 @@
 */
 
 #include "DyWorld.h"
+#include <cnoid/ThreadPool>
+#include <algorithm>
 
 using namespace std;
 using namespace cnoid;
@@ -22,6 +24,10 @@ DyWorldBase::DyWorldBase()
     sensorsAreEnabled = false;
     isOldAccelSensorCalcMode = false;
     numRegisteredLinkPairs = 0;
+    numThreads_ = 0;
+
+    isPhaseTimeMeasurementEnabled_ = false;
+    resetPhaseTimes();
 }
 
 
@@ -35,6 +41,7 @@ void DyWorldBase::clearBodies()
 {
     nameToBodyMap.clear();
     bodiesWithVirtualJointForces_.clear();
+    bodyProcessingOrder.clear();
     subBodies_.clear();
     bodies_.clear();
     hasHighGainDynamics_ = false;
@@ -96,6 +103,41 @@ void DyWorldBase::initialize()
         forwardDynamics->setOldAccelSensorCalcMode(isOldAccelSensorCalcMode);
         forwardDynamics->initialize();
     }
+
+    // Bodies with more links are processed first to balance the loads of the threads
+    bodyProcessingOrder.clear();
+    for(auto& body : bodies_){
+        bodyProcessingOrder.push_back(body);
+    }
+    std::stable_sort(
+        bodyProcessingOrder.begin(), bodyProcessingOrder.end(),
+        [](DyBody* body1, DyBody* body2){ return body1->numLinks() > body2->numLinks(); });
+}
+
+
+void DyWorldBase::setNumThreads(int n)
+{
+    numThreads_ = std::max(n, 0);
+    if(numThreads_ <= 1){
+        threadPool.reset();
+    } else if(!threadPool || threadPool->size() != numThreads_ - 1){
+        threadPool.reset(new ThreadPool(numThreads_ - 1));
+    }
+}
+
+
+void DyWorldBase::setPhaseTimeMeasurementEnabled(bool on)
+{
+    isPhaseTimeMeasurementEnabled_ = on;
+}
+
+
+void DyWorldBase::resetPhaseTimes()
+{
+    for(int i=0; i < NumPhases; ++i){
+        phaseTimes[i] = 0.0;
+    }
+    numPhaseTimeMeasurementSteps_ = 0;
 }
 
 
@@ -109,8 +151,17 @@ void DyWorldBase::setVirtualJointForces()
 
 void DyWorldBase::calcNextState()
 {
-    for(auto& subBody : subBodies_){
-        subBody->forwardDynamics()->calcNextState();
+    if(threadPool && bodyProcessingOrder.size() > 1){
+        processBodiesInParallel(
+            [](DyBody* body){
+                for(auto& subBody : body->subBodies()){
+                    subBody->forwardDynamics()->calcNextState();
+                }
+            });
+    } else {
+        for(auto& subBody : subBodies_){
+            subBody->forwardDynamics()->calcNextState();
+        }
     }
     currentTime_ += timeStep_;
 }
@@ -118,8 +169,46 @@ void DyWorldBase::calcNextState()
 
 void DyWorldBase::refreshState()
 {
-    for(auto& subBody : subBodies_){
-        subBody->forwardDynamics()->refreshState();
+    if(threadPool && bodyProcessingOrder.size() > 1){
+        processBodiesInParallel(
+            [](DyBody* body){
+                for(auto& subBody : body->subBodies()){
+                    subBody->forwardDynamics()->refreshState();
+                }
+            });
+    } else {
+        for(auto& subBody : subBodies_){
+            subBody->forwardDynamics()->refreshState();
+        }
+    }
+}
+
+
+/**
+   The sub-bodies of a body are processed by the same thread because the sensors of
+   the body are updated with the states of the links in all the sub-bodies.
+*/
+void DyWorldBase::processBodiesInParallel(const std::function<void(DyBody* body)>& func)
+{
+    int numThreadsToUse = std::min(numThreads_, static_cast<int>(bodyProcessingOrder.size()));
+    nextBodyOrderIndex = 0;
+    for(int i=1; i < numThreadsToUse; ++i){
+        threadPool->start([this, &func](){ processBodiesInQueue(func); });
+    }
+    processBodiesInQueue(func);
+    threadPool->wait();
+}
+
+
+void DyWorldBase::processBodiesInQueue(const std::function<void(DyBody* body)>& func)
+{
+    const int numBodies = bodyProcessingOrder.size();
+    while(true){
+        int orderIndex = nextBodyOrderIndex.fetch_add(1);
+        if(orderIndex >= numBodies){
+            break;
+        }
+        func(bodyProcessingOrder[orderIndex]);
     }
 }
 
@@ -10,10 +10,16 @@
 #include "ExtraJoint.h"
 #include <string>
 #include <map>
+#include <memory>
+#include <atomic>
+#include <functional>
+#include <chrono>
 #include "exportdecl.h"
 
 namespace cnoid {
 
+class ThreadPool;
+
 class CNOID_EXPORT DyWorldBase
 {
 public:
@@ -88,6 +94,31 @@ public:
     virtual void calcNextState();
 
     void refreshState();
+
+    /**
+       The forward dynamics of the bodies are computed in parallel when the number of threads
+       is more than one. Each body is processed by a single thread and the bodies do not share
+       any state in the computation, so the results do not depend on the number of threads.
+       The default value is zero, which means that the bodies are processed in the calling thread.
+    */
+    void setNumThreads(int n);
+    int numThreads() const { return numThreads_; }
+
+    enum Phase {
+        VirtualJointForcePhase,
+        ConstraintForcePhase,
+        ForwardDynamicsPhase,
+        NumPhases
+    };
+
+    /**
+       When this mode is enabled, the elapsed time of each phase of calcNextState is accumulated.
+    */
+    void setPhaseTimeMeasurementEnabled(bool on);
+    bool isPhaseTimeMeasurementEnabled() const { return isPhaseTimeMeasurementEnabled_; }
+    void resetPhaseTimes();
+    double phaseTime(int phase) const { return phaseTimes[phase]; }
+    int numPhaseTimeMeasurementSteps() const { return numPhaseTimeMeasurementSteps_; }
         
     /**
        \brief get index of link pairs
@@ -127,7 +158,32 @@ private:
 
     std::vector<ExtraJoint> extraJoints_;
 
-    void extractInternalBodies(Link* link);    
+    int numThreads_;
+    std::unique_ptr<ThreadPool> threadPool;
+    std::vector<DyBody*> bodyProcessingOrder;
+    std::atomic<int> nextBodyOrderIndex;
+
+    bool isPhaseTimeMeasurementEnabled_;
+    std::chrono::steady_clock::time_point phaseStartTime;
+    double phaseTimes[NumPhases];
+    int numPhaseTimeMeasurementSteps_;
+
+    void extractInternalBodies(Link* link);
+    void processBodiesInParallel(const std::function<void(DyBody* body)>& func);
+    void processBodiesInQueue(const std::function<void(DyBody* body)>& func);
+
+protected:
+    void startPhaseTimeMeasurement() {
+        phaseStartTime = std::chrono::steady_clock::now();
+    }
+    void measurePhaseTime(int phase) {
+        auto time = std::chrono::steady_clock::now();
+        phaseTimes[phase] += std::chrono::duration<double>(time - phaseStartTime).count();
+        phaseStartTime = time;
+        if(phase == NumPhases - 1){
+            ++numPhaseTimeMeasurementSteps_;
+        }
+    }
 };
 
 template <class TConstraintForceSolver> class DyWorld : public DyWorldBase
@@ -148,9 +204,19 @@ public:
     }
 
     virtual void calcNextState() override {
-        DyWorldBase::setVirtualJointForces();
-        constraintForceSolver.solve();
-        DyWorldBase::calcNextState();
+        if(!isPhaseTimeMeasurementEnabled()){
+            DyWorldBase::setVirtualJointForces();
+            constraintForceSolver.solve();
+            DyWorldBase::calcNextState();
+        } else {
+            startPhaseTimeMeasurement();
+            DyWorldBase::setVirtualJointForces();
+            measurePhaseTime(VirtualJointForcePhase);
+            constraintForceSolver.solve();
+            measurePhaseTime(ConstraintForcePhase);
+            DyWorldBase::calcNextState();
+            measurePhaseTime(ForwardDynamicsPhase);
+        }
     }
 };
 
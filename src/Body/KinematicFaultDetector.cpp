@@ -0,0 +1,389 @@
+#include "KinematicFaultDetector.h"
+#include "Body.h"
+#include "BodyMotion.h"
+#include "BodyCollisionDetector.h"
+#include <cnoid/AISTCollisionDetector>
+#include <cnoid/IdPair>
+#include <cnoid/ThreadPool>
+#include <map>
+#include <limits>
+#include <cmath>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+const int MinNumFramesPerThread = 50;
+
+struct FrameRange
+{
+    int beginningFrame;
+    int endingFrame;
+    BodyPtr body;
+    unique_ptr<BodyCollisionDetector> bodyCollisionDetector;
+
+    vector<KinematicFaultDetector::Fault> faults;
+
+    // The indices of the faults continuing at the current frame
+    vector<int> lastPosFaultIndices;
+    vector<int> lastVelFaultIndices;
+    std::map<IdPair<int>, int> lastCollisionFaultIndices;
+};
+
+}
+
+namespace cnoid {
+
+class KinematicFaultDetector::Impl
+{
+public:
+    bool isJointPositionCheckEnabled;
+    double angleMargin;
+    double translationMargin;
+    bool isJointVelocityCheckEnabled;
+    double velocityLimitRatio;
+    bool isSelfCollisionCheckEnabled;
+    CollisionDetectorPtr collisionDetector;
+    vector<bool> linkSelection;
+    double lowerTime;
+    double upperTime;
+    int numThreads;
+    vector<Fault> faults;
+
+    shared_ptr<MultiValueSeq> qseq;
+    shared_ptr<MultiSE3Seq> pseq;
+    int numJoints;
+    int numLinks;
+    double frameRate;
+    int beginningFrame;
+    int endingFrame;
+
+    Impl();
+    int checkFaults(Body* body, BodyMotion& motion);
+    void checkFaultsInFrameRange(FrameRange& range);
+    void addFault(
+        FrameRange& range, int& lastFaultIndex, FaultType type, int frame,
+        int jointId, int linkIndex1, int linkIndex2, double value);
+    void mergeFaults(vector<FrameRange>& ranges);
+};
+
+}
+
+
+KinematicFaultDetector::KinematicFaultDetector()
+{
+    impl = new Impl;
+}
+
+
+KinematicFaultDetector::Impl::Impl()
+{
+    isJointPositionCheckEnabled = true;
+    angleMargin = 0.0;
+    translationMargin = 0.0;
+    isJointVelocityCheckEnabled = true;
+    velocityLimitRatio = 1.0;
+    isSelfCollisionCheckEnabled = true;
+    lowerTime = 0.0;
+    upperTime = std::numeric_limits<double>::max();
+    numThreads = 1;
+}
+
+
+KinematicFaultDetector::~KinematicFaultDetector()
+{
+    delete impl;
+}
+
+
+void KinematicFaultDetector::setJointPositionCheckEnabled(bool on)
+{
+    impl->isJointPositionCheckEnabled = on;
+}
+
+
+void KinematicFaultDetector::setAngleMargin(double margin)
+{
+    impl->angleMargin = margin;
+}
+
+
+void KinematicFaultDetector::setTranslationMargin(double margin)
+{
+    impl->translationMargin = margin;
+}
+
+
+void KinematicFaultDetector::setJointVelocityCheckEnabled(bool on)
+{
+    impl->isJointVelocityCheckEnabled = on;
+}
+
+
+void KinematicFaultDetector::setVelocityLimitRatio(double ratio)
+{
+    impl->velocityLimitRatio = ratio;
+}
+
+
+void KinematicFaultDetector::setSelfCollisionCheckEnabled(bool on)
+{
+    impl->isSelfCollisionCheckEnabled = on;
+}
+
+
+void KinematicFaultDetector::setCollisionDetector(CollisionDetector* detector)
+{
+    impl->collisionDetector = detector;
+}
+
+
+void KinematicFaultDetector::setLinkSelection(const std::vector<bool>& selection)
+{
+    impl->linkSelection = selection;
+}
+
+
+void KinematicFaultDetector::clearLinkSelection()
+{
+    impl->linkSelection.clear();
+}
+
+
+void KinematicFaultDetector::setTimeRange(double lower, double upper)
+{
+    impl->lowerTime = std::max(0.0, lower);
+    impl->upperTime = std::max(impl->lowerTime, upper);
+}
+
+
+void KinematicFaultDetector::setFullTimeRange()
+{
+    impl->lowerTime = 0.0;
+    impl->upperTime = std::numeric_limits<double>::max();
+}
+
+
+void KinematicFaultDetector::setNumThreads(int n)
+{
+    impl->numThreads = std::max(n, 1);
+}
+
+
+const std::vector<KinematicFaultDetector::Fault>& KinematicFaultDetector::faults() const
+{
+    return impl->faults;
+}
+
+
+int KinematicFaultDetector::checkFaults(Body* body, BodyMotion& motion)
+{
+    return impl->checkFaults(body, motion);
+}
+
+
+int KinematicFaultDetector::Impl::checkFaults(Body* body, BodyMotion& motion)
+{
+    faults.clear();
+
+    motion.updateLinkPosSeqAndJointPosSeqWithBodyPositionSeq();
+    qseq = motion.jointPosSeq();
+    pseq = motion.linkPosSeq();
+
+    if((!isJointPositionCheckEnabled && !isJointVelocityCheckEnabled && !isSelfCollisionCheckEnabled) ||
+       body->isStaticModel() || !qseq->getNumFrames()){
+        return 0;
+    }
+
+    numJoints = std::min(body->numJoints(), qseq->numParts());
+    numLinks = std::min(body->numLinks(), pseq->numParts());
+
+    frameRate = motion.frameRate();
+    beginningFrame = std::max(0, (int)(lowerTime * frameRate));
+    endingFrame = motion.numFrames() - 1;
+    if(upperTime < std::numeric_limits<double>::max()){
+        endingFrame = std::min(endingFrame, (int)std::lround(upperTime * frameRate));
+    }
+    const int numFrames = endingFrame - beginningFrame + 1;
+    if(numFrames <= 0){
+        return 0;
+    }
+
+    const int numRanges = std::max(1, std::min(numThreads, numFrames / MinNumFramesPerThread));
+    vector<FrameRange> ranges(numRanges);
+
+    // The bodies and the collision detectors are prepared in this thread
+    for(int i=0; i < numRanges; ++i){
+        auto& range = ranges[i];
+        range.beginningFrame = beginningFrame + numFrames * i / numRanges;
+        range.endingFrame = beginningFrame + numFrames * (i + 1) / numRanges - 1;
+        range.body = body->clone();
+        if(isSelfCollisionCheckEnabled){
+            range.bodyCollisionDetector = make_unique<BodyCollisionDetector>();
+            if(collisionDetector){
+                range.bodyCollisionDetector->setCollisionDetector(collisionDetector->clone());
+            } else {
+                range.bodyCollisionDetector->setCollisionDetector(new AISTCollisionDetector);
+            }
+            range.bodyCollisionDetector->addBody(range.body, true);
+            range.bodyCollisionDetector->makeReady();
+        }
+    }
+
+    if(numRanges == 1){
+        checkFaultsInFrameRange(ranges[0]);
+    } else {
+        ThreadPool threadPool(numRanges - 1);
+        for(int i=1; i < numRanges; ++i){
+            threadPool.start([this, &ranges, i](){ checkFaultsInFrameRange(ranges[i]); });
+        }
+        checkFaultsInFrameRange(ranges[0]);
+        threadPool.wait();
+    }
+
+    mergeFaults(ranges);
+
+    qseq.reset();
+    pseq.reset();
+
+    return faults.size();
+}
+
+
+void KinematicFaultDetector::Impl::checkFaultsInFrameRange(FrameRange& range)
+{
+    Body* body = range.body;
+    const double stepRatio2 = 2.0 / frameRate;
+
+    range.lastPosFaultIndices.resize(numJoints, -1);
+    range.lastVelFaultIndices.resize(numJoints, -1);
+
+    if(isSelfCollisionCheckEnabled){
+        Link* root = body->rootLink();
+        root->p().setZero();
+        root->R().setIdentity();
+    }
+
+    for(int frame = range.beginningFrame; frame <= range.endingFrame; ++frame){
+
+        int prevFrame = (frame == beginningFrame) ? beginningFrame : frame - 1;
+        int nextFrame = (frame == endingFrame) ? endingFrame : frame + 1;
+
+        for(int i=0; i < numJoints; ++i){
+            Link* joint = body->joint(i);
+            double q = qseq->at(frame, i);
+            joint->q() = q;
+            const int linkIndex = joint->index();
+            if(linkIndex >= 0 && (linkSelection.empty() || (linkIndex < (int)linkSelection.size() && linkSelection[linkIndex]))){
+                if(isJointPositionCheckEnabled){
+                    bool fault = false;
+                    if(joint->isRevoluteJoint()){
+                        fault = (q > (joint->q_upper() - angleMargin) || q < (joint->q_lower() + angleMargin));
+                    } else if(joint->isPrismaticJoint()){
+                        fault = (q > (joint->q_upper() - translationMargin) || q < (joint->q_lower() + translationMargin));
+                    }
+                    if(fault){
+                        addFault(range, range.lastPosFaultIndices[i], JointPositionFault, frame, i, -1, -1, q);
+                    }
+                }
+                if(isJointVelocityCheckEnabled){
+                    double dq = (qseq->at(nextFrame, i) - qseq->at(prevFrame, i)) / stepRatio2;
+                    joint->dq() = dq;
+                    if(dq > (joint->dq_upper() * velocityLimitRatio) || dq < (joint->dq_lower() * velocityLimitRatio)){
+                        addFault(range, range.lastVelFaultIndices[i], JointVelocityFault, frame, i, -1, -1, dq);
+                    }
+                }
+            }
+        }
+
+        if(isSelfCollisionCheckEnabled){
+
+            Link* link = body->link(0);
+            if(!pseq->empty()){
+                const SE3& p = pseq->at(frame, 0);
+                link->p() = p.translation();
+                link->R() = p.rotation().toRotationMatrix();
+            } else {
+                link->p().setZero();
+                link->R().setIdentity();
+            }
+
+            body->calcForwardKinematics();
+
+            if(!pseq->empty()){
+                for(int i=1; i < numLinks; ++i){
+                    link = body->link(i);
+                    const SE3& p = pseq->at(frame, i);
+                    link->p() = p.translation();
+                    link->R() = p.rotation().toRotationMatrix();
+                }
+            }
+
+            range.bodyCollisionDetector->updatePositions();
+
+            range.bodyCollisionDetector->detectCollisions(
+                [&](const CollisionPair& collisionPair){
+                    const int linkIndex1 = static_cast<Link*>(collisionPair.object(0))->index();
+                    const int linkIndex2 = static_cast<Link*>(collisionPair.object(1))->index();
+                    IdPair<int> linkPair(linkIndex1, linkIndex2);
+                    auto inserted = range.lastCollisionFaultIndices.insert(make_pair(linkPair, -1));
+                    addFault(range, inserted.first->second, SelfCollisionFault, frame, -1, linkIndex1, linkIndex2, 0.0);
+                });
+        }
+    }
+}
+
+
+void KinematicFaultDetector::Impl::addFault
+(FrameRange& range, int& lastFaultIndex, FaultType type, int frame,
+ int jointId, int linkIndex1, int linkIndex2, double value)
+{
+    if(lastFaultIndex >= 0 && range.faults[lastFaultIndex].endingFrame >= frame - 1){
+        range.faults[lastFaultIndex].endingFrame = frame;
+    } else {
+        lastFaultIndex = range.faults.size();
+        range.faults.push_back({ type, frame, frame, jointId, linkIndex1, linkIndex2, value });
+    }
+}
+
+
+/**
+   A fault at the head of a frame range is joined to the same fault at the tail of the
+   previous range, so the faults are the same as the ones detected by a single thread.
+*/
+void KinematicFaultDetector::Impl::mergeFaults(vector<FrameRange>& ranges)
+{
+    faults = std::move(ranges[0].faults);
+
+    vector<int> continuingFaultIndices;
+
+    for(size_t i=1; i < ranges.size(); ++i){
+        auto& range = ranges[i];
+        const int prevEndingFrame = range.beginningFrame - 1;
+        continuingFaultIndices.clear();
+        for(size_t j=0; j < faults.size(); ++j){
+            if(faults[j].endingFrame == prevEndingFrame){
+                continuingFaultIndices.push_back(j);
+            }
+        }
+        for(auto& fault : range.faults){
+            bool merged = false;
+            if(fault.beginningFrame == range.beginningFrame){
+                for(auto index : continuingFaultIndices){
+                    auto& prevFault = faults[index];
+                    if(prevFault.type == fault.type && prevFault.jointId == fault.jointId &&
+                       IdPair<int>(prevFault.linkIndex1, prevFault.linkIndex2) ==
+                       IdPair<int>(fault.linkIndex1, fault.linkIndex2)){
+                        prevFault.endingFrame = fault.endingFrame;
+                        merged = true;
+                        break;
+                    }
+                }
+            }
+            if(!merged){
+                faults.push_back(fault);
+            }
+        }
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef CNOID_BODY_KINEMATIC_FAULT_DETECTOR_H
+#define CNOID_BODY_KINEMATIC_FAULT_DETECTOR_H
+
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class Body;
+class BodyMotion;
+class CollisionDetector;
+
+/**
+   This class detects the joint position limit overs, the joint velocity limit overs
+   and the self-collisions in the frames of a body motion without any GUI.
+*/
+class CNOID_EXPORT KinematicFaultDetector
+{
+public:
+    KinematicFaultDetector();
+    ~KinematicFaultDetector();
+
+    void setJointPositionCheckEnabled(bool on);
+    void setAngleMargin(double margin);
+    void setTranslationMargin(double margin);
+    void setJointVelocityCheckEnabled(bool on);
+    void setVelocityLimitRatio(double ratio);
+    void setSelfCollisionCheckEnabled(bool on);
+
+    /**
+       The detector is cloned for each thread. AISTCollisionDetector is used by default.
+    */
+    void setCollisionDetector(CollisionDetector* detector);
+
+    //! The joints of the links whose flags are false are not checked.
+    void setLinkSelection(const std::vector<bool>& selection);
+    void clearLinkSelection();
+
+    void setTimeRange(double lower, double upper);
+    void setFullTimeRange();
+
+    /**
+       The frame range is divided among the threads, each of which uses a clone of the body
+       and the collision detector. The result is the same as the one of a single thread.
+    */
+    void setNumThreads(int n);
+
+    enum FaultType {
+        JointPositionFault,
+        JointVelocityFault,
+        SelfCollisionFault
+    };
+
+    /**
+       A fault lasting in the consecutive frames
+    */
+    struct Fault
+    {
+        FaultType type;
+        int beginningFrame;
+        int endingFrame;
+        // The joint id of a joint fault
+        int jointId;
+        // The indices of the colliding links of a self-collision
+        int linkIndex1;
+        int linkIndex2;
+        // The joint position or velocity at the beginning frame of a joint fault
+        double value;
+    };
+
+    /**
+       The body is not modified by this function.
+       @return The number of detected faults
+    */
+    int checkFaults(Body* body, BodyMotion& motion);
+
+    //! Faults in the order of the beginning frames
+    const std::vector<Fault>& faults() const;
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
@@ -5,11 +5,91 @@
 #include "MassMatrix.h"
 #include "Link.h"
 #include "InverseDynamics.h"
+#include <cnoid/EigenUtil>
+#include <algorithm>
 
+using namespace std;
 using namespace cnoid;
 
 namespace {
 
+/**
+   The composite rigid body inertia around the world origin.
+   mc is the product of the mass and the center of mass, and I is the inertia tensor.
+*/
+struct CompositeInertia
+{
+    double m;
+    Vector3 mc;
+    Matrix3 I;
+
+    void setLinkInertia(Link* link){
+        const Vector3 c = link->R() * link->c() + link->p();
+        const Matrix3 c_hat = hat(c);
+        m = link->m();
+        mc = m * c;
+        I.noalias() = link->R() * link->I() * link->R().transpose();
+        I.noalias() += m * c_hat * c_hat.transpose();
+    }
+
+    void add(const CompositeInertia& inertia){
+        m += inertia.m;
+        mc += inertia.mc;
+        I += inertia.I;
+    }
+
+    // The spatial force to accelerate the body with the spatial acceleration (sv, sw)
+    Vector6 force(const Vector3& sv, const Vector3& sw) const {
+        Vector6 f;
+        f.head<3>() = m * sv + sw.cross(mc);
+        f.tail<3>() = mc.cross(sv) + I * sw;
+        return f;
+    }
+};
+
+/**
+   The spatial axis of a joint around the world origin, which is zero for a fixed joint.
+   This is the same as the one used in the inverse dynamics calculation.
+*/
+bool getSpatialJointAxis(Link* link, Vector3& out_sv, Vector3& out_sw)
+{
+    if(link->parent()){
+        if(link->isRevoluteJoint()){
+            out_sw.noalias() = link->R() * link->a();
+            out_sv.noalias() = link->p().cross(out_sw);
+            return true;
+        } else if(link->isPrismaticJoint()){
+            out_sw.setZero();
+            out_sv.noalias() = link->R() * link->d();
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+   The order to process the coordinates in the LTDL factorization, in which each coordinate
+   comes before its ancestors. The coordinates are sorted by the depth in the tree.
+*/
+void getDescendantFirstOrder(const vector<int>& parents, vector<int>& out_order)
+{
+    const int n = parents.size();
+    vector<int> depths(n);
+    for(int i=0; i < n; ++i){
+        int depth = 0;
+        for(int j = parents[i]; j >= 0; j = parents[j]){
+            ++depth;
+        }
+        depths[i] = depth;
+    }
+    out_order.resize(n);
+    for(int i=0; i < n; ++i){
+        out_order[i] = i;
+    }
+    std::stable_sort(out_order.begin(), out_order.end(),
+                     [&](int i1, int i2){ return depths[i1] > depths[i2]; });
+}
+
 template<typename Derived>
 void setColumnOfMassMatrix(Body* body, Eigen::MatrixBase<Derived>& out_M, int column)
 {
@@ -35,15 +115,12 @@ void setColumnOfMassMatrix(Body* body, Eigen::MatrixBase<Derived>& out_M, int co
 namespace cnoid {
 
 /**
-   calculate the mass matrix using the unit vector method
-   \todo replace the unit vector method here with a more efficient method
-
    The motion equation (dv != dvo)
    |       |   | dv  |   |   |   | fext      |
    | out_M | * | dw  | + | b | = | tauext    |
    |       |   | ddq |   |   |   | u         |
 */
-void calcMassMatrix(Body* body, const Vector3& g, Eigen::MatrixXd& out_M, VectorXd& out_b)
+void calcMassMatrixWithUnitVectorMethod(Body* body, const Vector3& g, Eigen::MatrixXd& out_M, VectorXd& out_b)
 {
     const int nj = body->numJoints();
     Link* rootLink = body->rootLink();
@@ -113,10 +190,198 @@ void calcMassMatrix(Body* body, const Vector3& g, Eigen::MatrixXd& out_M, Vector
     rootLink->dw() = dworg;
 }
 
+/**
+   The composite-rigid-body algorithm. The coordinates of a floating root link are the
+   linear velocity of the root link origin and the angular velocity in the world frame,
+   which are the same as the ones of calcMassMatrixWithUnitVectorMethod.
+*/
 void calcMassMatrix(Body* body, MatrixXd& out_M)
 {
-    VectorXd b;
-    calcMassMatrix(body, Vector3::Zero(), out_M, b);
+    const int nj = body->numJoints();
+    const int numLinks = body->numLinks();
+    Link* rootLink = body->rootLink();
+    const int offset = rootLink->isFixedJoint() ? 0 : 6;
+
+    out_M.setZero(nj + offset, nj + offset);
+
+    vector<CompositeInertia> inertias(numLinks);
+    for(int i=0; i < numLinks; ++i){
+        inertias[i].setLinkInertia(body->link(i));
+    }
+
+    // The links are stored in the order that each parent comes before its children
+    for(int i = numLinks - 1; i >= 0; --i){
+        Link* link = body->link(i);
+        const CompositeInertia& inertia = inertias[i];
+        if(Link* parent = link->parent()){
+            inertias[parent->index()].add(inertia);
+        }
+        const int id = link->jointId();
+        if(id < 0 || id >= nj){
+            continue;
+        }
+        const int k = id + offset;
+        out_M(k, k) = link->Jm2(); // motor inertia
+
+        Vector3 sv, sw;
+        if(!getSpatialJointAxis(link, sv, sw)){
+            continue;
+        }
+        const Vector6 f = inertia.force(sv, sw);
+        out_M(k, k) += sv.dot(f.head<3>()) + sw.dot(f.tail<3>());
+
+        // Only the elements of the ancestor joints are non-zero
+        for(Link* ancestor = link->parent(); ancestor; ancestor = ancestor->parent()){
+            const int ancestorId = ancestor->jointId();
+            if(ancestorId >= 0 && ancestorId < nj && getSpatialJointAxis(ancestor, sv, sw)){
+                const int l = ancestorId + offset;
+                out_M(l, k) = out_M(k, l) = sv.dot(f.head<3>()) + sw.dot(f.tail<3>());
+            }
+        }
+        if(offset > 0){
+            auto block = out_M.block<6, 1>(0, k);
+            block.head<3>() = f.head<3>();
+            block.tail<3>() = f.tail<3>() - rootLink->p().cross(f.head<3>());
+            out_M.block<1, 6>(k, 0) = block.transpose();
+        }
+    }
+
+    if(offset > 0){
+        const CompositeInertia& inertia = inertias[0];
+        const Vector3& p = rootLink->p();
+        for(int i=0; i < 6; ++i){
+            Vector3 sv, sw;
+            if(i < 3){
+                sv = Vector3::Unit(i);
+                sw.setZero();
+            } else {
+                sw = Vector3::Unit(i - 3);
+                sv = p.cross(sw);
+            }
+            const Vector6 f = inertia.force(sv, sw);
+            out_M.block<3, 1>(0, i) = f.head<3>();
+            out_M.block<3, 1>(3, i) = f.tail<3>() - p.cross(f.head<3>());
+        }
+    }
+}
+
+
+void calcMassMatrix(Body* body, const Vector3& g, MatrixXd& out_M, VectorXd& out_b)
+{
+    const int nj = body->numJoints();
+    Link* rootLink = body->rootLink();
+    const int totaldof = rootLink->isFixedJoint() ? nj : nj + 6;
+
+    // preserve and clear the joint accelerations
+    VectorXd ddqorg(nj);
+    VectorXd uorg(nj);
+    for(int i = 0; i < nj; ++i){
+        Link* joint = body->joint(i);
+        ddqorg[i] = joint->ddq();
+        uorg  [i] = joint->u();
+        joint->ddq() = 0.0;
+    }
+
+    // preserve and clear the root link acceleration
+    const Vector3 dvorg = rootLink->dv();
+    const Vector3 dworg  = rootLink->dw();
+
+    rootLink->dv() = g;
+    rootLink->dw().setZero();
+
+    out_b.resize(totaldof);
+    setColumnOfMassMatrix(body, out_b, 0);
+
+    // recover state
+    for(int i = 0; i < nj; ++i){
+        Link* joint = body->joint(i);
+        joint->ddq()  = ddqorg[i];
+        joint->u()    = uorg  [i];
+    }
+    rootLink->dv() = dvorg;
+    rootLink->dw() = dworg;
+
+    calcMassMatrix(body, out_M);
+}
+
+
+void getMassMatrixParentIndices(Body* body, std::vector<int>& out_parents)
+{
+    const int nj = body->numJoints();
+    Link* rootLink = body->rootLink();
+    const int offset = rootLink->isFixedJoint() ? 0 : 6;
+
+    out_parents.resize(nj + offset);
+    for(int i=0; i < offset; ++i){
+        out_parents[i] = i - 1;
+    }
+    for(int i=0; i < nj; ++i){
+        int parent = offset - 1;
+        Link* joint = body->joint(i);
+        if(joint->index() >= 0){
+            for(Link* ancestor = joint->parent(); ancestor; ancestor = ancestor->parent()){
+                const int ancestorId = ancestor->jointId();
+                if(ancestorId >= 0 && ancestorId < nj){
+                    parent = ancestorId + offset;
+                    break;
+                }
+            }
+        }
+        out_parents[i + offset] = parent;
+    }
+}
+
+
+/**
+   See Featherstone, Rigid Body Dynamics Algorithms, Section 6.3.
+   The coordinates are processed in the order that each coordinate comes before its
+   ancestors so that the parent indices do not have to be smaller than the child indices.
+*/
+void factorizeMassMatrixLTDL(MatrixXd& io_M, const std::vector<int>& parents)
+{
+    auto& H = io_M;
+    vector<int> order;
+    getDescendantFirstOrder(parents, order);
+
+    for(auto k : order){
+        int i = parents[k];
+        while(i >= 0){
+            const double a = H(k, i) / H(k, k);
+            int j = i;
+            while(j >= 0){
+                H(i, j) -= H(k, j) * a;
+                j = parents[j];
+            }
+            H(k, i) = a;
+            i = parents[i];
+        }
+    }
+}
+
+
+void solveMassMatrixLTDL(const MatrixXd& LTDL, const std::vector<int>& parents, VectorXd& io_x)
+{
+    auto& x = io_x;
+    vector<int> order;
+    getDescendantFirstOrder(parents, order);
+
+    // solve L^T y = b
+    for(auto i : order){
+        for(int j = parents[i]; j >= 0; j = parents[j]){
+            x[j] -= LTDL(i, j) * x[i];
+        }
+    }
+    // solve D z = y
+    for(int i=0; i < x.size(); ++i){
+        x[i] /= LTDL(i, i);
+    }
+    // solve L x = z
+    for(auto it = order.rbegin(); it != order.rend(); ++it){
+        const int i = *it;
+        for(int j = parents[i]; j >= 0; j = parents[j]){
+            x[i] -= LTDL(i, j) * x[j];
+        }
+    }
 }
 
 }
@@ -6,13 +6,47 @@
 #define CNOID_BODY_MASS_MATRIX_H
 
 #include "Body.h"
+#include <vector>
 #include "exportdecl.h"
 
 namespace cnoid {
 
+/**
+   The mass matrix is calculated with the composite-rigid-body algorithm.
+   The link positions must be updated by the forward kinematics in advance.
+*/
 CNOID_EXPORT void calcMassMatrix(Body* body, MatrixXd& out_M);
 CNOID_EXPORT void calcMassMatrix(Body* body, const Vector3& g, MatrixXd& out_M, VectorXd& out_b);
 
+/**
+   This function calculates the same matrix as calcMassMatrix with the unit vector method,
+   which executes the inverse dynamics calculation for each column. It is much slower
+   than calcMassMatrix and is mainly used to validate the result of it.
+*/
+CNOID_EXPORT void calcMassMatrixWithUnitVectorMethod(
+    Body* body, const Vector3& g, MatrixXd& out_M, VectorXd& out_b);
+
+/**
+   This function gets the index of the parent coordinate of each generalized coordinate
+   of the mass matrix, or -1 for a coordinate without the parent. The six coordinates of
+   a floating root link are treated as a serial chain.
+*/
+CNOID_EXPORT void getMassMatrixParentIndices(Body* body, std::vector<int>& out_parents);
+
+/**
+   This function factorizes the mass matrix M into L^T D L in place, exploiting the
+   branch-induced sparsity given by the parent indices. After the factorization, M(i, i)
+   is D(i, i) and M(i, j) is L(i, j) for each ancestor coordinate j of i. The other
+   elements are not used and are left undefined.
+*/
+CNOID_EXPORT void factorizeMassMatrixLTDL(MatrixXd& io_M, const std::vector<int>& parents);
+
+/**
+   This function solves M x = b with the factorized matrix. io_x is b as input and x as output.
+*/
+CNOID_EXPORT void solveMassMatrixLTDL(
+    const MatrixXd& LTDL, const std::vector<int>& parents, VectorXd& io_x);
+
 }
 
 #endif
@@ -22,6 +22,13 @@ public:
     virtual void getJointDisplacements(std::vector<stdx::optional<double>>& out_q) const = 0;
     virtual stdx::optional<Vector3> ZMP() const = 0;
 
+    /**
+       Creates a provider that gives the same poses independently of this provider
+       so that the poses can be obtained in another thread.
+       @return nullptr if the provider cannot be cloned
+    */
+    virtual PoseProvider* clonePoseProvider() const { return nullptr; }
+
     [[deprecated("Use getJointDisplacements.")]]
     void getJointPositions(std::vector<stdx::optional<double>>& out_q) const {
         getJointDisplacements(out_q);
@@ -4,25 +4,75 @@
 #include "BodyMotion.h"
 #include "ZMPSeq.h"
 #include "PoseProvider.h"
+#include <cnoid/ThreadPool>
+#include <atomic>
+#include <chrono>
+#include <thread>
 
 using namespace std;
 using namespace cnoid;
 
+namespace {
+
+const int MinNumFramesPerThread = 100;
+const std::chrono::milliseconds ProgressInterval(50);
+
+struct FrameRange
+{
+    int beginningFrame;
+    int endingFrame;
+    Body* body;
+    PoseProvider* provider;
+    BodyPtr clonedBody;
+    unique_ptr<PoseProvider> clonedProvider;
+
+    // The number of the frames converted before the provider gives a base link in this range
+    int numFramesWithoutBaseLink;
+
+    // The base link state at the end of this range, which is taken over by the next range
+    int lastBaseLinkIndex;
+    Vector3 p_lastBaseLink;
+    Matrix3 R_lastBaseLink;
+};
+
+class ConversionProcess
+{
+public:
+    double frameRate;
+    int numFrames;
+    int numLinkPositions;
+    bool allLinkPositionOutputMode;
+    BodyPositionSeq* pseq;
+    ZMPSeq* zmpSeq;
+    std::atomic<int> numConvertedFrames;
+    std::atomic<bool> isCanceled;
+    std::function<bool(int numConvertedFrames, int numFrames)> progressFunction;
+    std::chrono::steady_clock::time_point lastProgressTime;
+
+    shared_ptr<LinkTraverse> createFkTraverse(Link* baseLink, Link* rootLink);
+    void convertFrames(FrameRange& range, bool isMainThread);
+    void updateFramesWithBaseLink(Body* body, int beginningFrame, int numFrames, Link* baseLink);
+    void checkProgress(bool doForce = false);
+};
+
+}
+
 
 PoseProviderToBodyMotionConverter::PoseProviderToBodyMotionConverter()
 {
     setFullTimeRange();
     allLinkPositionOutputMode = true;
+    numThreads = 1;
 }
 
-    
+
 void PoseProviderToBodyMotionConverter::setTimeRange(double lower, double upper)
 {
     lowerTime = std::max(0.0, lower);
     upperTime = std::max(lowerTime, upper);
 }
 
-    
+
 void PoseProviderToBodyMotionConverter::setFullTimeRange()
 {
     lowerTime = 0.0;
@@ -36,6 +86,19 @@ void PoseProviderToBodyMotionConverter::setAllLinkPositionOutput(bool on)
 }
 
 
+void PoseProviderToBodyMotionConverter::setNumThreads(int n)
+{
+    numThreads = std::max(n, 1);
+}
+
+
+void PoseProviderToBodyMotionConverter::setProgressFunction
+(std::function<bool(int numConvertedFrames, int numFrames)> func)
+{
+    progressFunction = func;
+}
+
+
 bool PoseProviderToBodyMotionConverter::convert(Body* body, PoseProvider* provider, BodyMotion& motion)
 {
     const double frameRate = motion.frameRate();
@@ -49,19 +112,25 @@ bool PoseProviderToBodyMotionConverter::convert(Body* body, PoseProvider* provid
     pseq->setNumJointDisplacementsHint(numJoints);
     motion.setNumFrames(endingFrame + 1, true);
 
-    ZMPSeq& zmpSeq = *getOrCreateZMPSeq(motion);
-    bool isZmpValid = false;
+    ConversionProcess process;
+    process.frameRate = frameRate;
+    process.numFrames = std::max(endingFrame - beginningFrame + 1, 0);
+    process.numLinkPositions = numLinkPositions;
+    process.allLinkPositionOutputMode = allLinkPositionOutputMode;
+    process.pseq = pseq.get();
+    process.zmpSeq = getOrCreateZMPSeq(motion).get();
+    process.numConvertedFrames = 0;
+    process.isCanceled = false;
+    process.progressFunction = progressFunction;
+    process.lastProgressTime = std::chrono::steady_clock::now();
 
-    Link* rootLink = body->rootLink();
-    Link* baseLink = rootLink;
-
-    std::shared_ptr<LinkTraverse> fkTraverse;
-    if(allLinkPositionOutputMode){
-        fkTraverse = make_shared<LinkTraverse>(baseLink, true, true);
-    } else {
-        fkTraverse = make_shared<LinkPath>(baseLink, rootLink);
+    // The frame data is allocated in advance because the allocation is not thread-safe
+    for(int frameIndex = beginningFrame; frameIndex <= endingFrame; ++frameIndex){
+        pseq->allocateFrame(frameIndex);
     }
 
+    Link* rootLink = body->rootLink();
+
     // store the original state
     vector<double> orgJointDisplacements(numJoints);
     for(int i=0; i < numJoints; ++i){
@@ -70,9 +139,126 @@ bool PoseProviderToBodyMotionConverter::convert(Body* body, PoseProvider* provid
     Vector3 p0 = rootLink->p();
     Matrix3 R0 = rootLink->R();
 
+    int numRanges = std::min(numThreads, process.numFrames / MinNumFramesPerThread);
+    vector<FrameRange> ranges(std::max(numRanges, 1));
+    for(int i=1; i < numRanges; ++i){
+        auto& range = ranges[i];
+        range.clonedProvider.reset(provider->clonePoseProvider());
+        if(!range.clonedProvider){
+            numRanges = 1;
+            break;
+        }
+        range.provider = range.clonedProvider.get();
+        range.clonedBody = body->clone();
+        range.body = range.clonedBody;
+    }
+    ranges.resize(std::max(numRanges, 1));
+    numRanges = ranges.size();
+
+    for(int i=0; i < numRanges; ++i){
+        auto& range = ranges[i];
+        range.beginningFrame = beginningFrame + process.numFrames * i / numRanges;
+        range.endingFrame = beginningFrame + process.numFrames * (i + 1) / numRanges - 1;
+    }
+    ranges[0].body = body;
+    ranges[0].provider = provider;
+
+    if(numRanges == 1){
+        process.convertFrames(ranges[0], true);
+
+    } else {
+        ThreadPool threadPool(numRanges - 1);
+        std::atomic<int> numFinishedThreads(0);
+        for(int i=1; i < numRanges; ++i){
+            threadPool.start(
+                [&process, &ranges, &numFinishedThreads, i](){
+                    process.convertFrames(ranges[i], false);
+                    ++numFinishedThreads;
+                });
+        }
+        process.convertFrames(ranges[0], true);
+
+        if(process.progressFunction){
+            while(numFinishedThreads < numRanges - 1){
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                process.checkProgress();
+            }
+        }
+        threadPool.wait();
+
+        /*
+           The frames at the head of a range in which the provider does not give the base link
+           must be updated with the base link state taken over from the previous ranges.
+           The joint displacements of the frames are already valid.
+        */
+        if(!process.isCanceled){
+            int baseLinkIndex = ranges[0].lastBaseLinkIndex;
+            Vector3 p = ranges[0].p_lastBaseLink;
+            Matrix3 R = ranges[0].R_lastBaseLink;
+            for(int i=1; i < numRanges; ++i){
+                auto& range = ranges[i];
+                if(baseLinkIndex >= 0 && range.numFramesWithoutBaseLink > 0){
+                    Link* baseLink = body->link(baseLinkIndex);
+                    baseLink->p() = p;
+                    baseLink->R() = R;
+                    process.updateFramesWithBaseLink(
+                        body, range.beginningFrame, range.numFramesWithoutBaseLink, baseLink);
+                }
+                if(range.lastBaseLinkIndex >= 0){
+                    baseLinkIndex = range.lastBaseLinkIndex;
+                    p = range.p_lastBaseLink;
+                    R = range.R_lastBaseLink;
+                }
+            }
+        }
+    }
+
+    if(process.progressFunction && !process.isCanceled){
+        process.checkProgress(true);
+    }
+
+    // restore the original state
+    for(int i=0; i < numJoints; ++i){
+        body->joint(i)->q() = orgJointDisplacements[i];
+    }
+    rootLink->p() = p0;
+    rootLink->R() = R0;
+    body->calcForwardKinematics();
+
+    return !process.isCanceled;
+}
+
+
+shared_ptr<LinkTraverse> ConversionProcess::createFkTraverse(Link* baseLink, Link* rootLink)
+{
+    if(allLinkPositionOutputMode){
+        return make_shared<LinkTraverse>(baseLink, true, true);
+    } else {
+        return make_shared<LinkPath>(baseLink, rootLink);
+    }
+}
+
+
+void ConversionProcess::convertFrames(FrameRange& range, bool isMainThread)
+{
+    Body* body = range.body;
+    PoseProvider* provider = range.provider;
+    const int numJoints = body->numJoints();
+
+    Link* rootLink = body->rootLink();
+    Link* baseLink = rootLink;
+    auto fkTraverse = createFkTraverse(baseLink, rootLink);
+
     std::vector<stdx::optional<double>> srcJointDisplacements(numJoints);
 
-    for(int frameIndex = beginningFrame; frameIndex <= endingFrame; ++frameIndex){
+    range.numFramesWithoutBaseLink = 0;
+    range.lastBaseLinkIndex = -1;
+
+    for(int frameIndex = range.beginningFrame; frameIndex <= range.endingFrame; ++frameIndex){
+
+        if(isCanceled){
+            break;
+        }
 
         provider->seek(frameIndex / frameRate);
 
@@ -87,9 +273,13 @@ bool PoseProviderToBodyMotionConverter::convert(Body* body, PoseProvider* provid
                 }
             }
             provider->getBaseLinkPosition(baseLink->T());
+            range.lastBaseLinkIndex = baseLinkIndex;
+
+        } else if(range.lastBaseLinkIndex < 0){
+            ++range.numFramesWithoutBaseLink;
         }
 
-        auto& frame = pseq->allocateFrame(frameIndex);
+        auto& frame = pseq->frame(frameIndex);
 
         provider->getJointDisplacements(srcJointDisplacements);
         auto displacements = frame.jointDisplacements();
@@ -107,23 +297,53 @@ bool PoseProviderToBodyMotionConverter::convert(Body* body, PoseProvider* provid
         }
 
         if(auto zmp = provider->ZMP()){
-            zmpSeq[frameIndex] = *zmp;
-            isZmpValid = true;
+            (*zmpSeq)[frameIndex] = *zmp;
         }
 
+        ++numConvertedFrames;
+
+        if(isMainThread && progressFunction){
+            checkProgress();
+        }
     }
 
-    if(!isZmpValid){
-        //bodyMotionItem->clearRelativeZmpSeq();
+    if(range.lastBaseLinkIndex >= 0){
+        Link* lastBaseLink = body->link(range.lastBaseLinkIndex);
+        range.p_lastBaseLink = lastBaseLink->p();
+        range.R_lastBaseLink = lastBaseLink->R();
     }
+}
 
-    // restore the original state
-    for(int i=0; i < numJoints; ++i){
-        body->joint(i)->q() = orgJointDisplacements[i];
+
+void ConversionProcess::updateFramesWithBaseLink(Body* body, int beginningFrame, int numFrames, Link* baseLink)
+{
+    const int numJoints = body->numJoints();
+    Link* rootLink = body->rootLink();
+    auto fkTraverse = createFkTraverse(baseLink, rootLink);
+
+    for(int frameIndex = beginningFrame; frameIndex < beginningFrame + numFrames; ++frameIndex){
+        auto& frame = pseq->frame(frameIndex);
+        auto displacements = frame.jointDisplacements();
+        for(int i=0; i < numJoints; ++i){
+            body->joint(i)->q() = displacements[i];
+        }
+        if(allLinkPositionOutputMode || baseLink != rootLink){
+            fkTraverse->calcForwardKinematics();
+        }
+        for(int i=0; i < numLinkPositions; ++i){
+            frame.linkPosition(i).set(body->link(i)->position());
+        }
     }
-    rootLink->p() = p0;
-    rootLink->R() = R0;
-    body->calcForwardKinematics();
+}
+
 
-    return true;
+void ConversionProcess::checkProgress(bool doForce)
+{
+    auto now = std::chrono::steady_clock::now();
+    if(doForce || now - lastProgressTime >= ProgressInterval){
+        lastProgressTime = now;
+        if(!progressFunction(numConvertedFrames, numFrames)){
+            isCanceled = true;
+        }
+    }
 }
@@ -1,6 +1,7 @@
 #ifndef CNOID_BODY_POSE_PROVIDER_TO_BODY_MOTION_CONVERTER_H
 #define CNOID_BODY_POSE_PROVIDER_TO_BODY_MOTION_CONVERTER_H
 
+#include <functional>
 #include "exportdecl.h"
 
 namespace cnoid {
@@ -16,12 +17,30 @@ public:
     void setTimeRange(double lower, double upper);
     void setFullTimeRange();
     void setAllLinkPositionOutput(bool on);
+
+    /**
+       The frame range is divided among the threads when the provider can be cloned
+       by PoseProvider::clonePoseProvider. The result is the same as the one of a single thread.
+    */
+    void setNumThreads(int n);
+
+    /**
+       The function is called in the thread calling the convert function during the conversion.
+       The conversion is canceled when the function returns false.
+    */
+    void setProgressFunction(std::function<bool(int numConvertedFrames, int numFrames)> func);
+    
+    /**
+       @return false if the conversion is canceled
+    */
     bool convert(Body* body, PoseProvider* provider, BodyMotion& motion);
 
 private:
     double lowerTime;
     double upperTime;
     bool allLinkPositionOutputMode;
+    int numThreads;
+    std::function<bool(int numConvertedFrames, int numFrames)> progressFunction;
 };
 
 }
@@ -10,6 +10,7 @@
 #include <cnoid/DyBody>
 #include <cnoid/ForwardDynamicsCBM>
 #include <cnoid/ConstraintForceSolver>
+#include <cnoid/AISTCollisionDetector>
 #include <cnoid/LeggedBodyHelper>
 #include <cnoid/CloneMap>
 #include <cnoid/FloatingNumberString>
@@ -79,6 +80,7 @@ public:
         
     Selection dynamicsMode;
     Selection integrationMode;
+    Selection constraintMatrixMode;
     Vector3 gravity;
     double minFrictionCoefficient;
     double maxFrictionCoefficient;
@@ -86,12 +88,17 @@ public:
     FloatingNumberString contactCullingDepth;
     FloatingNumberString errorCriterion;
     int maxNumIterations;
+    int numConstraintSolverThreads;
+    int numForwardDynamicsThreads;
     FloatingNumberString contactCorrectionDepth;
     FloatingNumberString contactCorrectionVelocityRatio;
     double epsilon;
     bool is2Dmode;
     bool isKinematicWalkingEnabled;
     bool isOldAccelSensorMode;
+    bool isPhaseTimeReportEnabled;
+    bool isCollisionModelCacheEnabled;
+    string collisionModelCacheDirectory;
     bool hasNonRootFreeJoints;
 
     stdx::optional<int> forcedBodyPositionFunctionId;
@@ -107,6 +114,7 @@ public:
     void addBody(AISTSimBody* simBody);
     void clearExternalForces();
     void stepKinematicsSimulation(const std::vector<SimulationBody*>& activeSimBodies);
+    void putPhaseTimeReport();
     void setForcedPosition(BodyItem* bodyItem, const Isometry3& T);
     void doSetForcedPosition();
     void doPutProperties(PutPropertyFunction& putProperty);
@@ -138,7 +146,8 @@ AISTSimulatorItem::AISTSimulatorItem()
 AISTSimulatorItem::Impl::Impl(AISTSimulatorItem* self)
     : self(self),
       dynamicsMode(2, CNOID_GETTEXT_DOMAIN_NAME),
-      integrationMode(2, CNOID_GETTEXT_DOMAIN_NAME)
+      integrationMode(2, CNOID_GETTEXT_DOMAIN_NAME),
+      constraintMatrixMode(2, CNOID_GETTEXT_DOMAIN_NAME)
 {
     dynamicsMode.setSymbol(ForwardDynamicsMode, N_("Forward dynamics"));
     dynamicsMode.setSymbol(KinematicsMode,      N_("Kinematics"));
@@ -146,6 +155,10 @@ AISTSimulatorItem::Impl::Impl(AISTSimulatorItem* self)
     integrationMode.setSymbol(SemiImplicitEuler, N_("Semi-implicit Euler"));
     integrationMode.setSymbol(RungeKutta,        N_("Runge-Kutta"));
     integrationMode.select(SemiImplicitEuler);
+
+    constraintMatrixMode.setSymbol(DenseConstraintMatrix,       N_("Dense"));
+    constraintMatrixMode.setSymbol(BlockSparseConstraintMatrix, N_("Block sparse"));
+    constraintMatrixMode.select(DenseConstraintMatrix);
     
     gravity << 0.0, 0.0, -DEFAULT_GRAVITY_ACCELERATION;
 
@@ -158,12 +171,20 @@ AISTSimulatorItem::Impl::Impl(AISTSimulatorItem* self)
     
     errorCriterion = cfs.gaussSeidelErrorCriterion();
     maxNumIterations = cfs.gaussSeidelMaxNumIterations();
+    numConstraintSolverThreads = cfs.numThreads();
+    numForwardDynamicsThreads = world.numThreads();
     contactCorrectionDepth = cfs.contactCorrectionDepth();
     contactCorrectionVelocityRatio = cfs.contactCorrectionVelocityRatio();
 
     isKinematicWalkingEnabled = false;
     is2Dmode = false;
     isOldAccelSensorMode = false;
+    isPhaseTimeReportEnabled = false;
+
+    // The defaults are given by the environment variables read by AISTCollisionDetector
+    isCollisionModelCacheEnabled = AISTCollisionDetector::isModelCacheEnabled();
+    collisionModelCacheDirectory = AISTCollisionDetector::modelCacheDirectory();
+
     hasNonRootFreeJoints = false;
 
     mv = MessageView::instance();
@@ -181,7 +202,8 @@ AISTSimulatorItem::AISTSimulatorItem(const AISTSimulatorItem& org)
 AISTSimulatorItem::Impl::Impl(AISTSimulatorItem* self, const Impl& org)
     : self(self),
       dynamicsMode(org.dynamicsMode),
-      integrationMode(org.integrationMode)
+      integrationMode(org.integrationMode),
+      constraintMatrixMode(org.constraintMatrixMode)
 {
     gravity = org.gravity;
     minFrictionCoefficient = org.minFrictionCoefficient;
@@ -190,12 +212,17 @@ AISTSimulatorItem::Impl::Impl(AISTSimulatorItem* self, const Impl& org)
     contactCullingDepth = org.contactCullingDepth;
     errorCriterion = org.errorCriterion;
     maxNumIterations = org.maxNumIterations;
+    numConstraintSolverThreads = org.numConstraintSolverThreads;
+    numForwardDynamicsThreads = org.numForwardDynamicsThreads;
     contactCorrectionDepth = org.contactCorrectionDepth;
     contactCorrectionVelocityRatio = org.contactCorrectionVelocityRatio;
     epsilon = org.epsilon;
     isKinematicWalkingEnabled = org.isKinematicWalkingEnabled;
     is2Dmode = org.is2Dmode;
     isOldAccelSensorMode = org.isOldAccelSensorMode;
+    isPhaseTimeReportEnabled = org.isPhaseTimeReportEnabled;
+    isCollisionModelCacheEnabled = org.isCollisionModelCacheEnabled;
+    collisionModelCacheDirectory = org.collisionModelCacheDirectory;
 
     mv = MessageView::instance();
 }
@@ -219,6 +246,12 @@ void AISTSimulatorItem::setIntegrationMode(int mode)
 }
 
 
+void AISTSimulatorItem::setConstraintMatrixMode(int mode)
+{
+    impl->constraintMatrixMode.select(mode);
+}
+
+
 void AISTSimulatorItem::setGravity(const Vector3& gravity)
 {
     impl->gravity = gravity;
@@ -296,6 +329,36 @@ void AISTSimulatorItem::setMaxNumIterations(int value)
 }
 
 
+void AISTSimulatorItem::setNumConstraintSolverThreads(int n)
+{
+    impl->numConstraintSolverThreads = n;
+}
+
+
+void AISTSimulatorItem::setNumForwardDynamicsThreads(int n)
+{
+    impl->numForwardDynamicsThreads = n;
+}
+
+
+void AISTSimulatorItem::setPhaseTimeReportEnabled(bool on)
+{
+    impl->isPhaseTimeReportEnabled = on;
+}
+
+
+void AISTSimulatorItem::setCollisionModelCacheEnabled(bool on)
+{
+    impl->isCollisionModelCacheEnabled = on;
+}
+
+
+void AISTSimulatorItem::setCollisionModelCacheDirectory(const std::string& directory)
+{
+    impl->collisionModelCacheDirectory = directory;
+}
+
+
 void AISTSimulatorItem::setContactCorrectionDepth(double value)
 {
     impl->contactCorrectionDepth = value;
@@ -418,11 +481,16 @@ bool AISTSimulatorItem::Impl::initializeSimulation(const std::vector<SimulationB
     world.setOldAccelSensorCalcMode(isOldAccelSensorMode);
     world.setTimeStep(self->worldTimeStep());
     world.setCurrentTime(0.0);
+    world.setNumThreads(numForwardDynamicsThreads);
+    world.setPhaseTimeMeasurementEnabled(isPhaseTimeReportEnabled);
+    world.resetPhaseTimes();
 
     ConstraintForceSolver& cfs = world.constraintForceSolver;
     cfs.setMaterialTable(self->worldItem()->materialTable());
     cfs.setGaussSeidelErrorCriterion(errorCriterion.value());
     cfs.setGaussSeidelMaxNumIterations(maxNumIterations);
+    cfs.setNumThreads(numConstraintSolverThreads);
+    cfs.setBlockSparseMatrixMode(constraintMatrixMode.is(BlockSparseConstraintMatrix));
     cfs.setContactDepthCorrection(contactCorrectionDepth.value(), contactCorrectionVelocityRatio.value());
     
     self->addPostDynamicsFunction([&](){ clearExternalForces(); });
@@ -452,6 +520,12 @@ bool AISTSimulatorItem::Impl::initializeSimulation(const std::vector<SimulationB
     cfs.setContactCullingDistance(contactCullingDistance.value());
     cfs.setContactCullingDepth(contactCullingDepth.value());
     cfs.setCoefficientOfRestitution(epsilon);
+
+    // The cache is shared by all the AIST collision detectors in the process
+    AISTCollisionDetector::setModelCacheEnabled(isCollisionModelCacheEnabled);
+    if(isCollisionModelCacheEnabled){
+        AISTCollisionDetector::setModelCacheDirectory(collisionModelCacheDirectory);
+    }
     cfs.setCollisionDetector(self->getOrCreateCollisionDetector());
 
     if(is2Dmode){
@@ -614,12 +688,32 @@ void AISTSimulatorItem::Impl::stepKinematicsSimulation(const std::vector<Simulat
 
 void AISTSimulatorItem::finalizeSimulation()
 {
+    if(impl->isPhaseTimeReportEnabled){
+        impl->putPhaseTimeReport();
+    }
     if(ENABLE_DEBUG_OUTPUT){
         impl->os.close();
     }
 }
 
 
+void AISTSimulatorItem::Impl::putPhaseTimeReport()
+{
+    int numSteps = world.numPhaseTimeMeasurementSteps();
+    if(numSteps == 0){
+        return;
+    }
+    auto averageTime = [&](int phase){ return world.phaseTime(phase) * 1000.0 / numSteps; };
+    mv->putln(
+        format(_("Average computation times of {0} per step: "
+                 "virtual joint forces {1:.3f} [ms], constraint forces {2:.3f} [ms], forward dynamics {3:.3f} [ms]"),
+               self->displayName(),
+               averageTime(DyWorldBase::VirtualJointForcePhase),
+               averageTime(DyWorldBase::ConstraintForcePhase),
+               averageTime(DyWorldBase::ForwardDynamicsPhase)));
+}
+
+
 std::shared_ptr<CollisionLinkPairList> AISTSimulatorItem::getCollisions()
 {
     return impl->world.constraintForceSolver.getCollisions();
@@ -717,6 +811,12 @@ void AISTSimulatorItem::Impl::doPutProperties(PutPropertyFunction& putProperty)
     putProperty(_("Error criterion"), errorCriterion,
                 [&](const string& v){ return errorCriterion.setPositiveValue(v); });
     putProperty.min(1)(_("Max iterations"), maxNumIterations, changeProperty(maxNumIterations));
+    putProperty.min(0)(_("Constraint solver threads"), numConstraintSolverThreads,
+                       changeProperty(numConstraintSolverThreads));
+    putProperty(_("Constraint matrix"), constraintMatrixMode,
+                [&](int index){ return constraintMatrixMode.selectIndex(index); });
+    putProperty.min(0)(_("Forward dynamics threads"), numForwardDynamicsThreads,
+                       changeProperty(numForwardDynamicsThreads));
     putProperty(_("CC depth"), contactCorrectionDepth,
                 [&](const string& v){ return contactCorrectionDepth.setNonNegativeValue(v); });
     putProperty(_("CC v-ratio"), contactCorrectionVelocityRatio,
@@ -725,6 +825,11 @@ void AISTSimulatorItem::Impl::doPutProperties(PutPropertyFunction& putProperty)
                 changeProperty(isKinematicWalkingEnabled));
     putProperty(_("2D mode"), is2Dmode, changeProperty(is2Dmode));
     putProperty(_("Old accel sensor mode"), isOldAccelSensorMode, changeProperty(isOldAccelSensorMode));
+    putProperty(_("Phase time report"), isPhaseTimeReportEnabled, changeProperty(isPhaseTimeReportEnabled));
+    putProperty(_("Collision model cache"), isCollisionModelCacheEnabled,
+                changeProperty(isCollisionModelCacheEnabled));
+    putProperty(_("Collision model cache directory"), collisionModelCacheDirectory,
+                changeProperty(collisionModelCacheDirectory));
 }
 
 
@@ -746,11 +851,19 @@ bool AISTSimulatorItem::Impl::store(Archive& archive)
     archive.write("contactCullingDepth", contactCullingDepth);
     archive.write("errorCriterion", errorCriterion);
     archive.write("maxNumIterations", maxNumIterations);
+    archive.write("constraintSolverThreads", numConstraintSolverThreads);
+    archive.write("constraintMatrixMode", constraintMatrixMode.selectedSymbol(), DOUBLE_QUOTED);
+    archive.write("forwardDynamicsThreads", numForwardDynamicsThreads);
     archive.write("contactCorrectionDepth", contactCorrectionDepth);
     archive.write("contactCorrectionVelocityRatio", contactCorrectionVelocityRatio);
     archive.write("kinematicWalking", isKinematicWalkingEnabled);
     archive.write("2Dmode", is2Dmode);
     archive.write("oldAccelSensorMode", isOldAccelSensorMode);
+    archive.write("phaseTimeReport", isPhaseTimeReportEnabled);
+    archive.write("collision_model_cache", isCollisionModelCacheEnabled);
+    if(!collisionModelCacheDirectory.empty()){
+        archive.writeRelocatablePath("collision_model_cache_directory", collisionModelCacheDirectory);
+    }
     return true;
 }
 
@@ -782,10 +895,21 @@ bool AISTSimulatorItem::Impl::restore(const Archive& archive)
     contactCullingDepth = archive.get("contactCullingDepth", contactCullingDepth.string());
     errorCriterion = archive.get("errorCriterion", errorCriterion.string());
     archive.read("maxNumIterations", maxNumIterations);
+    archive.read("constraintSolverThreads", numConstraintSolverThreads);
+    if(archive.read("constraintMatrixMode", symbol)){
+        constraintMatrixMode.select(symbol);
+    }
+    archive.read("forwardDynamicsThreads", numForwardDynamicsThreads);
     contactCorrectionDepth = archive.get("contactCorrectionDepth", contactCorrectionDepth.string());
     contactCorrectionVelocityRatio = archive.get("contactCorrectionVelocityRatio", contactCorrectionVelocityRatio.string());
     archive.read("kinematicWalking", isKinematicWalkingEnabled);
     archive.read("2Dmode", is2Dmode);
     archive.read("oldAccelSensorMode", isOldAccelSensorMode);
+    archive.read("phaseTimeReport", isPhaseTimeReportEnabled);
+    archive.read("collision_model_cache", isCollisionModelCacheEnabled);
+    string directory;
+    if(archive.read("collision_model_cache_directory", directory)){
+        collisionModelCacheDirectory = archive.resolveRelocatablePath(directory);
+    }
     return true;
 }
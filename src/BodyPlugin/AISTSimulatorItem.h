@@ -32,8 +32,14 @@ public:
         RUNGE_KUTTA_INTEGRATION = RungeKutta
     };
 
+    enum ConstraintMatrixMode {
+        DenseConstraintMatrix,
+        BlockSparseConstraintMatrix
+    };
+
     void setDynamicsMode(int mode);
     void setIntegrationMode(int mode);
+    void setConstraintMatrixMode(int mode);
     void setGravity(const Vector3& gravity);
     const Vector3& gravity() const;
     void setFrictionCoefficientRange(double minFriction, double maxFriction);
@@ -43,11 +49,21 @@ public:
     void setContactCullingDepth(double value);        
     void setErrorCriterion(double value);        
     void setMaxNumIterations(int value);
+    void setNumConstraintSolverThreads(int n);
+    void setNumForwardDynamicsThreads(int n);
     void setContactCorrectionDepth(double value);
     void setContactCorrectionVelocityRatio(double value);
     void setEpsilon(double epsilon);
     void set2Dmode(bool on);
     void setKinematicWalkingEnabled(bool on);
+    void setPhaseTimeReportEnabled(bool on);
+
+    /**
+       The built collision models of the identical meshes are shared, and they are also stored
+       in the directory if it is specified. See AISTCollisionDetector::setModelCacheEnabled.
+    */
+    void setCollisionModelCacheEnabled(bool on);
+    void setCollisionModelCacheDirectory(const std::string& directory);
 
     [[deprecated("This function does nothing. Set Link::LinkContactState to Link::sensingMode from a controller.")]]
     void setConstraintForceOutputEnabled(bool on);
@@ -14,6 +14,7 @@
 #include <cnoid/ValueTreeUtil>
 #include <cnoid/GL1SceneRenderer>
 #include <cnoid/GLSLSceneRenderer>
+#include <cnoid/GLPixelBufferReader>
 #include <cnoid/RenderableItem>
 #include <cnoid/Body>
 #include <cnoid/Camera>
@@ -25,6 +26,8 @@
 #include <cnoid/SceneLights>
 #include <cnoid/CloneMap>
 #include <cnoid/EigenUtil>
+#include <cnoid/MeshBVH>
+#include <cnoid/ThreadPool>
 #include <cnoid/StringUtil>
 #include <cnoid/Tokenizer>
 #include <QThread>
@@ -37,6 +40,7 @@
 #include <condition_variable>
 #include <queue>
 #include <random>
+#include <chrono>
 #include <iostream>
 #include "gettext.h"
 
@@ -103,6 +107,22 @@ public:
 
 class SensorScreenRenderer;
 
+/**
+   The BVHs of the link shapes and the other scene objects are shared by all the sensors
+   simulated by the ray casting.
+*/
+struct RayCastingTarget
+{
+    Link* link; // null for an object that does not move
+    unique_ptr<MeshBVH> bvh;
+};
+
+struct RayCastingTargetPosition
+{
+    Matrix3f R;
+    Vector3f p;
+};
+
 class SensorScene : public Referenced
 {
 public:
@@ -165,6 +185,31 @@ public:
     bool isDense;
     bool flagToUpdatePreprocessedNodeTree;
 
+    // The pixels are read with pixel buffer objects when these are available
+    unique_ptr<GLPixelBufferReader> colorReader;
+    unique_ptr<GLPixelBufferReader> depthReader;
+    bool hasOneFrameLatency;
+
+    // The rays are cast against the BVHs instead of rendering the scene in the ray casting mode
+    bool isRayCastingMode;
+    vector<RayCastingTargetPosition> rayCastingTargetPositions;
+    Matrix3f R_rayCastingSensor;
+    Vector3f p_rayCastingSensor;
+    vector<Vector3f> rayDirections;
+    float minRayDistance;
+    float maxRayDistance;
+    vector<float> rayDistances;
+    vector<int> rayHitTargets;
+    vector<int> rayHitTriangles;
+    vector<Vector3f> rayOriginsInTargets;
+    vector<Matrix3f> rayRotationsToTargets;
+
+    // Timing statistics
+    int numRenderedFrames;
+    double renderingTime;
+    double readbackTime;
+    double conversionTime;
+
     std::mt19937 randomNumber;
     std::uniform_real_distribution<> detectionProbability;
     std::normal_distribution<> distanceErrorDistribution;
@@ -174,6 +219,16 @@ public:
     bool initialize(SensorScenePtr scene, int bodyIndex);
     SgCamera* initializeCamera(int bodyIndex);
     void initializeGL(SgCamera* sceneCamera);
+    void initializePixelBufferReaders();
+    void releasePixelBufferReaders();
+    void initializeRayCasting();
+    void updateRayCastingPositions();
+    void castRays();
+    void castRayPackets(int firstPacket, int lastPacket);
+    void castRay(int rayIndex);
+    void storeRayCastingResultToTmpDataBuffer();
+    bool getRangeCameraDataByRayCasting(Image& image, vector<Vector3f>& points);
+    bool getRangeSensorDataByRayCasting(vector<double>& rangeData);
     void startRenderingThread();
     void moveRenderingBufferToThread(QThread& thread);
     void moveRenderingBufferToMainThread();
@@ -182,6 +237,8 @@ public:
     void render(SensorScreenRenderer*& currentGLContextScreen);
     void finalizeRendering();
     void storeResultToTmpDataBuffer();
+    bool readColorPixels(unsigned char* pixels);
+    bool readDepthPixels(float* depths);
     bool getCameraImage(Image& image);
     bool getRangeCameraData(Image& image, vector<Vector3f>& points);
     bool getRangeSensorData(vector<double>& rangeData);
@@ -205,6 +262,7 @@ public:
     double cycleTime;
     double latency;
     double onsetTime;
+    double prevOnsetTime;
     SensorScenePtr sharedScene;
     vector<SensorScenePtr> scenes;
     vector<SensorScreenRendererPtr> screens;
@@ -213,6 +271,7 @@ public:
     bool needToClearVisionDataByTurningOff;
     std::shared_ptr<RangeSensor::RangeData> rangeData;
     FisheyeLensConverter fisheyeLensConverter;
+    bool isRayCastingMode;
 
     SensorRenderer(GLVisionSimulatorItem::Impl* simImpl, Device* sensor, SimulationBody* simBody, int bodyIndex);
     ~SensorRenderer();
@@ -227,6 +286,8 @@ public:
     bool waitForRenderingToFinish();
     void clearVisionData();
     void copyVisionData();
+    void terminateRenderingThreads();
+    void putTimingStatistics(ostream& os);
     bool waitForRenderingToFinish(std::unique_lock<std::mutex>& lock);
 };
 typedef ref_ptr<SensorRenderer> SensorRendererPtr;
@@ -276,11 +337,21 @@ public:
     double maxLatency;
     CloneMap cloneMap;
     bool isAntiAliasingEnabled;
+    bool isOcclusionCullingEnabled;
+    bool isPixelBufferReadbackEnabled;
+    bool isOneFrameLatencyReadbackEnabled;
+    bool isTimingStatisticsEnabled;
+    vector<string> rayCastingSensorNames;
+    string rayCastingSensorNameListString;
+    vector<RayCastingTarget> rayCastingTargets;
+    // Shared by all the sensors simulated by the ray casting
+    unique_ptr<ThreadPool> rayCastingThreadPool;
         
     Impl(GLVisionSimulatorItem* self);
     Impl(GLVisionSimulatorItem* self, const Impl& org);
     ~Impl();
     bool initializeSimulation(SimulatorItem* simulatorItem);
+    void initializeRayCastingTargets(const vector<SimulationBody*>& simBodies);
     void onPreDynamics();
     void queueRenderingLoop();
     void onPostDynamics();
@@ -339,6 +410,10 @@ GLVisionSimulatorItem::Impl::Impl(GLVisionSimulatorItem* self)
     threadMode.select(GLVisionSimulatorItem::SENSOR_THREAD_MODE);
 
     isAntiAliasingEnabled = false;
+    isOcclusionCullingEnabled = false;
+    isPixelBufferReadbackEnabled = true;
+    isOneFrameLatencyReadbackEnabled = false;
+    isTimingStatisticsEnabled = false;
 }
 
 
@@ -353,7 +428,8 @@ GLVisionSimulatorItem::Impl::Impl(GLVisionSimulatorItem* self, const Impl& org)
     : self(self),
       os(MessageView::instance()->cout()),
       bodyNames(org.bodyNames),
-      sensorNames(org.sensorNames)
+      sensorNames(org.sensorNames),
+      rayCastingSensorNames(org.rayCastingSensorNames)
 {
     simulatorItem = nullptr;
 
@@ -362,6 +438,7 @@ GLVisionSimulatorItem::Impl::Impl(GLVisionSimulatorItem* self, const Impl& org)
     depthError = org.depthError;
     bodyNameListString = getNameListString(bodyNames);
     sensorNameListString = getNameListString(sensorNames);
+    rayCastingSensorNameListString = getNameListString(rayCastingSensorNames);
     threadMode = org.threadMode;
     isBestEffortModeProperty = org.isBestEffortModeProperty;
     shootAllSceneObjects = org.shootAllSceneObjects;
@@ -370,6 +447,10 @@ GLVisionSimulatorItem::Impl::Impl(GLVisionSimulatorItem* self, const Impl& org)
     maxFrameRate = org.maxFrameRate;
     maxLatency = org.maxLatency;
     isAntiAliasingEnabled = org.isAntiAliasingEnabled;
+    isOcclusionCullingEnabled = org.isOcclusionCullingEnabled;
+    isPixelBufferReadbackEnabled = org.isPixelBufferReadbackEnabled;
+    isOneFrameLatencyReadbackEnabled = org.isOneFrameLatencyReadbackEnabled;
+    isTimingStatisticsEnabled = org.isTimingStatisticsEnabled;
 }
 
 
@@ -405,6 +486,13 @@ void GLVisionSimulatorItem::setTargetSensors(const std::string& names)
 }
 
 
+void GLVisionSimulatorItem::setRayCastingSensors(const std::string& names)
+{
+    updateNames(names, impl->rayCastingSensorNameListString, impl->rayCastingSensorNames);
+    notifyUpdate();
+}
+
+
 void GLVisionSimulatorItem::setMaxFrameRate(double rate)
 {
     impl->setProperty(impl->maxFrameRate, rate);
@@ -468,6 +556,30 @@ void GLVisionSimulatorItem::setAdditionalLightsEnabled(bool on)
 }
 
 
+void GLVisionSimulatorItem::setOcclusionCullingEnabled(bool on)
+{
+    impl->setProperty(impl->isOcclusionCullingEnabled, on);
+}
+
+
+void GLVisionSimulatorItem::setPixelBufferReadbackEnabled(bool on)
+{
+    impl->setProperty(impl->isPixelBufferReadbackEnabled, on);
+}
+
+
+void GLVisionSimulatorItem::setOneFrameLatencyReadbackEnabled(bool on)
+{
+    impl->setProperty(impl->isOneFrameLatencyReadbackEnabled, on);
+}
+
+
+void GLVisionSimulatorItem::setTimingStatisticsEnabled(bool on)
+{
+    impl->setProperty(impl->isTimingStatisticsEnabled, on);
+}
+
+
 bool GLVisionSimulatorItem::initializeSimulation(SimulatorItem* simulatorItem)
 {
     return impl->initializeSimulation(simulatorItem);
@@ -546,6 +658,15 @@ bool GLVisionSimulatorItem::Impl::initializeSimulation(SimulatorItem* simulatorI
         return false;
     }
 
+    rayCastingTargets.clear();
+    rayCastingThreadPool.reset();
+    for(auto& renderer : sensorRenderers){
+        if(renderer->isRayCastingMode){
+            initializeRayCastingTargets(simBodies);
+            break;
+        }
+    }
+
 #ifdef Q_OS_LINUX
     /**
        The following code is neccessary to avoid a crash when a view which has a widget such as
@@ -603,6 +724,44 @@ bool GLVisionSimulatorItem::Impl::initializeSimulation(SimulatorItem* simulatorI
 }
 
 
+void GLVisionSimulatorItem::Impl::initializeRayCastingTargets(const vector<SimulationBody*>& simBodies)
+{
+    for(auto& simBody : simBodies){
+        for(auto& link : simBody->body()->links()){
+            if(auto shape = link->visualShape()){
+                unique_ptr<MeshBVH> bvh(new MeshBVH);
+                if(bvh->build(shape) > 0){
+                    rayCastingTargets.push_back({ link, std::move(bvh) });
+                }
+            }
+        }
+    }
+
+    if(shootAllSceneObjects){
+        if(auto worldItem = self->findOwnerItem<WorldItem>()){
+            for(auto& item : worldItem->descendantItems()){
+                auto renderable = dynamic_cast<RenderableItem*>(item.get());
+                if(renderable && !dynamic_cast<BodyItem*>(item.get())){
+                    if(auto node = renderable->getScene()){
+                        if(!node->hasAttribute(SgObject::MetaScene)){
+                            unique_ptr<MeshBVH> bvh(new MeshBVH);
+                            if(bvh->build(node) > 0){
+                                rayCastingTargets.push_back({ nullptr, std::move(bvh) });
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    const int numThreads = std::thread::hardware_concurrency();
+    if(numThreads >= 2){
+        rayCastingThreadPool.reset(new ThreadPool(numThreads - 1));
+    }
+}
+
+
 SensorRenderer::SensorRenderer(GLVisionSimulatorItem::Impl* simImpl, Device* device, SimulationBody* simBody, int bodyIndex)
     : simImpl(simImpl),
       device(device),
@@ -613,7 +772,13 @@ SensorRenderer::SensorRenderer(GLVisionSimulatorItem::Impl* simImpl, Device* dev
     camera = dynamic_cast<Camera*>(device);
     rangeCamera = dynamic_cast<RangeCamera*>(camera.get());
     rangeSensor = dynamic_cast<RangeSensor*>(device);
-    
+
+    isRayCastingMode = false;
+    if((rangeCamera && rangeCamera->lensType() == Camera::NORMAL_LENS) || rangeSensor){
+        auto& names = simImpl->rayCastingSensorNames;
+        isRayCastingMode = std::find(names.begin(), names.end(), device->name()) != names.end();
+    }
+
     if(camera){
         auto lensType = camera->lensType();
 
@@ -669,6 +834,13 @@ SensorRenderer::SensorRenderer(GLVisionSimulatorItem::Impl* simImpl, Device* dev
                 screens.push_back(screen);
             }
         }
+    } else if(rangeSensor && isRayCastingMode){
+        // The whole range is covered by a single screen in the ray casting
+        auto screen = new SensorScreenRenderer(simImpl, device, new RangeSensor(*rangeSensor));
+        screen->numYawSamples = rangeSensor->numYawSamples();
+        screen->numUniqueYawSamples = screen->numYawSamples;
+        screens.push_back(screen);
+
     } else if(rangeSensor){
 
         int numScreens = 1;
@@ -716,6 +888,10 @@ SensorRenderer::SensorRenderer(GLVisionSimulatorItem::Impl* simImpl, Device* dev
             cout << "Number of screens = " << numScreens << endl;
         }
     }
+
+    for(auto& screen : screens){
+        screen->isRayCastingMode = isRayCastingMode;
+    }
 }
 
 
@@ -756,6 +932,7 @@ bool SensorRenderer::initialize(const vector<SimulationBody*>& simBodies)
     elapsedTime = 0.0;
     latency = std::min(cycleTime, simImpl->maxLatency);
     onsetTime = 0.0;
+    prevOnsetTime = 0.0;
     wasDeviceOn = false;
     isRendering = false;
     needToClearVisionDataByTurningOff = false;
@@ -778,6 +955,12 @@ SensorScenePtr SensorRenderer::createSensorScene(const vector<SimulationBody*>&
 {
     SensorScenePtr scene = new SensorScene;
     scene->root = new SgGroup;
+
+    // The scene graph is not used in the ray casting
+    if(isRayCastingMode){
+        return scene;
+    }
+
     simImpl->cloneMap.clear();
 
     for(size_t i=0; i < simBodies.size(); ++i){
@@ -824,6 +1007,8 @@ SensorScreenRenderer::SensorScreenRenderer(GLVisionSimulatorItem::Impl* simImpl,
     frameBuffer = nullptr;
     renderer = nullptr;
     screenId = FRONT_SCREEN;
+    hasOneFrameLatency = false;
+    isRayCastingMode = false;
 }
 
 
@@ -831,14 +1016,21 @@ bool SensorScreenRenderer::initialize(SensorScenePtr scene, int bodyIndex)
 {
     this->scene = scene;
 
-    auto sceneCamera = initializeCamera(bodyIndex);
-    if(!sceneCamera){
-        return false;
+    if(isRayCastingMode){
+        initializeRayCasting();
+    } else {
+        auto sceneCamera = initializeCamera(bodyIndex);
+        if(!sceneCamera){
+            return false;
+        }
+        initializeGL(sceneCamera);
     }
 
-    initializeGL(sceneCamera);
-
     hasUpdatedData = false;
+    numRenderedFrames = 0;
+    renderingTime = 0.0;
+    readbackTime = 0.0;
+    conversionTime = 0.0;
 
     return true;
 }
@@ -1014,10 +1206,62 @@ void SensorScreenRenderer::initializeGL(SgCamera* sceneCamera)
         renderer->enableAdditionalLights(simImpl->areAdditionalLightsEnabled);
     }
 
+    if(auto glslRenderer = dynamic_cast<GLSLSceneRenderer*>(renderer)){
+        glslRenderer->setOcclusionCullingEnabled(simImpl->isOcclusionCullingEnabled);
+    }
+
+    initializePixelBufferReaders();
+
     doneGLContextCurrent();
 }
 
 
+/**
+   The pixel buffer objects are only used with the GLSL renderer, which loads the OpenGL
+   functions to use them. In the one frame latency mode, the pixels of a frame are transferred
+   while the next frame is being rendered, and the data of the frame is output at that time.
+*/
+void SensorScreenRenderer::initializePixelBufferReaders()
+{
+    releasePixelBufferReaders();
+    hasOneFrameLatency = false;
+
+    if(!simImpl->isPixelBufferReadbackEnabled || !dynamic_cast<GLSLSceneRenderer*>(renderer)){
+        return;
+    }
+
+    const int numBuffers = simImpl->isOneFrameLatencyReadbackEnabled ? 2 : 1;
+    bool initialized = true;
+    if(cameraForRendering && cameraForRendering->imageType() == Camera::COLOR_IMAGE){
+        colorReader.reset(new GLPixelBufferReader(GLPixelBufferReader::RGB, numBuffers));
+        initialized = colorReader->initialize(pixelWidth, pixelHeight);
+    }
+    if(initialized && (rangeCameraForRendering || rangeSensorForRendering)){
+        depthReader.reset(new GLPixelBufferReader(GLPixelBufferReader::Depth, numBuffers));
+        initialized = depthReader->initialize(pixelWidth, pixelHeight);
+    }
+    if(!initialized){
+        // Fall back to the synchronous reading
+        releasePixelBufferReaders();
+        return;
+    }
+    hasOneFrameLatency = (colorReader || depthReader) && simImpl->isOneFrameLatencyReadbackEnabled;
+}
+
+
+void SensorScreenRenderer::releasePixelBufferReaders()
+{
+    if(colorReader){
+        colorReader->release();
+        colorReader.reset();
+    }
+    if(depthReader){
+        depthReader->release();
+        depthReader.reset();
+    }
+}
+
+
 // For SENSOR_THREAD_MODE
 void SensorRenderer::startSharedRenderingThread()
 {
@@ -1058,7 +1302,9 @@ void SensorScreenRenderer::startRenderingThread()
 
 void SensorScreenRenderer::moveRenderingBufferToThread(QThread& thread)
 {
-    glContext->moveToThread(&thread);
+    if(glContext){
+        glContext->moveToThread(&thread);
+    }
 }
 
 
@@ -1072,20 +1318,26 @@ void SensorRenderer::moveRenderingBufferToMainThread()
 
 void SensorScreenRenderer::moveRenderingBufferToMainThread()
 {
-    QThread* mainThread = QApplication::instance()->thread();
-    glContext->moveToThread(mainThread);
+    if(glContext){
+        QThread* mainThread = QApplication::instance()->thread();
+        glContext->moveToThread(mainThread);
+    }
 }
 
 
 void SensorScreenRenderer::makeGLContextCurrent()
 {
-    glContext->makeCurrent(offscreenSurface);
+    if(glContext){
+        glContext->makeCurrent(offscreenSurface);
+    }
 }
 
 
 void SensorScreenRenderer::doneGLContextCurrent()
 {
-    glContext->doneCurrent();
+    if(glContext){
+        glContext->doneCurrent();
+    }
 }
 
 
@@ -1109,6 +1361,7 @@ void GLVisionSimulatorItem::Impl::onPreDynamics()
             }
             if(renderer->elapsedTime >= renderer->cycleTime){
                 if(!renderer->isRendering){
+                    renderer->prevOnsetTime = renderer->onsetTime;
                     renderer->onsetTime = currentTime;
                     renderer->isRendering = true;
                     if(useThreadsForSensors){
@@ -1187,6 +1440,11 @@ void SensorRenderer::updateSensorScene(bool updateSensorForRenderingThread)
     if(updateSensorForRenderingThread){
         deviceForRendering->copyStateFrom(*device);
     }
+    if(isRayCastingMode){
+        for(auto& screen : screens){
+            screen->updateRayCastingPositions();
+        }
+    }
 }
     
 
@@ -1267,17 +1525,40 @@ void SensorRenderer::render(SensorScreenRenderer*& currentGLContextScreen, bool
 
 void SensorScreenRenderer::render(SensorScreenRenderer*& currentGLContextScreen)
 {
+    if(isRayCastingMode){
+        auto time0 = std::chrono::steady_clock::now();
+        castRays();
+        auto time1 = std::chrono::steady_clock::now();
+        storeRayCastingResultToTmpDataBuffer();
+        auto time2 = std::chrono::steady_clock::now();
+        ++numRenderedFrames;
+        renderingTime += std::chrono::duration<double>(time1 - time0).count();
+        conversionTime += std::chrono::duration<double>(time2 - time1).count();
+        return;
+    }
+
     if(this != currentGLContextScreen){
         makeGLContextCurrent();
         currentGLContextScreen = this;
     }
+
+    auto time0 = std::chrono::steady_clock::now();
+    
     renderer->render();
 
     if(USE_FLUSH_GL_FUNCTION){
         renderer->flushGL();
     }
+
+    auto time1 = std::chrono::steady_clock::now();
+    const double readbackTime0 = readbackTime;
     
     storeResultToTmpDataBuffer();
+
+    auto time2 = std::chrono::steady_clock::now();
+    ++numRenderedFrames;
+    renderingTime += std::chrono::duration<double>(time1 - time0).count();
+    conversionTime += std::chrono::duration<double>(time2 - time1).count() - (readbackTime - readbackTime0);
 }
 
 
@@ -1298,6 +1579,26 @@ void SensorScreenRenderer::finalizeRendering()
 
 void SensorScreenRenderer::storeResultToTmpDataBuffer()
 {
+    if(colorReader || depthReader){
+        auto time0 = std::chrono::steady_clock::now();
+        if(colorReader){
+            colorReader->startReading();
+        }
+        if(depthReader){
+            depthReader->startReading();
+        }
+        readbackTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - time0).count();
+
+        // No data is output at the first frame in the one frame latency mode
+        if(hasOneFrameLatency){
+            auto reader = colorReader ? colorReader.get() : depthReader.get();
+            if(reader->numPendingReadings() < 2){
+                hasUpdatedData = false;
+                return;
+            }
+        }
+    }
+    
     if(cameraForRendering){
         if(!tmpImage){
             tmpImage = std::make_shared<Image>();
@@ -1459,7 +1760,13 @@ void SensorRenderer::copyVisionData()
     }
 
     if(hasUpdatedData){
-        double delay = simImpl->currentTime - onsetTime;
+        double delay;
+        if(screens[0]->hasOneFrameLatency){
+            // The output data was rendered at the previous onset
+            delay = simImpl->currentTime - prevOnsetTime;
+        } else {
+            delay = simImpl->currentTime - onsetTime;
+        }
         if(camera){
             auto lensType = camera->lensType();
             if(lensType == Camera::NORMAL_LENS){
@@ -1523,14 +1830,44 @@ void SensorRenderer::copyVisionData()
 }
 
 
+bool SensorScreenRenderer::readColorPixels(unsigned char* pixels)
+{
+    auto time0 = std::chrono::steady_clock::now();
+    bool result = true;
+    if(colorReader){
+        result = colorReader->fetch(pixels);
+    } else {
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, pixelWidth, pixelHeight, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+    }
+    readbackTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - time0).count();
+    return result;
+}
+
+
+bool SensorScreenRenderer::readDepthPixels(float* depths)
+{
+    auto time0 = std::chrono::steady_clock::now();
+    bool result = true;
+    if(depthReader){
+        result = depthReader->fetch(depths);
+    } else {
+        glReadPixels(0, 0, pixelWidth, pixelHeight, GL_DEPTH_COMPONENT, GL_FLOAT, depths);
+    }
+    readbackTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - time0).count();
+    return result;
+}
+
+
 bool SensorScreenRenderer::getCameraImage(Image& image)
 {
     if(cameraForRendering->imageType() != Camera::COLOR_IMAGE){
         return false;
     }
     image.setSize(pixelWidth, pixelHeight, 3);
-    glPixelStorei(GL_PACK_ALIGNMENT, 1);
-    glReadPixels(0, 0, pixelWidth, pixelHeight, GL_RGB, GL_UNSIGNED_BYTE, image.pixels());
+    if(!readColorPixels(image.pixels())){
+        return false;
+    }
     image.applyVerticalFlip();
     return true;
 }
@@ -1542,9 +1879,10 @@ bool SensorScreenRenderer::getRangeCameraData(Image& image, vector<Vector3f>& po
 
     const bool extractColors = (cameraForRendering->imageType() == Camera::COLOR_IMAGE);
     if(extractColors){
-        glPixelStorei(GL_PACK_ALIGNMENT, 1);
         colorBuf.resize(pixelWidth * pixelHeight * 3 * sizeof(unsigned char));
-        glReadPixels(0, 0, pixelWidth, pixelHeight, GL_RGB, GL_UNSIGNED_BYTE, &colorBuf[0]);
+        if(!readColorPixels(&colorBuf[0])){
+            return false;
+        }
         if(rangeCameraForRendering->isOrganized()){
             image.setSize(pixelWidth, pixelHeight, 3);
         } else {
@@ -1554,7 +1892,9 @@ bool SensorScreenRenderer::getRangeCameraData(Image& image, vector<Vector3f>& po
     }
 
     depthBuf.resize(pixelWidth * pixelHeight * sizeof(float));
-    glReadPixels(0, 0, pixelWidth, pixelHeight, GL_DEPTH_COMPONENT, GL_FLOAT, &depthBuf[0]);
+    if(!readDepthPixels(&depthBuf[0])){
+        return false;
+    }
 
     const Matrix4f Pinv = renderer->projectionMatrix().inverse().cast<float>();
     const float fw = pixelWidth;
@@ -1685,7 +2025,9 @@ bool SensorScreenRenderer::getRangeSensorData(vector<double>& rangeData)
     const double errorDeviation = rangeSensorForRendering->errorDeviation();
 
     depthBuf.resize(pixelWidth * pixelHeight * sizeof(float));
-    glReadPixels(0, 0, pixelWidth, pixelHeight, GL_DEPTH_COMPONENT, GL_FLOAT, &depthBuf[0]);
+    if(!readDepthPixels(&depthBuf[0])){
+        return false;
+    }
 
     rangeData.reserve(numUniqueYawSamples * numPitchSamples);
 
@@ -1784,6 +2126,365 @@ void SensorScreenRenderer::putRangeSensorDataAsDebugMessages
 }
 
 
+void SensorScreenRenderer::initializeRayCasting()
+{
+    rayDirections.clear();
+
+    if(rangeCameraForRendering){
+        // The directions are given so that the distances are the depths in the camera coordinate
+        pixelWidth = rangeCameraForRendering->resolutionX();
+        pixelHeight = rangeCameraForRendering->resolutionY();
+        const double aspectRatio = static_cast<double>(pixelWidth) / pixelHeight;
+        const double fovy = SgPerspectiveCamera::fovy(aspectRatio, rangeCameraForRendering->fieldOfView());
+        const float tanY = tan(fovy / 2.0);
+        const float tanX = tanY * aspectRatio;
+        const float fw = pixelWidth;
+        const float fh = pixelHeight;
+        rayDirections.reserve(pixelWidth * pixelHeight);
+        for(int y = pixelHeight - 1; y >= 0; --y){
+            const float ny = 2.0f * y / fh - 1.0f;
+            for(int x=0; x < pixelWidth; ++x){
+                const float nx = 2.0f * x / fw - 1.0f;
+                rayDirections.emplace_back(nx * tanX, ny * tanY, -1.0f);
+            }
+        }
+        minRayDistance = rangeCameraForRendering->nearClipDistance();
+        maxRayDistance = rangeCameraForRendering->farClipDistance();
+        if(rangeCameraForRendering->errorDeviation() > 0.0){
+            distanceErrorDistribution.param(
+                std::normal_distribution<>::param_type(0.0, rangeCameraForRendering->errorDeviation()));
+        }
+
+    } else if(rangeSensorForRendering){
+        const double yawRange = rangeSensorForRendering->yawRange();
+        const double yawStep = rangeSensorForRendering->yawStep();
+        const double pitchRange = rangeSensorForRendering->pitchRange();
+        const int numPitchSamples = rangeSensorForRendering->numPitchSamples();
+        const double pitchStep = rangeSensorForRendering->pitchStep();
+        rayDirections.reserve(numUniqueYawSamples * numPitchSamples);
+        for(int pitch=0; pitch < numPitchSamples; ++pitch){
+            const double pitchAngle = pitch * pitchStep - pitchRange / 2.0;
+            const double cosPitchAngle = cos(pitchAngle);
+            for(int yaw=0; yaw < numUniqueYawSamples; ++yaw){
+                const double yawAngle = yaw * yawStep - yawRange / 2.0;
+                rayDirections.emplace_back(
+                    -sin(yawAngle) * cosPitchAngle, sin(pitchAngle), -cos(yawAngle) * cosPitchAngle);
+            }
+        }
+        minRayDistance = rangeSensorForRendering->minDistance();
+        maxRayDistance = rangeSensorForRendering->maxDistance();
+        if(rangeSensorForRendering->errorDeviation() > 0.0){
+            distanceErrorDistribution.param(
+                std::normal_distribution<>::param_type(0.0, rangeSensorForRendering->errorDeviation()));
+        }
+        depthError = simImpl->depthError;
+    }
+
+    const int numRays = rayDirections.size();
+    rayDistances.resize(numRays);
+    rayHitTargets.resize(numRays);
+    rayHitTriangles.resize(numRays);
+    rayCastingTargetPositions.resize(simImpl->rayCastingTargets.size());
+    rayOriginsInTargets.resize(simImpl->rayCastingTargets.size());
+    rayRotationsToTargets.resize(simImpl->rayCastingTargets.size());
+
+    randomNumber.seed(0);
+    detectionProbability.reset();
+    distanceErrorDistribution.reset();
+}
+
+
+/**
+   This function is called in the simulation thread when the rendering of the sensor is started,
+   and the positions are used in the rendering thread.
+*/
+void SensorScreenRenderer::updateRayCastingPositions()
+{
+    auto& targets = simImpl->rayCastingTargets;
+    for(size_t i=0; i < targets.size(); ++i){
+        auto& position = rayCastingTargetPositions[i];
+        if(auto link = targets[i].link){
+            position.R = link->R().cast<float>();
+            position.p = link->p().cast<float>();
+        } else {
+            position.R.setIdentity();
+            position.p.setZero();
+        }
+    }
+
+    VisionSensor* sensor = rangeSensor ? static_cast<VisionSensor*>(rangeSensor) : static_cast<VisionSensor*>(camera);
+    auto sensorLink = sensor->link();
+    R_rayCastingSensor = (sensorLink->R() * sensor->R_local() * sensor->opticalFrameRotation()).cast<float>();
+    p_rayCastingSensor = (sensorLink->T() * sensor->p_local()).cast<float>();
+}
+
+
+/**
+   The rays are divided into the packets of four rays, and the packets are cast in parallel.
+   Adjacent rays are put into a packet so that the rays in a packet traverse similar nodes.
+   The remaining rays that do not fill a packet are cast one by one.
+*/
+void SensorScreenRenderer::castRays()
+{
+    // The ray origin and the rotation from the sensor coordinate to each target coordinate
+    const int numTargets = rayCastingTargetPositions.size();
+    for(int i=0; i < numTargets; ++i){
+        auto& position = rayCastingTargetPositions[i];
+        rayOriginsInTargets[i] = position.R.transpose() * (p_rayCastingSensor - position.p);
+        rayRotationsToTargets[i] = position.R.transpose() * R_rayCastingSensor;
+    }
+
+    const int numRays = rayDirections.size();
+    const int numPackets = numRays / 4;
+    const int MinNumPacketsPerThread = 64;
+    auto threadPool = simImpl->rayCastingThreadPool.get();
+    int numRanges = 1;
+    if(threadPool){
+        numRanges = std::max(1, std::min(threadPool->size() + 1, numPackets / MinNumPacketsPerThread));
+    }
+
+    // The pool is shared with the other sensors, so only the tasks of this sensor are waited for
+    std::mutex mutex;
+    std::condition_variable condition;
+    int numPendingRanges = numRanges - 1;
+
+    for(int i=1; i < numRanges; ++i){
+        const int first = numPackets * i / numRanges;
+        const int last = numPackets * (i + 1) / numRanges;
+        threadPool->start(
+            [this, first, last, &mutex, &condition, &numPendingRanges](){
+                castRayPackets(first, last);
+                std::lock_guard<std::mutex> lock(mutex);
+                if(--numPendingRanges == 0){
+                    condition.notify_one();
+                }
+            });
+    }
+    castRayPackets(0, numPackets / numRanges);
+    for(int i = numPackets * 4; i < numRays; ++i){
+        castRay(i);
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [&numPendingRanges](){ return numPendingRanges == 0; });
+}
+
+
+void SensorScreenRenderer::castRayPackets(int firstPacket, int lastPacket)
+{
+    auto& targets = simImpl->rayCastingTargets;
+    const int numTargets = targets.size();
+    auto& origins = rayOriginsInTargets;
+    auto& rotations = rayRotationsToTargets;
+
+    Eigen::Array4f dx, dy, dz;
+
+    for(int packet = firstPacket; packet < lastPacket; ++packet){
+        const int firstRay = packet * 4;
+        for(int i=0; i < 4; ++i){
+            const auto& d = rayDirections[firstRay + i];
+            dx[i] = d.x();
+            dy[i] = d.y();
+            dz[i] = d.z();
+        }
+        Eigen::Array4f distances = Eigen::Array4f::Constant(maxRayDistance);
+        Eigen::Array4i hitTargets = Eigen::Array4i::Constant(-1);
+        Eigen::Array4i hitTriangles = Eigen::Array4i::Constant(-1);
+
+        for(int i=0; i < numTargets; ++i){
+            // The distances are not changed by the transformation because it is rigid
+            const Matrix3f& R = rotations[i];
+            const Eigen::Array4f lx = R(0, 0) * dx + R(0, 1) * dy + R(0, 2) * dz;
+            const Eigen::Array4f ly = R(1, 0) * dx + R(1, 1) * dy + R(1, 2) * dz;
+            const Eigen::Array4f lz = R(2, 0) * dx + R(2, 1) * dy + R(2, 2) * dz;
+            Eigen::Array4i triangles = Eigen::Array4i::Constant(-1);
+            if(targets[i].bvh->castRays(origins[i], lx, ly, lz, minRayDistance, distances, triangles)){
+                const Eigen::Array<bool, 4, 1> hit = (triangles >= 0);
+                hitTargets = hit.select(Eigen::Array4i::Constant(i), hitTargets);
+                hitTriangles = hit.select(triangles, hitTriangles);
+            }
+        }
+
+        for(int i=0; i < 4; ++i){
+            rayDistances[firstRay + i] = distances[i];
+            rayHitTargets[firstRay + i] = hitTargets[i];
+            rayHitTriangles[firstRay + i] = hitTriangles[i];
+        }
+    }
+}
+
+
+void SensorScreenRenderer::castRay(int rayIndex)
+{
+    auto& targets = simImpl->rayCastingTargets;
+    const int numTargets = targets.size();
+    float distance = maxRayDistance;
+    int hitTarget = -1;
+    int hitTriangle = -1;
+
+    for(int i=0; i < numTargets; ++i){
+        const Vector3f direction = rayRotationsToTargets[i] * rayDirections[rayIndex];
+        int triangle = -1;
+        if(targets[i].bvh->castRay(rayOriginsInTargets[i], direction, minRayDistance, distance, triangle)){
+            hitTarget = i;
+            hitTriangle = triangle;
+        }
+    }
+
+    rayDistances[rayIndex] = distance;
+    rayHitTargets[rayIndex] = hitTarget;
+    rayHitTriangles[rayIndex] = hitTriangle;
+}
+
+
+void SensorScreenRenderer::storeRayCastingResultToTmpDataBuffer()
+{
+    if(rangeCameraForRendering){
+        if(!tmpImage){
+            tmpImage = std::make_shared<Image>();
+        }
+        tmpPoints = std::make_shared<vector<Vector3f>>();
+        hasUpdatedData = getRangeCameraDataByRayCasting(*tmpImage, *tmpPoints);
+    } else if(rangeSensorForRendering){
+        tmpRangeData = std::make_shared<vector<double>>();
+        hasUpdatedData = getRangeSensorDataByRayCasting(*tmpRangeData);
+    }
+}
+
+
+/**
+   The outputs are the same as the ones of getRangeCameraData except that the colors are
+   the diffuse colors of the materials without lighting.
+*/
+bool SensorScreenRenderer::getRangeCameraDataByRayCasting(Image& image, vector<Vector3f>& points)
+{
+    // The default background color of GLSceneRenderer
+    static const Vector3f backgroundColor(0.1f, 0.1f, 0.3f);
+
+    unsigned char* pixels = nullptr;
+    const bool isOrganized = rangeCameraForRendering->isOrganized();
+    if(cameraForRendering->imageType() == Camera::COLOR_IMAGE){
+        if(isOrganized){
+            image.setSize(pixelWidth, pixelHeight, 3);
+        } else {
+            image.setSize(pixelWidth * pixelHeight, 1, 3);
+        }
+        pixels = image.pixels();
+    }
+
+    const int cx = pixelWidth / 2;
+    const int cy = pixelHeight / 2;
+    Matrix3f Ro;
+    bool hasRo = !rangeCameraForRendering->opticalFrameRotation().isIdentity();
+    if(hasRo){
+        Ro = rangeCameraForRendering->opticalFrameRotation().cast<float>();
+    }
+    points.clear();
+    points.reserve(pixelWidth * pixelHeight);
+
+    const double detectionRate = rangeCameraForRendering->detectionRate();
+    const double errorDeviation = rangeCameraForRendering->errorDeviation();
+    auto& targets = simImpl->rayCastingTargets;
+
+    isDense = true;
+    int index = 0;
+
+    for(int y = pixelHeight - 1; y >= 0; --y){
+        for(int x=0; x < pixelWidth; ++x, ++index){
+            int target = rayHitTargets[index];
+
+            if(detectionRate < 1.0){
+                if(detectionProbability(randomNumber) > detectionRate){
+                    if(!isOrganized){
+                        continue;
+                    } else {
+                        target = -1;
+                    }
+                }
+            }
+
+            Vector3f p;
+            const Vector3f* color;
+            if(target >= 0){
+                p = rayDirections[index] * rayDistances[index];
+                if(errorDeviation > 0.0){
+                    double d = p.norm();
+                    double r = (d + distanceErrorDistribution(randomNumber)) / d;
+                    p *= r;
+                }
+                color = &targets[target].bvh->triangleColor(rayHitTriangles[index]);
+            } else if(isOrganized){
+                p.z() = -numeric_limits<float>::infinity();
+                if(x == cx){
+                    p.x() = 0.0;
+                } else {
+                    p.x() = (x - cx) * numeric_limits<float>::infinity();
+                }
+                if(y == cy){
+                    p.y() = 0.0;
+                } else {
+                    p.y() = (y - cy) * numeric_limits<float>::infinity();
+                }
+                color = &backgroundColor;
+                isDense = false;
+            } else {
+                continue;
+            }
+
+            if(hasRo){
+                points.push_back(Ro * p);
+            } else {
+                points.push_back(p);
+            }
+            if(pixels){
+                for(int i=0; i < 3; ++i){
+                    pixels[i] = static_cast<unsigned char>(std::min(std::max((*color)[i], 0.0f), 1.0f) * 255.0f);
+                }
+                pixels += 3;
+            }
+        }
+    }
+
+    if(pixels && !isOrganized){
+        image.setSize((pixels - image.pixels()) / 3, 1, 3);
+    }
+
+    return true;
+}
+
+
+bool SensorScreenRenderer::getRangeSensorDataByRayCasting(vector<double>& rangeData)
+{
+    const double detectionRate = rangeSensorForRendering->detectionRate();
+    const double errorDeviation = rangeSensorForRendering->errorDeviation();
+    const int numRays = rayDistances.size();
+
+    rangeData.reserve(numRays);
+
+    for(int i=0; i < numRays; ++i){
+        if(detectionRate < 1.0){
+            if(detectionProbability(randomNumber) > detectionRate){
+                rangeData.push_back(std::numeric_limits<double>::infinity());
+                continue;
+            }
+        }
+        if(rayHitTargets[i] < 0){
+            rangeData.push_back(std::numeric_limits<double>::infinity());
+        } else {
+            // The depth error is added along the ray. This is the same as getRangeSensorData
+            // for the ray on the optical axis of a screen.
+            double distance = fabs(rayDistances[i] - depthError);
+            if(errorDeviation > 0.0){
+                distance += distanceErrorDistribution(randomNumber);
+            }
+            rangeData.push_back(distance);
+        }
+    }
+
+    return true;
+}
+
+
 void GLVisionSimulatorItem::finalizeSimulation()
 {
     impl->finalizeSimulation();
@@ -1803,19 +2504,58 @@ void GLVisionSimulatorItem::Impl::finalizeSimulation()
             sensorQueue.pop();
         }
     }
+
+    if(isTimingStatisticsEnabled){
+        for(auto& renderer : sensorRenderers){
+            renderer->terminateRenderingThreads();
+            renderer->putTimingStatistics(os);
+        }
+        os.flush();
+    }
         
     sensorRenderers.clear();
+    rayCastingTargets.clear();
+    rayCastingThreadPool.reset();
 }
 
 
 SensorRenderer::~SensorRenderer()
+{
+    terminateRenderingThreads();
+    screens.clear();
+}
+
+
+void SensorRenderer::terminateRenderingThreads()
 {
     if(simImpl->useThreadsForSensors){
         for(auto& scene : scenes){
             scene->terminate();
         }
     }
-    screens.clear();
+}
+
+
+void SensorRenderer::putTimingStatistics(ostream& os)
+{
+    int numFrames = 0;
+    double renderingTime = 0.0;
+    double readbackTime = 0.0;
+    double conversionTime = 0.0;
+    for(auto& screen : screens){
+        numFrames = std::max(numFrames, screen->numRenderedFrames);
+        renderingTime += screen->renderingTime;
+        readbackTime += screen->readbackTime;
+        conversionTime += screen->conversionTime;
+    }
+    if(numFrames > 0){
+        os << format(_("{0}: {1} frames, rendering {2:.3f} ms, readback {3:.3f} ms, "
+                       "conversion {4:.3f} ms per frame.\n"),
+                     device->name(), numFrames,
+                     renderingTime * 1000.0 / numFrames,
+                     readbackTime * 1000.0 / numFrames,
+                     conversionTime * 1000.0 / numFrames);
+    }
 }
 
 
@@ -1834,6 +2574,7 @@ SensorScreenRenderer::~SensorScreenRenderer()
 {
     if(glContext){
         makeGLContextCurrent();
+        releasePixelBufferReaders();
         frameBuffer->release();
         delete frameBuffer;
         delete glContext;
@@ -1858,6 +2599,9 @@ void GLVisionSimulatorItem::Impl::doPutProperties(PutPropertyFunction& putProper
                 [&](const string& names){ return updateNames(names, bodyNameListString, bodyNames); });
     putProperty(_("Target sensors"), sensorNameListString,
                 [&](const string& names){ return updateNames(names, sensorNameListString, sensorNames); });
+    putProperty(_("Ray casting sensors"), rayCastingSensorNameListString,
+                [&](const string& names){
+                    return updateNames(names, rayCastingSensorNameListString, rayCastingSensorNames); });
     putProperty(_("Max frame rate"), maxFrameRate, changeProperty(maxFrameRate));
     putProperty(_("Max latency [s]"), maxLatency, changeProperty(maxLatency));
     putProperty(_("Record vision data"), isVisionDataRecordingEnabled, changeProperty(isVisionDataRecordingEnabled));
@@ -1871,6 +2615,11 @@ void GLVisionSimulatorItem::Impl::doPutProperties(PutPropertyFunction& putProper
     putProperty(_("Head light"), isHeadLightEnabled, changeProperty(isHeadLightEnabled));
     putProperty(_("Additional lights"), areAdditionalLightsEnabled, changeProperty(areAdditionalLightsEnabled));
     putProperty(_("Anti-aliasing"), isAntiAliasingEnabled, changeProperty(isAntiAliasingEnabled));
+    putProperty(_("Occlusion culling"), isOcclusionCullingEnabled, changeProperty(isOcclusionCullingEnabled));
+    putProperty(_("Pixel buffer readback"), isPixelBufferReadbackEnabled, changeProperty(isPixelBufferReadbackEnabled));
+    putProperty(_("One frame latency readback"), isOneFrameLatencyReadbackEnabled,
+                changeProperty(isOneFrameLatencyReadbackEnabled));
+    putProperty(_("Timing statistics"), isTimingStatisticsEnabled, changeProperty(isTimingStatisticsEnabled));
 }
 
 
@@ -1885,6 +2634,7 @@ bool GLVisionSimulatorItem::Impl::store(Archive& archive)
 {
     writeElements(archive, "target_bodies", bodyNames, true);
     writeElements(archive, "target_sensors", sensorNames, true);
+    writeElements(archive, "ray_casting_sensors", rayCastingSensorNames, true);
     archive.write("max_frame_rate", maxFrameRate);
     archive.write("max_latency", maxLatency);
     archive.write("record_vision_data", isVisionDataRecordingEnabled);
@@ -1896,6 +2646,10 @@ bool GLVisionSimulatorItem::Impl::store(Archive& archive)
     archive.write("enable_head_light", isHeadLightEnabled);    
     archive.write("enable_additional_lights", areAdditionalLightsEnabled);
     archive.write("antialiasing", isAntiAliasingEnabled);
+    archive.write("occlusion_culling", isOcclusionCullingEnabled);
+    archive.write("pixel_buffer_readback", isPixelBufferReadbackEnabled);
+    archive.write("one_frame_latency_readback", isOneFrameLatencyReadbackEnabled);
+    archive.write("timing_statistics", isTimingStatisticsEnabled);
     return true;
 }
 
@@ -1913,6 +2667,8 @@ bool GLVisionSimulatorItem::Impl::restore(const Archive& archive)
     bodyNameListString = getNameListString(bodyNames);
     readElements(archive, { "target_sensors", "targetSensors" }, sensorNames);
     sensorNameListString = getNameListString(sensorNames);
+    readElements(archive, "ray_casting_sensors", rayCastingSensorNames);
+    rayCastingSensorNameListString = getNameListString(rayCastingSensorNames);
 
     archive.read({ "max_frame_rate", "maxFrameRate" }, maxFrameRate);
     archive.read({ "max_latency", "maxLatency" }, maxLatency);
@@ -1924,6 +2680,10 @@ bool GLVisionSimulatorItem::Impl::restore(const Archive& archive)
     archive.read({ "enable_head_light", "enableHeadLight" }, isHeadLightEnabled);
     archive.read({ "enable_additional_lights", "enableAdditionalLights" }, areAdditionalLightsEnabled);
     archive.read({ "antialiasing", "antiAliasing" }, isAntiAliasingEnabled);
+    archive.read("occlusion_culling", isOcclusionCullingEnabled);
+    archive.read("pixel_buffer_readback", isPixelBufferReadbackEnabled);
+    archive.read("one_frame_latency_readback", isOneFrameLatencyReadbackEnabled);
+    archive.read("timing_statistics", isTimingStatisticsEnabled);
 
     string symbol;
     if(archive.read({ "thread_mode", "threadMode" }, symbol)){
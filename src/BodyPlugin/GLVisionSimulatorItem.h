@@ -19,6 +19,12 @@ public:
 
     void setTargetBodies(const std::string& bodyNames);
     void setTargetSensors(const std::string& sensorNames);
+
+    /**
+       The range sensors and the range cameras specified by this function are simulated by
+       casting rays against the BVHs of the scene meshes instead of rendering the scene.
+    */
+    void setRayCastingSensors(const std::string& sensorNames);
     void setMaxFrameRate(double rate);
     void setMaxLatency(double latency);
     void setVisionDataRecordingEnabled(bool on);
@@ -28,6 +34,10 @@ public:
     void setAllSceneObjectsEnabled(bool on);
     void setHeadLightEnabled(bool on);
     void setAdditionalLightsEnabled(bool on);
+    void setOcclusionCullingEnabled(bool on);
+    void setPixelBufferReadbackEnabled(bool on);
+    void setOneFrameLatencyReadbackEnabled(bool on);
+    void setTimingStatisticsEnabled(bool on);
 
     virtual bool initializeSimulation(SimulatorItem* simulatorItem) override;
     virtual void finalizeSimulation() override;
@@ -4,7 +4,7 @@
 #include "WorldItem.h"
 #include "BodySelectionManager.h"
 #include <cnoid/RootItem>
-#include <cnoid/BodyState>
+#include <cnoid/KinematicFaultDetector>
 #include <cnoid/Archive>
 #include <cnoid/MainWindow>
 #include <cnoid/ExtensionManager>
@@ -17,16 +17,13 @@
 #include <cnoid/Dialog>
 #include <cnoid/Separator>
 #include <cnoid/EigenUtil>
-#include <cnoid/BodyCollisionDetector>
-#include <cnoid/AISTCollisionDetector>
-#include <cnoid/IdPair>
 #include <QButtonGroup>
 #include <QDialogButtonBox>
 #include <QBoxLayout>
 #include <QFrame>
 #include <QLabel>
 #include <fmt/format.h>
-#include <map>
+#include <thread>
 #include "gettext.h"
 
 using namespace std;
@@ -35,16 +32,8 @@ using fmt::format;
 
 namespace {
 
-bool USE_DUPLICATED_BODY = false;
-
 KinematicFaultChecker* checkerInstance = nullptr;
 
-#if defined(_MSC_VER) && _MSC_VER < 1800
-inline long lround(double x) {
-    return static_cast<long>((x > 0.0) ? floor(x + 0.5) : ceil(x -0.5));
-}
-#endif
-
 }
 
 namespace cnoid {
@@ -70,17 +59,10 @@ public:
 
     CheckBox onlyTimeBarRangeCheck;
 
-    int numFaults;
-    vector<int> lastPosFaultFrames;
-    vector<int> lastVelFaultFrames;
-    typedef IdPair<CollisionDetector::GeometryHandle> GeometryPair;
-    typedef std::map<GeometryPair, int> LastCollisionFrameMap;
-    LastCollisionFrameMap lastCollisionFrames;
-
+    KinematicFaultDetector detector;
     double frameRate;
     double angleMargin;
     double translationMargin;
-    double velocityLimitRatio;
 
     Impl();
     bool store(Archive& archive);
@@ -90,9 +72,9 @@ public:
         BodyItem* bodyItem, BodyMotionItem* motionItem,
         bool checkPosition, bool checkVelocity, bool checkCollision,
         vector<bool> linkSelection, double beginningTime, double endingTime);
-    void putJointPositionFault(int frame, Link* joint);
-    void putJointVelocityFault(int frame, Link* joint);
-    void putSelfCollision(Body* body, int frame, const CollisionPair& collisionPair);
+    void putJointPositionFault(int frame, Link* joint, double q);
+    void putJointVelocityFault(int frame, Link* joint, double dq);
+    void putSelfCollision(int frame, Link* link1, Link* link2);
 };
 
 }
@@ -138,6 +120,8 @@ KinematicFaultChecker::Impl::Impl()
       os(mv->cout())
 {
     setWindowTitle(_("Kinematic Fault Checker"));
+
+    detector.setNumThreads(std::thread::hardware_concurrency());
     
     auto vbox = new QVBoxLayout;
     setLayout(vbox);
@@ -342,212 +326,94 @@ int KinematicFaultChecker::Impl::checkFaults
  bool checkPosition, bool checkVelocity, bool checkCollision, vector<bool> linkSelection,
  double beginningTime, double endingTime)
 {
-    numFaults = 0;
-
     auto body = bodyItem->body();
     auto motion = motionItem->motion();
-    motion->updateLinkPosSeqAndJointPosSeqWithBodyPositionSeq();
-    auto qseq = motion->jointPosSeq();;
-    auto pseq = motion->linkPosSeq();
-    
-    if((!checkPosition && !checkVelocity && !checkCollision) || body->isStaticModel() || !qseq->getNumFrames()){
-        return numFaults;
-    }
-
-    BodyState orgKinematicState;
-    
-    if(USE_DUPLICATED_BODY){
-        body = body->clone();
-    } else {
-        bodyItem->storeKinematicState(orgKinematicState);
-    }
-
-    BodyCollisionDetector bodyCollisionDetector;
-    WorldItem* worldItem = bodyItem->findOwnerItem<WorldItem>();
-    if(worldItem){
-        bodyCollisionDetector.setCollisionDetector(worldItem->collisionDetector()->clone());
-    } else {
-        bodyCollisionDetector.setCollisionDetector(new AISTCollisionDetector);
-    }
-
-    bodyCollisionDetector.addBody(body, true);
-    bodyCollisionDetector.makeReady();
-
-    const int numJoints = std::min(body->numJoints(), qseq->numParts());
-    const int numLinks = std::min(body->numLinks(), pseq->numParts());
 
     frameRate = motion->frameRate();
-    double stepRatio2 = 2.0 / frameRate;
     angleMargin = radian(angleMarginSpin.value());
     translationMargin = translationMarginSpin.value();
-    velocityLimitRatio = velocityLimitRatioSpin.value() / 100.0;
-
-    int beginningFrame = std::max(0, (int)(beginningTime * frameRate));
-    int endingFrame = std::min((motion->numFrames() - 1), (int)lround(endingTime * frameRate));
 
-    lastPosFaultFrames.clear();
-    lastPosFaultFrames.resize(numJoints, std::numeric_limits<int>::min());
-    lastVelFaultFrames.clear();
-    lastVelFaultFrames.resize(numJoints, std::numeric_limits<int>::min());
-    lastCollisionFrames.clear();
-
-    if(checkCollision){
-        Link* root = body->rootLink();
-        root->p().setZero();
-        root->R().setIdentity();
+    detector.setJointPositionCheckEnabled(checkPosition);
+    detector.setAngleMargin(angleMargin);
+    detector.setTranslationMargin(translationMargin);
+    detector.setJointVelocityCheckEnabled(checkVelocity);
+    detector.setVelocityLimitRatio(velocityLimitRatioSpin.value() / 100.0);
+    detector.setSelfCollisionCheckEnabled(checkCollision);
+    if(auto worldItem = bodyItem->findOwnerItem<WorldItem>()){
+        detector.setCollisionDetector(worldItem->collisionDetector());
+    } else {
+        detector.setCollisionDetector(nullptr);
     }
-        
-    for(int frame = beginningFrame; frame <= endingFrame; ++frame){
-
-        int prevFrame = (frame == beginningFrame) ? beginningFrame : frame - 1;
-        int nextFrame = (frame == endingFrame) ? endingFrame : frame + 1;
-
-        for(int i=0; i < numJoints; ++i){
-            Link* joint = body->joint(i);
-            double q = qseq->at(frame, i);
-            joint->q() = q;
-            if(joint->index() >= 0 && linkSelection[joint->index()]){
-                if(checkPosition){
-                    bool fault = false;
-                    if(joint->isRevoluteJoint()){
-                        fault = (q > (joint->q_upper() - angleMargin) || q < (joint->q_lower() + angleMargin));
-                    } else if(joint->isPrismaticJoint()){
-                        fault = (q > (joint->q_upper() - translationMargin) || q < (joint->q_lower() + translationMargin));
-                    }
-                    if(fault){
-                        putJointPositionFault(frame, joint);
-                    }
-                }
-                if(checkVelocity){
-                    double dq = (qseq->at(nextFrame, i) - qseq->at(prevFrame, i)) / stepRatio2;
-                    joint->dq() = dq;
-                    if(dq > (joint->dq_upper() * velocityLimitRatio) || dq < (joint->dq_lower() * velocityLimitRatio)){
-                        putJointVelocityFault(frame, joint);
-                    }
-                }
-            }
-        }
-
-        if(checkCollision){
-
-            Link* link = body->link(0);
-            if(!pseq->empty())
-            {
-                const SE3& p = pseq->at(frame, 0);
-                link->p() = p.translation();
-                link->R() = p.rotation().toRotationMatrix();
-            }
-            else
-            {
-                link->p() = Vector3d(0., 0., 0.);
-                link->R() = Matrix3d::Identity();
-            }
-
-            body->calcForwardKinematics();
-
-            for(int i=1; i < numLinks; ++i){
-                link = body->link(i);
-                if(!pseq->empty())
-                {
-                    const SE3& p = pseq->at(frame, i);
-                    link->p() = p.translation();
-                    link->R() = p.rotation().toRotationMatrix();
-                }
-            }
-
-            bodyCollisionDetector.updatePositions();
-
-            bodyCollisionDetector.detectCollisions(
-                [&](const CollisionPair& collisionPair){
-                    putSelfCollision(body, frame, collisionPair);
-                });
+    detector.setLinkSelection(linkSelection);
+    detector.setTimeRange(beginningTime, endingTime);
+
+    int numFaults = detector.checkFaults(body, *motion);
+
+    for(auto& fault : detector.faults()){
+        switch(fault.type){
+        case KinematicFaultDetector::JointPositionFault:
+            putJointPositionFault(fault.beginningFrame, body->joint(fault.jointId), fault.value);
+            break;
+        case KinematicFaultDetector::JointVelocityFault:
+            putJointVelocityFault(fault.beginningFrame, body->joint(fault.jointId), fault.value);
+            break;
+        case KinematicFaultDetector::SelfCollisionFault:
+            putSelfCollision(
+                fault.beginningFrame, body->link(fault.linkIndex1), body->link(fault.linkIndex2));
+            break;
         }
     }
 
-    if(!USE_DUPLICATED_BODY){
-        bodyItem->restoreKinematicState(orgKinematicState);
-    }
-
     return numFaults;
 }
 
 
-void KinematicFaultChecker::Impl::putJointPositionFault(int frame, Link* joint)
+void KinematicFaultChecker::Impl::putJointPositionFault(int frame, Link* joint, double q)
 {
-    if(frame > lastPosFaultFrames[joint->jointId()] + 1){
-        double q, l, u, m;
-        if(joint->isRevoluteJoint()){
-            q = degree(joint->q());
-            l = degree(joint->q_lower());
-            u = degree(joint->q_upper());
-            m = degree(angleMargin);
-        } else {
-            q = joint->q();
-            l = joint->q_lower();
-            u = joint->q_upper();
-            m = translationMargin;
-        }
-
-        if(m != 0.0){
-            os << format(_("{0:7.3f} [s]: Position limit over of {1} ({2} is beyond the range ({3} , {4}) with margin {5}.)"),
-                         (frame / frameRate), joint->name(), q, l, u, m) << endl;
-        } else {
-            os << format(_("{0:7.3f} [s]: Position limit over of {1} ({2} is beyond the range ({3} , {4}).)"),
-                         (frame / frameRate), joint->name(), q, l, u) << endl;
-        }
+    double l, u, m;
+    if(joint->isRevoluteJoint()){
+        q = degree(q);
+        l = degree(joint->q_lower());
+        u = degree(joint->q_upper());
+        m = degree(angleMargin);
+    } else {
+        l = joint->q_lower();
+        u = joint->q_upper();
+        m = translationMargin;
+    }
 
-        numFaults++;
+    if(m != 0.0){
+        os << format(_("{0:7.3f} [s]: Position limit over of {1} ({2} is beyond the range ({3} , {4}) with margin {5}.)"),
+                     (frame / frameRate), joint->name(), q, l, u, m) << endl;
+    } else {
+        os << format(_("{0:7.3f} [s]: Position limit over of {1} ({2} is beyond the range ({3} , {4}).)"),
+                     (frame / frameRate), joint->name(), q, l, u) << endl;
     }
-    lastPosFaultFrames[joint->jointId()] = frame;
 }
 
 
-void KinematicFaultChecker::Impl::putJointVelocityFault(int frame, Link* joint)
+void KinematicFaultChecker::Impl::putJointVelocityFault(int frame, Link* joint, double dq)
 {
-    if(frame > lastVelFaultFrames[joint->jointId()] + 1){
-        double dq, l, u;
-        if(joint->isRevoluteJoint()){
-            dq = degree(joint->dq());
-            l = degree(joint->dq_lower());
-            u = degree(joint->dq_upper());
-        } else {
-            dq = joint->dq();
-            l = joint->dq_lower();
-            u = joint->dq_upper();
-        }
+    double l, u;
+    if(joint->isRevoluteJoint()){
+        dq = degree(dq);
+        l = degree(joint->dq_lower());
+        u = degree(joint->dq_upper());
+    } else {
+        l = joint->dq_lower();
+        u = joint->dq_upper();
+    }
 
-        double r = (dq < 0.0) ? (dq / l) : (dq / u);
-        r *= 100.0;
+    double r = (dq < 0.0) ? (dq / l) : (dq / u);
+    r *= 100.0;
 
-        os << format(_("{0:7.3f} [s]: Velocity limit over of {1} ({2} is {3:.0f}% of the range ({4} , {5}).)"),
-                     (frame / frameRate), joint->name(), dq, r, l, u) << endl;
-        
-        numFaults++;
-    }
-    lastVelFaultFrames[joint->jointId()] = frame;
+    os << format(_("{0:7.3f} [s]: Velocity limit over of {1} ({2} is {3:.0f}% of the range ({4} , {5}).)"),
+                 (frame / frameRate), joint->name(), dq, r, l, u) << endl;
 }
 
 
-void KinematicFaultChecker::Impl::putSelfCollision(Body* body, int frame, const CollisionPair& collisionPair)
+void KinematicFaultChecker::Impl::putSelfCollision(int frame, Link* link1, Link* link2)
 {
-    bool putMessage = false;
-    GeometryPair gPair(collisionPair.geometries());
-    auto p = lastCollisionFrames.find(gPair);
-    if(p == lastCollisionFrames.end()){
-        putMessage = true;
-        lastCollisionFrames[gPair] = frame;
-    } else {
-        if(frame > p->second + 1){
-            putMessage = true;
-        }
-        p->second = frame;
-    }
-
-    if(putMessage){
-        Link* link0 = static_cast<Link*>(collisionPair.object(0));
-        Link* link1 = static_cast<Link*>(collisionPair.object(1));
-        os << format(_("{0:7.3f} [s]: Collision between {1} and {2}"),
-                     (frame / frameRate), link0->name(), link1->name()) << endl;
-        numFaults++;
-    }
+    os << format(_("{0:7.3f} [s]: Collision between {1} and {2}"),
+                 (frame / frameRate), link1->name(), link2->name()) << endl;
 }
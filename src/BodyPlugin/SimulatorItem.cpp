@@ -32,15 +32,27 @@
 #include <cnoid/SceneView>
 #include <cnoid/CloneMap>
 #include <cnoid/CollisionDetector>
+#include <cnoid/Tokenizer>
 #include <QThread>
 #include <QMutex>
 #include <QElapsedTimer>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <atomic>
+#include <chrono>
 #include <set>
 #include <deque>
 #include <fmt/format.h>
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <cerrno>
+#endif
 #include "gettext.h"
 
 using namespace std;
@@ -53,6 +65,33 @@ enum { RESOLUTION_TIMESTEP, RESOLUTION_FRAMERATE, RESOLUTION_TIMEBAR, N_TEMPORAR
 
 const char* realtimeSyncModeSymbols[] = { "off", "compensatory", "conservative" };
 static const char* timeRangeModeSymbols[] = { "unlimited", "specified", "timebar" };
+const char* controllerThreadHandoffModeSymbols[] = { "blocking", "spin_then_park" };
+const char* realtimePacingModeSymbols[] = { "millisecond_sleep", "deadline" };
+
+// Upper limits of the bins of the realtime jitter histogram in seconds
+const double realtimeJitterBinLimits[] = { 10e-6, 20e-6, 50e-6, 100e-6, 200e-6, 500e-6, 1e-3, 2e-3, 5e-3, 10e-3 };
+
+typedef std::chrono::steady_clock RealtimeClock;
+
+/**
+   The thread sleeps until the time before the deadline by the spin time and then busy-waits
+   for the deadline.
+*/
+void sleepUntil(RealtimeClock::time_point deadline, RealtimeClock::duration spinTime)
+{
+    auto sleepDeadline = deadline - spinTime;
+#ifdef __linux__
+    // The steady clock of libstdc++ and libc++ is CLOCK_MONOTONIC
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(sleepDeadline.time_since_epoch()).count();
+    timespec ts;
+    ts.tv_sec = ns / 1000000000;
+    ts.tv_nsec = ns % 1000000000;
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR){ }
+#else
+    std::this_thread::sleep_until(sleepDeadline);
+#endif
+    while(RealtimeClock::now() < deadline){ }
+}
 
 typedef map<weak_ref_ptr<BodyItem>, SimulationBodyPtr> BodyItemToSimBodyMap;
 
@@ -98,6 +137,96 @@ struct FunctionSet
     void updateFunctions();
 };
 
+/**
+   This class passes a signal from a thread to another thread. In the spin mode, the receiver
+   polls the signal for a while before sleeping on the condition variable. The spin count is
+   adapted so that the spin is given up soon when the signal is usually not given in the period.
+*/
+class HandoffSignal
+{
+public:
+    HandoffSignal()
+        : isSignaled(false),
+          isReceiverSleeping(false)
+    {
+        spinCount = initialSpinCount;
+    }
+
+    void reset(){
+        isSignaled = false;
+        spinCount = initialSpinCount;
+    }
+
+    void notify(){
+        isSignaled.store(true);
+        if(isReceiverSleeping.load()){
+            std::lock_guard<std::mutex> lock(mutex);
+            condition.notify_one();
+        }
+    }
+
+    void wait(bool doSpin){
+        if(doSpin){
+            for(int i=0; i < spinCount; ++i){
+                if(isSignaled.load(std::memory_order_acquire)){
+                    isSignaled.store(false, std::memory_order_relaxed);
+                    spinCount = std::min(spinCount * 2, maxSpinCount);
+                    return;
+                }
+                pause();
+            }
+            spinCount = std::max(spinCount / 2, minSpinCount);
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        isReceiverSleeping.store(true);
+        condition.wait(lock, [&](){ return isSignaled.load(); });
+        isReceiverSleeping.store(false);
+        isSignaled.store(false, std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr int initialSpinCount = 4000;
+    static constexpr int minSpinCount = 100;
+    static constexpr int maxSpinCount = 100000;
+
+    std::atomic<bool> isSignaled;
+    std::atomic<bool> isReceiverSleeping;
+    int spinCount;
+    std::mutex mutex;
+    std::condition_variable condition;
+
+    static void pause(){
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+        _mm_pause();
+#endif
+    }
+};
+
+struct HandoffLatencyStatistics
+{
+    int count;
+    double total;
+    double max;
+
+    void clear(){
+        count = 0;
+        total = 0.0;
+        max = 0.0;
+    }
+    void add(double latency){
+        ++count;
+        total += latency;
+        if(latency > max){
+            max = latency;
+        }
+    }
+    double average() const {
+        return count > 0 ? (total / count) : 0.0;
+    }
+};
+
+typedef std::chrono::steady_clock HandoffClock;
+
 class ControllerInfo : public Referenced, public ControllerIO
 {
 public:
@@ -106,13 +235,19 @@ public:
     Body* body_;
 
     std::thread controlThread;
-    std::condition_variable controlCondition;
-    std::mutex controlMutex;
-    bool isExitingControlLoopRequested;
-    bool isControlRequested;
-    bool isControlFinished;
+    HandoffSignal controlRequest;
+    HandoffSignal controlFinish;
+    bool isSpinHandoffEnabled;
+    std::atomic<bool> isExitingControlLoopRequested;
     bool isControlToBeContinued;
 
+    // Handoff latency statistics
+    bool isHandoffTimeMeasured;
+    HandoffClock::time_point controlRequestTime;
+    HandoffClock::time_point controlFinishTime;
+    HandoffLatencyStatistics wakeLatency;
+    HandoffLatencyStatistics finishLatency;
+
     std::mutex logMutex;
     ReferencedPtr lastLogData;
     unique_ptr<ReferencedObjectSeq> logBuf;
@@ -141,8 +276,11 @@ public:
     virtual bool setNoDelayMode(bool on) override;
     virtual bool isSimulationFromInitialState() const override;
 
+    void startControlThread(int cpu);
+    void requestControlInThread();
     bool waitForControlInThreadToFinish();
     void concurrentControlLoop();    
+    void exitControlThread();
 };
 
 typedef ref_ptr<ControllerInfo> ControllerInfoPtr;
@@ -277,6 +415,10 @@ public:
     Selection recordingMode;
     Selection timeRangeMode;
     Selection realtimeSyncMode;
+    Selection realtimePacingMode;
+    double realtimeSpinTime;
+    bool isRealtimeJitterReportEnabled;
+    RealtimeJitterHistogram jitterHistogram;
     double timeLength;
     int maxFrame;
     int ringBufferSize;
@@ -286,6 +428,9 @@ public:
     bool isActiveControlTimeRangeMode;
     bool useControllerThreads;
     bool useControllerThreadsProperty;
+    Selection controllerThreadHandoffMode;
+    vector<int> controllerThreadCpus;
+    bool isControllerHandoffTimeMeasured;
     bool isAllLinkPositionOutputMode;
     bool isDeviceStateOutputEnabled;
     bool isDoingSimulationLoop;
@@ -355,6 +500,8 @@ public:
     void resetSimulatorItemForControllerItem(ControllerItem* controllerItem);
     bool startSimulation(bool doReset);
     virtual void run() override;
+    void addStepLatenessToJitterHistogram(double lateness, bool isOverrun);
+    void putRealtimeJitterReport();
     void onSimulationLoopStarted();
     void updateSimBodyLists();
     bool stepSimulationMain();
@@ -373,6 +520,8 @@ public:
     void setVirtualElasticStringForce();
     void onSlowerThanRealtimeEnabledChanged(bool on);
     bool onAllLinkPositionOutputModeChanged(bool on);
+    string getControllerThreadCpuString() const;
+    bool setControllerThreadCpuString(const string& cpus);
     void doPutProperties(PutPropertyFunction& putProperty);
     bool store(Archive& archive);
     bool restore(const Archive& archive);
@@ -875,6 +1024,9 @@ void SimulationBody::Impl::initializeRecordBuffers()
         numLinksToRecord = simImpl->isAllLinkPositionOutputMode ? body_->numLinks() : 1;
         numJointsToRecord = body_->numAllJoints();
         positionBuf = make_unique<BodyPositionSeq>();
+        positionBuf->setNumLinkPositionsHint(numLinksToRecord);
+        positionBuf->setNumJointDisplacementsHint(numJointsToRecord);
+        positionBuf->setArenaStorageEnabled(true, 256);
 
         if(!simImpl->isRecordingEnabled){
             bodyMotionEngine = make_unique<BodyMotionEngineCore>(bodyItem);
@@ -952,6 +1104,7 @@ void SimulationBody::Impl::initializeRecordItems()
     motion->setDimension(0, numJointsToRecord, numLinksToRecord);
     motion->setOffsetTime(0.0);
     positionRecord = motion->positionSeq();
+    positionRecord->setArenaStorageEnabled(true);
 
     if(deviceStateBuf){
         deviceStateRecord = getOrCreateMultiDeviceStateSeq(*motion);
@@ -1018,14 +1171,13 @@ void SimulationBody::bufferRecords()
 void SimulationBody::Impl::bufferRecords()
 {
     if(positionBuf){
-        if(currentPositionBufIndex >= positionBuf->numFrames()){
-            positionBuf->setNumFrames(currentPositionBufIndex + 1);
-        }
-        auto& frame = positionBuf->frame(currentPositionBufIndex++);
         if(!body_->existence()){
-            frame.clear();
+            if(currentPositionBufIndex >= positionBuf->numFrames()){
+                positionBuf->setNumFrames(currentPositionBufIndex + 1);
+            }
+            positionBuf->frame(currentPositionBufIndex++).clear();
         } else {
-            frame.allocate(numLinksToRecord, numJointsToRecord);
+            auto& frame = positionBuf->allocateFrame(currentPositionBufIndex++);
             bufferBodyPosition(body_, frame);
 
             Body* multiplexBody = body_->nextMultiplexBody();
@@ -1098,7 +1250,7 @@ void SimulationBody::Impl::flushRecordsToBodyMotionItems()
 
     for(int i=0; i < currentPositionBufIndex; ++i){
         if(positionRecord->numFrames() < ringBufferSize){
-            positionRecord->append();
+            positionRecord->appendAllocatedFrame();
         } else {
             positionRecord->rotate();
             offsetChanged = true;
@@ -1219,6 +1371,8 @@ SimulatorItem::Impl::Impl(SimulatorItem* self)
       recordingMode(NumRecordingModes, CNOID_GETTEXT_DOMAIN_NAME),
       timeRangeMode(NumTimeRangeModes, CNOID_GETTEXT_DOMAIN_NAME),
       realtimeSyncMode(NumRealtimeSyncModes, CNOID_GETTEXT_DOMAIN_NAME),
+      realtimePacingMode(NumRealtimePacingModes, CNOID_GETTEXT_DOMAIN_NAME),
+      controllerThreadHandoffMode(NumControllerThreadHandoffModes, CNOID_GETTEXT_DOMAIN_NAME),
       mv(MessageView::instance())
 {
     worldItem = nullptr;
@@ -1251,8 +1405,24 @@ SimulatorItem::Impl::Impl(SimulatorItem* self)
     realtimeSyncMode.setSymbol(ConservativeRealtimeSync, N_("On (Conservative)"));
     realtimeSyncMode.select(CompensatoryRealtimeSync);
 
+    realtimePacingMode.setSymbol(MillisecondSleepPacing, N_("Millisecond sleep"));
+    realtimePacingMode.setSymbol(DeadlinePacing, N_("Deadline"));
+    realtimePacingMode.select(MillisecondSleepPacing);
+    realtimeSpinTime = 0.0;
+    isRealtimeJitterReportEnabled = false;
+    jitterHistogram.binLimits.assign(std::begin(realtimeJitterBinLimits), std::end(realtimeJitterBinLimits));
+    jitterHistogram.counts.assign(jitterHistogram.binLimits.size() + 1, 0);
+    jitterHistogram.numSteps = 0;
+    jitterHistogram.numOverruns = 0;
+    jitterHistogram.maxLateness = 0.0;
+
+    controllerThreadHandoffMode.setSymbol(BlockingHandoff, N_("Blocking"));
+    controllerThreadHandoffMode.setSymbol(SpinThenParkHandoff, N_("Spin then park"));
+    controllerThreadHandoffMode.select(BlockingHandoff);
+
     timeLength = 180.0; // 3 min.
     useControllerThreadsProperty = true;
+    isControllerHandoffTimeMeasured = false;
     isActiveControlTimeRangeMode = false;
     isAllLinkPositionOutputMode = true;
     isDeviceStateOutputEnabled = true;
@@ -1282,9 +1452,15 @@ SimulatorItem::Impl::Impl(SimulatorItem* self, const Impl& org)
     recordingMode = org.recordingMode;
     timeRangeMode = org.timeRangeMode;
     realtimeSyncMode = org.realtimeSyncMode;
+    realtimePacingMode = org.realtimePacingMode;
+    realtimeSpinTime = org.realtimeSpinTime;
+    isRealtimeJitterReportEnabled = org.isRealtimeJitterReportEnabled;
 
     timeLength = org.timeLength;
     useControllerThreadsProperty = org.useControllerThreadsProperty;
+    controllerThreadHandoffMode = org.controllerThreadHandoffMode;
+    controllerThreadCpus = org.controllerThreadCpus;
+    isControllerHandoffTimeMeasured = org.isControllerHandoffTimeMeasured;
     isActiveControlTimeRangeMode = org.isActiveControlTimeRangeMode;
     isAllLinkPositionOutputMode = org.isAllLinkPositionOutputMode;
     isDeviceStateOutputEnabled = org.isDeviceStateOutputEnabled;
@@ -1409,6 +1585,60 @@ void SimulatorItem::setRealtimeSyncMode(bool on)
 }
 
 
+void SimulatorItem::setRealtimePacingMode(int mode)
+{
+    impl->realtimePacingMode.select(mode);
+}
+
+
+int SimulatorItem::realtimePacingMode() const
+{
+    return impl->realtimePacingMode.which();
+}
+
+
+void SimulatorItem::setRealtimeSpinTime(double time)
+{
+    impl->realtimeSpinTime = std::max(time, 0.0);
+}
+
+
+const SimulatorItem::RealtimeJitterHistogram& SimulatorItem::realtimeJitterHistogram() const
+{
+    return impl->jitterHistogram;
+}
+
+
+void SimulatorItem::setRealtimeJitterReportEnabled(bool on)
+{
+    impl->isRealtimeJitterReportEnabled = on;
+}
+
+
+void SimulatorItem::setControllerThreadHandoffMode(int mode)
+{
+    impl->controllerThreadHandoffMode.select(mode);
+}
+
+
+int SimulatorItem::controllerThreadHandoffMode() const
+{
+    return impl->controllerThreadHandoffMode.which();
+}
+
+
+void SimulatorItem::setControllerThreadCpus(const std::vector<int>& cpus)
+{
+    impl->controllerThreadCpus = cpus;
+}
+
+
+void SimulatorItem::setControllerHandoffStatisticsEnabled(bool on)
+{
+    impl->isControllerHandoffTimeMeasured = on;
+}
+
+
 void SimulatorItem::setDeviceStateOutputEnabled(bool on)
 {
     impl->isDeviceStateOutputEnabled = on;
@@ -1890,12 +2120,10 @@ bool SimulatorItem::Impl::startSimulation(bool doReset)
 
         useControllerThreads = useControllerThreadsProperty;
         if(useControllerThreads){
-            for(auto& info : activeControllerInfos){
-                info->isExitingControlLoopRequested = false;
-                info->isControlRequested = false;
-                info->isControlFinished = false;
-                info->isControlToBeContinued = false;
-                info->controlThread = std::thread([info](){ info->concurrentControlLoop(); });
+            const int numCpus = controllerThreadCpus.size();
+            for(size_t i=0; i < activeControllerInfos.size(); ++i){
+                activeControllerInfos[i]->startControlThread(
+                    numCpus > 0 ? controllerThreadCpus[i % numCpus] : -1);
             }
         }
 
@@ -2095,13 +2323,30 @@ void SimulatorItem::Impl::run()
         const double compensationRatio = (dt > 0.1) ? 0.1 : dt;
         const double dtms = dt * 1000.0;
         double compensatedSimulationTime = 0.0;
+
+        // The elapsed time is measured with the nanosecond resolution in both the pacing modes
+        // so that the lateness of the steps is recorded with the same resolution
+        const bool isDeadlinePacing = realtimePacingMode.is(DeadlinePacing);
+        const auto spinTime =
+            std::chrono::duration_cast<RealtimeClock::duration>(std::chrono::duration<double>(realtimeSpinTime));
+        auto timerStartTime = RealtimeClock::now();
+        auto getTimerElapsedTime = [&](){
+            return std::chrono::duration<double, std::milli>(RealtimeClock::now() - timerStartTime).count();
+        };
+        // The deadline of the first step is the start time, so the step is not recorded
+        bool isFirstStep = true;
+        std::fill(jitterHistogram.counts.begin(), jitterHistogram.counts.end(), 0);
+        jitterHistogram.numSteps = 0;
+        jitterHistogram.numOverruns = 0;
+        jitterHistogram.maxLateness = 0.0;
+
         while(true){
             if(pauseRequested){
                 if(stopRequested){
                     break;
                 }
                 if(!isOnPause){
-                    elapsedTime += timer.elapsed();
+                    elapsedTime += getTimerElapsedTime();
                     isOnPause = true;
                     sigSimulationPaused();
                 }
@@ -2109,15 +2354,25 @@ void SimulatorItem::Impl::run()
             } else {
                 if(isOnPause){
                     timer.start();
+                    timerStartTime = RealtimeClock::now();
                     isOnPause = false;
                     sigSimulationResumed();
                 }
                 if(!stepSimulationMain() || stopRequested || frame >= maxFrame){
                     break;
                 }
-                double diff = (double)compensatedSimulationTime - (elapsedTime + timer.elapsed());
+                const double deadline = compensatedSimulationTime;
+                double diff = deadline - (elapsedTime + getTimerElapsedTime());
+                const bool isOverrun = (diff < 0.0);
+                if(isDeadlinePacing && diff > 0.0){
+                    sleepUntil(
+                        timerStartTime + std::chrono::duration_cast<RealtimeClock::duration>(
+                            std::chrono::duration<double, std::milli>(deadline - elapsedTime)),
+                        spinTime);
+                    diff = 0.0;
+                }
                 if(currentRealtimeSyncMode == ConservativeRealtimeSync){
-                    if(diff >= 0.0){
+                    if(diff > 0.0){
                         QThread::msleep(diff);
                     } else if(diff < 0.0){
                         compensatedSimulationTime += -diff;
@@ -2135,6 +2390,12 @@ void SimulatorItem::Impl::run()
                         }
                     }
                 }
+                // The lateness is measured at the wake-up in both the pacing modes
+                if(isFirstStep){
+                    isFirstStep = false;
+                } else {
+                    addStepLatenessToJitterHistogram(elapsedTime + getTimerElapsedTime() - deadline, isOverrun);
+                }
                 compensatedSimulationTime += dtms;
                 ++frame;
             }
@@ -2151,12 +2412,7 @@ void SimulatorItem::Impl::run()
 
     if(useControllerThreads){
         for(auto& info : activeControllerInfos){
-            {
-                std::lock_guard<std::mutex> lock(info->controlMutex);
-                info->isExitingControlLoopRequested = true;
-            }
-            info->controlCondition.notify_all();
-            info->controlThread.join();
+            info->exitControlThread();
         }
     }
 
@@ -2198,11 +2454,7 @@ bool SimulatorItem::Impl::stepSimulationMain()
                 hasNoDelayModeControllers = true;
             }
             info->controller->input();
-            {
-                std::lock_guard<std::mutex> lock(info->controlMutex);                
-                info->isControlRequested = true;
-            }
-            info->controlCondition.notify_all();
+            info->requestControlInThread();
         }
         if(hasNoDelayModeControllers){
             // Todo: Process the controller that finishes control earlier first to
@@ -2268,13 +2520,52 @@ bool SimulatorItem::Impl::stepSimulationMain()
 
 namespace {
 
+void ControllerInfo::startControlThread(int cpu)
+{
+    isSpinHandoffEnabled =
+        simImpl->controllerThreadHandoffMode.is(SimulatorItem::SpinThenParkHandoff) &&
+        std::thread::hardware_concurrency() > 1;
+    isHandoffTimeMeasured = simImpl->isControllerHandoffTimeMeasured;
+    wakeLatency.clear();
+    finishLatency.clear();
+    controlRequest.reset();
+    controlFinish.reset();
+    isExitingControlLoopRequested = false;
+    isControlToBeContinued = false;
+
+    controlThread = std::thread([this](){ concurrentControlLoop(); });
+
+#ifdef __linux__
+    if(cpu >= 0 && cpu < CPU_SETSIZE){
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        CPU_SET(cpu, &cpuSet);
+        if(pthread_setaffinity_np(controlThread.native_handle(), sizeof(cpu_set_t), &cpuSet) != 0){
+            simImpl->mv->putln(
+                format(_("The thread of {0} cannot be pinned to CPU {1}."), controllerName(), cpu),
+                MessageView::Warning);
+        }
+    }
+#endif
+}
+
+
+void ControllerInfo::requestControlInThread()
+{
+    if(isHandoffTimeMeasured){
+        controlRequestTime = HandoffClock::now();
+    }
+    controlRequest.notify();
+}
+
+
 bool ControllerInfo::waitForControlInThreadToFinish()
 {
-    std::unique_lock<std::mutex> lock(controlMutex);
-    while(!isControlFinished){
-        controlCondition.wait(lock);
+    controlFinish.wait(isSpinHandoffEnabled);
+    if(isHandoffTimeMeasured){
+        finishLatency.add(
+            std::chrono::duration<double>(HandoffClock::now() - controlFinishTime).count());
     }
-    isControlFinished = false;
     return isControlToBeContinued;
 }
 
@@ -2282,35 +2573,67 @@ bool ControllerInfo::waitForControlInThreadToFinish()
 void ControllerInfo::concurrentControlLoop()
 {
     while(true){
-        {
-            std::unique_lock<std::mutex> lock(controlMutex);
-            while(true){
-                if(isExitingControlLoopRequested){
-                    goto exitConcurrentControlLoop;
-                }
-                if(isControlRequested){
-                    isControlRequested = false;
-                    isControlToBeContinued = false;
-                    break;
-                }
-                controlCondition.wait(lock);
-            }
+        controlRequest.wait(isSpinHandoffEnabled);
+        if(isExitingControlLoopRequested){
+            break;
+        }
+        if(isHandoffTimeMeasured){
+            wakeLatency.add(
+                std::chrono::duration<double>(HandoffClock::now() - controlRequestTime).count());
         }
 
-        bool doContinue = controller->control();
-        
-        {
-            std::lock_guard<std::mutex> lock(controlMutex);
-            isControlFinished = true;
-            isControlToBeContinued = doContinue;
+        isControlToBeContinued = controller->control();
+
+        if(isHandoffTimeMeasured){
+            controlFinishTime = HandoffClock::now();
         }
-        controlCondition.notify_all();
+        controlFinish.notify();
+    }
+}
+
+
+void ControllerInfo::exitControlThread()
+{
+    isExitingControlLoopRequested = true;
+    controlRequest.notify();
+    controlThread.join();
+}
+
+}
+
+
+/**
+   \param lateness The lateness of the step from the realtime schedule in milliseconds
+*/
+void SimulatorItem::Impl::addStepLatenessToJitterHistogram(double lateness, bool isOverrun)
+{
+    const double latenessInSeconds = lateness / 1000.0;
+    auto& limits = jitterHistogram.binLimits;
+    int bin = std::upper_bound(limits.begin(), limits.end(), latenessInSeconds) - limits.begin();
+    ++jitterHistogram.counts[bin];
+    ++jitterHistogram.numSteps;
+    if(isOverrun){
+        ++jitterHistogram.numOverruns;
+    }
+    if(latenessInSeconds > jitterHistogram.maxLateness){
+        jitterHistogram.maxLateness = latenessInSeconds;
     }
-    
-exitConcurrentControlLoop:
-    return;
 }
 
+
+void SimulatorItem::Impl::putRealtimeJitterReport()
+{
+    mv->putln(format(_("Realtime step lateness of {0}: {1} steps, {2} overruns, max {3:.1f} [us]"),
+                     self->displayName(), jitterHistogram.numSteps, jitterHistogram.numOverruns,
+                     jitterHistogram.maxLateness * 1.0e6));
+    auto& limits = jitterHistogram.binLimits;
+    for(size_t i=0; i < jitterHistogram.counts.size(); ++i){
+        if(i < limits.size()){
+            mv->putln(format("  < {0:>6g} [us]: {1}", limits[i] * 1.0e6, jitterHistogram.counts[i]));
+        } else {
+            mv->putln(format(" >= {0:>6g} [us]: {1}", limits.back() * 1.0e6, jitterHistogram.counts[i]));
+        }
+    }
 }
 
 
@@ -2474,6 +2797,9 @@ void SimulatorItem::Impl::onSimulationLoopStopped(bool isForced)
     }
 
     flushRecords();
+    if(worldLogFileItem){
+        worldLogFileItem->endOutput();
+    }
     logEngine->stopOngoingTimeUpdate();
 
     mv->notify(format(_("Simulation by {0} has finished at {1} [s]."), self->displayName(), finishTime));
@@ -2483,6 +2809,21 @@ void SimulatorItem::Impl::onSimulationLoopStopped(bool isForced)
                          actualSimulationTime, (actualSimulationTime / finishTime)));
     }
 
+    if(currentRealtimeSyncMode != NonRealtimeSync && isRealtimeJitterReportEnabled &&
+       jitterHistogram.numSteps > 0){
+        putRealtimeJitterReport();
+    }
+
+    if(useControllerThreads && isControllerHandoffTimeMeasured){
+        for(auto& info : activeControllerInfos){
+            mv->putln(format(_("Controller thread handoff of {0}: "
+                               "wake latency avg {1:.2f} max {2:.2f} [us], finish latency avg {3:.2f} max {4:.2f} [us]"),
+                             info->controllerName(),
+                             info->wakeLatency.average() * 1.0e6, info->wakeLatency.max * 1.0e6,
+                             info->finishLatency.average() * 1.0e6, info->finishLatency.max * 1.0e6));
+        }
+    }
+
     clearSimulation();
 
     SceneView::unblockEditModeForAllViews(self);
@@ -2752,6 +3093,35 @@ bool SimulatorItem::Impl::onAllLinkPositionOutputModeChanged(bool on)
 }
 
 
+string SimulatorItem::Impl::getControllerThreadCpuString() const
+{
+    string cpus;
+    for(size_t i=0; i < controllerThreadCpus.size(); ++i){
+        if(i > 0){
+            cpus += ", ";
+        }
+        cpus += std::to_string(controllerThreadCpus[i]);
+    }
+    return cpus;
+}
+
+
+bool SimulatorItem::Impl::setControllerThreadCpuString(const string& cpus)
+{
+    vector<int> cpuList;
+    for(auto& token : Tokenizer<CharSeparator<char>>(cpus, CharSeparator<char>(", "))){
+        char* end;
+        long cpu = strtol(token.c_str(), &end, 10);
+        if(*end != '\0' || cpu < 0){
+            return false;
+        }
+        cpuList.push_back(cpu);
+    }
+    controllerThreadCpus = cpuList;
+    return true;
+}
+
+
 std::shared_ptr<CollisionLinkPairList> SimulatorItem::getCollisions()
 {
     return std::make_shared<CollisionLinkPairList>();
@@ -2785,6 +3155,13 @@ void SimulatorItem::Impl::doPutProperties(PutPropertyFunction& putProperty)
 
     putProperty(_("Realtime sync"), realtimeSyncMode,
                 [&](int index){ return realtimeSyncMode.select(index); });
+    putProperty(_("Realtime pacing"), realtimePacingMode,
+                [&](int index){ return realtimePacingMode.select(index); });
+    putProperty.min(0.0).max(1000.0)(_("Realtime spin time [us]"), realtimeSpinTime * 1.0e6,
+                [&](double t){ realtimeSpinTime = t * 1.0e-6; return true; });
+    putProperty.reset();
+    putProperty(_("Realtime jitter report"), isRealtimeJitterReportEnabled,
+                changeProperty(isRealtimeJitterReportEnabled));
     putProperty(_("Time range"), timeRangeMode,
                 [&](int index){ return timeRangeMode.select(index); });
     putProperty.min(0.0);
@@ -2802,6 +3179,12 @@ void SimulatorItem::Impl::doPutProperties(PutPropertyFunction& putProperty)
                 changeProperty(recordCollisionData));
     putProperty(_("Controller Threads"), useControllerThreadsProperty,
                 changeProperty(useControllerThreadsProperty));
+    putProperty(_("Controller thread handoff"), controllerThreadHandoffMode,
+                [&](int index){ return controllerThreadHandoffMode.select(index); });
+    putProperty(_("Controller thread CPUs"), getControllerThreadCpuString(),
+                [&](const string& s){ return setControllerThreadCpuString(s); });
+    putProperty(_("Controller handoff statistics"), isControllerHandoffTimeMeasured,
+                changeProperty(isControllerHandoffTimeMeasured));
     putProperty(_("Controller options"), controllerOptionString_,
                 changeProperty(controllerOptionString_));
     putProperty(_("Block scene view edit mode"), isSceneViewEditModeBlockedDuringSimulation,
@@ -2824,6 +3207,9 @@ bool SimulatorItem::Impl::store(Archive& archive)
         archive.write("frame_rate", frameRateProperty);
     }
     archive.write("realtime_sync_mode", realtimeSyncModeSymbols[realtimeSyncMode.which()]);
+    archive.write("realtime_pacing", realtimePacingModeSymbols[realtimePacingMode.which()]);
+    archive.write("realtime_spin_time", realtimeSpinTime);
+    archive.write("realtime_jitter_report", isRealtimeJitterReportEnabled);
     archive.write("recording", recordingMode.selectedSymbol());
     archive.write("time_range_mode", timeRangeModeSymbols[timeRangeMode.which()]);
     archive.write("time_length", timeLength);
@@ -2831,6 +3217,12 @@ bool SimulatorItem::Impl::store(Archive& archive)
     archive.write("output_all_link_positions", isAllLinkPositionOutputMode);
     archive.write("output_device_states", isDeviceStateOutputEnabled);
     archive.write("use_controller_threads", useControllerThreadsProperty);
+    archive.write("controller_thread_handoff",
+                  controllerThreadHandoffModeSymbols[controllerThreadHandoffMode.which()]);
+    if(!controllerThreadCpus.empty()){
+        archive.write("controller_thread_cpus", getControllerThreadCpuString(), DOUBLE_QUOTED);
+    }
+    archive.write("controller_handoff_statistics", isControllerHandoffTimeMeasured);
     archive.write("record_collision_data", recordCollisionData);
     archive.write("controller_options", controllerOptionString_, DOUBLE_QUOTED);
     archive.write("block_scene_view_edit_mode", isSceneViewEditModeBlockedDuringSimulation);
@@ -2913,6 +3305,16 @@ bool SimulatorItem::Impl::restore(const Archive& archive)
         realtimeSyncMode.select(on ? CompensatoryRealtimeSync : NonRealtimeSync);
     }
 
+    if(archive.read("realtime_pacing", symbol)){
+        for(int i=0; i < NumRealtimePacingModes; ++i){
+            if(symbol == realtimePacingModeSymbols[i]){
+                realtimePacingMode.select(i);
+            }
+        }
+    }
+    archive.read("realtime_spin_time", realtimeSpinTime);
+    archive.read("realtime_jitter_report", isRealtimeJitterReportEnabled);
+
     archive.read({ "time_length", "timeLength" }, timeLength);
 
     bool on = archive.get({ "output_all_link_positions", "allLinkPositionOutputMode" }, isAllLinkPositionOutputMode);
@@ -2921,6 +3323,18 @@ bool SimulatorItem::Impl::restore(const Archive& archive)
     archive.read({ "output_device_states", "deviceStateOutput" }, isDeviceStateOutputEnabled);
     archive.read({ "record_collision_data", "recordCollisionData" }, recordCollisionData);
     archive.read({ "use_controller_threads", "controllerThreads" }, useControllerThreadsProperty);
+    if(archive.read("controller_thread_handoff", symbol)){
+        for(int i=0; i < NumControllerThreadHandoffModes; ++i){
+            if(symbol == controllerThreadHandoffModeSymbols[i]){
+                controllerThreadHandoffMode.select(i);
+            }
+        }
+    }
+    string cpus;
+    if(archive.read("controller_thread_cpus", cpus)){
+        setControllerThreadCpuString(cpus);
+    }
+    archive.read("controller_handoff_statistics", isControllerHandoffTimeMeasured);
     archive.read({ "controller_options", "controllerOptions" }, controllerOptionString_);
     archive.read({ "block_scene_view_edit_mode", "scene_view_edit_mode_blocking" },
                  isSceneViewEditModeBlockedDuringSimulation);
@@ -164,6 +164,40 @@ public:
 
     [[deprecated("Use setRealtimeSyncMode(int mode)")]]
     void setRealtimeSyncMode(bool on);
+
+    enum RealtimePacingMode {
+        MillisecondSleepPacing,
+        DeadlinePacing,
+        NumRealtimePacingModes
+    };
+
+    /**
+       In the deadline pacing mode, the simulation thread sleeps until the absolute deadline of
+       each step with the nanosecond resolution instead of sleeping for whole milliseconds.
+       The last part of the sleep can be replaced with the busy wait by setRealtimeSpinTime.
+    */
+    void setRealtimePacingMode(int mode);
+    int realtimePacingMode() const;
+    void setRealtimeSpinTime(double time);
+
+    /**
+       Histogram of the lateness of the steps from the realtime schedule in the last simulation
+       with the realtime sync. The lateness of a step that cannot be finished in time is counted
+       as an overrun.
+    */
+    struct RealtimeJitterHistogram
+    {
+        //! Upper limits of the bins in seconds. The last bin of the counts has no upper limit.
+        std::vector<double> binLimits;
+        std::vector<int> counts;
+        int numSteps;
+        int numOverruns;
+        double maxLateness;
+    };
+    //! This must be called when the simulation is not running.
+    const RealtimeJitterHistogram& realtimeJitterHistogram() const;
+    //! The histogram is put to the message view at the end of a simulation when this is enabled.
+    void setRealtimeJitterReportEnabled(bool on);
     
     void setSlowerThanRealtimeEnabled(bool on);
     
@@ -177,6 +211,26 @@ public:
 
     const std::string& controllerOptionString() const;
 
+    enum ControllerThreadHandoffMode {
+        BlockingHandoff,
+        SpinThenParkHandoff,
+        NumControllerThreadHandoffModes
+    };
+
+    /**
+       This mode specifies how the simulation thread and the controller threads wait for each other
+       when the controller threads are used. In the spin-then-park mode, a waiting thread spins for
+       an adaptive period before sleeping so that the handoff does not need the context switches.
+    */
+    void setControllerThreadHandoffMode(int mode);
+    int controllerThreadHandoffMode() const;
+
+    //! The controller threads are pinned to the CPUs in turn. An empty list disables the pinning.
+    void setControllerThreadCpus(const std::vector<int>& cpus);
+
+    //! The wake and finish latencies of each controller thread are reported at the end of a simulation.
+    void setControllerHandoffStatisticsEnabled(bool on);
+
     void setSceneViewEditModeBlockedDuringSimulation(bool on);    
     
     /**
@@ -21,6 +21,7 @@
 #include <cnoid/FileDialog>
 #include <cnoid/Archive>
 #include <cnoid/UTF8>
+#include <cnoid/Selection>
 #include <cnoid/stdx/filesystem>
 #include <fmt/format.h>
 #include <QDateTime>
@@ -28,6 +29,24 @@
 #include <stack>
 #include <map>
 #include <regex>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <climits>
+#include <cstdio>
+#include <zlib.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 #include "gettext.h"
 
 using namespace std;
@@ -43,6 +62,21 @@ static const int frameHeaderSize =
     + sizeof(int)   // data size
     ;
 
+/*
+   A negative value at the top of the file specifies the format version of the log.
+   The original format, which does not have the value, is version 1.
+*/
+static const int compressedFormatVersion = 2;
+
+static const int frameIndexFileFormatVersion = 1;
+
+static const int writeQueueCapacity = 256;
+
+enum FrameTypeID {
+    KEY_FRAME,
+    DELTA_FRAME
+};
+
 enum DataTypeID {
     BODY_STATE,
     LINK_POSITIONS,
@@ -52,27 +86,114 @@ enum DataTypeID {
 
 struct CorruptLogException { };
 
+/**
+   Read-only memory mapping of a file. The mapping is only supported on POSIX systems,
+   and the stream reader is used on the other systems.
+*/
+class MappedFile
+{
+public:
+    MappedFile() {
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    ~MappedFile() {
+        close();
+    }
+
+    bool open(const string& filename){
+        close();
+#ifndef _WIN32
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if(fd < 0){
+            return false;
+        }
+        struct stat st;
+        if(fstat(fd, &st) == 0 && st.st_size > 0){
+            void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(p != MAP_FAILED){
+                data_ = static_cast<const char*>(p);
+                size_ = st.st_size;
+            }
+        }
+        ::close(fd);
+#endif
+        return data_ != nullptr;
+    }
+
+    void close(){
+#ifndef _WIN32
+        if(data_){
+            munmap(const_cast<char*>(data_), size_);
+        }
+#endif
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    bool isOpen() const { return data_ != nullptr; }
+    const char* data() const { return data_; }
+    int64_t size() const { return size_; }
+
+    //! \return True if the range is in the mapped area.
+    bool contains(int64_t pos, int64_t size) const {
+        return data_ && pos >= 0 && pos + size <= size_;
+    }
+
+private:
+    const char* data_;
+    int64_t size_;
+};
+
+
+/**
+   The data is read from the mapped file without copying it when the area of the data is
+   in the mapping. Otherwise the data is read from the stream into the internal buffer.
+*/
 class ReadBuf
 {
 public:
     vector<char> data;
     ifstream& ifs;
+    const char* top;
+    int dataSize;
+    bool isMapped;
     int pos;
 
     ReadBuf(ifstream& ifs)
         : ifs(ifs) {
+        top = nullptr;
+        dataSize = 0;
+        isMapped = false;
+        pos = 0;
+    }
+
+    //! The data in the external memory such as the file mapping is accessed directly.
+    void setExternalData(const char* data, int size){
+        this->data.clear();
+        top = data;
+        dataSize = size;
+        isMapped = true;
         pos = 0;
     }
 
     bool checkSize(int size){
-        int left = data.size() - pos;
+        int left = dataSize - pos;
         if(left < size){
+            if(isMapped){
+                return false;
+            }
             int len = size - left;
-            data.resize(data.size() + len);
+            data.resize(dataSize + len);
+            top = &data.front();
             ifs.read(&data[pos], len);
             if(!ifs.fail()){
+                dataSize = data.size();
                 return true;
             } else {
+                data.resize(dataSize);
+                top = data.empty() ? nullptr : &data.front();
                 ifs.clear();
                 return false;
             }
@@ -96,66 +217,67 @@ public:
         return pos + size;
     }
 
-    char* buf() {
-        return &data.front();
-    }
-
     void clear(){
         data.clear();
+        top = nullptr;
+        dataSize = 0;
+        isMapped = false;
         pos = 0;
     }
 
     int size() const {
-        return data.size();
-    }
-
-    char* current() {
-        return &data[pos];
+        return dataSize;
     }
 
-    char* end() {
-        return &data.front() + data.size();
+    bool isEnd() {
+        return (pos >= dataSize);
     }
 
-    bool isEnd() {
-        return (pos >= static_cast<int>(data.size()));
+    const char* current() const {
+        return top + pos;
     }
 
     void seek(int pos = 0) { this->pos = pos; }
 
     char readID(){
         ensureSize(1);
-        return data[pos++];
+        return top[pos++];
     }
 
     bool readBool(){
         ensureSize(1);
-        return data[pos++];
+        return top[pos++];
     }
 
     char readOctet(){
         ensureSize(1);
-        return data[pos++];
+        return top[pos++];
     }
 
     short readShort(){
         ensureSize(2);
-        unsigned char low = data[pos++];
-        unsigned char high = data[pos++];
+        unsigned char low = top[pos++];
+        unsigned char high = top[pos++];
         short value = low + (high << 8);
         return value;
     }
 
     int readInt(){
         ensureSize(4);
-        unsigned char d0 = data[pos++];
-        unsigned char d1 = data[pos++];
-        unsigned char d2 = data[pos++];
-        unsigned char d3 = data[pos++];
+        unsigned char d0 = top[pos++];
+        unsigned char d1 = top[pos++];
+        unsigned char d2 = top[pos++];
+        unsigned char d3 = top[pos++];
         int value = d0 + (d1 << 8) + (d2 << 16) + (d3 << 24);
         return value;
     }
 
+    int64_t readInt64(){
+        uint64_t low = static_cast<unsigned int>(readInt());
+        uint64_t high = static_cast<unsigned int>(readInt());
+        return static_cast<int64_t>(low | (high << 32));
+    }
+
     int readSeekOffset(){
         int offset = readInt();
         if(offset < 0){
@@ -167,11 +289,8 @@ public:
     float readFloat(){
         ensureSize(sizeof(float));
         float value;
-        char* p = (char*)&value;
-        const int n = sizeof(float);
-        for(int i=0; i < n; ++i){
-            p[i] = data[pos++];
-        }
+        memcpy(&value, top + pos, sizeof(float));
+        pos += sizeof(float);
         return value;
     }
 
@@ -196,25 +315,176 @@ public:
             throw CorruptLogException();
         }
         ensureSize(size);
-        std::string str;
-        str.reserve(size);
-        for(int i=0; i < size; ++i){
-            str.append(1, data[pos++]);
-        }
+        std::string str(top + pos, size);
+        pos += size;
         return str;
     }
 };
 
 
+/**
+   This class writes the data blocks to a file in a background thread. The blocks are passed
+   through a bounded single-producer single-consumer queue whose buffers are reused, so the
+   producer does not do any file I/O or memory allocation in the steady state. The mutex is
+   only used to make a waiting thread sleep.
+*/
+class AsyncFileWriter
+{
+public:
+    enum SyncMode { NoSync, SyncOnClose, SyncEveryBlock };
+
+    AsyncFileWriter(int capacity)
+        : buffers(capacity)
+    {
+        fp = nullptr;
+        syncMode = NoSync;
+        head = 0;
+        tail = 0;
+        isClosing = false;
+        isWriterWaiting = false;
+        isProducerWaiting = false;
+        resetStatistics();
+    }
+
+    ~AsyncFileWriter(){
+        close();
+    }
+
+    void setSyncMode(int mode){
+        syncMode = mode;
+    }
+
+    bool open(const string& filename){
+        close();
+        fp = fopen(filename.c_str(), "wb");
+        if(!fp){
+            return false;
+        }
+        head = 0;
+        tail = 0;
+        isClosing = false;
+        resetStatistics();
+        writerThread = std::thread([this](){ run(); });
+        return true;
+    }
+
+    bool isOpen() const {
+        return fp != nullptr;
+    }
+
+    //! The blocks in the queue are written before the file is closed.
+    void close(){
+        if(!fp){
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            isClosing = true;
+        }
+        dataCondition.notify_one();
+        writerThread.join();
+        fflush(fp);
+        if(syncMode != NoSync){
+            syncFile();
+        }
+        fclose(fp);
+        fp = nullptr;
+    }
+
+    //! The data is moved to the queue and the argument is replaced with an empty buffer.
+    void push(vector<char>& data){
+        if(!fp){
+            ++numDroppedBlocks;
+            data.clear();
+            return;
+        }
+        const size_t capacity = buffers.size();
+        const size_t t = tail.load(std::memory_order_relaxed);
+        if(t - head.load() >= capacity){
+            ++numBackPressuredBlocks;
+            std::unique_lock<std::mutex> lock(mutex);
+            isProducerWaiting = true;
+            spaceCondition.wait(lock, [&](){ return t - head.load() < capacity; });
+            isProducerWaiting = false;
+        }
+        buffers[t % capacity].swap(data);
+        data.clear();
+        tail.store(t + 1);
+        if(isWriterWaiting.load()){
+            std::lock_guard<std::mutex> lock(mutex);
+            dataCondition.notify_one();
+        }
+    }
+
+    void resetStatistics(){
+        numBackPressuredBlocks = 0;
+        numDroppedBlocks = 0;
+    }
+
+    std::atomic<int> numBackPressuredBlocks;
+    std::atomic<int> numDroppedBlocks;
+
+private:
+    vector<vector<char>> buffers;
+    std::atomic<size_t> head;
+    std::atomic<size_t> tail;
+    FILE* fp;
+    int syncMode;
+    std::thread writerThread;
+    std::mutex mutex;
+    std::condition_variable dataCondition;
+    std::condition_variable spaceCondition;
+    bool isClosing;
+    std::atomic<bool> isWriterWaiting;
+    std::atomic<bool> isProducerWaiting;
+
+    void run(){
+        const size_t capacity = buffers.size();
+        while(true){
+            const size_t h = head.load(std::memory_order_relaxed);
+            if(h == tail.load()){
+                fflush(fp);
+                std::unique_lock<std::mutex> lock(mutex);
+                isWriterWaiting = true;
+                dataCondition.wait(lock, [&](){ return h != tail.load() || isClosing; });
+                isWriterWaiting = false;
+                if(h == tail.load()){
+                    break;
+                }
+            }
+            auto& buf = buffers[h % capacity];
+            if(fwrite(buf.data(), 1, buf.size(), fp) != buf.size()){
+                ++numDroppedBlocks;
+            }
+            if(syncMode == SyncEveryBlock){
+                fflush(fp);
+                syncFile();
+            }
+            head.store(h + 1);
+            if(isProducerWaiting.load()){
+                std::lock_guard<std::mutex> lock(mutex);
+                spaceCondition.notify_one();
+            }
+        }
+    }
+
+    void syncFile(){
+#ifdef _WIN32
+        _commit(_fileno(fp));
+#else
+        fsync(fileno(fp));
+#endif
+    }
+};
+
+
 class WriteBuf
 {
 public:
     vector<char> data;
-    ofstream& ofs;
     size_t seekOffset;
 
-    WriteBuf(ofstream& ofs)
-        : ofs(ofs) {
+    WriteBuf() {
         seekOffset = 0;
     }
     
@@ -232,17 +502,21 @@ public:
 
     void clear(){
         data.clear();
-        seekOffset = ofs.tellp();
+    }
+
+    void reset(){
+        data.clear();
+        seekOffset = 0;
     }
 
     int size() const {
         return data.size();
     }
 
-    void flush(){
-        ofs.write(&data.front(), data.size());
-        ofs.flush();
-        clear();
+    //! The data is moved to the writer and the seek offset is advanced by its size.
+    void flush(AsyncFileWriter& writer){
+        seekOffset += data.size();
+        writer.push(data);
     }
         
     void writeID(DataTypeID id){
@@ -276,6 +550,11 @@ public:
         data[pos++] = (value >> 24) & 0xff;
     }
 
+    void writeInt64(int64_t value){
+        writeInt(static_cast<int>(value & 0xffffffff));
+        writeInt(static_cast<int>((value >> 32) & 0xffffffff));
+    }
+
     void writeSeekPos(int pos){
         writeInt(pos);
     }
@@ -406,11 +685,26 @@ public:
     bool isTimeStampSuffixEnabled;
     vector<string> bodyNames;
     
-    ofstream ofs;
+    AsyncFileWriter writer;
     WriteBuf writeBuf;
-    int lastOutputFramePos;
+    Selection fileSyncMode;
+    bool isRecording;
+    size_t lastOutputFramePos;
     double recordingFrameRate;
     stack<int> sizeHeaderStack;
+    vector<float> outputFrameTimes;
+    vector<int64_t> outputFramePositions;
+
+    // for the compressed format
+    bool isCompressionEnabled;
+    int keyframeInterval;
+    bool isCompressedOutput;
+    int outputFrameDataPos;
+    int numFramesSinceKeyframe;
+    int numCompressionFailures;
+    vector<char> lastOutputFrameData;
+    vector<char> deltaBuf;
+    vector<Bytef> compressionBuf;
 
     // for device state recording and playback
     struct DeviceStateCache : public Referenced {
@@ -428,14 +722,27 @@ public:
     vector<double> doubleWriteBuf;
 
     ifstream ifs;
+    MappedFile mappedFile;
     ReadBuf readBuf;
     ReadBuf readBuf2;
-    int currentReadFramePos;
+    int64_t currentReadFramePos;
+    int currentReadFrameIndex;
     int currentReadFrameDataSize;
     int prevReadFrameOffset;
     double currentReadFrameTime;
     bool isCurrentFrameDataLoaded;
     bool isOverRange;
+
+    // Frame index for the random access
+    vector<double> frameTimes;
+    vector<int64_t> framePositions;
+    int64_t nextUnindexedFramePos;
+
+    bool isCompressedInput;
+    ReadBuf frameReadBuf;
+    vector<char> inflatedFrameData;
+    vector<char> decodedFrameData;
+    int decodedFrameIndex;
         
     vector<BodyInfoPtr> bodyInfos;
     ScopedConnection worldSubTreeChangedConnection;
@@ -448,10 +755,16 @@ public:
     string getActualFilename();
     void updateBodyInfos();
     void onWorldSubTreeChanged();
+    string getFrameIndexFilename();
     bool readTopHeader();
-    bool readFrameHeader(int pos);
+    bool readFrameHeader(int64_t pos);
+    bool loadFrameIndexFile();
+    bool extendFrameIndex(double time);
+    void writeFrameIndexFile();
     bool seek(double time);
     bool loadCurrentFrameData();
+    bool readCompressedFrame(int frameIndex, char& out_frameType, bool doInflate);
+    bool decodeFrame(int frameIndex);
     bool recallStateAtTime(double time);
     void readBodyStates(double time);
     void readBodyState(BodyInfo* bodyInfo, double time);
@@ -465,6 +778,9 @@ public:
     void fixSizeHeader();
     void endHeaderOutput();
     void beginFrameOutput(double time);
+    void endFrameOutput();
+    void compressFrameData();
+    void endOutput();
     void outputDeviceState(DeviceState* state);
     void exchangeDeviceStateCacheArrays();
     void openDialogToSelectDirectoryToSavePlaybackArchive();
@@ -515,12 +831,25 @@ WorldLogFileItem::WorldLogFileItem()
 
 WorldLogFileItem::Impl::Impl(WorldLogFileItem* self)
     : self(self),
-      writeBuf(ofs),
+      writer(writeQueueCapacity),
+      fileSyncMode(3, CNOID_GETTEXT_DOMAIN_NAME),
       readBuf(ifs),
-      readBuf2(ifs)
+      readBuf2(ifs),
+      frameReadBuf(ifs)
 {
+    fileSyncMode.setSymbol(AsyncFileWriter::NoSync, N_("None"));
+    fileSyncMode.setSymbol(AsyncFileWriter::SyncOnClose, N_("At the end"));
+    fileSyncMode.setSymbol(AsyncFileWriter::SyncEveryBlock, N_("Every frame"));
+    fileSyncMode.select(AsyncFileWriter::NoSync);
+
     isTimeStampSuffixEnabled = false;
     recordingFrameRate = 0.0;
+    isCompressionEnabled = false;
+    keyframeInterval = 100;
+    isCompressedOutput = false;
+    isCompressedInput = false;
+    decodedFrameIndex = -1;
+    isRecording = false;
     isBodyInfoUpdateNeeded = true;
 }
 
@@ -534,12 +863,20 @@ WorldLogFileItem::WorldLogFileItem(const WorldLogFileItem& org)
 
 WorldLogFileItem::Impl::Impl(WorldLogFileItem* self, Impl& org)
     : self(self),
-      writeBuf(ofs),
+      writer(writeQueueCapacity),
+      fileSyncMode(org.fileSyncMode),
       readBuf(ifs),
-      readBuf2(ifs)
+      readBuf2(ifs),
+      frameReadBuf(ifs)
 {
     isTimeStampSuffixEnabled = org.isTimeStampSuffixEnabled;
     recordingFrameRate = org.recordingFrameRate;
+    isCompressionEnabled = org.isCompressionEnabled;
+    keyframeInterval = org.keyframeInterval;
+    isCompressedOutput = false;
+    isCompressedInput = false;
+    decodedFrameIndex = -1;
+    isRecording = false;
     isBodyInfoUpdateNeeded = true;
 }
 
@@ -627,6 +964,30 @@ double WorldLogFileItem::recordingFrameRate() const
 }
 
 
+void WorldLogFileItem::setCompressionEnabled(bool on)
+{
+    impl->isCompressionEnabled = on;
+}
+
+
+bool WorldLogFileItem::isCompressionEnabled() const
+{
+    return impl->isCompressionEnabled;
+}
+
+
+void WorldLogFileItem::setKeyframeInterval(int numFrames)
+{
+    impl->keyframeInterval = std::max(numFrames, 1);
+}
+
+
+int WorldLogFileItem::keyframeInterval() const
+{
+    return impl->keyframeInterval;
+}
+
+
 void WorldLogFileItem::Impl::updateBodyInfos()
 {
     bodyInfos.clear();
@@ -683,23 +1044,47 @@ bool WorldLogFileItem::Impl::readTopHeader()
     currentReadFrameDataSize = 0;
     prevReadFrameOffset = 0;
     currentReadFrameTime = -1.0;
-    
+
+    frameTimes.clear();
+    framePositions.clear();
+    nextUnindexedFramePos = 0;
+    currentReadFrameIndex = -1;
+
+    isCompressedInput = false;
+    decodedFrameIndex = -1;
+
     if(ifs.is_open()){
         ifs.close();
     }
+    mappedFile.close();
     string fname = fromUTF8(getActualFilename());
     if(filesystem::exists(fname)){
         ifs.open(fname.c_str(), ios::in | ios::binary);
         if(ifs.is_open()){
+            // The file being recorded is read with the stream because it is still growing
+            if(!isRecording){
+                mappedFile.open(fname);
+            }
             readBuf.clear();
             try {
-                int headerSize = readBuf.readSeekOffset();
+                int headerSize = readBuf.readInt();
+                if(headerSize < 0){
+                    if(-headerSize != compressedFormatVersion){
+                        throw CorruptLogException();
+                    }
+                    isCompressedInput = true;
+                    headerSize = readBuf.readSeekOffset();
+                }
                 if(readBuf.checkSize(headerSize)){
                     while(!readBuf.isEnd()){
                         bodyNames.push_back(readBuf.readString());
                     }
                     currentReadFramePos = readBuf.pos;
+                    nextUnindexedFramePos = readBuf.pos;
                     result = readFrameHeader(readBuf.pos);
+                    if(result){
+                        loadFrameIndexFile();
+                    }
                 }
             } catch(CorruptLogException&){
                 bodyNames.clear();
@@ -716,7 +1101,7 @@ bool WorldLogFileItem::Impl::readTopHeader()
 }
 
 
-bool WorldLogFileItem::Impl::readFrameHeader(int pos)
+bool WorldLogFileItem::Impl::readFrameHeader(int64_t pos)
 {
     isCurrentFrameDataLoaded = false;
     
@@ -724,6 +1109,15 @@ bool WorldLogFileItem::Impl::readFrameHeader(int pos)
         return false;
     }
 
+    if(mappedFile.contains(pos, frameHeaderSize)){
+        readBuf.setExternalData(mappedFile.data() + pos, frameHeaderSize);
+        currentReadFramePos = pos;
+        prevReadFrameOffset = readBuf.readSeekOffset();
+        currentReadFrameTime = readBuf.readFloat();
+        currentReadFrameDataSize = readBuf.readSeekOffset();
+        return true;
+    }
+
     ifs.seekg(pos);
 
     if(ifs.eof()){
@@ -746,58 +1140,242 @@ bool WorldLogFileItem::Impl::readFrameHeader(int pos)
 }
         
         
-bool WorldLogFileItem::Impl::seek(double time)
+string WorldLogFileItem::Impl::getFrameIndexFilename()
 {
-    isOverRange = false;
+    return fromUTF8(getActualFilename()) + ".index";
+}
 
-    if(!readFrameHeader(currentReadFramePos)){
-        readTopHeader();
+
+/**
+   The index file is only used when it was written for the current log file,
+   which is checked with the size of the log file.
+*/
+bool WorldLogFileItem::Impl::loadFrameIndexFile()
+{
+    string fname = getFrameIndexFilename();
+    stdx::error_code ec;
+    if(!filesystem::exists(fname, ec)){
+        return false;
     }
-    
-    if(currentReadFrameTime == time){
-        return true;
+    ifstream ifs2(fname.c_str(), ios::in | ios::binary);
+    if(!ifs2.is_open()){
+        return false;
     }
-
-    if(currentReadFrameTime < time){
-        while(true){
-            int pos = currentReadFramePos;
-            if(!readFrameHeader(currentReadFramePos + frameHeaderSize + currentReadFrameDataSize)){
-                isOverRange = true;
-                return (currentReadFrameTime >= 0.0);
-            }
-            if(currentReadFrameTime == time){
-                return true;
-            } else if(currentReadFrameTime > time){
-                return readFrameHeader(pos);
-            }
+    ReadBuf buf(ifs2);
+    vector<double> times;
+    vector<int64_t> positions;
+    int64_t endPos;
+    try {
+        if(buf.readInt() != frameIndexFileFormatVersion){
+            return false;
+        }
+        int64_t logFileSize = buf.readInt64();
+        if(logFileSize != static_cast<int64_t>(filesystem::file_size(fromUTF8(getActualFilename()), ec))){
+            return false;
+        }
+        endPos = buf.readInt64();
+        int numFrames = buf.readSeekOffset();
+        times.resize(numFrames);
+        positions.resize(numFrames);
+        for(int i=0; i < numFrames; ++i){
+            times[i] = buf.readFloat();
+            positions[i] = buf.readInt64();
         }
     }
+    catch(CorruptLogException&){
+        return false;
+    }
+    if(positions.empty() || positions.front() != nextUnindexedFramePos){
+        return false;
+    }
+    frameTimes.swap(times);
+    framePositions.swap(positions);
+    nextUnindexedFramePos = endPos;
+    return true;
+}
 
-    // currentReadFrameTime > time
-    while(true){
-        if(prevReadFrameOffset <= 0){
-            isOverRange = true;
-            return (currentReadFrameTime >= 0.0);
+
+/**
+   The frames that are not covered by the index file are indexed by reading the frame headers
+   until a frame after the given time is found. This is only done once for each frame.
+*/
+bool WorldLogFileItem::Impl::extendFrameIndex(double time)
+{
+    bool extended = false;
+    while(frameTimes.empty() || frameTimes.back() <= time){
+        if(!readFrameHeader(nextUnindexedFramePos)){
+            break;
         }
-        if(!readFrameHeader(currentReadFramePos - prevReadFrameOffset)){
+        frameTimes.push_back(currentReadFrameTime);
+        framePositions.push_back(currentReadFramePos);
+        nextUnindexedFramePos = currentReadFramePos + frameHeaderSize + currentReadFrameDataSize;
+        extended = true;
+    }
+    return extended;
+}
+
+
+bool WorldLogFileItem::Impl::seek(double time)
+{
+    isOverRange = false;
+
+    if(!ifs.is_open() || frameTimes.empty()){
+        if(!readTopHeader()){
             return false;
         }
-        if(currentReadFrameTime <= time){
-            return true;
-        }
     }
+    if(frameTimes.empty() || frameTimes.back() <= time){
+        extendFrameIndex(time);
+    }
+    if(frameTimes.empty()){
+        return false;
+    }
+
+    // The last frame whose time is not greater than the given time
+    int index = std::upper_bound(frameTimes.begin(), frameTimes.end(), time) - frameTimes.begin() - 1;
+    if(index < 0){
+        index = 0;
+        isOverRange = true;
+    } else if(index == static_cast<int>(frameTimes.size()) - 1 && frameTimes[index] < time){
+        isOverRange = true;
+    }
+
+    if(!readFrameHeader(framePositions[index])){
+        return false;
+    }
+    currentReadFrameIndex = index;
+    return (currentReadFrameTime >= 0.0);
 }
 
 
 bool WorldLogFileItem::Impl::loadCurrentFrameData()
 {
-    ifs.seekg(currentReadFramePos + frameHeaderSize);
+    if(isCompressedInput){
+        isCurrentFrameDataLoaded = decodeFrame(currentReadFrameIndex);
+        if(isCurrentFrameDataLoaded){
+            readBuf.setExternalData(decodedFrameData.data(), decodedFrameData.size());
+        }
+        return isCurrentFrameDataLoaded;
+    }
+
+    int64_t pos = currentReadFramePos + frameHeaderSize;
+    if(mappedFile.contains(pos, currentReadFrameDataSize)){
+        readBuf.setExternalData(mappedFile.data() + pos, currentReadFrameDataSize);
+        isCurrentFrameDataLoaded = true;
+        return true;
+    }
+    ifs.seekg(pos);
     readBuf.clear();
     isCurrentFrameDataLoaded = readBuf.checkSize(currentReadFrameDataSize);
     return isCurrentFrameDataLoaded;
 }
 
 
+/**
+   A frame of the compressed format consists of the frame type, the size of the original data
+   and the data compressed with zlib. The original data of a delta frame is given by the XOR
+   of the decompressed data and the original data of the previous frame.
+*/
+bool WorldLogFileItem::Impl::readCompressedFrame(int frameIndex, char& out_frameType, bool doInflate)
+{
+    int64_t pos = framePositions[frameIndex];
+    if(mappedFile.contains(pos, frameHeaderSize)){
+        frameReadBuf.setExternalData(mappedFile.data() + pos, frameHeaderSize);
+    } else {
+        ifs.seekg(pos);
+        frameReadBuf.clear();
+        if(!frameReadBuf.checkSize(frameHeaderSize)){
+            return false;
+        }
+    }
+    frameReadBuf.readSeekOffset();
+    frameReadBuf.readFloat();
+    const int dataSize = frameReadBuf.readSeekOffset();
+    const int readSize = doInflate ? dataSize : 1;
+
+    pos += frameHeaderSize;
+    if(mappedFile.contains(pos, readSize)){
+        frameReadBuf.setExternalData(mappedFile.data() + pos, readSize);
+    } else {
+        ifs.seekg(pos);
+        frameReadBuf.clear();
+        if(!frameReadBuf.checkSize(readSize)){
+            return false;
+        }
+    }
+    out_frameType = frameReadBuf.readOctet();
+    if(!doInflate){
+        return true;
+    }
+    uLongf size = frameReadBuf.readSeekOffset();
+    inflatedFrameData.resize(size);
+    if(size > 0){
+        const int compressedSize = dataSize - frameReadBuf.pos;
+        if(compressedSize < 0 ||
+           uncompress(reinterpret_cast<Bytef*>(inflatedFrameData.data()), &size,
+                      reinterpret_cast<const Bytef*>(frameReadBuf.current()), compressedSize) != Z_OK ||
+           size != inflatedFrameData.size()){
+            throw CorruptLogException();
+        }
+    }
+    return true;
+}
+
+
+/**
+   The frame is decoded from the nearest keyframe, so the cost of the random access is bounded
+   by the keyframe interval. The decoding continues from the last decoded frame in the playback.
+*/
+bool WorldLogFileItem::Impl::decodeFrame(int frameIndex)
+{
+    if(frameIndex < 0){
+        return false;
+    }
+    if(frameIndex == decodedFrameIndex){
+        return true;
+    }
+    char frameType;
+    int keyframeIndex = frameIndex;
+    while(true){
+        if(keyframeIndex == decodedFrameIndex){
+            break;
+        }
+        if(!readCompressedFrame(keyframeIndex, frameType, false)){
+            return false;
+        }
+        if(frameType == KEY_FRAME){
+            break;
+        }
+        if(--keyframeIndex < 0){
+            throw CorruptLogException();
+        }
+    }
+    int startIndex = keyframeIndex;
+    if(keyframeIndex == decodedFrameIndex){
+        startIndex = decodedFrameIndex + 1;
+    }
+    decodedFrameIndex = -1;
+    for(int i = startIndex; i <= frameIndex; ++i){
+        if(!readCompressedFrame(i, frameType, true)){
+            return false;
+        }
+        if(frameType == KEY_FRAME){
+            decodedFrameData.swap(inflatedFrameData);
+        } else {
+            const size_t n = inflatedFrameData.size();
+            if(n != decodedFrameData.size()){
+                throw CorruptLogException();
+            }
+            for(size_t j=0; j < n; ++j){
+                decodedFrameData[j] ^= inflatedFrameData[j];
+            }
+        }
+    }
+    decodedFrameIndex = frameIndex;
+    return true;
+}
+
+
 /**
    @return True if the time is within the data range and the frame is correctly recalled.
    False if the time is outside the data range or the frame cannot be recalled.
@@ -983,9 +1561,15 @@ void WorldLogFileItem::Impl::readLastDeviceState(DeviceInfo& devInfo, Device* de
             devInfo.isConsistent = true;
         }
     } else {
-        ifs.seekg(pos);
+        if(mappedFile.contains(pos, 0)){
+            readBuf2.setExternalData(
+                mappedFile.data() + pos,
+                std::min(mappedFile.size() - static_cast<int64_t>(pos), static_cast<int64_t>(INT_MAX)));
+        } else {
+            ifs.seekg(pos);
+            readBuf2.clear();
+        }
         devInfo.lastStateSeekPos = pos;
-        readBuf2.clear();
         int size = readBuf2.readShort();
         if(size > 0){
             readDeviceState(devInfo, device, readBuf2, size);
@@ -1019,14 +1603,27 @@ void WorldLogFileItem::Impl::clearOutput()
     if(ifs.is_open()){
         ifs.close();
     }
-    if(ofs.is_open()){
-        ofs.close();
-    }
+    // The mapping must be released before the file is truncated
+    mappedFile.close();
+    writer.close();
+    isRecording = true;
     recordingStartTime = QDateTime::currentDateTime();
     
-    ofs.open(fromUTF8(getActualFilename()).c_str(), ios::out | ios::binary | ios::trunc);
-    writeBuf.clear();
+    isCompressedOutput = isCompressionEnabled;
+    lastOutputFrameData.clear();
+    numFramesSinceKeyframe = 0;
+    numCompressionFailures = 0;
+
+    writer.setSyncMode(fileSyncMode.which());
+    writer.open(fromUTF8(getActualFilename()));
+    writeBuf.reset();
     lastOutputFramePos = 0;
+    outputFrameTimes.clear();
+    outputFramePositions.clear();
+
+    // The index file of the previous log is invalid
+    stdx::error_code ec;
+    filesystem::remove(getFrameIndexFilename(), ec);
 
     currentDeviceStateCacheArrayIndex = 0;
     exchangeDeviceStateCacheArrays();
@@ -1052,6 +1649,9 @@ void WorldLogFileItem::Impl::fixSizeHeader()
 void WorldLogFileItem::beginHeaderOutput()
 {
     impl->writeBuf.clear();
+    if(impl->isCompressedOutput){
+        impl->writeBuf.writeInt(-compressedFormatVersion);
+    }
     impl->reserveSizeHeader();
 }
 
@@ -1074,7 +1674,7 @@ void WorldLogFileItem::endHeaderOutput()
 void WorldLogFileItem::Impl::endHeaderOutput()
 {
     fixSizeHeader();
-    writeBuf.flush();
+    writeBuf.flush(writer);
 }
 
 
@@ -1106,10 +1706,13 @@ void WorldLogFileItem::Impl::beginFrameOutput(double time)
         writeBuf.writeSeekOffset(0);
     }
     lastOutputFramePos = pos;
+    outputFrameTimes.push_back(time);
+    outputFramePositions.push_back(pos);
     
     deviceIndex = 0;
     writeBuf.writeFloat(time);
     reserveSizeHeader(); // area for the frame data size
+    outputFrameDataPos = writeBuf.size();
 }
 
 
@@ -1172,7 +1775,9 @@ void WorldLogFileItem::Impl::outputDeviceState(DeviceState* state)
         cache = new DeviceStateCache;
     } else {
         cache = (*pLastDeviceStateCacheArray)[deviceIndex];
-        if(state == cache->state){
+        // The reference to the previous state is not used in the compressed format
+        // because the unchanged state is efficiently compressed as a delta
+        if(state == cache->state && !isCompressedOutput){
             writeBuf.writeShort(-1);
             writeBuf.writeSeekOffset(cache->seekPos);
             goto endOutputDeviceState;
@@ -1212,9 +1817,138 @@ void WorldLogFileItem::endBodyStateOutput()
 
 void WorldLogFileItem::endFrameOutput()
 {
-    impl->fixSizeHeader();
-    impl->writeBuf.flush();
-    impl->exchangeDeviceStateCacheArrays();
+    impl->endFrameOutput();
+}
+
+
+void WorldLogFileItem::Impl::endFrameOutput()
+{
+    if(isCompressedOutput){
+        compressFrameData();
+    }
+    fixSizeHeader();
+    writeBuf.flush(writer);
+    exchangeDeviceStateCacheArrays();
+}
+
+
+/**
+   A keyframe is inserted at the specified interval and when the size of the frame data changes.
+*/
+void WorldLogFileItem::Impl::compressFrameData()
+{
+    const char* data = writeBuf.data.data() + outputFrameDataPos;
+    int size = writeBuf.size() - outputFrameDataPos;
+
+    bool isKeyframe = (numFramesSinceKeyframe >= keyframeInterval - 1) ||
+        (size != static_cast<int>(lastOutputFrameData.size()));
+    if(isKeyframe){
+        deltaBuf.assign(data, data + size);
+        numFramesSinceKeyframe = 0;
+    } else {
+        deltaBuf.resize(size);
+        for(int i=0; i < size; ++i){
+            deltaBuf[i] = data[i] ^ lastOutputFrameData[i];
+        }
+        ++numFramesSinceKeyframe;
+    }
+    lastOutputFrameData.assign(data, data + size);
+
+    uLongf compressedSize = compressBound(size);
+    compressionBuf.resize(compressedSize);
+    if(compress2(compressionBuf.data(), &compressedSize,
+                 reinterpret_cast<const Bytef*>(deltaBuf.data()), size, Z_BEST_SPEED) != Z_OK){
+        // The frame is stored as an empty keyframe, and the next frame is also a keyframe
+        ++numCompressionFailures;
+        isKeyframe = true;
+        size = 0;
+        compressedSize = 0;
+        lastOutputFrameData.clear();
+        numFramesSinceKeyframe = keyframeInterval;
+    }
+
+    writeBuf.data.resize(outputFrameDataPos);
+    writeBuf.writeOctet(isKeyframe ? KEY_FRAME : DELTA_FRAME);
+    writeBuf.writeInt(size);
+    writeBuf.data.insert(writeBuf.data.end(), compressionBuf.begin(), compressionBuf.begin() + compressedSize);
+}
+
+
+/**
+   This function writes the index file of the frames. The index file enables the
+   random access to the frames without reading all the frame headers.
+*/
+void WorldLogFileItem::endOutput()
+{
+    impl->endOutput();
+}
+
+
+void WorldLogFileItem::Impl::endOutput()
+{
+    if(!writer.isOpen()){
+        return;
+    }
+    // The index must be written after all the frames are written to the log file
+    writer.close();
+    if(!outputFramePositions.empty()){
+        writeFrameIndexFile();
+    }
+    isRecording = false;
+
+    int numBackPressuredFrames = writer.numBackPressuredBlocks;
+    int numDroppedFrames = writer.numDroppedBlocks;
+    if(numBackPressuredFrames > 0 || numDroppedFrames > 0){
+        MessageView::instance()->putln(
+            format(_("{0}: {1} frames waited for the log file writer and {2} frames could not be written."),
+                   self->displayName(), numBackPressuredFrames, numDroppedFrames),
+            numDroppedFrames > 0 ? MessageView::Warning : MessageView::Normal);
+    }
+    if(numCompressionFailures > 0){
+        MessageView::instance()->putln(
+            format(_("{0}: {1} frames could not be compressed and were recorded without the states."),
+                   self->displayName(), numCompressionFailures),
+            MessageView::Warning);
+    }
+
+    // Reopen the log to read the completed file with the mapping and the index
+    if(ifs.is_open()){
+        readTopHeader();
+    }
+}
+
+
+void WorldLogFileItem::Impl::writeFrameIndexFile()
+{
+    int64_t logFileSize = writeBuf.seekPos();
+    
+    ofstream ofs2(getFrameIndexFilename().c_str(), ios::out | ios::binary | ios::trunc);
+    if(!ofs2.is_open()){
+        return;
+    }
+    WriteBuf buf;
+    buf.writeInt(frameIndexFileFormatVersion);
+    buf.writeInt64(logFileSize);
+    buf.writeInt64(logFileSize); // end position of the indexed frames
+    const int numFrames = outputFramePositions.size();
+    buf.writeInt(numFrames);
+    for(int i=0; i < numFrames; ++i){
+        buf.writeFloat(outputFrameTimes[i]);
+        buf.writeInt64(outputFramePositions[i]);
+    }
+    ofs2.write(buf.data.data(), buf.data.size());
+}
+
+
+int WorldLogFileItem::numBackPressuredFrames() const
+{
+    return impl->writer.numBackPressuredBlocks;
+}
+
+
+int WorldLogFileItem::numDroppedFrames() const
+{
+    return impl->writer.numDroppedBlocks;
 }
 
 
@@ -1239,6 +1973,14 @@ void WorldLogFileItem::doPutProperties(PutPropertyFunction& putProperty)
                 changeProperty(impl->isTimeStampSuffixEnabled));
     putProperty(_("Recording frame rate"), impl->recordingFrameRate,
                 changeProperty(impl->recordingFrameRate));
+    putProperty(_("Compression"), impl->isCompressionEnabled,
+                changeProperty(impl->isCompressionEnabled));
+    putProperty.min(1)(_("Keyframe interval"), impl->keyframeInterval,
+                       changeProperty(impl->keyframeInterval));
+    putProperty(_("File sync"), impl->fileSyncMode,
+                [&](int index){ return impl->fileSyncMode.selectIndex(index); });
+    putProperty(_("Back-pressured frames"), numBackPressuredFrames());
+    putProperty(_("Dropped frames"), numDroppedFrames());
 }
 
 
@@ -1247,6 +1989,9 @@ bool WorldLogFileItem::store(Archive& archive)
     archive.writeFileInformation(this);
     archive.write("timeStampSuffix", impl->isTimeStampSuffixEnabled);
     archive.write("recordingFrameRate", impl->recordingFrameRate);
+    archive.write("compression", impl->isCompressionEnabled);
+    archive.write("keyframeInterval", impl->keyframeInterval);
+    archive.write("fileSyncMode", impl->fileSyncMode.selectedSymbol(), DOUBLE_QUOTED);
     return true;
 }
 
@@ -1255,6 +2000,12 @@ bool WorldLogFileItem::restore(const Archive& archive)
 {
     archive.read("timeStampSuffix", impl->isTimeStampSuffixEnabled);
     archive.read("recordingFrameRate", impl->recordingFrameRate);
+    archive.read("compression", impl->isCompressionEnabled);
+    archive.read("keyframeInterval", impl->keyframeInterval);
+    std::string symbol;
+    if(archive.read("fileSyncMode", symbol)){
+        impl->fileSyncMode.select(symbol);
+    }
 
     std::string filename;
     if(archive.read({ "file", "filename" }, filename)){
@@ -26,6 +26,15 @@ public:
     void setRecordingFrameRate(double rate);
     double recordingFrameRate() const;
 
+    /**
+       The frames are compressed with the XOR delta from the previous frame in the compressed
+       format. A keyframe, which does not depend on the previous frame, is inserted at the interval.
+    */
+    void setCompressionEnabled(bool on);
+    bool isCompressionEnabled() const;
+    void setKeyframeInterval(int numFrames);
+    int keyframeInterval() const;
+
     void clearOutput();
     void beginHeaderOutput();
     int outputBodyHeader(const std::string& name);
@@ -40,6 +49,16 @@ public:
     void endDeviceStateOutput();
     void endBodyStateOutput();
     void endFrameOutput();
+    //! This function must be called when the recording finishes to write the frame index.
+    void endOutput();
+
+    /**
+       The frames are written to the file by a background thread. These functions return the
+       numbers of the frames that waited for the full write queue and that could not be written
+       in the last recording.
+    */
+    int numBackPressuredFrames() const;
+    int numDroppedFrames() const;
 
     int numBodies() const;
     const std::string& bodyName(int bodyIndex) const;
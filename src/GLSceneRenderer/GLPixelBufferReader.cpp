@@ -0,0 +1,224 @@
+#include "GLPixelBufferReader.h"
+#include "glcore.h"
+#include <vector>
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+using namespace cnoid;
+
+namespace cnoid {
+
+class GLPixelBufferReader::Impl
+{
+public:
+    struct Buffer
+    {
+        GLuint pbo;
+        GLsync fence;
+    };
+    vector<Buffer> buffers;
+    PixelFormat format;
+    int width;
+    int height;
+    size_t dataSize;
+    int head; // the index of the oldest pending reading
+    int numPendingReadings;
+    bool isInitialized;
+
+    Impl(PixelFormat format, int numBuffers);
+    bool initialize(int width, int height);
+    void release();
+    bool startReading();
+    bool fetch(void* out_pixels);
+    void clear();
+};
+
+}
+
+
+GLPixelBufferReader::GLPixelBufferReader(PixelFormat format, int numBuffers)
+{
+    impl = new Impl(format, numBuffers);
+}
+
+
+GLPixelBufferReader::Impl::Impl(PixelFormat format, int numBuffers)
+    : buffers(std::max(numBuffers, 1)),
+      format(format)
+{
+    for(auto& buffer : buffers){
+        buffer.pbo = 0;
+        buffer.fence = nullptr;
+    }
+    width = 0;
+    height = 0;
+    dataSize = 0;
+    head = 0;
+    numPendingReadings = 0;
+    isInitialized = false;
+}
+
+
+GLPixelBufferReader::~GLPixelBufferReader()
+{
+    delete impl;
+}
+
+
+bool GLPixelBufferReader::initialize(int width, int height)
+{
+    return impl->initialize(width, height);
+}
+
+
+bool GLPixelBufferReader::Impl::initialize(int width, int height)
+{
+    release();
+
+    if(!glGenBuffers || !glFenceSync || !glClientWaitSync){
+        return false;
+    }
+
+    this->width = width;
+    this->height = height;
+    const size_t pixelSize = (format == RGB) ? 3 : sizeof(GLfloat);
+    dataSize = width * height * pixelSize;
+
+    for(auto& buffer : buffers){
+        glGenBuffers(1, &buffer.pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, dataSize, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    isInitialized = true;
+    return true;
+}
+
+
+void GLPixelBufferReader::release()
+{
+    impl->release();
+}
+
+
+void GLPixelBufferReader::Impl::release()
+{
+    if(isInitialized){
+        clear();
+        for(auto& buffer : buffers){
+            glDeleteBuffers(1, &buffer.pbo);
+            buffer.pbo = 0;
+        }
+        isInitialized = false;
+    }
+}
+
+
+int GLPixelBufferReader::numBuffers() const
+{
+    return impl->buffers.size();
+}
+
+
+int GLPixelBufferReader::numPendingReadings() const
+{
+    return impl->numPendingReadings;
+}
+
+
+size_t GLPixelBufferReader::dataSize() const
+{
+    return impl->dataSize;
+}
+
+
+bool GLPixelBufferReader::startReading()
+{
+    return impl->startReading();
+}
+
+
+bool GLPixelBufferReader::Impl::startReading()
+{
+    if(!isInitialized || numPendingReadings == static_cast<int>(buffers.size())){
+        return false;
+    }
+    auto& buffer = buffers[(head + numPendingReadings) % buffers.size()];
+
+    // The pack alignment of the context is restored after the reading
+    GLint packAlignment;
+    glGetIntegerv(GL_PACK_ALIGNMENT, &packAlignment);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.pbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    if(format == RGB){
+        glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+    } else {
+        glReadPixels(0, 0, width, height, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, packAlignment);
+
+    buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    // The commands must be flushed so that the fence is signaled without another command
+    glFlush();
+    
+    ++numPendingReadings;
+    return true;
+}
+
+
+bool GLPixelBufferReader::fetch(void* out_pixels)
+{
+    return impl->fetch(out_pixels);
+}
+
+
+bool GLPixelBufferReader::Impl::fetch(void* out_pixels)
+{
+    if(numPendingReadings == 0){
+        return false;
+    }
+    auto& buffer = buffers[head];
+
+    bool fetched = false;
+    GLenum result = glClientWaitSync(buffer.fence, 0, GL_TIMEOUT_IGNORED);
+    if(result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED){
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.pbo);
+        if(auto data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, dataSize, GL_MAP_READ_BIT)){
+            std::memcpy(out_pixels, data, dataSize);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            fetched = true;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+    glDeleteSync(buffer.fence);
+    buffer.fence = nullptr;
+
+    head = (head + 1) % buffers.size();
+    --numPendingReadings;
+
+    return fetched;
+}
+
+
+void GLPixelBufferReader::clear()
+{
+    impl->clear();
+}
+
+
+void GLPixelBufferReader::Impl::clear()
+{
+    while(numPendingReadings > 0){
+        auto& buffer = buffers[head];
+        glDeleteSync(buffer.fence);
+        buffer.fence = nullptr;
+        head = (head + 1) % buffers.size();
+        --numPendingReadings;
+    }
+    head = 0;
+}
@@ -0,0 +1,54 @@
+#ifndef CNOID_GLSCENE_RENDERER_GL_PIXEL_BUFFER_READER_H
+#define CNOID_GLSCENE_RENDERER_GL_PIXEL_BUFFER_READER_H
+
+#include <cstddef>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class reads the pixels of the current frame buffer with a ring of pixel buffer objects.
+   A reading started by startReading() is finished by fetch(), which waits for the fence of the
+   oldest reading in the ring, so the transfer can be overlapped with the following rendering.
+   The functions must be called in the OpenGL context where the reader is initialized, and the
+   context must be the one used by GLSLSceneRenderer because its OpenGL functions are used.
+*/
+class CNOID_EXPORT GLPixelBufferReader
+{
+public:
+    enum PixelFormat { RGB, Depth };
+
+    GLPixelBufferReader(PixelFormat format, int numBuffers = 2);
+    GLPixelBufferReader(const GLPixelBufferReader&) = delete;
+    GLPixelBufferReader& operator=(const GLPixelBufferReader&) = delete;
+    ~GLPixelBufferReader();
+
+    bool initialize(int width, int height);
+
+    //! This must be called before the context is destroyed to delete the buffers
+    void release();
+
+    int numBuffers() const;
+    int numPendingReadings() const;
+    std::size_t dataSize() const;
+
+    //! This returns false when all the buffers are used by the readings that have not been fetched.
+    bool startReading();
+
+    /**
+       The pixels of the oldest reading are copied to out_pixels, which must have dataSize() bytes.
+       The rows are stored from the bottom as glReadPixels does.
+    */
+    bool fetch(void* out_pixels);
+
+    //! The pending readings are discarded
+    void clear();
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
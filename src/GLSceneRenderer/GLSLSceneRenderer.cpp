@@ -10,6 +10,7 @@
 #include <cnoid/SceneCameras>
 #include <cnoid/SceneLights>
 #include <cnoid/SceneEffects>
+#include <cnoid/MeshGenerator>
 #include <cnoid/EigenUtil>
 #include <cnoid/NullOut>
 #include <fmt/format.h>
@@ -30,6 +31,14 @@ using fmt::format;
 namespace {
 
 const float MinLineWidthForPicking = 4.0f;
+
+// The shapes sharing a mesh and a material are drawn with a single instanced draw call
+// when the number of them is at least this value
+const int MinNumInstancesForInstancedDrawing = 2;
+
+// The visibility of a shape is checked with the occlusion query of its bounding box
+// when the mesh has at least this number of triangles
+const int MinNumTrianglesForOcclusionQuery = 10000;
 const bool USE_GL_FLOAT_FOR_NORMALS = false;
 
 // This does not seem to be necessary
@@ -80,16 +89,64 @@ struct SgObjectPtrHash {
 
 typedef std::unordered_map<SgObjectPtr, GLResourcePtr, SgObjectPtrHash> GLResourceMap;
 
+struct ShapeInstanceKey
+{
+    SgMesh* mesh;
+    SgMaterial* material;
+    SgTexture* texture;
+    bool operator==(const ShapeInstanceKey& rhs) const {
+        return mesh == rhs.mesh && material == rhs.material && texture == rhs.texture;
+    }
+};
+
+struct ShapeInstanceKeyHash {
+    std::size_t operator()(const ShapeInstanceKey& key) const {
+        std::hash<void*> hash;
+        return hash(key.mesh) ^ (hash(key.material) << 1) ^ (hash(key.texture) << 2);
+    }
+};
+
+struct ShapeInstanceGroup
+{
+    SgShapePtr shape;
+    Affine3Array modelTransforms;
+};
+
+/**
+   The indices of the vertex, normal, texture coordinate and color of a face vertex.
+   An index is -1 when the attribute is not used or is specified by the vertex index.
+*/
+struct FaceVertexAttributeIndices
+{
+    int indices[4];
+    bool operator==(const FaceVertexAttributeIndices& rhs) const {
+        return std::equal(indices, indices + 4, rhs.indices);
+    }
+};
+
+struct FaceVertexAttributeIndicesHash {
+    std::size_t operator()(const FaceVertexAttributeIndices& a) const {
+        std::size_t h = 0;
+        for(int i=0; i < 4; ++i){
+            h = h * 31 + std::hash<int>()(a.indices[i]);
+        }
+        return h;
+    }
+};
+
 class VertexResource : public GLResource
 {
 public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
     
-    static const int MAX_NUM_BUFFERS = 4;
+    static const int MAX_NUM_BUFFERS = 5;
     GLuint vao;
     GLuint vbos[MAX_NUM_BUFFERS];
     GLsizei numVertices;
     int numBuffers;
+    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT when the vertices are drawn with the element buffer
+    GLenum elementType;
+    size_t bufferSize;
     // Local transform is used with the short integer type vertex elements
     Matrix4* pLocalTransform;
     Matrix4 localTransform;
@@ -118,6 +175,8 @@ public:
         }
         numBuffers = 0;
         numVertices = 0;
+        elementType = 0;
+        bufferSize = 0;
     }
 
     virtual void discard() override { clearHandles(); }
@@ -146,6 +205,13 @@ public:
             }
             numBuffers = 0;
         }
+        elementType = 0;
+        bufferSize = 0;
+    }
+
+    void setBufferData(GLenum target, size_t size, const void* data){
+        glBufferData(target, size, data, GL_STATIC_DRAW);
+        bufferSize += size;
     }
 
     GLuint vbo(int index) {
@@ -259,6 +325,36 @@ public:
 typedef ref_ptr<TextResource> TextResourcePtr;
 
 
+/**
+   This keeps whether the sub tree of a transform node can be skipped when its bounding box
+   is outside the view frustum. The sub tree cannot be skipped when it contains a node that
+   is not covered by the bounding box, such as a marker or an overlay.
+*/
+class CullingInfo : public GLResource
+{
+public:
+    bool isCullable;
+    bool isCullabilityValid;
+    ScopedConnection connection;
+
+    CullingInfo(SgObject* obj)
+    {
+        isCullabilityValid = false;
+        connection =
+            obj->sigUpdated().connect(
+                [this](const SgUpdate& update){
+                    if(update.hasAction(SgUpdate::Added | SgUpdate::Removed)){
+                        isCullabilityValid = false;
+                    }
+                });
+    }
+
+    virtual void discard() override { }
+};
+
+typedef ref_ptr<CullingInfo> CullingInfoPtr;
+
+
 class ResourceRefreshGroupResource : public GLResource
 {
 public:
@@ -363,6 +459,24 @@ public:
 
     Affine3Array modelMatrixStack; // stack of the model matrices
     Affine3Array modelMatrixBuffer; // Model matrices used later are stored in this buffer
+
+    bool isInstancingEnabled;
+    bool isInstancingBeingProcessed;
+    vector<ShapeInstanceGroup> shapeInstanceGroups;
+    int numShapeInstanceGroups;
+    std::unordered_map<ShapeInstanceKey, int, ShapeInstanceKeyHash> shapeInstanceGroupMap;
+    vector<Matrix4f, Eigen::aligned_allocator<Matrix4f>> instanceMatrixBuf;
+    GLuint instanceMatrixBuffer;
+
+    bool isFrustumCullingEnabled;
+    bool isFrustumCullingBeingProcessed;
+    Vector4 frustumPlanes[6];
+    bool isOcclusionCullingEnabled;
+    bool isOcclusionCullingBeingProcessed;
+    GLuint occlusionQuery;
+    SgShapePtr occlusionQueryBox;
+    double nearClipDistance;
+
     Isometry3 viewTransform;
     Matrix4 projectionMatrix;
     Matrix4 PV;
@@ -420,10 +534,14 @@ public:
     ScopedConnection currentFogConnection;
 
     bool defaultSmoothShading;
+    bool isIndexedVertexBufferEnabled;
     bool isNormalVisualizationEnabled;
     float normalVisualizationLength;
     SgMaterialPtr normalVisualizationMaterial;
 
+    // The face vertex index of each vertex stored in the vertex buffers of a mesh
+    vector<int> meshVertexSources;
+
 #ifdef CNOID_ENABLE_FREE_TYPE
     GLFreeType freeType;
 #endif
@@ -508,6 +626,11 @@ public:
     void renderChildNodesWithNodeDecorationCheck(SgGroup* group);
     void renderGroup(SgGroup* group);
     void renderTransform(SgTransform* transform);
+    void updateFrustumPlanes();
+    bool isOutsideFrustum(const BoundingBox& bbox, const Affine3& T) const;
+    bool checkIfSubTreeCanBeCulled(SgTransform* transform, const Affine3& T);
+    bool checkIfCullableNode(SgNode* node);
+    void keepSubTreeResources(SgObject* object);
     void renderFixedPixelSizeGroup(SgFixedPixelSizeGroup* fixedPixelSizeGroup);
     void renderSwitchableGroup(SgSwitchableGroup* group);
     void renderUnpickableGroup(SgUnpickableGroup* group);
@@ -517,7 +640,13 @@ public:
     void drawVertexResource(VertexResource* resource, GLenum primitiveMode, const Affine3& modelTransform);
     void drawBoundingBox(VertexResource* resource, const BoundingBox& bbox);
     void renderShape(SgShape* shape);
+    bool canRenderShapeAsInstance() const;
+    void addShapeInstance(SgShape* shape);
+    void renderShapeInstances();
+    void renderShapeInstanceGroup(ShapeInstanceGroup& group);
+    VertexResource* setupShapeRendering(SgShape* shape, int pickIndex);
     void renderShapeMain(SgShape* shape, const Affine3& modelTransform, int pickIndex);
+    void renderShapeWithOcclusionQuery(SgShape* shape);
     void applyCullingMode(SgMesh* mesh);
     void renderShapeVertices(SgShape* shape);
     void renderPlot(
@@ -544,6 +673,9 @@ public:
     bool renderTexture(SgTexture* texture);
     bool loadTextureImage(TextureResource* resource, const Image& image);
     void makeVertexBufferObjects(SgShape* shape, VertexResource* resource);
+    void writeMeshElementIndices(
+        SgMesh* mesh, bool hasNormals, bool hasTexCoords, bool hasColors, VertexResource* resource);
+    void setNonIndexedMeshVertexSources(SgMesh* mesh);
     void writeMeshVertices(SgMesh* mesh, VertexResource* resource, SgTexture* texResource);
     template<typename value_type, GLenum gltype, GLboolean normalized, class VertexArrayWrapper>
     void writeMeshVerticesSub(SgMesh* mesh, VertexResource* resource, VertexArrayWrapper& normals);
@@ -707,6 +839,14 @@ void GLSLSceneRenderer::Impl::initialize()
     isLowMemoryConsumptionMode = false;
     isBoundingBoxRenderingMode = false;
     isBoundingBoxRenderingForLightweightRenderingGroupEnabled = false;
+    isInstancingEnabled = true;
+    isInstancingBeingProcessed = false;
+    numShapeInstanceGroups = 0;
+    isFrustumCullingEnabled = true;
+    isFrustumCullingBeingProcessed = false;
+    isOcclusionCullingEnabled = false;
+    isOcclusionCullingBeingProcessed = false;
+    nearClipDistance = 0.0;
 
     defaultFBO = 0;
     
@@ -719,6 +859,7 @@ void GLSLSceneRenderer::Impl::initialize()
     projectionMatrix.setIdentity();
 
     defaultSmoothShading = true;
+    isIndexedVertexBufferEnabled = true;
     defaultMaterial = new SgMaterial;
     defaultPointSize = 1.0f;
     defaultLineWidth = 1.0f;
@@ -883,6 +1024,12 @@ void GLSLSceneRenderer::Impl::clearGL(bool isGLContextActive, bool isCalledFromC
         if(depthBufferForOverlay){
             glDeleteRenderbuffers(1, &depthBufferForOverlay);
         }
+        if(instanceMatrixBuffer){
+            glDeleteBuffers(1, &instanceMatrixBuffer);
+        }
+        if(occlusionQuery){
+            glDeleteQueries(1, &occlusionQuery);
+        }
     }
 
     if(!isCalledFromDestructor){
@@ -908,6 +1055,8 @@ void GLSLSceneRenderer::Impl::clearGL(bool isGLContextActive, bool isCalledFromC
         colorBufferForPicking = 0;
         depthBufferForPicking = 0;
         depthBufferForOverlay = 0;
+        instanceMatrixBuffer = 0;
+        occlusionQuery = 0;
         pickingImageWidth = 0;
         pickingImageHeight = 0;
         needToUpdateOverlayDepthBufferSize = true;
@@ -970,6 +1119,30 @@ bool GLSLSceneRenderer::Impl::initializeGL()
         checkGPU();
     }
 
+    char* CNOID_ENABLE_GLSL_INDEXED_VERTEX_BUFFER = getenv("CNOID_ENABLE_GLSL_INDEXED_VERTEX_BUFFER");
+    if(CNOID_ENABLE_GLSL_INDEXED_VERTEX_BUFFER && strcmp(CNOID_ENABLE_GLSL_INDEXED_VERTEX_BUFFER, "0") == 0){
+        isIndexedVertexBufferEnabled = false;
+        os() << _("Indexed vertex buffers are disabled according to the value of CNOID_ENABLE_GLSL_INDEXED_VERTEX_BUFFER.\n");
+    }
+
+    char* CNOID_ENABLE_GLSL_INSTANCING = getenv("CNOID_ENABLE_GLSL_INSTANCING");
+    if(CNOID_ENABLE_GLSL_INSTANCING && strcmp(CNOID_ENABLE_GLSL_INSTANCING, "0") == 0){
+        isInstancingEnabled = false;
+        os() << _("Instanced drawing is disabled according to the value of CNOID_ENABLE_GLSL_INSTANCING.\n");
+    }
+
+    char* CNOID_ENABLE_GLSL_FRUSTUM_CULLING = getenv("CNOID_ENABLE_GLSL_FRUSTUM_CULLING");
+    if(CNOID_ENABLE_GLSL_FRUSTUM_CULLING && strcmp(CNOID_ENABLE_GLSL_FRUSTUM_CULLING, "0") == 0){
+        isFrustumCullingEnabled = false;
+        os() << _("View frustum culling is disabled according to the value of CNOID_ENABLE_GLSL_FRUSTUM_CULLING.\n");
+    }
+
+    char* CNOID_ENABLE_GLSL_OCCLUSION_CULLING = getenv("CNOID_ENABLE_GLSL_OCCLUSION_CULLING");
+    if(CNOID_ENABLE_GLSL_OCCLUSION_CULLING && strcmp(CNOID_ENABLE_GLSL_OCCLUSION_CULLING, "1") == 0){
+        isOcclusionCullingEnabled = true;
+        os() << _("Occlusion culling is enabled according to the value of CNOID_ENABLE_GLSL_OCCLUSION_CULLING.\n");
+    }
+
     os().flush();
 
     return initializeGLForRendering();
@@ -1305,7 +1478,19 @@ void GLSLSceneRenderer::Impl::doRender()
 
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
+        isInstancingBeingProcessed =
+            isInstancingEnabled && currentProgram == fullLightingProgram.get() && !isNormalVisualizationEnabled;
+
+        isOcclusionCullingBeingProcessed = isOcclusionCullingEnabled;
+
         renderChildNodes(self->sceneRoot());
+
+        isOcclusionCullingBeingProcessed = false;
+
+        if(isInstancingBeingProcessed){
+            renderShapeInstances();
+            isInstancingBeingProcessed = false;
+        }
         
         /*
           \todo Render transparent objects directly
@@ -1576,6 +1761,7 @@ void GLSLSceneRenderer::Impl::renderCamera(SgCamera* camera, const Isometry3& ca
         self->getPerspectiveProjectionMatrix(
             pers->fovy(aspectRatio), aspectRatio, pers->nearClipDistance(), pers->farClipDistance(),
             projectionMatrix);
+        nearClipDistance = pers->nearClipDistance();
         
     } else if(SgOrthographicCamera* ortho = dynamic_cast<SgOrthographicCamera*>(camera)){
         GLfloat left, right, bottom, top;
@@ -1583,11 +1769,13 @@ void GLSLSceneRenderer::Impl::renderCamera(SgCamera* camera, const Isometry3& ca
         self->getOrthographicProjectionMatrix(
             left, right, bottom, top, ortho->nearClipDistance(), ortho->farClipDistance(),
             projectionMatrix);
+        nearClipDistance = ortho->nearClipDistance();
         
     } else {
         self->getPerspectiveProjectionMatrix(
             radian(40.0), self->aspectRatio(), 0.01, 1.0e4,
             projectionMatrix);
+        nearClipDistance = 0.01;
     }
 
     if(isUpsideDownEnabled){
@@ -1598,6 +1786,11 @@ void GLSLSceneRenderer::Impl::renderCamera(SgCamera* camera, const Isometry3& ca
     }
     PV = projectionMatrix * viewTransform.matrix();
 
+    isFrustumCullingBeingProcessed = isFrustumCullingEnabled;
+    if(isFrustumCullingBeingProcessed){
+        updateFrustumPlanes();
+    }
+
     modelMatrixStack.clear();
     modelMatrixStack.push_back(Affine3::Identity());
     modelMatrixBuffer.clear();
@@ -2109,6 +2302,15 @@ void GLSLSceneRenderer::Impl::renderTransform(SgTransform* transform)
         Affine3 T;
         transform->getTransform(T);
         modelMatrixStack.push_back(modelMatrixStack.back() * T);
+
+        if(isFrustumCullingBeingProcessed && checkIfSubTreeCanBeCulled(transform, modelMatrixStack.back())){
+            if(isCheckingUnusedResources){
+                keepSubTreeResources(transform);
+            }
+            modelMatrixStack.pop_back();
+            return;
+        }
+
         pushPickNode(transform);
 
         renderChildNodes(transform);
@@ -2119,6 +2321,104 @@ void GLSLSceneRenderer::Impl::renderTransform(SgTransform* transform)
 }
 
 
+/**
+   The planes are extracted from the projection view matrix in the world coordinate.
+   A point p is inside the frustum when n.dot(p) + d >= 0 for all the planes (n, d).
+*/
+void GLSLSceneRenderer::Impl::updateFrustumPlanes()
+{
+    const auto r0 = PV.row(0).transpose();
+    const auto r1 = PV.row(1).transpose();
+    const auto r2 = PV.row(2).transpose();
+    const auto r3 = PV.row(3).transpose();
+    frustumPlanes[0] = r3 + r0; // left
+    frustumPlanes[1] = r3 - r0; // right
+    frustumPlanes[2] = r3 + r1; // bottom
+    frustumPlanes[3] = r3 - r1; // top
+    frustumPlanes[4] = r3 + r2; // near
+    frustumPlanes[5] = r3 - r2; // far
+}
+
+
+bool GLSLSceneRenderer::Impl::isOutsideFrustum(const BoundingBox& bbox, const Affine3& T) const
+{
+    if(bbox.empty()){
+        return false;
+    }
+    const Vector3 c = T * bbox.center();
+    const Vector3 h = 0.5 * bbox.size();
+    const Matrix3 A = T.linear();
+    for(int i=0; i < 6; ++i){
+        const Vector3 n = frustumPlanes[i].head<3>();
+        const double r = (A.transpose() * n).cwiseAbs().dot(h);
+        if(n.dot(c) + frustumPlanes[i][3] + r < 0.0){
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool GLSLSceneRenderer::Impl::checkIfSubTreeCanBeCulled(SgTransform* transform, const Affine3& T)
+{
+    if(!isOutsideFrustum(transform->untransformedBoundingBox(), T)){
+        return false;
+    }
+    auto info = getOrCreateGLResource<CullingInfo>(transform);
+    if(!info->isCullabilityValid){
+        info->isCullable = true;
+        for(auto& child : *transform){
+            if(!checkIfCullableNode(child)){
+                info->isCullable = false;
+                break;
+            }
+        }
+        info->isCullabilityValid = true;
+    }
+    return info->isCullable;
+}
+
+
+bool GLSLSceneRenderer::Impl::checkIfCullableNode(SgNode* node)
+{
+    if(node->hasAttribute(SgObject::Marker)){
+        return false;
+    }
+    if(auto group = node->toGroupNode()){
+        if(dynamic_cast<SgOverlay*>(group) || dynamic_cast<SgFixedPixelSizeGroup*>(group)){
+            return false;
+        }
+        for(auto& child : *group){
+            if(!checkIfCullableNode(child)){
+                return false;
+            }
+        }
+        return true;
+    }
+    return (dynamic_cast<SgShape*>(node) || dynamic_cast<SgPlot*>(node) ||
+            dynamic_cast<SgText*>(node) || dynamic_cast<SgPreprocessed*>(node));
+}
+
+
+/**
+   The resources of a culled sub tree are moved to the next resource map so that they
+   are not released by the unused resource check.
+*/
+void GLSLSceneRenderer::Impl::keepSubTreeResources(SgObject* object)
+{
+    auto p = currentResourceMap->find(object);
+    if(p != currentResourceMap->end()){
+        nextResourceMap->insert(*p);
+    }
+    if(object->hasAttribute(SgObject::Composite) || object->isGroupNode()){
+        int n = object->numChildObjects();
+        for(int i=0; i < n; ++i){
+            keepSubTreeResources(object->childObject(i));
+        }
+    }
+}
+
+
 void GLSLSceneRenderer::renderCustomTransform(SgTransform* transform, std::function<void()> traverseFunction)
 {
     Affine3 T;
@@ -2178,7 +2478,11 @@ void GLSLSceneRenderer::Impl::drawVertexResource
 {
     currentProgram->setTransform(PV, viewTransform, modelTransform, resource->pLocalTransform);
     glBindVertexArray(resource->vao);
-    glDrawArrays(primitiveMode, 0, resource->numVertices);
+    if(resource->elementType){
+        glDrawElements(primitiveMode, resource->numVertices, resource->elementType, nullptr);
+    } else {
+        glDrawArrays(primitiveMode, 0, resource->numVertices);
+    }
 }
 
 
@@ -2221,6 +2525,12 @@ void GLSLSceneRenderer::Impl::renderShape(SgShape* shape)
 {
     SgMesh* mesh = shape->mesh();
     if(mesh && mesh->hasVertices()){
+        if(isFrustumCullingBeingProcessed && isOutsideFrustum(mesh->boundingBox(), modelMatrixStack.back())){
+            if(isCheckingUnusedResources){
+                keepSubTreeResources(shape);
+            }
+            return;
+        }
         SgMaterial* material = shape->material();
         bool isTransparent = false;
         if(currentProgram->hasCapability(ShaderProgram::Transparency)){
@@ -2229,9 +2539,18 @@ void GLSLSceneRenderer::Impl::renderShape(SgShape* shape)
             }
         }
         if(!isTransparent){
-            auto pickIndex = pushPickEndNode(shape, false);
-            renderShapeMain(shape, modelMatrixStack.back(), pickIndex);
-            popPickNode();
+            if(isOcclusionCullingBeingProcessed && !isBoundingBoxRenderingMode &&
+               mesh->numTriangles() >= MinNumTrianglesForOcclusionQuery){
+                pushPickEndNode(shape, false);
+                renderShapeWithOcclusionQuery(shape);
+                popPickNode();
+            } else if(canRenderShapeAsInstance()){
+                addShapeInstance(shape);
+            } else {
+                auto pickIndex = pushPickEndNode(shape, false);
+                renderShapeMain(shape, modelMatrixStack.back(), pickIndex);
+                popPickNode();
+            }
         } else {
             if(!isRenderingShadowMap){
                 SgShapePtr shapePtr = shape;
@@ -2248,7 +2567,106 @@ void GLSLSceneRenderer::Impl::renderShape(SgShape* shape)
 }
 
 
-void GLSLSceneRenderer::Impl::renderShapeMain(SgShape* shape, const Affine3& modelTransform, int pickIndex)
+/**
+   The instanced drawing is only applied to the opaque shapes rendered by the full lighting
+   program in the visible image rendering. The picking image is rendered without it so that
+   each shape can be picked individually.
+*/
+bool GLSLSceneRenderer::Impl::canRenderShapeAsInstance() const
+{
+    return isInstancingBeingProcessed &&
+        currentProgram == fullLightingProgram.get() &&
+        !isBoundingBoxRenderingMode &&
+        !isLowMemoryConsumptionRenderingBeingProcessed &&
+        solidWireframeStyleStack.empty();
+}
+
+
+void GLSLSceneRenderer::Impl::addShapeInstance(SgShape* shape)
+{
+    ShapeInstanceKey key = { shape->mesh(), shape->material(), shape->texture() };
+    auto inserted = shapeInstanceGroupMap.emplace(key, numShapeInstanceGroups);
+    if(inserted.second){
+        if(numShapeInstanceGroups == static_cast<int>(shapeInstanceGroups.size())){
+            shapeInstanceGroups.emplace_back();
+        }
+        shapeInstanceGroups[numShapeInstanceGroups++].shape = shape;
+    }
+    shapeInstanceGroups[inserted.first->second].modelTransforms.push_back(modelMatrixStack.back());
+}
+
+
+void GLSLSceneRenderer::Impl::renderShapeInstances()
+{
+    for(int i=0; i < numShapeInstanceGroups; ++i){
+        auto& group = shapeInstanceGroups[i];
+        if(group.modelTransforms.size() >= MinNumInstancesForInstancedDrawing){
+            renderShapeInstanceGroup(group);
+        } else {
+            for(auto& T : group.modelTransforms){
+                renderShapeMain(group.shape, T, 0);
+            }
+        }
+        group.shape.reset();
+        group.modelTransforms.clear();
+    }
+    numShapeInstanceGroups = 0;
+    shapeInstanceGroupMap.clear();
+}
+
+
+void GLSLSceneRenderer::Impl::renderShapeInstanceGroup(ShapeInstanceGroup& group)
+{
+    auto resource = setupShapeRendering(group.shape, 0);
+    applyCullingMode(group.shape->mesh());
+
+    // The vertices stored in the low memory consumption mode need the local transform
+    if(resource->pLocalTransform){
+        for(auto& T : group.modelTransforms){
+            drawVertexResource(resource, GL_TRIANGLES, T);
+        }
+        return;
+    }
+    
+    fullLightingProgram->setInstancedTransform(PV, viewTransform);
+
+    const int numInstances = group.modelTransforms.size();
+    instanceMatrixBuf.resize(numInstances);
+    for(int i=0; i < numInstances; ++i){
+        instanceMatrixBuf[i] = group.modelTransforms[i].matrix().cast<float>();
+    }
+
+    if(!instanceMatrixBuffer){
+        glGenBuffers(1, &instanceMatrixBuffer);
+    }
+    {
+        LockVertexArrayAPI lock;
+        glBindVertexArray(resource->vao);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceMatrixBuffer);
+        for(int i=0; i < 4; ++i){
+            const GLuint location = 4 + i;
+            glVertexAttribPointer(
+                location, 4, GL_FLOAT, GL_FALSE, sizeof(Matrix4f), ((GLubyte*)NULL + (i * 4 * sizeof(float))));
+            glVertexAttribDivisor(location, 1);
+            glEnableVertexAttribArray(location);
+        }
+    }
+    glBufferData(GL_ARRAY_BUFFER, numInstances * sizeof(Matrix4f), instanceMatrixBuf.data(), GL_STREAM_DRAW);
+
+    if(resource->elementType){
+        glDrawElementsInstanced(GL_TRIANGLES, resource->numVertices, resource->elementType, nullptr, numInstances);
+    } else {
+        glDrawArraysInstanced(GL_TRIANGLES, 0, resource->numVertices, numInstances);
+    }
+
+    // The instance attributes must not be used by the usual drawing with the vertex array
+    for(int i=0; i < 4; ++i){
+        glDisableVertexAttribArray(4 + i);
+    }
+}
+
+
+VertexResource* GLSLSceneRenderer::Impl::setupShapeRendering(SgShape* shape, int pickIndex)
 {
     auto mesh = shape->mesh();
     
@@ -2275,6 +2693,15 @@ void GLSLSceneRenderer::Impl::renderShapeMain(SgShape* shape, const Affine3& mod
     if(!resource->isValid()){
         makeVertexBufferObjects(shape, resource);
     }
+    return resource;
+}
+
+
+void GLSLSceneRenderer::Impl::renderShapeMain(SgShape* shape, const Affine3& modelTransform, int pickIndex)
+{
+    auto mesh = shape->mesh();
+    auto resource = setupShapeRendering(shape, pickIndex);
+
     if(isBoundingBoxRenderingMode){
         drawBoundingBox(resource, mesh->boundingBox());
     } else {
@@ -2290,6 +2717,65 @@ void GLSLSceneRenderer::Impl::renderShapeMain(SgShape* shape, const Affine3& mod
 }
 
 
+/**
+   The bounding box of the shape is drawn with the occlusion query before the shape, and
+   the shape is drawn with the conditional rendering on the result of the query. The GPU
+   waits for the result, so the CPU does not stall and the rendered image is not changed.
+*/
+void GLSLSceneRenderer::Impl::renderShapeWithOcclusionQuery(SgShape* shape)
+{
+    const Affine3& T = modelMatrixStack.back();
+    const BoundingBox& bbox = shape->mesh()->boundingBox();
+
+    // The bounding box faces are clipped when the camera is in or near the box
+    if(bbox.empty()){
+        renderShapeMain(shape, T, 0);
+        return;
+    }
+    BoundingBox wbbox = bbox;
+    wbbox.transform(T);
+    const Vector3 margin = Vector3::Constant(nearClipDistance + 1.0e-3);
+    const Vector3 eye = viewTransform.inverse(Eigen::Isometry).translation();
+    if((eye.array() > (wbbox.min() - margin).array()).all() &&
+       (eye.array() < (wbbox.max() + margin).array()).all()){
+        renderShapeMain(shape, T, 0);
+        return;
+    }
+
+    if(!occlusionQuery){
+        glGenQueries(1, &occlusionQuery);
+    }
+    if(!occlusionQueryBox){
+        occlusionQueryBox = new SgShape;
+        MeshGenerator meshGenerator;
+        occlusionQueryBox->setMesh(meshGenerator.generateBox(Vector3(1.0, 1.0, 1.0)));
+    }
+    Affine3 Tb = T;
+    Tb.translate(bbox.center());
+    Tb.scale(bbox.size());
+
+    {
+        ScopedShaderProgramActivator programActivator(nolightingProgram.get(), this);
+        VertexResource* resource = getOrCreateVertexResource(occlusionQueryBox->mesh());
+        if(!resource->isValid()){
+            makeVertexBufferObjects(occlusionQueryBox, resource);
+        }
+        applyCullingMode(occlusionQueryBox->mesh());
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthMask(GL_FALSE);
+        glBeginQuery(GL_ANY_SAMPLES_PASSED, occlusionQuery);
+        drawVertexResource(resource, GL_TRIANGLES, Tb);
+        glEndQuery(GL_ANY_SAMPLES_PASSED);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthMask(GL_TRUE);
+    }
+
+    glBeginConditionalRender(occlusionQuery, GL_QUERY_BY_REGION_WAIT);
+    renderShapeMain(shape, T, 0);
+    glEndConditionalRender();
+}
+
+
 void GLSLSceneRenderer::Impl::applyCullingMode(SgMesh* mesh)
 {
     if(!stateFlag[CULL_FACE]){
@@ -2428,6 +2914,18 @@ bool GLSLSceneRenderer::Impl::loadTextureImage(TextureResource* resource, const
 void GLSLSceneRenderer::Impl::makeVertexBufferObjects(SgShape* shape, VertexResource* resource)
 {
     auto mesh = shape->mesh();
+    auto texture = shape->texture();
+    const bool hasTexCoords = texture && mesh->hasTexCoords() && isTextureBeingRendered;
+
+    /*
+      The vertices sharing all the attributes are stored only once and drawn with the
+      element buffer. Flat shading needs a normal for each triangle and cannot share them.
+    */
+    if(isIndexedVertexBufferEnabled && defaultSmoothShading){
+        writeMeshElementIndices(mesh, mesh->hasNormals(), hasTexCoords, mesh->hasColors(), resource);
+    } else {
+        setNonIndexedMeshVertexSources(mesh);
+    }
 
     if(isLowMemoryConsumptionRenderingBeingProcessed){
         writeMeshVerticesNormalizedShort(mesh, resource);
@@ -2444,8 +2942,7 @@ void GLSLSceneRenderer::Impl::makeVertexBufferObjects(SgShape* shape, VertexReso
         writeMeshNormalsShort(mesh, resource);
     } 
 
-    auto texture = shape->texture();
-    if(texture && mesh->hasTexCoords() && isTextureBeingRendered){
+    if(hasTexCoords){
         if(isLowMemoryConsumptionRenderingBeingProcessed){
             writeMeshTexCoordsHalfFloat(mesh, texture, resource);
         } else {
@@ -2459,25 +2956,95 @@ void GLSLSceneRenderer::Impl::makeVertexBufferObjects(SgShape* shape, VertexReso
 }
 
 
+void GLSLSceneRenderer::Impl::writeMeshElementIndices
+(SgMesh* mesh, bool hasNormals, bool hasTexCoords, bool hasColors, VertexResource* resource)
+{
+    auto& triangleVertices = mesh->triangleVertices();
+    const int numFaceVertices = triangleVertices.size();
+    const auto& normalIndices = mesh->normalIndices();
+    const auto& texCoordIndices = mesh->texCoordIndices();
+    const auto& colorIndices = mesh->colorIndices();
+    const bool hasNormalIndices = hasNormals && !normalIndices.empty();
+    const bool hasTexCoordIndices = hasTexCoords && !texCoordIndices.empty();
+    const bool hasColorIndices = hasColors && !colorIndices.empty();
+
+    meshVertexSources.clear();
+    vector<GLuint> indices(numFaceVertices);
+
+    if(!hasNormalIndices && !hasTexCoordIndices && !hasColorIndices){
+        // All the attributes are specified by the vertex index
+        vector<int> vertexMap(mesh->vertices()->size(), -1);
+        for(int i=0; i < numFaceVertices; ++i){
+            int& index = vertexMap[triangleVertices[i]];
+            if(index < 0){
+                index = meshVertexSources.size();
+                meshVertexSources.push_back(i);
+            }
+            indices[i] = index;
+        }
+    } else {
+        // A vertex is split for each combination of the attributes
+        std::unordered_map<FaceVertexAttributeIndices, int, FaceVertexAttributeIndicesHash> vertexMap;
+        vertexMap.reserve(numFaceVertices);
+        for(int i=0; i < numFaceVertices; ++i){
+            FaceVertexAttributeIndices key = {{
+                    triangleVertices[i],
+                    hasNormalIndices ? normalIndices[i] : -1,
+                    hasTexCoordIndices ? texCoordIndices[i] : -1,
+                    hasColorIndices ? colorIndices[i] : -1 }};
+            auto inserted = vertexMap.emplace(key, meshVertexSources.size());
+            if(inserted.second){
+                meshVertexSources.push_back(i);
+            }
+            indices[i] = inserted.first->second;
+        }
+    }
+
+    const int numVertices = meshVertexSources.size();
+    if(numVertices == numFaceVertices){
+        // No vertex is shared
+        return;
+    }
+
+    {
+        LockVertexArrayAPI lock;
+        glBindVertexArray(resource->vao);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, resource->newBuffer());
+    }
+    if(numVertices <= 65536){
+        vector<GLushort> shortIndices(indices.begin(), indices.end());
+        resource->setBufferData(
+            GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(GLushort), shortIndices.data());
+        resource->elementType = GL_UNSIGNED_SHORT;
+    } else {
+        resource->setBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data());
+        resource->elementType = GL_UNSIGNED_INT;
+    }
+}
+
+
+void GLSLSceneRenderer::Impl::setNonIndexedMeshVertexSources(SgMesh* mesh)
+{
+    const int numFaceVertices = mesh->triangleVertices().size();
+    meshVertexSources.resize(numFaceVertices);
+    for(int i=0; i < numFaceVertices; ++i){
+        meshVertexSources[i] = i;
+    }
+}
+
+
 template<typename value_type, GLenum gltype, GLboolean normalized, class VertexArrayWrapper>
 void GLSLSceneRenderer::Impl::writeMeshVerticesSub
 (SgMesh* mesh, VertexResource* resource, VertexArrayWrapper& vertices)
 {
     const auto& orgVertices = *mesh->vertices();
     auto& triangleVertices = mesh->triangleVertices();
-    const int totalNumVertices = triangleVertices.size();
-    const int numTriangles = mesh->numTriangles();
-    resource->numVertices = totalNumVertices;
+    resource->numVertices = triangleVertices.size();
 
-    int faceVertexIndex = 0;
+    vertices.array.reserve(meshVertexSources.size());
     
-    vertices.array.reserve(totalNumVertices);
-    
-    for(int i=0; i < numTriangles; ++i){
-        for(int j=0; j < 3; ++j){
-            const int orgVertexIndex = triangleVertices[faceVertexIndex++];
-            vertices.append(orgVertices[orgVertexIndex]);
-        }
+    for(auto faceVertexIndex : meshVertexSources){
+        vertices.append(orgVertices[triangleVertices[faceVertexIndex]]);
     }
 
     {
@@ -2487,7 +3054,7 @@ void GLSLSceneRenderer::Impl::writeMeshVerticesSub
         glVertexAttribPointer((GLuint)0, 3, gltype, normalized, 0, ((GLubyte*)NULL + (0)));
     }
     auto size = vertices.array.size() * sizeof(value_type);
-    glBufferData(GL_ARRAY_BUFFER, size, vertices.array.data(), GL_STATIC_DRAW);
+    resource->setBufferData(GL_ARRAY_BUFFER, size, vertices.array.data());
     glEnableVertexAttribArray(0);
 }
 
@@ -2556,42 +3123,37 @@ bool GLSLSceneRenderer::Impl::writeMeshNormalsSub
     bool ready = false;
     
     auto& triangleVertices = mesh->triangleVertices();
-    const int totalNumVertices = triangleVertices.size();
-    const int numTriangles = mesh->numTriangles();
     
-    normals.array.reserve(totalNumVertices);
+    normals.array.reserve(meshVertexSources.size());
 
     if(!defaultSmoothShading){
         // flat shading
         const auto& orgVertices = *mesh->vertices();
-        for(int i=0; i < numTriangles; ++i){
-            SgMesh::TriangleRef triangle = mesh->triangle(i);
-            const Vector3f e1 = orgVertices[triangle[1]] - orgVertices[triangle[0]];
-            const Vector3f e2 = orgVertices[triangle[2]] - orgVertices[triangle[0]];
-            const Vector3f normal = e1.cross(e2).normalized();
-            for(int j=0; j < 3; ++j){
-                normals.append(normal);
+        int prevTriangleIndex = -1;
+        Vector3f normal;
+        for(auto faceVertexIndex : meshVertexSources){
+            const int triangleIndex = faceVertexIndex / 3;
+            if(triangleIndex != prevTriangleIndex){
+                SgMesh::TriangleRef triangle = mesh->triangle(triangleIndex);
+                const Vector3f e1 = orgVertices[triangle[1]] - orgVertices[triangle[0]];
+                const Vector3f e2 = orgVertices[triangle[2]] - orgVertices[triangle[0]];
+                normal = e1.cross(e2).normalized();
+                prevTriangleIndex = triangleIndex;
             }
+            normals.append(normal);
         }
         ready = true;
 
     } else if(mesh->normals()){
         const auto& orgNormals = *mesh->normals();
         const auto& normalIndices = mesh->normalIndices();
-        int faceVertexIndex = 0;
         if(normalIndices.empty()){
-            for(int i=0; i < numTriangles; ++i){
-                for(int j=0; j < 3; ++j){
-                    const int orgVertexIndex = triangleVertices[faceVertexIndex++];
-                    normals.append(orgNormals[orgVertexIndex]);
-                }
+            for(auto faceVertexIndex : meshVertexSources){
+                normals.append(orgNormals[triangleVertices[faceVertexIndex]]);
             }
         } else {
-            for(int i=0; i < numTriangles; ++i){
-                for(int j=0; j < 3; ++j){
-                    const int normalIndex = normalIndices[faceVertexIndex++];
-                    normals.append(orgNormals[normalIndex]);
-                }
+            for(auto faceVertexIndex : meshVertexSources){
+                normals.append(orgNormals[normalIndices[faceVertexIndex]]);
             }
         }
         ready = true;
@@ -2603,7 +3165,7 @@ bool GLSLSceneRenderer::Impl::writeMeshNormalsSub
             glBindBuffer(GL_ARRAY_BUFFER, resource->newBuffer());
             glVertexAttribPointer((GLuint)1, glsize, gltype, normalized, 0, ((GLubyte*)NULL + (0)));
         }
-        glBufferData(GL_ARRAY_BUFFER, normals.array.size() * sizeof(value_type), normals.array.data(), GL_STATIC_DRAW);
+        resource->setBufferData(GL_ARRAY_BUFFER, normals.array.size() * sizeof(value_type), normals.array.data());
         glEnableVertexAttribArray(1);
     }
     
@@ -2611,16 +3173,12 @@ bool GLSLSceneRenderer::Impl::writeMeshNormalsSub
         auto lines = new SgLineSet;
         auto lineVertices = lines->getOrCreateVertices();
         const auto& orgVertices = *mesh->vertices();
-        int vertexIndex = 0;
-        for(int i=0; i < numTriangles; ++i){
-            for(int j=0; j < 3; ++j){
-                const int orgVertexIndex = triangleVertices[vertexIndex];
-                auto& v = orgVertices[orgVertexIndex];
-                lineVertices->push_back(v);
-                lineVertices->push_back(v + normals.get(vertexIndex) * normalVisualizationLength);
-                lines->addLine(vertexIndex * 2, vertexIndex * 2 + 1);
-                ++vertexIndex;
-            }
+        const int numVertices = meshVertexSources.size();
+        for(int vertexIndex = 0; vertexIndex < numVertices; ++vertexIndex){
+            auto& v = orgVertices[triangleVertices[meshVertexSources[vertexIndex]]];
+            lineVertices->push_back(v);
+            lineVertices->push_back(v + normals.get(vertexIndex) * normalVisualizationLength);
+            lines->addLine(vertexIndex * 2, vertexIndex * 2 + 1);
         }
         lines->setMaterial(normalVisualizationMaterial);
         resource->normalVisualization = lines;
@@ -2721,7 +3279,6 @@ void GLSLSceneRenderer::Impl::writeMeshTexCoordsSub
 (SgMesh* mesh, SgTexture* texture, VertexResource* resource, TexCoordArrayWrapper& texCoords)
 {
     auto& triangleVertices = mesh->triangleVertices();
-    const int totalNumVertices = triangleVertices.size();
     SgTexCoordArrayPtr pOrgTexCoords;
     const auto& texCoordIndices = mesh->texCoordIndices();
 
@@ -2745,23 +3302,15 @@ void GLSLSceneRenderer::Impl::writeMeshTexCoordsSub
         }
     }
 
-    texCoords.array.reserve(totalNumVertices);
-    const int numTriangles = mesh->numTriangles();
-    int faceVertexIndex = 0;
+    texCoords.array.reserve(meshVertexSources.size());
     
     if(texCoordIndices.empty()){
-        for(int i=0; i < numTriangles; ++i){
-            for(int j=0; j < 3; ++j){
-                const int orgVertexIndex = triangleVertices[faceVertexIndex++];
-                texCoords.append((*pOrgTexCoords)[orgVertexIndex]);
-            }
+        for(auto faceVertexIndex : meshVertexSources){
+            texCoords.append((*pOrgTexCoords)[triangleVertices[faceVertexIndex]]);
         }
     } else {
-        for(int i=0; i < numTriangles; ++i){
-            for(int j=0; j < 3; ++j){
-                const int texCoordIndex = texCoordIndices[faceVertexIndex++];
-                texCoords.append((*pOrgTexCoords)[texCoordIndex]);
-            }
+        for(auto faceVertexIndex : meshVertexSources){
+            texCoords.append((*pOrgTexCoords)[texCoordIndices[faceVertexIndex]]);
         }
     }
     {
@@ -2770,7 +3319,7 @@ void GLSLSceneRenderer::Impl::writeMeshTexCoordsSub
         glVertexAttribPointer((GLuint)2, 2, gltype, normalized, 0, 0);
     }
     auto size = texCoords.array.size() * sizeof(value_type);
-    glBufferData(GL_ARRAY_BUFFER, size, texCoords.array.data(), GL_STATIC_DRAW);
+    resource->setBufferData(GL_ARRAY_BUFFER, size, texCoords.array.data());
     glEnableVertexAttribArray(2);
 }
 
@@ -2854,33 +3403,18 @@ void GLSLSceneRenderer::Impl::writeMeshTexCoordsUnsignedShort
 void GLSLSceneRenderer::Impl::writeMeshColors(SgMesh* mesh, VertexResource* resource)
 {
     auto& triangleVertices = mesh->triangleVertices();
-    const int totalNumVertices = triangleVertices.size();
     const auto& orgColors = *mesh->colors();
     const auto& colorIndices = mesh->colorIndices();
 
     typedef Eigen::Array<GLubyte,3,1> Color;
     vector<Color> colors;
-    colors.reserve(totalNumVertices);
+    colors.reserve(meshVertexSources.size());
     
-    const int numTriangles = mesh->numTriangles();
-    int faceVertexIndex = 0;
-
-    if(colorIndices.empty()){
-        for(int i=0; i < numTriangles; ++i){
-            for(int j=0; j < 3; ++j){
-                const int orgVertexIndex = triangleVertices[faceVertexIndex++];
-                Vector3f c = 255.0f * orgColors[orgVertexIndex];
-                colors.emplace_back(c[0], c[1], c[2]);
-            }
-        }
-    } else {
-        for(int i=0; i < numTriangles; ++i){
-            for(int j=0; j < 3; ++j){
-                const int colorIndex = colorIndices[faceVertexIndex++];
-                Vector3f c = 255.0f * orgColors[colorIndex];
-                colors.emplace_back(c[0], c[1], c[2]);
-            }
-        }
+    for(auto faceVertexIndex : meshVertexSources){
+        const int colorIndex =
+            colorIndices.empty() ? triangleVertices[faceVertexIndex] : colorIndices[faceVertexIndex];
+        Vector3f c = 255.0f * orgColors[colorIndex];
+        colors.emplace_back(c[0], c[1], c[2]);
     }
 
     {
@@ -2888,7 +3422,7 @@ void GLSLSceneRenderer::Impl::writeMeshColors(SgMesh* mesh, VertexResource* reso
         glBindBuffer(GL_ARRAY_BUFFER, resource->newBuffer());
         glVertexAttribPointer((GLuint)3, 3, GL_UNSIGNED_BYTE, GL_TRUE, 0, ((GLubyte*)NULL + (0)));
     }
-    glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(Color), colors.data(), GL_STATIC_DRAW);
+    resource->setBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(Color), colors.data());
     glEnableVertexAttribArray(3);
 }
     
@@ -2906,7 +3440,7 @@ void GLSLSceneRenderer::Impl::renderShapeVertices(SgShape* shape)
                 glBindBuffer(GL_ARRAY_BUFFER, resource->newBuffer());
                 glVertexAttribPointer((GLuint)0, 3, GL_FLOAT, GL_FALSE, 0, ((GLubyte *)NULL + (0)));
             }
-            glBufferData(GL_ARRAY_BUFFER, vertices->size() * sizeof(Vector3f), vertices->data(), GL_STATIC_DRAW);
+            resource->setBufferData(GL_ARRAY_BUFFER, vertices->size() * sizeof(Vector3f), vertices->data());
             glEnableVertexAttribArray(0);
             resource->numVertices = vertices->size();
         }
@@ -2931,7 +3465,7 @@ void GLSLSceneRenderer::Impl::renderPlot
             glBindBuffer(GL_ARRAY_BUFFER, resource->newBuffer());
             glVertexAttribPointer((GLuint)0, 3, GL_FLOAT, GL_FALSE, 0, ((GLubyte *)NULL + (0)));
         }
-        glBufferData(GL_ARRAY_BUFFER, vertices->size() * sizeof(Vector3f), vertices->data(), GL_STATIC_DRAW);
+        resource->setBufferData(GL_ARRAY_BUFFER, vertices->size() * sizeof(Vector3f), vertices->data());
         glEnableVertexAttribArray(0);
 
         if(plot->hasColors()){
@@ -2969,7 +3503,7 @@ void GLSLSceneRenderer::Impl::renderPlot
                 glBindBuffer(GL_ARRAY_BUFFER, resource->newBuffer());
                 glVertexAttribPointer((GLuint)3, 3, GL_UNSIGNED_BYTE, GL_TRUE, 0, ((GLubyte*)NULL +(0)));
             }
-            glBufferData(GL_ARRAY_BUFFER, n * sizeof(Color), colors.data(), GL_STATIC_DRAW);
+            resource->setBufferData(GL_ARRAY_BUFFER, n * sizeof(Color), colors.data());
             glEnableVertexAttribArray(3);
         }
     }        
@@ -3226,9 +3760,13 @@ void GLSLSceneRenderer::Impl::renderOverlayMain(SgOverlay* overlay, const Affine
     if(isRenderingPickingImage){
         currentNodePath = nodePath;
     }
+    // The overlay may be rendered with a different projection
+    bool wasFrustumCullingBeingProcessed = isFrustumCullingBeingProcessed;
+    isFrustumCullingBeingProcessed = false;
     modelMatrixStack.push_back(T);
     renderGroup(overlay);
     modelMatrixStack.pop_back();
+    isFrustumCullingBeingProcessed = wasFrustumCullingBeingProcessed;
 }
 
 
@@ -3616,3 +4154,68 @@ void GLSLSceneRenderer::setLowMemoryConsumptionMode(bool on)
         requestToClearResources();
     }
 }
+
+
+void GLSLSceneRenderer::setIndexedVertexBufferEnabled(bool on)
+{
+    if(impl->isIndexedVertexBufferEnabled != on){
+        impl->isIndexedVertexBufferEnabled = on;
+        requestToClearResources();
+    }
+}
+
+
+bool GLSLSceneRenderer::isIndexedVertexBufferEnabled() const
+{
+    return impl->isIndexedVertexBufferEnabled;
+}
+
+
+void GLSLSceneRenderer::setInstancingEnabled(bool on)
+{
+    impl->isInstancingEnabled = on;
+}
+
+
+bool GLSLSceneRenderer::isInstancingEnabled() const
+{
+    return impl->isInstancingEnabled;
+}
+
+
+void GLSLSceneRenderer::setFrustumCullingEnabled(bool on)
+{
+    impl->isFrustumCullingEnabled = on;
+}
+
+
+bool GLSLSceneRenderer::isFrustumCullingEnabled() const
+{
+    return impl->isFrustumCullingEnabled;
+}
+
+
+void GLSLSceneRenderer::setOcclusionCullingEnabled(bool on)
+{
+    impl->isOcclusionCullingEnabled = on;
+}
+
+
+bool GLSLSceneRenderer::isOcclusionCullingEnabled() const
+{
+    return impl->isOcclusionCullingEnabled;
+}
+
+
+size_t GLSLSceneRenderer::vertexBufferMemorySize() const
+{
+    // The next map has all the resources after the rendering with the unused resource check
+    auto& resourceMap = impl->hasValidNextResourceMap ? *impl->nextResourceMap : *impl->currentResourceMap;
+    size_t size = 0;
+    for(auto& kv : resourceMap){
+        if(auto resource = dynamic_cast<VertexResource*>(kv.second.get())){
+            size += resource->bufferSize;
+        }
+    }
+    return size;
+}
@@ -88,6 +88,22 @@ class CNOID_EXPORT GLSLSceneRenderer : public GLSceneRenderer
     virtual void setBoundingBoxRenderingForLightweightRenderingGroupEnabled(bool on) override;
 
     void setLowMemoryConsumptionMode(bool on);
+    void setIndexedVertexBufferEnabled(bool on);
+    bool isIndexedVertexBufferEnabled() const;
+    void setInstancingEnabled(bool on);
+    bool isInstancingEnabled() const;
+    void setFrustumCullingEnabled(bool on);
+    bool isFrustumCullingEnabled() const;
+
+    /**
+       The large opaque shapes are drawn only when their bounding boxes are not occluded.
+       This is disabled by default.
+    */
+    void setOcclusionCullingEnabled(bool on);
+    bool isOcclusionCullingEnabled() const;
+
+    //! The total size of the vertex buffer objects currently allocated for the scene
+    size_t vertexBufferMemorySize() const;
 
     virtual void setPickingImageOutputEnabled(bool on) override;
     virtual bool getPickingImage(Image& out_image) override;
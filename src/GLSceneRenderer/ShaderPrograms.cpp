@@ -199,6 +199,12 @@ public:
     GLint normalMatrixLocation;
     GLint MVPLocation;
 
+    // For the instanced drawing
+    GLint isInstancingEnabledLocation;
+    GLint viewMatrixLocation;
+    GLint viewProjectionMatrixLocation;
+    bool isInstancingEnabled;
+
     // For the wireframe overlay rendering
     int viewportWidth, viewportHeight;
     GLint viewportMatrixLocation;
@@ -1232,6 +1238,11 @@ void FullLightingProgram::Impl::initialize(GLSLProgram& glsl)
         MVPLocation = glsl.getUniformLocation("MVP");
     }
 
+    isInstancingEnabledLocation = glsl.getUniformLocation("isInstancingEnabled");
+    viewMatrixLocation = glsl.getUniformLocation("viewMatrix");
+    viewProjectionMatrixLocation = glsl.getUniformLocation("viewProjectionMatrix");
+    isInstancingEnabled = false;
+
     viewportMatrixLocation = glsl.getUniformLocation("viewportMatrix");
     isViewportMatrixInvalidated = true;
     isWireframeEnabledLocation = glsl.getUniformLocation("isWireframeEnabled");
@@ -1263,6 +1274,7 @@ void FullLightingProgram::Impl::initialize(GLSLProgram& glsl)
         auto& shadow = shadowInfos[i];
         glUniform1i(shadow.shadowMapLocation, shadowMapTextureTopIndex + i);
     }
+    glUniform1i(isInstancingEnabledLocation, false);
 }
 
 
@@ -1359,6 +1371,11 @@ bool FullLightingProgram::setLight
 void FullLightingProgram::setTransform
 (const Matrix4& PV, const Isometry3& V, const Affine3& M, const Matrix4* L)
 {
+    if(impl->isInstancingEnabled){
+        glUniform1i(impl->isInstancingEnabledLocation, false);
+        impl->isInstancingEnabled = false;
+    }
+
     const Affine3f VM = (V * M).cast<float>();
     const Matrix3f N = VM.linear();
 
@@ -1388,6 +1405,26 @@ void FullLightingProgram::setTransform
 }
 
 
+void FullLightingProgram::setInstancedTransform(const Matrix4& PV, const Isometry3& V)
+{
+    if(!impl->isInstancingEnabled){
+        glUniform1i(impl->isInstancingEnabledLocation, true);
+        impl->isInstancingEnabled = true;
+    }
+
+    const Matrix4f Vf = V.matrix().cast<float>();
+    glUniformMatrix4fv(impl->viewMatrixLocation, 1, GL_FALSE, Vf.data());
+    const Matrix4f PVf = PV.cast<float>();
+    glUniformMatrix4fv(impl->viewProjectionMatrixLocation, 1, GL_FALSE, PVf.data());
+
+    for(int i=0; i < impl->numShadows; ++i){
+        auto& shadow = impl->shadowInfos[i];
+        const Matrix4f BPV = shadow.BPV.cast<float>();
+        glUniformMatrix4fv(shadow.shadowMatrixLocation, 1, GL_FALSE, BPV.data());
+    }
+}
+
+
 void FullLightingProgram::enableWireframe(const Vector4f& color, float width)
 {
     if(!impl->isWireframeEnabled || color != impl->wireframeColor || width != impl->wireframeWidth){
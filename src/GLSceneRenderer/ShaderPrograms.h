@@ -324,6 +324,13 @@ public:
         int index, const SgLight* light, const Isometry3& T, const Isometry3& view, bool shadowCasting) override;
     virtual void setTransform(const Matrix4& PV, const Isometry3& V, const Affine3& M, const Matrix4* L) override;
 
+    /**
+       This function sets the transforms for the instanced drawing, in which the model matrix
+       of each instance is given by the vertex attributes at the locations 4 to 7.
+       The instanced drawing is disabled by the next call of setTransform.
+    */
+    void setInstancedTransform(const Matrix4& PV, const Isometry3& V);
+
     void enableWireframe(const Vector4f& color, float width);
     void disableWireframe();
     bool isWireframeEnabled() const;
@@ -6,6 +6,7 @@ layout (location = 0) in vec4 vertexPosition;
 layout (location = 1) in vec3 vertexNormal;
 layout (location = 2) in vec2 vertexTexCoord;
 layout (location = 3) in vec3 vertexColor;
+layout (location = 4) in mat4 instanceModelMatrix;
 
 out VertexData {
     vec3 position;
@@ -36,17 +37,32 @@ uniform mat3 normalMatrix;
 uniform int numShadows;
 uniform mat4 shadowMatrices[MAX_NUM_SHADOWS];
 
+// The model matrix is given by the instance attribute in the instanced drawing
+uniform bool isInstancingEnabled;
+uniform mat4 viewMatrix;
+uniform mat4 viewProjectionMatrix;
+
 void main()
 {
-    outData.normal = normalize(normalMatrix * vertexNormal);
-    outData.position = vec3(modelViewMatrix * vertexPosition);
-
     outData.texCoord = vertexTexCoord;
     outData.colorV = vertexColor;
-    
-    for(int i=0; i < numShadows; ++i){
-        outData.shadowCoords[i] = shadowMatrices[i] * vertexPosition;
+
+    if(isInstancingEnabled){
+        mat4 instanceModelViewMatrix = viewMatrix * instanceModelMatrix;
+        outData.normal = normalize(mat3(instanceModelViewMatrix) * vertexNormal);
+        outData.position = vec3(instanceModelViewMatrix * vertexPosition);
+        vec4 worldPosition = instanceModelMatrix * vertexPosition;
+        for(int i=0; i < numShadows; ++i){
+            outData.shadowCoords[i] = shadowMatrices[i] * worldPosition;
+        }
+        gl_Position = viewProjectionMatrix * worldPosition;
+
+    } else {
+        outData.normal = normalize(normalMatrix * vertexNormal);
+        outData.position = vec3(modelViewMatrix * vertexPosition);
+        for(int i=0; i < numShadows; ++i){
+            outData.shadowCoords[i] = shadowMatrices[i] * vertexPosition;
+        }
+        gl_Position = MVP * vertexPosition;
     }
-    
-    gl_Position = MVP * vertexPosition;
 }
@@ -38,4 +38,9 @@ double CutoffCoef::get (
     return _impl->get (point, normalDir, tri);
 }
 
+double CutoffCoef::influenceDistance() const
+{
+    return _impl->influenceDistance();
+}
+
 }}
@@ -42,6 +42,11 @@ public:
 		const Vector3& point,
 		const Vector3& normalDir,
         const GaussTriangle3d& tri) const;
+
+	/**
+	   The coefficient is always 1.0 for the points farther than this distance from a triangle
+	*/
+	double influenceDistance() const;
 };
 
 
@@ -134,6 +134,12 @@ double CutoffCoefImpl::eval(const double distance) const
 	return _fcut->eval(rbar);
 }
 
+double CutoffCoefImpl::influenceDistance() const
+{
+    // eval() saturates at 1.0 when the distance is outside (_rbarb-1, 1) * _prc
+    return (1.0 - _rbarb) * _prc;
+}
+
 #ifndef NDEBUG
 double CutoffCoefImpl::funcNormCutoff (const double rbar) const
 {
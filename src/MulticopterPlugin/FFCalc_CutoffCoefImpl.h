@@ -48,6 +48,8 @@ public:
 
 	double eval (const double distance) const;
 
+	double influenceDistance() const;
+
 #ifndef NDEBUG
 
 	double funcNormCutoff (const double rbar) const;
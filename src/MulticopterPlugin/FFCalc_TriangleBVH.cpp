@@ -0,0 +1,101 @@
+/**
+   @author Japan Atomic Energy Agency
+*/
+
+#include "MulticopterPluginHeader.h"
+#include <algorithm>
+
+namespace Multicopter {
+namespace FFCalc {
+
+namespace
+{
+    const int MAX_NUM_LEAF_TRIANGLES = 4;
+}
+
+TriangleBVH::TriangleBVH (const std::vector<GaussTriangle3d>& triAry)
+{
+    build (triAry);
+}
+
+void TriangleBVH::build (const std::vector<GaussTriangle3d>& triAry)
+{
+    _nodes.clear();
+    _indices.clear();
+
+    const int numTri = triAry.size();
+    if (numTri == 0)
+        return;
+
+    std::vector<Vector3> mins(numTri);
+    std::vector<Vector3> maxs(numTri);
+    std::vector<Vector3> centers(numTri);
+    _indices.resize(numTri);
+
+    for (int i=0; i<numTri; ++i)
+    {
+        const GaussTriangle3d& tri = triAry[i];
+        mins[i] = tri[0].cwiseMin(tri[1]).cwiseMin(tri[2]);
+        maxs[i] = tri[0].cwiseMax(tri[1]).cwiseMax(tri[2]);
+        centers[i] = 0.5 * (mins[i] + maxs[i]);
+        _indices[i] = i;
+    }
+
+    _nodes.reserve(2 * numTri);
+    build (mins, maxs, centers, 0, numTri);
+}
+
+/**
+   The triangles are split at the median of the longest axis of the box enclosing their centers,
+   which keeps the depth of the tree within log2 of the number of the triangles.
+*/
+int TriangleBVH::build (
+    const std::vector<Vector3>& mins,
+    const std::vector<Vector3>& maxs,
+    const std::vector<Vector3>& centers,
+    int first, int last)
+{
+    const int nodeIndex = _nodes.size();
+    _nodes.emplace_back();
+
+    Vector3 vmin = mins[_indices[first]];
+    Vector3 vmax = maxs[_indices[first]];
+    Vector3 cmin = centers[_indices[first]];
+    Vector3 cmax = cmin;
+    for (int i=first+1; i<last; ++i)
+    {
+        const int index = _indices[i];
+        vmin = vmin.cwiseMin(mins[index]);
+        vmax = vmax.cwiseMax(maxs[index]);
+        cmin = cmin.cwiseMin(centers[index]);
+        cmax = cmax.cwiseMax(centers[index]);
+    }
+    _nodes[nodeIndex].min = vmin;
+    _nodes[nodeIndex].max = vmax;
+
+    if (last - first <= MAX_NUM_LEAF_TRIANGLES)
+    {
+        _nodes[nodeIndex].firstIndex = first;
+        _nodes[nodeIndex].numTriangles = last - first;
+        _nodes[nodeIndex].rightChild = -1;
+        return nodeIndex;
+    }
+
+    int axis;
+    (cmax - cmin).maxCoeff(&axis);
+    const int middle = (first + last) / 2;
+    std::nth_element(
+        _indices.begin() + first, _indices.begin() + middle, _indices.begin() + last,
+        [&](int i1, int i2){ return centers[i1][axis] < centers[i2][axis]; });
+
+    _nodes[nodeIndex].firstIndex = first;
+    _nodes[nodeIndex].numTriangles = 0;
+    build (mins, maxs, centers, first, middle);
+    const int rightChild = build (mins, maxs, centers, middle, last);
+    _nodes[nodeIndex].rightChild = rightChild;
+
+    return nodeIndex;
+}
+
+
+}}
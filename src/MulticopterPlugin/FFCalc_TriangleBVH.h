@@ -0,0 +1,98 @@
+/**
+   @author Japan Atomic Energy Agency
+*/
+
+#pragma once
+#include "FFCalc_Common.h"
+#include "FFCalc_GaussTriangle3d.h"
+#include <vector>
+
+namespace Multicopter {
+namespace FFCalc {
+
+/**
+   Bounding volume hierarchy of axis-aligned boxes over a triangle array,
+   which is used to find the triangles close to a point.
+*/
+class TriangleBVH
+{
+private:
+
+    struct Node
+    {
+        Vector3 min;
+        Vector3 max;
+        // The left child of an internal node is the next node
+        int rightChild;
+        int firstIndex;
+        int numTriangles;
+    };
+
+    std::vector<Node> _nodes;
+
+    std::vector<int> _indices;
+
+    int build (
+        const std::vector<Vector3>& mins,
+        const std::vector<Vector3>& maxs,
+        const std::vector<Vector3>& centers,
+        int first, int last);
+
+    static double squaredDistance (const Node& node, const Vector3& point)
+    {
+        double d2 = 0.0;
+        for (int i=0; i<3; ++i)
+        {
+            double d = std::max (std::max (node.min[i] - point[i], point[i] - node.max[i]), 0.0);
+            d2 += d * d;
+        }
+        return d2;
+    }
+
+public:
+
+    TriangleBVH () { }
+
+    TriangleBVH (const std::vector<GaussTriangle3d>& triAry);
+
+    void build (const std::vector<GaussTriangle3d>& triAry);
+
+    bool empty() const { return _nodes.empty(); }
+
+    /**
+       Calls func(index) for each triangle whose bounding box is not farther than distance from point.
+       The indices are not given in ascending order.
+    */
+    template<class Function>
+    void forEachTriangleNear (const Vector3& point, double distance, Function func) const
+    {
+        if (_nodes.empty())
+            return;
+
+        const double d2 = distance * distance;
+        int stack[64];
+        int top = 0;
+        stack[top++] = 0;
+
+        while (top > 0)
+        {
+            const int nodeIndex = stack[--top];
+            const Node& node = _nodes[nodeIndex];
+            if (squaredDistance (node, point) > d2)
+                continue;
+            if (node.numTriangles > 0)
+            {
+                for (int i=0; i<node.numTriangles; ++i)
+                    func (_indices[node.firstIndex + i]);
+            }
+            else
+            {
+                stack[top++] = node.rightChild;
+                stack[top++] = nodeIndex + 1;
+            }
+        }
+    }
+};
+
+
+}}
@@ -42,6 +42,7 @@
 #include "FFCalc_INormalizedFunction.h"
 #include "FFCalc_CutoffCoef.h"
 #include "FFCalc_CutoffCoefImpl.h"
+#include "FFCalc_TriangleBVH.h"
 
 #include "LinkAttribute.h"
 #include "LinkTriangleAttribute.h"
@@ -35,6 +35,7 @@ MulticopterSimulatorItem::MulticopterSimulatorItem()
     _groundEffect=false;
     _outputParam=false;
     _timeStep=1.0;
+    _numThreads=1;
 }
 
 
@@ -48,6 +49,7 @@ MulticopterSimulatorItem::MulticopterSimulatorItem(const MulticopterSimulatorIte
     _groundEffect=org._groundEffect;
     _outputParam=org._outputParam;
     _timeStep=org._timeStep;
+    _numThreads=org._numThreads;
 }
 
 MulticopterSimulatorItem::~MulticopterSimulatorItem()
@@ -129,6 +131,7 @@ MulticopterSimulatorItem::setParameterToSimulationManager()
     simMgr->setGroundEffect(_groundEffect);
     simMgr->setLogEnabled(_outputParam);
     simMgr->setLogInterval(_timeStep);
+    simMgr->setNumThreads(_numThreads);
     FluidEnvironment* fluEnv = simMgr->fluidEnvironment();
     if(_airDefinitionFileName==""){
         simMgr->setNewFluidEnvironment();
@@ -162,6 +165,8 @@ MulticopterSimulatorItem::doPutProperties(PutPropertyFunction& putProperty)
     putProperty(MULTICOPTER_GROUNDEFFECT, _groundEffect, changeProperty(_groundEffect));
     putProperty(MULTICOPTER_OUTPUT, _outputParam, changeProperty(_outputParam));
     putProperty(MULTICOPTER_TIMESTEP, _timeStep, changeProperty(_timeStep));
+    putProperty.min(1).max(256);
+    putProperty(MULTICOPTER_NUMTHREADS, _numThreads, changeProperty(_numThreads));
 }
 
 bool
@@ -204,6 +209,7 @@ MulticopterSimulatorItem::store(Archive& archive)
     archive.write(MULTICOPTER_GROUNDEFFECT, _groundEffect);
     archive.write(MULTICOPTER_OUTPUT, _outputParam);
     archive.write(MULTICOPTER_TIMESTEP, _timeStep);
+    archive.write(MULTICOPTER_NUMTHREADS, _numThreads);
 
     return true;
 }
@@ -221,6 +227,7 @@ MulticopterSimulatorItem::restore(const Archive& archive)
     archive.read(MULTICOPTER_GROUNDEFFECT, _groundEffect);
     archive.read(MULTICOPTER_OUTPUT, _outputParam);
     archive.read(MULTICOPTER_TIMESTEP, _timeStep);
+    archive.read(MULTICOPTER_NUMTHREADS, _numThreads);
 
     if(!_airDefinitionFileName.empty()){
         setAirDefinitionFile(_airDefinitionFileName);
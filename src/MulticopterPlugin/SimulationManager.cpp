@@ -4,7 +4,9 @@
 
 #include "MulticopterPluginHeader.h"
 #include "MulticopterSimulatorItem.h"
+#include <cnoid/ThreadPool>
 #include <fmt/format.h>
+#include <atomic>
 #include <cmath>
 #include <random>
 
@@ -86,6 +88,7 @@ SimulationManager::SimulationManager()
 
     _enableLinkForceDump = false;
     _degree=4;
+    _numThreads=1;
 
     _fluidDensitySim=_fluidDensity=0;
     _viscositySim= _viscosity=0;
@@ -396,8 +399,12 @@ SimulationManager::calculateSurfaceCuttoffCoefficient(map<Link*, tuple<Body*, Li
     const size_t numLink = linkPolygonMap.size();
 
     vector<Link*> linkAry;
+    vector<vector<LinkTriangleAttribute>*> triAttrAryList;
+    vector<LinkAttribute> linkAttrAry;
     vector<vector<FFCalc::GaussTriangle3d>> triAryList;
     linkAry.reserve(numLink);
+    triAttrAryList.reserve(numLink);
+    linkAttrAry.reserve(numLink);
     triAryList.reserve(numLink);
 
     for(auto& linkPolygon : linkPolygonMap){
@@ -413,15 +420,32 @@ SimulationManager::calculateSurfaceCuttoffCoefficient(map<Link*, tuple<Body*, Li
         }
 
         linkAry.push_back(&link);
+        triAttrAryList.push_back(&triAttrAry);
+        linkAttrAry.push_back(get<1>(fluidLinkBodyMap[&link]));
         triAryList.push_back(triAry);
     }
 
+    // The links with more triangles are processed first to balance the load of the threads
+    vector<int> linkOrder(numLink);
     for(size_t i=0 ; i<numLink ; ++i){
+        linkOrder[i] = i;
+    }
+    std::stable_sort(
+        linkOrder.begin(), linkOrder.end(),
+        [&](int i1, int i2){ return triAryList[i1].size() > triAryList[i2].size(); });
+
+    vector<FFCalc::TriangleBVH> bvhList(numLink);
+    processInParallel(numLink, [&](int order){
+        const int i = linkOrder[order];
+        bvhList[i].build(triAryList[i]);
+    });
+
+    processInParallel(numLink, [&](int order){
 
-        Link& curLink = *(linkAry[i]);
+        const size_t i = linkOrder[order];
         const vector<FFCalc::GaussTriangle3d>& curTriAry = triAryList[i];
 
-        const LinkAttribute& linkAttr = get<1>(fluidLinkBodyMap[&curLink]);
+        const LinkAttribute& linkAttr = linkAttrAry[i];
         double cutoffDist = linkAttr.cutoffDistance();
         double normMidVal = linkAttr.normMiddleValue();
         FFCalc::CutoffCoef cutoffCalc(cutoffDist, normMidVal);
@@ -440,10 +464,9 @@ SimulationManager::calculateSurfaceCuttoffCoefficient(map<Link*, tuple<Body*, Li
 
             for(size_t k=0 ; k<numLink ; ++k){
 
-                Link& trgLink = *(linkAry[k]);
                 const vector<FFCalc::GaussTriangle3d>& trgTriAry = triAryList[k];
 
-                if( &curLink == &trgLink )
+                if( k == i )
                     continue;
 
                 if( trgTriAry.empty() == true )
@@ -454,7 +477,7 @@ SimulationManager::calculateSurfaceCuttoffCoefficient(map<Link*, tuple<Body*, Li
 #else
                 double coefs[numIP];
 #endif
-                calcCuttoffCoef(cutoffCalc, curTri, trgTriAry, coefs);
+                calcCuttoffCoef(cutoffCalc, curTri, trgTriAry, bvhList[k], coefs);
                 for(int iIP=0 ; iIP<numIP ; ++iIP){
                     if( coefs[iIP] < minCoefs[iIP] ){
                         minCoefs[iIP] = coefs[iIP];
@@ -465,33 +488,74 @@ SimulationManager::calculateSurfaceCuttoffCoefficient(map<Link*, tuple<Body*, Li
 #endif
             }
 
-            LinkTriangleAttribute& triAttr = linkPolygonMap[&curLink][j];
+            LinkTriangleAttribute& triAttr = (*triAttrAryList[i])[j];
             for(int iIP=0 ; iIP<numIP ; ++iIP){
                 triAttr.setCutoffoefficient(iIP, minCoefs[iIP]);
             }
         }
-    }
+    });
 }
 
+/**
+   Only the target triangles within the influence distance of each Gauss point are evaluated
+   because the coefficient of the other triangles is always 1.0.
+*/
 void
 SimulationManager::calcCuttoffCoef (
         const FFCalc::CutoffCoef& cutoffCalc,
         const FFCalc::GaussTriangle3d& tri,
         const std::vector<FFCalc::GaussTriangle3d>& trgTriAry,
+        const FFCalc::TriangleBVH& trgBVH,
         double coefs[])
 {
     int numIP = getDegreeNumber();
+    const double influenceDist = cutoffCalc.influenceDistance();
     for(int it=0;it<numIP;it++)coefs[it]=1.0;
     for(size_t iIP=0 ; iIP<numIP ; ++iIP){
         const Eigen::Vector3d point = tri.getGaussPoint(iIP,numIP);
-        int trgTriArySize=trgTriAry.size();
-        for(size_t i=0 ; i<trgTriArySize ; ++i){
-            double coef = cutoffCalc.get (point, tri.normal(), trgTriAry[i]);
-            if( coef < coefs[iIP] ){
-                coefs[iIP] = coef;
+        trgBVH.forEachTriangleNear(
+            point, influenceDist,
+            [&](int i){
+                double coef = cutoffCalc.get (point, tri.normal(), trgTriAry[i]);
+                if( coef < coefs[iIP] ){
+                    coefs[iIP] = coef;
+                }
+            });
+    }
+}
+
+/**
+   The tasks are dispatched to the threads from an atomic counter. The function is called
+   in the calling thread only when the number of threads is one or less.
+*/
+void
+SimulationManager::processInParallel(int numTasks, const std::function<void(int index)>& func)
+{
+    int numThreadsToUse = std::min(_numThreads, numTasks);
+    if(numThreadsToUse <= 1){
+        for(int i=0 ; i<numTasks ; ++i){
+            func(i);
+        }
+        return;
+    }
+    if(!_threadPool || _threadPool->size() != _numThreads - 1){
+        _threadPool.reset(new ThreadPool(_numThreads - 1));
+    }
+    std::atomic<int> nextTaskIndex(0);
+    auto processTasksInQueue = [&](){
+        while(true){
+            int index = nextTaskIndex.fetch_add(1);
+            if(index >= numTasks){
+                break;
             }
+            func(index);
         }
+    };
+    for(int i=1 ; i<numThreadsToUse ; ++i){
+        _threadPool->start(processTasksInQueue);
     }
+    processTasksInQueue();
+    _threadPool->wait();
 }
 
 void
@@ -520,8 +584,13 @@ SimulationManager::midDynamicFunction(SimulatorItem* simItem, MulticopterSimulat
     _rotorOutValAry.clear();
     _linkOutValAry.clear();
 
-    for(auto itb = begin(_bodyLinkMap) ; itb != end(_bodyLinkMap) ; ++itb){
-        std::map<int,std::tuple<double,Vector3>> effectMap;
+    _linkForceTasks.clear();
+    _effectMaps.resize(_bodyLinkMap.size());
+    int bodyIndex = 0;
+
+    for(auto itb = begin(_bodyLinkMap) ; itb != end(_bodyLinkMap) ; ++itb, ++bodyIndex){
+        std::map<int,std::tuple<double,Vector3>>& effectMap = _effectMaps[bodyIndex];
+        effectMap.clear();
         bool calFlag=false;
 
 
@@ -553,33 +622,47 @@ SimulationManager::midDynamicFunction(SimulatorItem* simItem, MulticopterSimulat
         }
 
         for(auto itl = begin(linkAry) ; itl != end(linkAry) ; ++itl){
+            LinkForceTask task;
+            task.link = *itl;
+            task.linkState = _linkStateMap[*itl];
+            task.effectMap = &effectMap;
+            task.calFlag = calFlag;
+            _linkForceTasks.push_back(std::move(task));
+        }
+    }
 
-            try{
-                FFCalc::LinkStatePtr pLinkState;
-                pLinkState = _linkStateMap[*itl];
-                pLinkState->update (simItem->currentTime(), **itl);
-
-                std::unique_ptr<FFCalc::LinkForce> pLinkForce = midDynamicFunctionLink (
-                    simItem, multicopterSimItem, **itl, *pLinkState,effectMap,calFlag);
-
-                (*itl)->f_ext()   += pLinkForce->getForce();
-                (*itl)->tau_ext() += pLinkForce->getMoment();
-
-            }
-            catch(runtime_error& err){
-                UtilityImpl::printErrorMessage(
-                    format("{0:s} in {1:s} at {2:lf}",
-                           err.what(), (*itl)->name(), simItem->currentTime()));
-                continue;
-            }
+    // The forces of the links are independent of each other and are applied in the original order
+    const double time = simItem->currentTime();
+    processInParallel(_linkForceTasks.size(), [&](int index){
+        LinkForceTask& task = _linkForceTasks[index];
+        try{
+            task.linkState->update (time, *task.link);
+            task.linkForce = midDynamicFunctionLink (
+                simItem, multicopterSimItem, *task.link, *task.linkState, *task.effectMap, task.calFlag,
+                task.linkOutValAry);
+        }
+        catch(runtime_error& err){
+            task.errorMessage = err.what();
         }
+    });
+
+    for(auto& task : _linkForceTasks){
+        if(!task.linkForce){
+            UtilityImpl::printErrorMessage(
+                format("{0:s} in {1:s} at {2:lf}",
+                       task.errorMessage, task.link->name(), time));
+            continue;
+        }
+        task.link->f_ext()   += task.linkForce->getForce();
+        task.link->tau_ext() += task.linkForce->getMoment();
+        _linkOutValAry.splice(_linkOutValAry.end(), task.linkOutValAry);
     }
 }
 
 
 std::unique_ptr<FFCalc::LinkForce> SimulationManager::midDynamicFunctionLink (
     SimulatorItem* simItem, MulticopterSimulatorItem* multicopterSimItem, cnoid::Link& link, const FFCalc::LinkState& linkState,
-    std::map<int,std::tuple<double,Vector3>> effectMap,bool calFlag=false)
+    std::map<int,std::tuple<double,Vector3>> effectMap,bool calFlag, std::list<FluidOutValue>& linkOutValAry)
 {
 
     const Eigen::Vector3d loadingPoint = Vector3 (0.0, 0.0, 0.0);
@@ -591,7 +674,7 @@ std::unique_ptr<FFCalc::LinkForce> SimulationManager::midDynamicFunctionLink (
 
     if(linkAttr.isNull()==false){
 
-        const std::vector<LinkTriangleAttribute>& triAttrAry = _linkPolygonMap[&link];
+        const std::vector<LinkTriangleAttribute>& triAttrAry = linkPolygon(&link);
         const std::vector<bool>linkForceApplyTarget = linkAttr.linkForceApplyFlgAry();
 
         FFCalc::FFCalculator ffc (_gravity, fluidEnv, _fluEnvAllSim,link, linkAttr, linkState, triAttrAry);
@@ -642,7 +725,7 @@ std::unique_ptr<FFCalc::LinkForce> SimulationManager::midDynamicFunctionLink (
         fluOutVal.addInertiaTorque = lfAddMoment.getMoment();
         fluOutVal.surfaceForce     = lfSurface.getForce();
 
-        _linkOutValAry.push_back(fluOutVal);
+        linkOutValAry.push_back(fluOutVal);
 
 
 
@@ -809,6 +892,18 @@ SimulationManager::setDegreeNumber(int degreeNumber)
     _degree=degreeNumber;
 }
 
+void
+SimulationManager::setNumThreads(int n)
+{
+    _numThreads = std::max(n, 1);
+}
+
+int
+SimulationManager::numThreads() const
+{
+    return _numThreads;
+}
+
 int
 SimulationManager::getDegreeNumber() const
 {
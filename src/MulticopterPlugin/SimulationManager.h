@@ -6,6 +6,7 @@
 
 namespace cnoid {
 class MulticopterSimulatorItem;
+class ThreadPool;
 }
 
 namespace Multicopter {
@@ -45,6 +46,12 @@ public:
     void setDegreeNumber(int degreeNumber);
     int getDegreeNumber() const;
 
+    /**
+       The cutoff coefficients and the forces of the links are computed with this number of threads.
+    */
+    void setNumThreads(int n);
+    int numThreads() const;
+
     MulticopterMonitorView* multicopterMonitorView(){
         return _multicopterMonitorView;
     }
@@ -96,6 +103,17 @@ protected:
         Eigen::Vector3d rotationalAcceleration;
     };
 
+    class LinkForceTask{
+    public:
+        cnoid::Link* link;
+        FFCalc::LinkStatePtr linkState;
+        const std::map<int,std::tuple<double,cnoid::Vector3>>* effectMap;
+        bool calFlag;
+        std::unique_ptr<FFCalc::LinkForce> linkForce;
+        std::list<FluidOutValue> linkOutValAry;
+        std::string errorMessage;
+    };
+
     SimulationManager();
 
     ~SimulationManager();
@@ -134,10 +152,14 @@ protected:
                                             std::map<cnoid::Link*, std::vector<LinkTriangleAttribute>>& linkPolygonMap);
     
 
-    void calcCuttoffCoef (const FFCalc::CutoffCoef& cutoffCalc, const FFCalc::GaussTriangle3d& tri, const std::vector<FFCalc::GaussTriangle3d>& trgTriAry,double coefs[]);
+    void calcCuttoffCoef (const FFCalc::CutoffCoef& cutoffCalc, const FFCalc::GaussTriangle3d& tri, const std::vector<FFCalc::GaussTriangle3d>& trgTriAry,
+                          const FFCalc::TriangleBVH& trgBVH, double coefs[]);
+
+    void processInParallel(int numTasks, const std::function<void(int index)>& func);
 
     std::unique_ptr<FFCalc::LinkForce>
-    midDynamicFunctionLink(cnoid::SimulatorItem* simItem, cnoid::MulticopterSimulatorItem* fluidSimItem, cnoid::Link& link, const FFCalc::LinkState& linkState,std::map<int,std::tuple<double,cnoid::Vector3>> effectMap,bool calFlag);
+    midDynamicFunctionLink(cnoid::SimulatorItem* simItem, cnoid::MulticopterSimulatorItem* fluidSimItem, cnoid::Link& link, const FFCalc::LinkState& linkState,std::map<int,std::tuple<double,cnoid::Vector3>> effectMap,bool calFlag,
+                           std::list<FluidOutValue>& linkOutValAry);
 
     std::list<RotorDevice*> targetRotorDevices() const;
     std::list<RotorDevice*> targetRotorDevices(cnoid::Link* link) const;
@@ -160,6 +182,8 @@ private:
 
     std::list<RotorOutValue> _rotorOutValAry;
     std::list<FluidOutValue> _linkOutValAry;
+    std::vector<LinkForceTask> _linkForceTasks;
+    std::vector<std::map<int,std::tuple<double,cnoid::Vector3>>> _effectMaps;
     
     double _fluidDensity;
     double  _viscosity;
@@ -183,6 +207,8 @@ private:
 
     int _effectLinkBodyMapSize;
     int _degree;
+    int _numThreads;
+    std::unique_ptr<cnoid::ThreadPool> _threadPool;
 
     MulticopterMonitorView* _multicopterMonitorView;
     cnoid::AISTCollisionDetectorPtr _collisionDetector;
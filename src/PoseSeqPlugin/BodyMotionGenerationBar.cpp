@@ -23,7 +23,9 @@
 #include <cnoid/CheckBox>
 #include <cnoid/Dialog>
 #include <QDialogButtonBox>
+#include <QProgressDialog>
 #include <set>
+#include <thread>
 #include "gettext.h"
 
 using namespace std;
@@ -279,6 +281,7 @@ bool BodyMotionGenerationBar::Impl::shapeBodyMotionWithSimpleInterpolation
 {
     if(!poseProviderToBodyMotionConverter){
         poseProviderToBodyMotionConverter = make_unique<PoseProviderToBodyMotionConverter>();
+        poseProviderToBodyMotionConverter->setNumThreads(std::thread::hardware_concurrency());
     }
     if(setup->onlyTimeBarRangeCheck.isChecked()){
         poseProviderToBodyMotionConverter->setTimeRange(timeBar->minTime(), timeBar->maxTime());
@@ -290,10 +293,26 @@ bool BodyMotionGenerationBar::Impl::shapeBodyMotionWithSimpleInterpolation
     auto motion = motionItem->motion();
     motion->setFrameRate(timeBar->frameRate());
 
+    // The dialog is only shown when the conversion takes time
+    QProgressDialog progress(
+        _("Generating the body motion..."), _("Cancel"), 0, 0, MainWindow::instance());
+    progress.setWindowTitle(_("Body Motion Generation"));
+    progress.setWindowModality(Qt::WindowModal);
+    poseProviderToBodyMotionConverter->setProgressFunction(
+        [&progress](int numConvertedFrames, int numFrames){
+            progress.setMaximum(numFrames);
+            progress.setValue(numConvertedFrames);
+            return !progress.wasCanceled();
+        });
+
     bool result = poseProviderToBodyMotionConverter->convert(body, provider, *motion);
+
+    poseProviderToBodyMotionConverter->setProgressFunction(nullptr);
     
     if(result){
         motionItem->notifyUpdate();
+    } else if(progress.wasCanceled()){
+        MessageView::instance()->putln(_("The body motion generation has been canceled."));
     }
     return result;
 }
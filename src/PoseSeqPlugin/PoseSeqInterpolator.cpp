@@ -240,12 +240,23 @@ class PoseSeqInterpolator::Impl
 public:
 
     Impl(PoseSeqInterpolator* self);
+    Impl(PoseSeqInterpolator* self, const Impl& org);
 
     PoseSeqInterpolator* self;
     BodyPtr body;
     PoseSeqPtr poseSeq;
 
     bool needUpdate;
+    bool needToUpdateAllJoints;
+
+    /*
+       The time range covering the poses inserted, removed or modified since the last update.
+       Only the joint samples around the range are updated when the other joint samples are valid.
+    */
+    bool hasModifiedTimeRange;
+    double modifiedTimeMin;
+    double modifiedTimeMax;
+    int numPosesToUpdate;
 
     ConnectionSet poseSeqConnections;
 
@@ -340,6 +351,7 @@ public:
     void clearLipSyncShapes();
     void setLipSyncShapes(const Mapping& lipSyncShapeNode);
     void setPoseSeq(PoseSeq* seq);
+    void copyInterpolationState(const Impl& org);
     void invalidateCurrentInterpolation();
     bool interpolate(double time, int waistLinkIndex, const Vector3& waistTranslation);
     bool mixLipSyncShape();
@@ -347,6 +359,10 @@ public:
     void calcIkJointPositionsSub(Link* link, Link* baseLink, LinkInfo* baseLinkInfo, bool doUpward, Link* prevLink);
     void appendPronun(PoseSeq::iterator poseIter);
     void appendLinkSamples(PoseSeq::iterator poseIter, BodyKeyPose* pose);
+    void appendJointSample(JointInfo& info, int jointId, PoseSeq::iterator poseIter, BodyKeyPose* pose);
+    void updateJointSamplesInModifiedTimeRange();
+    bool updateJointSamplesInModifiedTimeRange(int jointId, PoseSeq::iterator firstModifiedPoseIter);
+    void rebuildJointSamples(int jointId);
 
     inline bool checkZmp(const Vector3& zmp, const Vector3& centerZmp);
         
@@ -374,8 +390,10 @@ public:
     void insertAuxKeyPosesForToeSteps();
     bool update();
     LinkInfo* getIkLinkInfo(int linkIndex);
+    void addModifiedTime(double time);
     void onPoseInserted(PoseSeq::iterator it);
     void onPoseAboutToBeRemoved(PoseSeq::iterator it, bool isMoving);
+    void onPoseAboutToBeModified(PoseSeq::iterator it);
     void onPoseModified(PoseSeq::iterator it);
 };
 }
@@ -767,6 +785,48 @@ void appendSample(typename SampleType::Seq& samples, const SampleType& sample)
     samples.push_back(sample);
 }
 
+
+/**
+   Find the sample of a key pose, which is not a sample inserted at a transition start point,
+   by searching from the hint position.
+*/
+template <class SampleType>
+typename SampleType::Seq::iterator findPoseSample
+(typename SampleType::Seq& samples, typename SampleType::Seq::iterator hint, PoseSeq::iterator poseIter)
+{
+    if(samples.empty()){
+        return samples.end();
+    }
+    const double time = poseIter->time();
+    auto p = hint;
+    if(p == samples.end()){
+        --p;
+    }
+    while(p != samples.begin() && p->x >= time){
+        --p;
+    }
+    while(p != samples.end() && p->x < time){
+        ++p;
+    }
+    while(p != samples.end() && p->x == time){
+        if(p->poseIter == poseIter){
+            return p;
+        }
+        ++p;
+    }
+    return samples.end();
+}
+
+
+BodyKeyPose* getJointKeyPose(PoseSeq::iterator poseIter, int jointId)
+{
+    auto pose = poseIter->get<BodyKeyPose>();
+    if(pose && jointId < pose->numJoints() && pose->isJointValid(jointId)){
+        return pose;
+    }
+    return nullptr;
+}
+
 }
 
 
@@ -776,6 +836,12 @@ PoseSeqInterpolator::PoseSeqInterpolator()
 }
 
 
+PoseSeqInterpolator::PoseSeqInterpolator(const PoseSeqInterpolator& org)
+{
+    impl = new Impl(this, *org.impl);
+}
+
+
 PoseSeqInterpolator::Impl::Impl(PoseSeqInterpolator* self)
     : self(self)
 {
@@ -801,6 +867,113 @@ PoseSeqInterpolator::Impl::Impl(PoseSeqInterpolator* self)
     isLipSyncMixEnabled = false;
     
     needUpdate = true;
+    needToUpdateAllJoints = true;
+    hasModifiedTimeRange = false;
+    numPosesToUpdate = 0;
+}
+
+
+PoseSeqInterpolator::Impl::Impl(PoseSeqInterpolator* self, const Impl& org)
+    : Impl(self)
+{
+    setBody(org.body);
+    for(size_t i=0; i < jointInfos.size(); ++i){
+        jointInfos[i].useLinearInterpolation = org.jointInfos[i].useLinearInterpolation;
+    }
+    lipSyncJoints = org.lipSyncJoints;
+    lipSyncLinkIndices = org.lipSyncLinkIndices;
+    lipSyncShapes = org.lipSyncShapes;
+    lipSyncMaxTransitionTime = org.lipSyncMaxTransitionTime;
+    isLipSyncMixEnabled = org.isLipSyncMixEnabled;
+
+    // The signals of the sequence are not connected
+    poseSeq = org.poseSeq;
+
+    timeScaleRatio = org.timeScaleRatio;
+    isAutoZmpAdjustmentMode = org.isAutoZmpAdjustmentMode;
+    minZmpTransitionTime = org.minZmpTransitionTime;
+    zmpCenteringTimeThresh = org.zmpCenteringTimeThresh;
+    zmpTimeMarginBeforeLifting = org.zmpTimeMarginBeforeLifting;
+    zmpMaxDistanceFromCenterSqr = org.zmpMaxDistanceFromCenterSqr;
+
+    stepTrajectoryAdjustmentMode = org.stepTrajectoryAdjustmentMode;
+
+    stealthyHeightRatioThresh = org.stealthyHeightRatioThresh;
+    flatLiftingHeight = org.flatLiftingHeight;
+    flatLandingHeight = org.flatLandingHeight;
+    impactReductionHeight = org.impactReductionHeight;
+    impactReductionTime = org.impactReductionTime;
+    impactReductionVelocity = org.impactReductionVelocity;
+
+    toeContactTime = org.toeContactTime;
+    toeContactAngle = org.toeContactAngle;
+
+    if(!org.needUpdate && body){
+        copyInterpolationState(org);
+    }
+}
+
+
+/**
+   Copy the samples computed by the update function of the original object so that
+   the clone does not have to rebuild the interpolation of the whole sequence.
+   The sample iterators are reset to the beginning of the copied containers.
+*/
+void PoseSeqInterpolator::Impl::copyInterpolationState(const Impl& org)
+{
+    for(size_t i=0; i < jointInfos.size(); ++i){
+        JointInfo& info = jointInfos[i];
+        const JointInfo& orgInfo = org.jointInfos[i];
+        info.samples = orgInfo.samples;
+        info.iter = info.samples.begin();
+        info.prevSegmentDirectionSign = orgInfo.prevSegmentDirectionSign;
+        info.prev_q = orgInfo.prev_q;
+    }
+
+    ikLinkInfos = org.ikLinkInfos;
+    for(auto& kv : ikLinkInfos){
+        LinkInfo& info = kv.second;
+        info.iter = info.samples.begin();
+        info.auxIter = info.isFootLink ? info.auxSamples.begin() : info.auxSamples.end();
+    }
+    footLinkInfos.clear();
+    for(auto& orgInfo : org.footLinkInfos){
+        for(auto& kv : org.ikLinkInfos){
+            if(&kv.second == orgInfo){
+                footLinkInfos.push_back(&ikLinkInfos.find(kv.first)->second);
+                break;
+            }
+        }
+    }
+
+    zmpSamples = org.zmpSamples;
+    zmpIter = zmpSamples.begin();
+
+    lipSyncSeq = org.lipSyncSeq;
+    lipSyncIter = lipSyncSeq.begin();
+
+    invalidateCurrentInterpolation();
+    needUpdate = false;
+    needToUpdateAllJoints = false;
+    hasModifiedTimeRange = false;
+    numPosesToUpdate = org.numPosesToUpdate;
+}
+
+
+PoseSeqInterpolator::~PoseSeqInterpolator()
+{
+    impl->poseSeqConnections.disconnect();
+    delete impl;
+}
+
+
+PoseProvider* PoseSeqInterpolator::clonePoseProvider() const
+{
+    // Update the interpolation here so that the clones share the computed samples
+    if(impl->needUpdate){
+        impl->update();
+    }
+    return new PoseSeqInterpolator(*this);
 }
 
 
@@ -835,6 +1008,7 @@ void PoseSeqInterpolator::Impl::setBody(Body* body0)
     }
     
     needUpdate = true;
+    needToUpdateAllJoints = true;
 }
 
 
@@ -854,6 +1028,8 @@ void PoseSeqInterpolator::Impl::setLinearInterpolationJoint(int jointId)
 {
     if(jointId < (int)jointInfos.size()){
         jointInfos[jointId].useLinearInterpolation = true;
+        needUpdate = true;
+        needToUpdateAllJoints = true;
     }
 }
 
@@ -977,6 +1153,11 @@ void PoseSeqInterpolator::Impl::setPoseSeq(PoseSeq* seq)
             [this](PoseSeq::iterator it, bool isMoving){
                 onPoseAboutToBeRemoved(it, isMoving);
             }));
+    poseSeqConnections.add(
+        seq->sigPoseAboutToBeModified().connect(
+            [this](PoseSeq::iterator it){
+                onPoseAboutToBeModified(it);
+            }));
     poseSeqConnections.add(
         seq->sigPoseModified().connect(
             [this](PoseSeq::iterator it){
@@ -985,6 +1166,7 @@ void PoseSeqInterpolator::Impl::setPoseSeq(PoseSeq* seq)
     
     invalidateCurrentInterpolation();
     needUpdate = true;
+    needToUpdateAllJoints = true;
 }
 
 
@@ -1540,9 +1722,15 @@ bool PoseSeqInterpolator::Impl::update()
     if(!body || !poseSeq){
         return false;
     }
-    
-    for(size_t i=0; i < jointInfos.size(); ++i){
-        jointInfos[i].clear();
+
+    if(!hasModifiedTimeRange || numPosesToUpdate != static_cast<int>(poseSeq->size())){
+        // Some poses may have been changed without the signals
+        needToUpdateAllJoints = true;
+    }
+    if(needToUpdateAllJoints){
+        for(size_t i=0; i < jointInfos.size(); ++i){
+            jointInfos[i].clear();
+        }
     }
     ikLinkInfos.clear();
     zmpSamples.clear();
@@ -1576,24 +1764,12 @@ bool PoseSeqInterpolator::Impl::update()
         } else {
             appendLinkSamples(poseIter, pose);
 
-            const int n = std::min(pose->numJoints(), (int)jointInfos.size());
-
-            for(int i=0; i < n; ++i){
-                JointInfo& jointInfo = jointInfos[i];
-                if(pose->isJointValid(i)){
-
-                    // make a flipping point stationary point
-                    double q = pose->jointDisplacement(i);
-                    double sign = q - jointInfo.prev_q;
-                    if(jointInfo.prevSegmentDirectionSign * sign <= 0.0){
-                        if(!jointInfo.samples.empty()){
-                            jointInfo.samples.back().isEndPoint = true;
-                        }
+            if(needToUpdateAllJoints){
+                const int n = std::min(pose->numJoints(), (int)jointInfos.size());
+                for(int i=0; i < n; ++i){
+                    if(pose->isJointValid(i)){
+                        appendJointSample(jointInfos[i], i, poseIter, pose);
                     }
-                    jointInfo.prevSegmentDirectionSign = sign;
-                    jointInfo.prev_q = q;
-
-                    appendSample(jointInfo.samples, JointSample(poseIter, i, jointInfo.useLinearInterpolation));
                 }
             }
             if(pose->isZmpValid()){
@@ -1625,12 +1801,16 @@ bool PoseSeqInterpolator::Impl::update()
         }
     }
 
-    for(size_t i=0; i < jointInfos.size(); ++i){
-        JointInfo& info = jointInfos[i];
-        if(!info.useLinearInterpolation){
-            initializeInterpolation<1, JointSample, false>(info.samples);
+    if(needToUpdateAllJoints){
+        for(size_t i=0; i < jointInfos.size(); ++i){
+            JointInfo& info = jointInfos[i];
+            if(!info.useLinearInterpolation){
+                initializeInterpolation<1, JointSample, false>(info.samples);
+            }
+            info.iter = info.samples.begin();
         }
-        info.iter = info.samples.begin();
+    } else {
+        updateJointSamplesInModifiedTimeRange();
     }
     for(auto& kv : ikLinkInfos){
         LinkInfo& info = kv.second;
@@ -1649,6 +1829,9 @@ bool PoseSeqInterpolator::Impl::update()
 
     invalidateCurrentInterpolation();
     needUpdate = false;
+    needToUpdateAllJoints = false;
+    hasModifiedTimeRange = false;
+    numPosesToUpdate = poseSeq->size();
 
     sigUpdated();
 
@@ -1656,6 +1839,153 @@ bool PoseSeqInterpolator::Impl::update()
 }
 
 
+void PoseSeqInterpolator::Impl::appendJointSample
+(JointInfo& info, int jointId, PoseSeq::iterator poseIter, BodyKeyPose* pose)
+{
+    // make a flipping point stationary point
+    double q = pose->jointDisplacement(jointId);
+    double sign = q - info.prev_q;
+    if(info.prevSegmentDirectionSign * sign <= 0.0){
+        if(!info.samples.empty()){
+            info.samples.back().isEndPoint = true;
+        }
+    }
+    info.prevSegmentDirectionSign = sign;
+    info.prev_q = q;
+
+    appendSample(info.samples, JointSample(poseIter, jointId, info.useLinearInterpolation));
+}
+
+
+void PoseSeqInterpolator::Impl::updateJointSamplesInModifiedTimeRange()
+{
+    auto firstModifiedPoseIter = poseSeq->begin();
+    while(firstModifiedPoseIter != poseSeq->end() && firstModifiedPoseIter->time() < modifiedTimeMin){
+        ++firstModifiedPoseIter;
+    }
+    for(size_t i=0; i < jointInfos.size(); ++i){
+        if(!updateJointSamplesInModifiedTimeRange(i, firstModifiedPoseIter)){
+            rebuildJointSamples(i);
+        }
+    }
+}
+
+
+/**
+   A joint sample depends on the two preceding key poses because of the flipping point detection,
+   and on the adjacent samples because of the velocity determination. The samples are regenerated
+   from the second valid key pose before the modified range to the second one after the range,
+   and the samples from the first valid key pose before the range to the first one after the range
+   replace the existing ones. The connection segments around the replaced samples are then updated.
+   The resulting samples are the same as the ones rebuilt from the whole sequence.
+*/
+bool PoseSeqInterpolator::Impl::updateJointSamplesInModifiedTimeRange
+(int jointId, PoseSeq::iterator firstModifiedPoseIter)
+{
+    JointInfo& info = jointInfos[jointId];
+    JointSample::Seq& samples = info.samples;
+    const auto poseBegin = poseSeq->begin();
+    const auto poseEnd = poseSeq->end();
+
+    PoseSeq::iterator prevPoseIters[2];
+    int numPrevPoses = 0;
+    auto poseIter = firstModifiedPoseIter;
+    while(numPrevPoses < 2 && poseIter != poseBegin){
+        --poseIter;
+        if(getJointKeyPose(poseIter, jointId)){
+            prevPoseIters[numPrevPoses++] = poseIter;
+        }
+    }
+    PoseSeq::iterator nextPoseIters[2];
+    int numNextPoses = 0;
+    poseIter = firstModifiedPoseIter;
+    while(poseIter != poseEnd && poseIter->time() <= modifiedTimeMax){
+        ++poseIter;
+    }
+    while(numNextPoses < 2 && poseIter != poseEnd){
+        if(getJointKeyPose(poseIter, jointId)){
+            nextPoseIters[numNextPoses++] = poseIter;
+        }
+        ++poseIter;
+    }
+
+    JointInfo newInfo;
+    newInfo.useLinearInterpolation = info.useLinearInterpolation;
+    auto poseIterToEnd = (numNextPoses > 0) ? std::next(nextPoseIters[numNextPoses - 1]) : poseEnd;
+    poseIter = (numPrevPoses > 0) ? prevPoseIters[numPrevPoses - 1] : firstModifiedPoseIter;
+    while(poseIter != poseIterToEnd){
+        if(auto pose = getJointKeyPose(poseIter, jointId)){
+            appendJointSample(newInfo, jointId, poseIter, pose);
+        }
+        ++poseIter;
+    }
+    JointSample::Seq& newSamples = newInfo.samples;
+    if(!info.useLinearInterpolation){
+        usePredeterminedVelocities<1, JointSample>(newSamples);
+    }
+
+    auto newFirst = newSamples.begin();
+    auto oldFirst = samples.begin();
+    if(numPrevPoses > 0){
+        newFirst = findPoseSample<JointSample>(newSamples, newSamples.begin(), prevPoseIters[0]);
+        oldFirst = findPoseSample<JointSample>(samples, info.iter, prevPoseIters[0]);
+        if(newFirst == newSamples.end() || oldFirst == samples.end()){
+            return false;
+        }
+    }
+    auto newEnd = newSamples.end();
+    auto oldEnd = samples.end();
+    if(numNextPoses > 0){
+        newEnd = findPoseSample<JointSample>(newSamples, newSamples.end(), nextPoseIters[0]);
+        oldEnd = findPoseSample<JointSample>(samples, info.iter, nextPoseIters[0]);
+        if(newEnd == newSamples.end() || oldEnd == samples.end()){
+            return false;
+        }
+        ++newEnd;
+        ++oldEnd;
+    }
+
+    samples.erase(oldFirst, oldEnd);
+    const bool isAtBeginning = (oldEnd == samples.begin());
+    auto segmentIter = isAtBeginning ? samples.end() : std::prev(oldEnd);
+    samples.splice(oldEnd, newSamples, newFirst, newEnd);
+
+    if(!info.useLinearInterpolation){
+        if(isAtBeginning){
+            segmentIter = samples.begin();
+        }
+        while(segmentIter != oldEnd){
+            auto next = std::next(segmentIter);
+            if(next == samples.end()){
+                break;
+            }
+            updateCubicConnectionSegment<1, JointSample>(segmentIter);
+            segmentIter = next;
+        }
+    }
+
+    info.iter = samples.begin();
+
+    return true;
+}
+
+
+void PoseSeqInterpolator::Impl::rebuildJointSamples(int jointId)
+{
+    JointInfo& info = jointInfos[jointId];
+    info.clear();
+    for(auto poseIter = poseSeq->begin(); poseIter != poseSeq->end(); ++poseIter){
+        if(auto pose = getJointKeyPose(poseIter, jointId)){
+            appendJointSample(info, jointId, poseIter, pose);
+        }
+    }
+    if(!info.useLinearInterpolation){
+        initializeInterpolation<1, JointSample, false>(info.samples);
+    }
+    info.iter = info.samples.begin();
+}
+
+
 void PoseSeqInterpolator::Impl::appendLinkSamples(PoseSeq::iterator poseIter, BodyKeyPose* pose)
 {
     for(auto it = pose->ikLinkBegin(); it != pose->ikLinkEnd(); ++it){
@@ -2257,19 +2587,42 @@ LinkInfo* PoseSeqInterpolator::Impl::getIkLinkInfo(int linkIndex)
 }
 
 
-void PoseSeqInterpolator::Impl::onPoseInserted(PoseSeq::iterator /* pose */)
+void PoseSeqInterpolator::Impl::addModifiedTime(double time)
 {
+    if(!hasModifiedTimeRange){
+        modifiedTimeMin = time;
+        modifiedTimeMax = time;
+        hasModifiedTimeRange = true;
+    } else {
+        modifiedTimeMin = std::min(modifiedTimeMin, time);
+        modifiedTimeMax = std::max(modifiedTimeMax, time);
+    }
     needUpdate = true;
 }
 
 
-void PoseSeqInterpolator::Impl::onPoseAboutToBeRemoved(PoseSeq::iterator /* pose */, bool /* isMoving */)
+void PoseSeqInterpolator::Impl::onPoseInserted(PoseSeq::iterator pose)
 {
-    needUpdate = true;
+    addModifiedTime(pose->time());
+    ++numPosesToUpdate;
 }
 
 
-void PoseSeqInterpolator::Impl::onPoseModified(PoseSeq::iterator /* pose */)
+void PoseSeqInterpolator::Impl::onPoseAboutToBeRemoved(PoseSeq::iterator pose, bool /* isMoving */)
 {
-    needUpdate = true;
+    addModifiedTime(pose->time());
+    --numPosesToUpdate;
+}
+
+
+void PoseSeqInterpolator::Impl::onPoseAboutToBeModified(PoseSeq::iterator pose)
+{
+    // The time before the modification is necessary when the time of the pose is changed
+    addModifiedTime(pose->time());
+}
+
+
+void PoseSeqInterpolator::Impl::onPoseModified(PoseSeq::iterator pose)
+{
+    addModifiedTime(pose->time());
 }
@@ -15,6 +15,14 @@ class CNOID_EXPORT PoseSeqInterpolator : public PoseProvider
 {
 public:
     PoseSeqInterpolator();
+    PoseSeqInterpolator(const PoseSeqInterpolator& org);
+    virtual ~PoseSeqInterpolator();
+
+    /**
+       The cloned interpolator shares the pose sequence with the original one and
+       is not updated by the modification of the sequence.
+    */
+    virtual PoseProvider* clonePoseProvider() const override;
 
     void setBody(Body* body);
     virtual Body* body() const override;
@@ -0,0 +1,296 @@
+#include "CollisionBroadphase.h"
+#include <algorithm>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+struct Proxy
+{
+    // Fattened box registered in the sweep list
+    Vector3 min;
+    Vector3 max;
+    bool isStatic;
+    bool isEnabled;
+    bool isValid;
+    int activeIndex;
+};
+
+struct EndPoint
+{
+    double value;
+    int id;
+    bool isMin;
+
+    bool operator<(const EndPoint& rhs) const {
+        if(value < rhs.value){
+            return true;
+        } else if(value == rhs.value){
+            // Min points come first so that touching boxes are detected as overlapping
+            return isMin && !rhs.isMin;
+        }
+        return false;
+    }
+};
+
+}
+
+namespace cnoid {
+
+class CollisionBroadphase::Impl
+{
+public:
+    vector<Proxy> proxies;
+    vector<EndPoint> endPoints;
+    vector<int> activeIds;
+    vector<IdPair<int>> overlappingPairs;
+    double margin;
+    int axis;
+    bool needToRebuildEndPoints;
+
+    Impl();
+    void updateObject(int id, const Vector3& min, const Vector3& max);
+    void rebuildEndPoints();
+    void sortEndPoints();
+    bool checkOverlap(const Proxy& p1, const Proxy& p2) const;
+    void findOverlappingPairs();
+};
+
+}
+
+
+CollisionBroadphase::CollisionBroadphase()
+{
+    impl = new Impl;
+}
+
+
+CollisionBroadphase::Impl::Impl()
+{
+    margin = 0.005;
+    axis = 0;
+    needToRebuildEndPoints = true;
+}
+
+
+CollisionBroadphase::~CollisionBroadphase()
+{
+    delete impl;
+}
+
+
+void CollisionBroadphase::clear()
+{
+    impl->proxies.clear();
+    impl->endPoints.clear();
+    impl->activeIds.clear();
+    impl->overlappingPairs.clear();
+    impl->needToRebuildEndPoints = true;
+}
+
+
+int CollisionBroadphase::addObject(bool isStatic)
+{
+    int id = impl->proxies.size();
+    impl->proxies.emplace_back();
+    auto& proxy = impl->proxies.back();
+    proxy.min.setZero();
+    proxy.max.setZero();
+    proxy.isStatic = isStatic;
+    proxy.isEnabled = true;
+    proxy.isValid = false;
+    proxy.activeIndex = -1;
+    impl->needToRebuildEndPoints = true;
+    return id;
+}
+
+
+int CollisionBroadphase::numObjects() const
+{
+    return impl->proxies.size();
+}
+
+
+void CollisionBroadphase::setObjectStatic(int id, bool on)
+{
+    impl->proxies[id].isStatic = on;
+}
+
+
+void CollisionBroadphase::setObjectEnabled(int id, bool on)
+{
+    impl->proxies[id].isEnabled = on;
+}
+
+
+void CollisionBroadphase::setMargin(double margin)
+{
+    impl->margin = margin;
+}
+
+
+double CollisionBroadphase::margin() const
+{
+    return impl->margin;
+}
+
+
+void CollisionBroadphase::updateObject(int id, const BoundingBox& bbox)
+{
+    if(bbox.empty()){
+        impl->proxies[id].isValid = false;
+    } else {
+        impl->updateObject(id, bbox.min(), bbox.max());
+    }
+}
+
+
+void CollisionBroadphase::updateObject(int id, const Vector3& min, const Vector3& max)
+{
+    impl->updateObject(id, min, max);
+}
+
+
+void CollisionBroadphase::Impl::updateObject(int id, const Vector3& min, const Vector3& max)
+{
+    auto& proxy = proxies[id];
+
+    // The registered box is kept while the actual box is inside it
+    if(proxy.isValid &&
+       (min.array() >= proxy.min.array()).all() && (max.array() <= proxy.max.array()).all()){
+        return;
+    }
+    proxy.min = min.array() - margin;
+    proxy.max = max.array() + margin;
+    proxy.isValid = true;
+}
+
+
+bool CollisionBroadphase::checkOverlap(int id1, int id2) const
+{
+    return impl->checkOverlap(impl->proxies[id1], impl->proxies[id2]);
+}
+
+
+bool CollisionBroadphase::Impl::checkOverlap(const Proxy& p1, const Proxy& p2) const
+{
+    return p1.isValid && p2.isValid &&
+        (p1.min.array() <= p2.max.array()).all() && (p2.min.array() <= p1.max.array()).all();
+}
+
+
+const std::vector<IdPair<int>>& CollisionBroadphase::findOverlappingPairs()
+{
+    impl->findOverlappingPairs();
+    return impl->overlappingPairs;
+}
+
+
+/**
+   The sweep axis is selected as the axis where the centers of the boxes are most scattered.
+*/
+void CollisionBroadphase::Impl::rebuildEndPoints()
+{
+    const int n = proxies.size();
+    Vector3 sum = Vector3::Zero();
+    Vector3 sum2 = Vector3::Zero();
+    int numValidProxies = 0;
+    for(auto& proxy : proxies){
+        if(proxy.isValid){
+            Vector3 c = (proxy.min + proxy.max) / 2.0;
+            sum += c;
+            sum2 += c.cwiseProduct(c);
+            ++numValidProxies;
+        }
+    }
+    if(numValidProxies > 0){
+        Vector3 mean = sum / numValidProxies;
+        Vector3 variance = sum2 / numValidProxies - mean.cwiseProduct(mean);
+        variance.maxCoeff(&axis);
+    }
+
+    endPoints.resize(n * 2);
+    for(int i=0; i < n; ++i){
+        auto& proxy = proxies[i];
+        auto& p0 = endPoints[i * 2];
+        p0.id = i;
+        p0.isMin = true;
+        p0.value = proxy.min[axis];
+        auto& p1 = endPoints[i * 2 + 1];
+        p1.id = i;
+        p1.isMin = false;
+        p1.value = proxy.max[axis];
+    }
+    std::sort(endPoints.begin(), endPoints.end());
+
+    needToRebuildEndPoints = false;
+}
+
+
+/**
+   Insertion sort is used because the end points are almost sorted when the objects
+   move coherently between the updates.
+*/
+void CollisionBroadphase::Impl::sortEndPoints()
+{
+    for(auto& point : endPoints){
+        auto& proxy = proxies[point.id];
+        point.value = point.isMin ? proxy.min[axis] : proxy.max[axis];
+    }
+    const int n = endPoints.size();
+    for(int i=1; i < n; ++i){
+        EndPoint point = endPoints[i];
+        int j = i - 1;
+        while(j >= 0 && point < endPoints[j]){
+            endPoints[j + 1] = endPoints[j];
+            --j;
+        }
+        endPoints[j + 1] = point;
+    }
+}
+
+
+void CollisionBroadphase::Impl::findOverlappingPairs()
+{
+    if(needToRebuildEndPoints){
+        rebuildEndPoints();
+    } else {
+        sortEndPoints();
+    }
+
+    overlappingPairs.clear();
+    activeIds.clear();
+
+    for(auto& point : endPoints){
+        auto& proxy = proxies[point.id];
+        if(!proxy.isValid || !proxy.isEnabled){
+            continue;
+        }
+        if(point.isMin){
+            for(auto& activeId : activeIds){
+                auto& activeProxy = proxies[activeId];
+                if(proxy.isStatic && activeProxy.isStatic){
+                    continue;
+                }
+                if(checkOverlap(proxy, activeProxy)){
+                    overlappingPairs.emplace_back(point.id, activeId);
+                }
+            }
+            proxy.activeIndex = activeIds.size();
+            activeIds.push_back(point.id);
+        } else {
+            // Remove the id from the active list by swapping it with the last element
+            int index = proxy.activeIndex;
+            if(index >= 0){
+                int lastId = activeIds.back();
+                activeIds[index] = lastId;
+                proxies[lastId].activeIndex = index;
+                activeIds.pop_back();
+                proxy.activeIndex = -1;
+            }
+        }
+    }
+
+    std::sort(overlappingPairs.begin(), overlappingPairs.end());
+}
@@ -0,0 +1,68 @@
+#ifndef CNOID_UTIL_COLLISION_BROADPHASE_H
+#define CNOID_UTIL_COLLISION_BROADPHASE_H
+
+#include "BoundingBox.h"
+#include "IdPair.h"
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class implements the broad-phase collision culling with the sweep and prune method.
+   Objects are registered as the axis-aligned bounding boxes in the world coordinate and the
+   pairs of the objects whose boxes overlap are extracted by the findOverlappingPairs function.
+   The end points on the sweep axis are kept sorted between the updates so that the sort cost
+   is almost linear when the objects move coherently.
+
+   The class can be shared by any collision detector implementation that needs to cull
+   the geometry pairs before the narrow-phase detection.
+*/
+class CNOID_EXPORT CollisionBroadphase
+{
+public:
+    CollisionBroadphase();
+    CollisionBroadphase(const CollisionBroadphase& org) = delete;
+    ~CollisionBroadphase();
+
+    void clear();
+
+    /**
+       \return The id of the added object. Ids are given as sequential numbers from zero.
+       \note A pair of static objects is never reported as an overlapping pair.
+    */
+    int addObject(bool isStatic = false);
+    int numObjects() const;
+
+    void setObjectStatic(int id, bool on);
+    void setObjectEnabled(int id, bool on);
+
+    /**
+       The bounding boxes are fattened by this margin so that the end points do not have to
+       be updated while the objects move within the margin. The default value is 0.005.
+    */
+    void setMargin(double margin);
+    double margin() const;
+
+    void updateObject(int id, const BoundingBox& bbox);
+    void updateObject(int id, const Vector3& min, const Vector3& max);
+
+    /**
+       \return The pairs of the overlapping objects. Each pair is given as (smaller id, larger id)
+       and the pairs are sorted in ascending order so that the result is deterministic.
+    */
+    const std::vector<IdPair<int>>& findOverlappingPairs();
+
+    /**
+       This function only checks the current boxes of the two objects.
+    */
+    bool checkOverlap(int id1, int id2) const;
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
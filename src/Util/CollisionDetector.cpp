@@ -182,6 +182,18 @@ bool CollisionDetector::isDynamicGeometryPairChangeEnabled() const
 }
 
 
+bool CollisionDetector::setBroadphaseEnabled(bool /* on */)
+{
+    return false;
+}
+
+
+bool CollisionDetector::isBroadphaseEnabled() const
+{
+    return false;
+}
+
+
 // This function should be a pure virtual function
 void CollisionDetector::detectCollisions
 (GeometryHandle /* geometry */, std::function<void(const CollisionPair& collisionPair)> /* callback */)
@@ -70,6 +70,15 @@ public:
     virtual void setDynamicGeometryPairChangeEnabled(bool on);
     virtual bool isDynamicGeometryPairChangeEnabled() const;
 
+    /**
+       If the broad-phase culling is enabled, only the geometry pairs whose axis-aligned bounding boxes
+       in the world coordinate overlap are checked in the narrow-phase collision detection.
+       The CollisionBroadphase class can be used to implement this function. Note that this mode is optional.
+       \return false if the detector does not support the broad-phase culling.
+    */
+    virtual bool setBroadphaseEnabled(bool on);
+    virtual bool isBroadphaseEnabled() const;
+
     virtual bool makeReady() = 0;
     
     virtual void updatePosition(GeometryHandle geometry, const Isometry3& position) = 0;
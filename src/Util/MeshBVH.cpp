@@ -0,0 +1,360 @@
+#include "MeshBVH.h"
+#include "MeshExtractor.h"
+#include "SceneDrawables.h"
+#include <algorithm>
+#include <vector>
+#include <cmath>
+
+using namespace std;
+using namespace cnoid;
+using Eigen::Array4f;
+using Eigen::Array4i;
+
+namespace {
+
+const int MaxNumLeafTriangles = 4;
+const int MaxStackSize = 64;
+const float DeterminantEpsilon = 1.0e-12f;
+
+struct Node
+{
+    Vector3f min;
+    Vector3f max;
+    int firstIndex;
+    int numTriangles; // zero for an inner node
+    int rightChild; // the left child follows its parent
+    int axis;
+};
+
+struct Triangle
+{
+    Vector3f v0;
+    Vector3f e1;
+    Vector3f e2;
+    int colorIndex;
+};
+
+}
+
+namespace cnoid {
+
+class MeshBVH::Impl
+{
+public:
+    vector<Node> nodes;
+    vector<Triangle> triangles;
+    vector<Vector3f> colors;
+
+    // Used in building the hierarchy
+    vector<Triangle> srcTriangles;
+    vector<Vector3f> mins;
+    vector<Vector3f> maxs;
+    vector<Vector3f> centers;
+    vector<int> indices;
+
+    int build(SgNode* node);
+    int buildNode(int first, int last);
+};
+
+}
+
+
+MeshBVH::MeshBVH()
+{
+    impl = new Impl;
+}
+
+
+MeshBVH::~MeshBVH()
+{
+    delete impl;
+}
+
+
+void MeshBVH::clear()
+{
+    impl->nodes.clear();
+    impl->triangles.clear();
+    impl->colors.clear();
+}
+
+
+int MeshBVH::build(SgNode* node)
+{
+    clear();
+    return impl->build(node);
+}
+
+
+int MeshBVH::Impl::build(SgNode* node)
+{
+    // The first color is used for the shapes without a material.
+    // White is the default diffuse color of SgMaterial.
+    colors.push_back(Vector3f(1.0f, 1.0f, 1.0f));
+
+    MeshExtractor extractor;
+    extractor.extract(
+        node,
+        [&](SgMesh* mesh){
+            int colorIndex = 0;
+            if(auto material = extractor.currentShape()->material()){
+                colorIndex = colors.size();
+                colors.push_back(material->diffuseColor());
+            }
+            const Affine3f T = extractor.currentTransform().cast<float>();
+            const auto& vertices = *mesh->vertices();
+            const int n = mesh->numTriangles();
+            for(int i=0; i < n; ++i){
+                auto triangle = mesh->triangle(i);
+                Triangle tri;
+                tri.v0 = T * vertices[triangle[0]];
+                tri.e1 = T * vertices[triangle[1]] - tri.v0;
+                tri.e2 = T * vertices[triangle[2]] - tri.v0;
+                tri.colorIndex = colorIndex;
+                srcTriangles.push_back(tri);
+            }
+        });
+
+    const int numTriangles = srcTriangles.size();
+    if(numTriangles > 0){
+        mins.resize(numTriangles);
+        maxs.resize(numTriangles);
+        centers.resize(numTriangles);
+        indices.resize(numTriangles);
+        for(int i=0; i < numTriangles; ++i){
+            const auto& tri = srcTriangles[i];
+            const Vector3f v1 = tri.v0 + tri.e1;
+            const Vector3f v2 = tri.v0 + tri.e2;
+            mins[i] = tri.v0.cwiseMin(v1).cwiseMin(v2);
+            maxs[i] = tri.v0.cwiseMax(v1).cwiseMax(v2);
+            centers[i] = 0.5f * (mins[i] + maxs[i]);
+            indices[i] = i;
+        }
+        nodes.reserve(2 * numTriangles / MaxNumLeafTriangles + 1);
+        buildNode(0, numTriangles);
+
+        // The triangles are stored in the order of the leaves
+        triangles.resize(numTriangles);
+        for(int i=0; i < numTriangles; ++i){
+            triangles[i] = srcTriangles[indices[i]];
+        }
+    }
+
+    srcTriangles.clear();
+    srcTriangles.shrink_to_fit();
+    mins.clear();
+    maxs.clear();
+    centers.clear();
+    indices.clear();
+
+    return numTriangles;
+}
+
+
+/**
+   The triangles are split at the median of the longest axis of the box enclosing their centers.
+   This keeps the depth of the tree within log2 of the number of the triangles.
+*/
+int MeshBVH::Impl::buildNode(int first, int last)
+{
+    const int nodeIndex = nodes.size();
+    nodes.emplace_back();
+
+    Vector3f vmin = mins[indices[first]];
+    Vector3f vmax = maxs[indices[first]];
+    Vector3f cmin = centers[indices[first]];
+    Vector3f cmax = cmin;
+    for(int i = first + 1; i < last; ++i){
+        const int index = indices[i];
+        vmin = vmin.cwiseMin(mins[index]);
+        vmax = vmax.cwiseMax(maxs[index]);
+        cmin = cmin.cwiseMin(centers[index]);
+        cmax = cmax.cwiseMax(centers[index]);
+    }
+    nodes[nodeIndex].min = vmin;
+    nodes[nodeIndex].max = vmax;
+    nodes[nodeIndex].firstIndex = first;
+
+    if(last - first <= MaxNumLeafTriangles){
+        nodes[nodeIndex].numTriangles = last - first;
+        nodes[nodeIndex].rightChild = -1;
+        nodes[nodeIndex].axis = 0;
+        return nodeIndex;
+    }
+
+    int axis;
+    (cmax - cmin).maxCoeff(&axis);
+    const int middle = (first + last) / 2;
+    std::nth_element(
+        indices.begin() + first, indices.begin() + middle, indices.begin() + last,
+        [&](int i1, int i2){ return centers[i1][axis] < centers[i2][axis]; });
+
+    nodes[nodeIndex].numTriangles = 0;
+    nodes[nodeIndex].axis = axis;
+    buildNode(first, middle);
+    const int rightChild = buildNode(middle, last);
+    nodes[nodeIndex].rightChild = rightChild;
+
+    return nodeIndex;
+}
+
+
+int MeshBVH::numTriangles() const
+{
+    return impl->triangles.size();
+}
+
+
+const Vector3f& MeshBVH::triangleColor(int triangleIndex) const
+{
+    return impl->colors[impl->triangles[triangleIndex].colorIndex];
+}
+
+
+bool MeshBVH::castRay
+(const Vector3f& origin, const Vector3f& direction, float minDistance,
+ float& io_distance, int& io_triangleIndex) const
+{
+    if(impl->nodes.empty()){
+        return false;
+    }
+    const Vector3f invDirection = direction.cwiseInverse();
+    bool updated = false;
+    int stack[MaxStackSize];
+    int stackSize = 0;
+    int nodeIndex = 0;
+
+    while(true){
+        const Node& node = impl->nodes[nodeIndex];
+        const Vector3f t1 = (node.min - origin).cwiseProduct(invDirection);
+        const Vector3f t2 = (node.max - origin).cwiseProduct(invDirection);
+        const float tnear = t1.cwiseMin(t2).maxCoeff();
+        const float tfar = t1.cwiseMax(t2).minCoeff();
+
+        if(tnear <= tfar && tfar >= minDistance && tnear <= io_distance){
+            if(node.numTriangles == 0){
+                const int leftChild = nodeIndex + 1;
+                if(direction[node.axis] < 0.0f){
+                    stack[stackSize++] = leftChild;
+                    nodeIndex = node.rightChild;
+                } else {
+                    stack[stackSize++] = node.rightChild;
+                    nodeIndex = leftChild;
+                }
+                continue;
+            }
+            const int end = node.firstIndex + node.numTriangles;
+            for(int i = node.firstIndex; i < end; ++i){
+                const Triangle& tri = impl->triangles[i];
+                const Vector3f p = direction.cross(tri.e2);
+                const float det = tri.e1.dot(p);
+                if(std::abs(det) <= DeterminantEpsilon){
+                    continue;
+                }
+                const float invDet = 1.0f / det;
+                const Vector3f t = origin - tri.v0;
+                const float u = t.dot(p) * invDet;
+                if(u < 0.0f || u > 1.0f){
+                    continue;
+                }
+                const Vector3f q = t.cross(tri.e1);
+                const float v = direction.dot(q) * invDet;
+                if(v < 0.0f || u + v > 1.0f){
+                    continue;
+                }
+                const float distance = tri.e2.dot(q) * invDet;
+                if(distance > minDistance && distance < io_distance){
+                    io_distance = distance;
+                    io_triangleIndex = i;
+                    updated = true;
+                }
+            }
+        }
+        if(stackSize == 0){
+            break;
+        }
+        nodeIndex = stack[--stackSize];
+    }
+
+    return updated;
+}
+
+
+bool MeshBVH::castRays
+(const Vector3f& origin, const Array4f& dx, const Array4f& dy, const Array4f& dz,
+ float minDistance, Array4f& io_distances, Array4i& io_triangleIndices) const
+{
+    if(impl->nodes.empty()){
+        return false;
+    }
+    const Array4f invdx = dx.inverse();
+    const Array4f invdy = dy.inverse();
+    const Array4f invdz = dz.inverse();
+    const Array4f dirs[] = { dx, dy, dz };
+    bool updated = false;
+    int stack[MaxStackSize];
+    int stackSize = 0;
+    int nodeIndex = 0;
+
+    while(true){
+        const Node& node = impl->nodes[nodeIndex];
+        Array4f t1 = (node.min.x() - origin.x()) * invdx;
+        Array4f t2 = (node.max.x() - origin.x()) * invdx;
+        Array4f tnear = t1.min(t2);
+        Array4f tfar = t1.max(t2);
+        t1 = (node.min.y() - origin.y()) * invdy;
+        t2 = (node.max.y() - origin.y()) * invdy;
+        tnear = tnear.max(t1.min(t2));
+        tfar = tfar.min(t1.max(t2));
+        t1 = (node.min.z() - origin.z()) * invdz;
+        t2 = (node.max.z() - origin.z()) * invdz;
+        tnear = tnear.max(t1.min(t2));
+        tfar = tfar.min(t1.max(t2));
+
+        if(((tnear <= tfar) && (tfar >= minDistance) && (tnear <= io_distances)).any()){
+            if(node.numTriangles == 0){
+                // The nearer child for the first ray is visited first
+                const int leftChild = nodeIndex + 1;
+                if(dirs[node.axis][0] < 0.0f){
+                    stack[stackSize++] = leftChild;
+                    nodeIndex = node.rightChild;
+                } else {
+                    stack[stackSize++] = node.rightChild;
+                    nodeIndex = leftChild;
+                }
+                continue;
+            }
+            const int end = node.firstIndex + node.numTriangles;
+            for(int i = node.firstIndex; i < end; ++i){
+                const Triangle& tri = impl->triangles[i];
+                const Vector3f& e1 = tri.e1;
+                const Vector3f& e2 = tri.e2;
+                // The vectors depending only on the origin are common to the four rays
+                const Vector3f t = origin - tri.v0;
+                const Vector3f q = t.cross(e1);
+                const Array4f px = dy * e2.z() - dz * e2.y();
+                const Array4f py = dz * e2.x() - dx * e2.z();
+                const Array4f pz = dx * e2.y() - dy * e2.x();
+                const Array4f det = e1.x() * px + e1.y() * py + e1.z() * pz;
+                const Array4f invDet = det.inverse();
+                const Array4f u = (t.x() * px + t.y() * py + t.z() * pz) * invDet;
+                const Array4f v = (dx * q.x() + dy * q.y() + dz * q.z()) * invDet;
+                const Array4f distances = e2.dot(q) * invDet;
+                const Eigen::Array<bool, 4, 1> hit =
+                    (det.abs() > DeterminantEpsilon) && (u >= 0.0f) && (v >= 0.0f) && (u + v <= 1.0f) &&
+                    (distances > minDistance) && (distances < io_distances);
+                if(hit.any()){
+                    io_distances = hit.select(distances, io_distances);
+                    io_triangleIndices = hit.select(Array4i::Constant(i), io_triangleIndices);
+                    updated = true;
+                }
+            }
+        }
+        if(stackSize == 0){
+            break;
+        }
+        nodeIndex = stack[--stackSize];
+    }
+
+    return updated;
+}
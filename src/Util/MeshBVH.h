@@ -0,0 +1,61 @@
+#ifndef CNOID_UTIL_MESH_BVH_H
+#define CNOID_UTIL_MESH_BVH_H
+
+#include "EigenTypes.h"
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class SgNode;
+
+/**
+   This class builds a bounding volume hierarchy of the triangles of the meshes in a scene graph
+   and casts rays against the triangles. The triangles are stored in the coordinate of the node
+   given to the build function. The ray casting functions do not modify the hierarchy, so an
+   instance can be shared by the threads that cast rays concurrently.
+
+   The directions of the rays do not have to be normalized. The distances are given in units
+   of the direction lengths, and a distance is only updated when a triangle is hit between
+   the minimum distance and the current value of the distance.
+*/
+class CNOID_EXPORT MeshBVH
+{
+public:
+    MeshBVH();
+    MeshBVH(const MeshBVH& org) = delete;
+    ~MeshBVH();
+
+    void clear();
+
+    //! \return The number of the triangles
+    int build(SgNode* node);
+
+    int numTriangles() const;
+    bool empty() const { return numTriangles() == 0; }
+
+    //! The diffuse color of the material of the shape including the triangle
+    const Vector3f& triangleColor(int triangleIndex) const;
+
+    bool castRay(
+        const Vector3f& origin, const Vector3f& direction, float minDistance,
+        float& io_distance, int& io_triangleIndex) const;
+
+    /**
+       Casting a packet of four rays that have the same origin. The rays are traversed together,
+       and the intersection tests are applied to the four rays at once. The rays should be
+       coherent for the traversal to be efficient.
+       \return True if any of the distances is updated.
+    */
+    bool castRays(
+        const Vector3f& origin,
+        const Eigen::Array4f& dx, const Eigen::Array4f& dy, const Eigen::Array4f& dz,
+        float minDistance, Eigen::Array4f& io_distances, Eigen::Array4i& io_triangleIndices) const;
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
@@ -0,0 +1,110 @@
+/**
+   This test checks the model cache of AISTCollisionDetector enabled by the environment
+   variable CNOID_AIST_MODEL_CACHE_DIR, which is given by the test definition.
+*/
+#include <cnoid/AISTCollisionDetector>
+#include <cnoid/MeshGenerator>
+#include <cnoid/SceneDrawables>
+#include <cnoid/stdx/filesystem>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+using namespace cnoid;
+namespace filesystem = cnoid::stdx::filesystem;
+
+namespace {
+
+const int NumShapes = 300;
+int numFailures = 0;
+
+void check(bool condition, const char* message)
+{
+    if(!condition){
+        cerr << "Failed: " << message << endl;
+        ++numFailures;
+    }
+}
+
+int countCacheFiles(const string& directory)
+{
+    int n = 0;
+    for(auto& entry : filesystem::directory_iterator(filesystem::path(directory))){
+        if(entry.path().extension() == ".coldet"){
+            ++n;
+        }
+    }
+    return n;
+}
+
+bool detectCollisionOfOverlappingShapes(SgMesh* mesh)
+{
+    AISTCollisionDetector detector;
+    SgShapePtr shape1 = new SgShape;
+    shape1->setMesh(mesh);
+    SgShapePtr shape2 = new SgShape;
+    shape2->setMesh(mesh);
+    auto handle1 = detector.addGeometry(shape1);
+    auto handle2 = detector.addGeometry(shape2);
+    if(!handle1 || !handle2){
+        return false;
+    }
+    detector.makeReady();
+    Isometry3 T = Isometry3::Identity();
+    detector.updatePosition(*handle1, T);
+    T.translation().x() = 0.05;
+    detector.updatePosition(*handle2, T);
+    bool detected = false;
+    detector.detectCollisions([&](const CollisionPair&){ detected = true; });
+    return detected;
+}
+
+}
+
+int main()
+{
+    check(AISTCollisionDetector::isModelCacheEnabled(), "the cache is enabled by the environment variable");
+    const string directory = AISTCollisionDetector::modelCacheDirectory();
+    check(!directory.empty(), "the cache directory is given by the environment variable");
+    if(directory.empty()){
+        return 1;
+    }
+    for(auto& entry : filesystem::directory_iterator(filesystem::path(directory))){
+        stdx::error_code ec;
+        filesystem::remove(entry.path(), ec);
+    }
+
+    // A cylinder is used so that the model is not replaced with a primitive
+    MeshGenerator meshGenerator;
+    SgMeshPtr mesh = meshGenerator.generateCylinder(0.1, 0.2);
+
+    {
+        AISTCollisionDetector detector;
+        vector<SgShapePtr> shapes;
+        for(int i=0; i < NumShapes; ++i){
+            SgShapePtr shape = new SgShape;
+            shape->setMesh(mesh);
+            shapes.push_back(shape);
+            check(static_cast<bool>(detector.addGeometry(shape)), "the geometry is added");
+        }
+        check(AISTCollisionDetector::numCachedModels() == 1, "the identical meshes share a model");
+        check(countCacheFiles(directory) == 1, "the built model is stored in the directory");
+    }
+
+    check(detectCollisionOfOverlappingShapes(mesh), "the collision is detected with the cached model");
+
+    // The model is loaded from the directory after the in-memory cache is cleared
+    AISTCollisionDetector::clearModelCache();
+    check(AISTCollisionDetector::numCachedModels() == 0, "the cache is cleared");
+    check(detectCollisionOfOverlappingShapes(mesh), "the collision is detected with the loaded model");
+    check(AISTCollisionDetector::numCachedModels() == 1, "the loaded model is cached");
+
+    AISTCollisionDetector::setModelCacheEnabled(false);
+    check(AISTCollisionDetector::numCachedModels() == 0, "disabling the cache releases the models");
+
+    if(numFailures > 0){
+        return 1;
+    }
+    cout << "AISTModelCacheTest passed." << endl;
+    return 0;
+}